@@ -0,0 +1,73 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FLEXFLOW_ACTIVATION_PLANNER_H__
+#define __FLEXFLOW_ACTIVATION_PLANNER_H__
+
+#include <cstddef>
+#include <vector>
+
+namespace FlexFlow {
+
+/**
+ * @brief Lifetime and footprint of one activation tensor over an operator
+ * schedule.
+ */
+struct ActivationInterval {
+  // Index of the operator that writes the tensor
+  int first_op = 0;
+  // Index of the last operator that reads it; equal to first_op if the
+  // tensor is never read
+  int last_op = 0;
+  // Bytes of the tensor on each device it is placed on
+  size_t bytes = 0;
+  // Tensors of the same class can be bound to the same buffer (e.g., same
+  // shape on the same devices)
+  int reuse_class = 0;
+  // Tensors of different arenas never share memory (e.g., different
+  // pipeline stages)
+  int arena = 0;
+};
+
+/**
+ * @brief Result of plan_activation_memory.
+ */
+struct ActivationPlan {
+  // Per tensor: the buffer it is bound to. Buffers are numbered in the
+  // order they are first used.
+  std::vector<int> buffer;
+  // Per buffer: its bytes (the same for all of its tensors)
+  std::vector<size_t> buffer_bytes;
+  // Per arena: the bytes of one buffer per tensor
+  std::vector<size_t> naive_bytes;
+  // Per arena: the bytes of the buffers in the buffer binding
+  std::vector<size_t> reused_bytes;
+};
+
+/**
+ * @brief Plan the activation memory of an operator schedule.
+ *
+ * @details Each tensor is bound to a buffer of its class whose previous
+ * tensors are all dead by the time it is written, scanning the schedule
+ * once. Buffers are shared within a class only, since InferenceManager
+ * backs each buffer with a Legion region, which only tensors with its index
+ * space can reuse.
+ */
+ActivationPlan
+    plan_activation_memory(std::vector<ActivationInterval> const &tensors);
+
+}; // namespace FlexFlow
+
+#endif // __FLEXFLOW_ACTIVATION_PLANNER_H__
@@ -0,0 +1,118 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FLEXFLOW_BPE_TOKENIZER_H__
+#define __FLEXFLOW_BPE_TOKENIZER_H__
+
+#include "flexflow/gpt_tokenizer.h"
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace FlexFlow {
+
+/**
+ * @brief Byte-level BPE tokenizer for GPT-2 style vocab and merge files.
+ *
+ * @details Produces the same ids as GPT_Tokenizer. Text is split into
+ * pieces by a hand-written UTF-8 scanner equivalent to the GPT-2 regex, and
+ * each piece is merged on integer symbol ids: symbols 0-255 are the raw
+ * bytes and every merge rule gets the id of its result, so the merge table
+ * maps a pair of ids to (rank, merged id). A piece is merged with a min-heap
+ * of candidate pairs over a linked list of symbols instead of rescanning all
+ * pairs after each merge. Merged pieces are memoized in a sharded cache, so
+ * all methods are safe to call from several threads at once.
+ */
+class BPETokenizer {
+public:
+  BPETokenizer(tokenizer_mode mode,
+               std::string const &vocab_file,
+               std::string const &merge_file,
+               std::string const &pad_token = "<pad>",
+               std::string const &unk_token = "<unk>");
+  // Token ids of text, without padding or special tokens
+  std::vector<int32_t> encode(std::string const &text) const;
+  // Same output as GPT_Tokenizer::encode: at most max_length - 1 tokens,
+  // padded to max_length, and prefixed with </s> (id 2) for OPT
+  void encode(std::string const &text,
+              size_t max_length,
+              std::vector<int32_t> *input_ids,
+              std::vector<int32_t> *mask_ids) const;
+  std::string decode(std::vector<int32_t> const &input_ids) const;
+  // Same output as GPT_Tokenizer::decode
+  std::string decode(std::vector<int32_t> const &input_ids,
+                     std::vector<int32_t> const &mask_ids) const;
+  // Batched versions of encode(text) and decode(input_ids), split across
+  // num_threads threads (0 for one per core)
+  std::vector<std::vector<int32_t>>
+      encode_batch(std::vector<std::string> const &texts,
+                   int num_threads = 0) const;
+  std::vector<std::string>
+      decode_batch(std::vector<std::vector<int32_t>> const &input_ids,
+                   int num_threads = 0) const;
+  int32_t pad_token_id() const {
+    return pad_id;
+  }
+  int32_t unk_token_id() const {
+    return unk_id;
+  }
+
+  tokenizer_mode mode;
+
+private:
+  struct Merge {
+    int32_t rank;
+    int32_t merged;
+  };
+  struct CacheShard {
+    std::mutex mutex;
+    std::unordered_map<std::string, std::vector<int32_t>> pieces;
+  };
+  static constexpr int NUM_CACHE_SHARDS = 64;
+  // Pieces at least this long are rarely repeated and are not cached
+  static constexpr size_t CACHE_PIECE_MAX_BYTES = 32;
+  static constexpr size_t CACHE_SHARD_MAX_SIZE = 32768;
+
+  void load_merge(std::string const &merge_file,
+                  std::unordered_map<std::string, int32_t> *symbols);
+  void load_vocab(std::string const &vocab_file,
+                  std::unordered_map<std::string, int32_t> const &symbols,
+                  std::string const &pad_token,
+                  std::string const &unk_token);
+  void encode_piece(char const *piece,
+                    size_t length,
+                    std::vector<int32_t> *output) const;
+  void merge_piece(char const *piece,
+                   size_t length,
+                   std::vector<int32_t> *output) const;
+  static uint64_t pair_key(int32_t left, int32_t right) {
+    return (uint64_t(uint32_t(left)) << 32) | uint32_t(right);
+  }
+
+  // (left symbol, right symbol) -> merge rule
+  std::unordered_map<uint64_t, Merge> merges;
+  // Symbol id -> token id, or unk_id if the symbol is not in the vocab
+  std::vector<int32_t> symbol_tokens;
+  // Token id -> its bytes
+  std::vector<std::string> token_bytes;
+  int32_t pad_id, unk_id;
+  mutable CacheShard cache[NUM_CACHE_SHARDS];
+};
+
+}; // namespace FlexFlow
+
+#endif // __FLEXFLOW_BPE_TOKENIZER_H__
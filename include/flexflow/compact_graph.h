@@ -0,0 +1,490 @@
+#ifndef _FLEXFLOW_COMPACT_GRAPH_H
+#define _FLEXFLOW_COMPACT_GRAPH_H
+
+#include "flexflow/basic_graph.h"
+#include "flexflow/graph_structures.h"
+#include <algorithm>
+#include <cassert>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace FlexFlow::PCG::Utils {
+
+/**
+ * @brief An edge of a CompactGraph, between dense node ids.
+ */
+struct CompactEdge {
+  int src, dst;
+  int src_idx, dst_idx;
+
+  bool operator==(CompactEdge const &other) const {
+    return src == other.src && dst == other.dst && src_idx == other.src_idx &&
+           dst_idx == other.dst_idx;
+  }
+};
+
+} // namespace FlexFlow::PCG::Utils
+
+namespace std {
+template <>
+struct hash<FlexFlow::PCG::Utils::CompactEdge> {
+  size_t operator()(FlexFlow::PCG::Utils::CompactEdge const &e) const {
+    size_t res = 17;
+    res = res * 31 + hash<int>()(e.src);
+    res = res * 31 + hash<int>()(e.dst);
+    res = res * 31 + hash<int>()(e.src_idx);
+    res = res * 31 + hash<int>()(e.dst_idx);
+    return res;
+  }
+};
+} // namespace std
+
+namespace FlexFlow::PCG::Utils {
+
+/**
+ * @brief Immutable graph with dense node ids and CSR adjacency.
+ *
+ * @details Nodes are numbered in insertion order and keep their id in every
+ * graph derived from this one; a removed node leaves a hole. Copies share
+ * all storage, and rewrite() shares the node table with the graph it is
+ * derived from, so the only per-derivation work is rebuilding the edge
+ * arrays. The structural hash is additive over nodes, each node
+ * contributing NodeHash(node) times the product of its in-edge hashes (the
+ * formula of Graph::hash), and rewrite() updates it from the nodes whose
+ * in-edges changed.
+ */
+template <typename N, typename NodeHash = std::hash<N>>
+class CompactGraph {
+public:
+  struct EdgeRange {
+    CompactEdge const *first, *last;
+
+    CompactEdge const *begin() const {
+      return first;
+    }
+    CompactEdge const *end() const {
+      return last;
+    }
+    size_t size() const {
+      return last - first;
+    }
+    bool empty() const {
+      return first == last;
+    }
+  };
+
+  CompactGraph() : CompactGraph({}, {}) {}
+
+  CompactGraph(std::vector<N> const &nodes,
+               std::vector<CompactEdge> const &edges) {
+    auto table = std::make_shared<NodeTable>();
+    table->nodes = nodes;
+    for (size_t i = 0; i < nodes.size(); i++) {
+      bool inserted = table->index.emplace(nodes[i], (int)i).second;
+      assert(inserted);
+    }
+    this->table = table;
+    auto adj = std::make_shared<Adjacency>();
+    adj->alive.assign(nodes.size(), 1);
+    adj->num_live = nodes.size();
+    build_edges(*adj, edges);
+    adj->contribution.resize(nodes.size());
+    adj->hash = 0;
+    for (size_t i = 0; i < nodes.size(); i++) {
+      adj->contribution[i] = this->contribution(*adj, i);
+      adj->hash += adj->contribution[i];
+    }
+    this->adj = adj;
+  }
+
+  // Ids handed out so far, including those of removed nodes
+  int num_ids() const {
+    return this->adj->alive.size();
+  }
+
+  size_t num_nodes() const {
+    return this->adj->num_live;
+  }
+
+  size_t num_edges() const {
+    return this->adj->in.size();
+  }
+
+  bool contains(int id) const {
+    return id >= 0 && id < this->num_ids() && this->adj->alive[id];
+  }
+
+  N const &node(int id) const {
+    assert(id >= 0);
+    NodeTable const *t = this->table.get();
+    while (id < t->base) {
+      t = t->parent.get();
+    }
+    assert(id - t->base < (int)t->nodes.size());
+    return t->nodes[id - t->base];
+  }
+
+  // The id of n, or -1 if n is not a node of this graph
+  int find(N const &n) const {
+    for (NodeTable const *t = this->table.get(); t != nullptr;
+         t = t->parent.get()) {
+      auto it = t->index.find(n);
+      if (it != t->index.end()) {
+        return this->contains(it->second) ? it->second : -1;
+      }
+    }
+    return -1;
+  }
+
+  EdgeRange in_edges(int id) const {
+    assert(this->contains(id));
+    Adjacency const &a = *this->adj;
+    return {a.in.data() + a.in_offsets[id], a.in.data() + a.in_offsets[id + 1]};
+  }
+
+  EdgeRange out_edges(int id) const {
+    assert(this->contains(id));
+    Adjacency const &a = *this->adj;
+    return {a.out.data() + a.out_offsets[id],
+            a.out.data() + a.out_offsets[id + 1]};
+  }
+
+  size_t hash() const {
+    return this->adj->hash;
+  }
+
+  /**
+   * @brief Derive a graph without the removed nodes and their edges, with
+   * added_nodes appended (they get ids num_ids(), num_ids() + 1, ...) and
+   * added_edges inserted. added_edges may refer to the new ids.
+   */
+  CompactGraph rewrite(std::vector<int> const &removed,
+                       std::vector<N> const &added_nodes,
+                       std::vector<CompactEdge> const &added_edges) const {
+    Adjacency const &old = *this->adj;
+    int const old_ids = this->num_ids();
+    int const new_ids = old_ids + added_nodes.size();
+
+    CompactGraph result;
+    if (added_nodes.empty()) {
+      result.table = this->table;
+    } else {
+      auto table = std::make_shared<NodeTable>();
+      table->base = old_ids;
+      table->depth = this->table->depth + 1;
+      table->nodes = added_nodes;
+      for (size_t i = 0; i < added_nodes.size(); i++) {
+        assert(this->find(added_nodes[i]) == -1);
+        table->index.emplace(added_nodes[i], old_ids + (int)i);
+      }
+      table->parent = this->table;
+      result.table = table;
+    }
+
+    auto adj = std::make_shared<Adjacency>();
+    adj->alive = old.alive;
+    adj->alive.resize(new_ids, 1);
+    adj->num_live = old.num_live + added_nodes.size();
+    // Nodes whose contribution to the hash changes
+    std::vector<char> touched(new_ids, 0);
+    for (int id : removed) {
+      assert(this->contains(id));
+      adj->alive[id] = 0;
+      adj->num_live--;
+      touched[id] = 1;
+    }
+    for (int id = old_ids; id < new_ids; id++) {
+      touched[id] = 1;
+    }
+    std::vector<CompactEdge> edges;
+    edges.reserve(old.in.size() + added_edges.size());
+    for (CompactEdge const &e : old.in) {
+      if (adj->alive[e.src] && adj->alive[e.dst]) {
+        edges.push_back(e);
+      } else if (adj->alive[e.dst]) {
+        touched[e.dst] = 1;
+      }
+    }
+    for (CompactEdge const &e : added_edges) {
+      assert(e.src >= 0 && e.src < new_ids && adj->alive[e.src]);
+      assert(e.dst >= 0 && e.dst < new_ids && adj->alive[e.dst]);
+      edges.push_back(e);
+      touched[e.dst] = 1;
+    }
+    build_edges(*adj, edges);
+
+    adj->contribution = old.contribution;
+    adj->contribution.resize(new_ids, 0);
+    adj->hash = old.hash;
+    for (int id = 0; id < new_ids; id++) {
+      if (touched[id]) {
+        adj->hash -= adj->contribution[id];
+        adj->contribution[id] =
+            adj->alive[id] ? result.contribution(*adj, id) : 0;
+        adj->hash += adj->contribution[id];
+      }
+    }
+    result.adj = adj;
+    if (result.table->depth > MAX_TABLE_DEPTH) {
+      result.flatten_table();
+    }
+    return result;
+  }
+
+  /**
+   * @brief Derive the subgraph induced by the given ids.
+   */
+  CompactGraph subgraph(std::vector<int> const &ids) const {
+    std::vector<char> keep(this->num_ids(), 0);
+    for (int id : ids) {
+      assert(this->contains(id));
+      keep[id] = 1;
+    }
+    std::vector<int> removed;
+    for (int id = 0; id < this->num_ids(); id++) {
+      if (this->contains(id) && !keep[id]) {
+        removed.push_back(id);
+      }
+    }
+    return this->rewrite(removed, {}, {});
+  }
+
+private:
+  // Lookups walk at most this many tables before the chain is flattened
+  static int const MAX_TABLE_DEPTH = 8;
+
+  // Nodes with ids [base, base + nodes.size()); older ids are in parent
+  struct NodeTable {
+    int base = 0, depth = 0;
+    std::vector<N> nodes;
+    std::unordered_map<N, int, NodeHash> index;
+    std::shared_ptr<NodeTable const> parent;
+  };
+
+  struct Adjacency {
+    std::vector<char> alive;
+    size_t num_live = 0;
+    // in is grouped by dst and out by src, with offsets indexed by id
+    std::vector<int> in_offsets, out_offsets;
+    std::vector<CompactEdge> in, out;
+    std::vector<size_t> contribution;
+    size_t hash = 0;
+  };
+
+  static void build_edges(Adjacency &a, std::vector<CompactEdge> const &edges) {
+    int const n = a.alive.size();
+    a.in_offsets.assign(n + 1, 0);
+    a.out_offsets.assign(n + 1, 0);
+    for (CompactEdge const &e : edges) {
+      a.in_offsets[e.dst + 1]++;
+      a.out_offsets[e.src + 1]++;
+    }
+    for (int i = 0; i < n; i++) {
+      a.in_offsets[i + 1] += a.in_offsets[i];
+      a.out_offsets[i + 1] += a.out_offsets[i];
+    }
+    a.in.resize(edges.size());
+    a.out.resize(edges.size());
+    std::vector<int> in_pos(a.in_offsets.begin(), a.in_offsets.end() - 1);
+    std::vector<int> out_pos(a.out_offsets.begin(), a.out_offsets.end() - 1);
+    for (CompactEdge const &e : edges) {
+      a.in[in_pos[e.dst]++] = e;
+      a.out[out_pos[e.src]++] = e;
+    }
+  }
+
+  size_t contribution(Adjacency const &a, int id) const {
+    NodeHash node_hash;
+    size_t h = node_hash(this->node(id));
+    for (int i = a.in_offsets[id]; i < a.in_offsets[id + 1]; i++) {
+      CompactEdge const &e = a.in[i];
+      size_t edge_hash = 17;
+      edge_hash = edge_hash * 31 + node_hash(this->node(e.src));
+      edge_hash = edge_hash * 31 + std::hash<int>()(e.src_idx);
+      edge_hash = edge_hash * 31 + std::hash<int>()(e.dst_idx);
+      h *= edge_hash;
+    }
+    return h;
+  }
+
+  void flatten_table() {
+    auto table = std::make_shared<NodeTable>();
+    int const n = this->num_ids();
+    table->nodes.reserve(n);
+    for (int id = 0; id < n; id++) {
+      table->nodes.push_back(this->node(id));
+    }
+    // A node that was removed and added again keeps only its live id
+    for (int id = 0; id < n; id++) {
+      if (this->contains(id)) {
+        table->index.emplace(table->nodes[id], id);
+      }
+    }
+    this->table = table;
+  }
+
+  std::shared_ptr<NodeTable const> table;
+  std::shared_ptr<Adjacency const> adj;
+};
+
+/**
+ * @brief Immediate post-dominator of every id of g, computed on the CSR
+ * arrays with the Cooper-Harvey-Kennedy iteration.
+ *
+ * @details Same result as imm_post_dominators on the GraphStructure view of
+ * g: a node with no immediate post-dominator (e.g., a sink, or a node whose
+ * paths end in different sinks) maps to itself. Removed ids map to -1.
+ */
+template <typename N, typename NodeHash>
+std::vector<int> dense_imm_post_dominators(CompactGraph<N, NodeHash> const &g) {
+  int const n = g.num_ids();
+  int const exit = n;
+  // Post-dominators are dominators of the reversed graph rooted at a
+  // virtual exit that follows every sink
+  auto for_each_reverse_succ = [&](int v, auto const &fn) {
+    if (v == exit) {
+      for (int u = 0; u < n; u++) {
+        if (g.contains(u) && g.out_edges(u).empty()) {
+          fn(u);
+        }
+      }
+    } else {
+      for (CompactEdge const &e : g.in_edges(v)) {
+        fn(e.src);
+      }
+    }
+  };
+
+  // Postorder of the reversed graph from the exit
+  std::vector<int> post_number(n + 1, -1), order;
+  std::vector<char> visited(n + 1, 0);
+  std::vector<std::pair<int, std::vector<int>>> stack;
+  auto push = [&](int v) {
+    visited[v] = 1;
+    std::vector<int> succs;
+    for_each_reverse_succ(v, [&](int u) { succs.push_back(u); });
+    stack.emplace_back(v, std::move(succs));
+  };
+  push(exit);
+  while (!stack.empty()) {
+    auto &top = stack.back();
+    if (!top.second.empty()) {
+      int u = top.second.back();
+      top.second.pop_back();
+      if (!visited[u]) {
+        push(u);
+      }
+    } else {
+      post_number[top.first] = order.size();
+      order.push_back(top.first);
+      stack.pop_back();
+    }
+  }
+
+  std::vector<int> idom(n + 1, -1);
+  idom[exit] = exit;
+  auto intersect = [&](int a, int b) {
+    while (a != b) {
+      while (post_number[a] < post_number[b]) {
+        a = idom[a];
+      }
+      while (post_number[b] < post_number[a]) {
+        b = idom[b];
+      }
+    }
+    return a;
+  };
+  bool changed = true;
+  while (changed) {
+    changed = false;
+    // Reverse postorder, skipping the exit
+    for (int i = (int)order.size() - 2; i >= 0; i--) {
+      int v = order[i];
+      int new_idom = -1;
+      auto relax = [&](int p) {
+        if (idom[p] != -1) {
+          new_idom = new_idom == -1 ? p : intersect(p, new_idom);
+        }
+      };
+      // Predecessors in the reversed graph are the original successors
+      if (g.out_edges(v).empty()) {
+        relax(exit);
+      }
+      for (CompactEdge const &e : g.out_edges(v)) {
+        relax(e.dst);
+      }
+      if (idom[v] != new_idom) {
+        idom[v] = new_idom;
+        changed = true;
+      }
+    }
+  }
+
+  std::vector<int> result(n, -1);
+  for (int v = 0; v < n; v++) {
+    if (g.contains(v)) {
+      result[v] = idom[v] == exit ? v : idom[v];
+    }
+  }
+  return result;
+}
+
+template <typename N, typename NodeHash>
+struct GraphStructure<CompactGraph<N, NodeHash>> {
+  using graph_type = CompactGraph<N, NodeHash>;
+  using G = graph_type;
+  using vertex_type = int;
+  using edge_type = CompactEdge;
+
+  std::unordered_set<vertex_type> get_nodes(G const &g) const {
+    std::unordered_set<vertex_type> nodes;
+    for (int id = 0; id < g.num_ids(); id++) {
+      if (g.contains(id)) {
+        nodes.insert(id);
+      }
+    }
+    return nodes;
+  }
+
+  std::unordered_set<edge_type> get_incoming_edges(G const &g,
+                                                   vertex_type const &n) const {
+    auto edges = g.in_edges(n);
+    return {edges.begin(), edges.end()};
+  }
+
+  std::unordered_set<edge_type> get_outgoing_edges(G const &g,
+                                                   vertex_type const &n) const {
+    auto edges = g.out_edges(n);
+    return {edges.begin(), edges.end()};
+  }
+
+  vertex_type get_src(G const &g, edge_type const &e) const {
+    return e.src;
+  }
+
+  vertex_type get_dst(G const &g, edge_type const &e) const {
+    return e.dst;
+  }
+
+  void set_src(G const &g, edge_type &e, vertex_type const &n) const {
+    e.src = n;
+  }
+
+  void set_dst(G const &g, edge_type &e, vertex_type const &n) const {
+    e.dst = n;
+  }
+};
+
+template <typename N, typename NodeHash>
+struct invalid_node<CompactGraph<N, NodeHash>,
+                    GraphStructure<CompactGraph<N, NodeHash>>> {
+  int operator()() const {
+    return -1;
+  }
+};
+
+} // namespace FlexFlow::PCG::Utils
+
+#endif // _FLEXFLOW_COMPACT_GRAPH_H
@@ -90,6 +90,10 @@ struct FFHandler {
   size_t offload_reserve_space_size;
   DataType quantization_type;
   bool allowTensorOpMathConversion;
+  int cpu_kernel_threads;
+  bool experts_grouped_gemm;
+  int expert_routing_interval;
+  bool cpu_weight_packing;
 #ifdef FF_USE_NCCL
   ncclComm_t ncclComm;
 #endif
@@ -100,6 +104,10 @@ struct FFInitInfo {
   size_t offload_reserve_space_size;
   DataType quantization_type;
   bool allowTensorOpMathConversion;
+  int cpu_kernel_threads;
+  bool experts_grouped_gemm;
+  int expert_routing_interval;
+  bool cpu_weight_packing;
   // int myRank, allRanks;
 };
 
@@ -167,6 +175,20 @@ public:
   int pipeline_parallelism_degree;
   // Control Tensor Op Math Conversion
   bool allow_tensor_op_math_conversion;
+  // Threads each CPU inference task uses for its GEMMs
+  int cpu_kernel_threads;
+  // Keep a panel-packed copy of each fp32 Linear weight for the CPU GEMM,
+  // which doubles the resident weight memory of those operators
+  bool cpu_weight_packing;
+  // Run the Experts operator as one GEMM per expert over its packed tokens
+  // instead of one GEMV per token
+  bool experts_grouped_gemm;
+  // Experts operators report their routing to ExpertLoadBalancer every this
+  // many steps (0: never), since each report syncs the stream
+  int expert_routing_interval;
+  // Routing stats of a previous run, which place the Experts blocks of each
+  // stage; the recorded stats are saved back to it at exit
+  std::string expert_routing_file;
   std::string dataset_path;
   std::string import_strategy_file;
   std::string export_strategy_file;
@@ -174,6 +196,8 @@ public:
   std::string export_strategy_computation_graph_file;
   bool include_costs_dot_graph;
   tl::optional<std::string> substitution_json_path = tl::nullopt;
+  // Cost table written by the mapper (--mapper-profiling)
+  std::string measured_cost_file;
   // We use MappingTagID as the key since we will pass the tag to the mapper
   // std::map<Legion::MappingTagID, ParallelConfig> strategies;
   int machine_model_version;
@@ -0,0 +1,128 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __FLEXFLOW_EXPERT_LOAD_BALANCER_H__
+#define __FLEXFLOW_EXPERT_LOAD_BALANCER_H__
+
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace FlexFlow {
+
+/**
+ * @brief Routing load of one MoE layer, accumulated over steps.
+ */
+struct ExpertRoutingStats {
+  // Per expert: assignments per step, as an exponential moving average
+  std::vector<double> load;
+  uint64_t num_steps = 0;
+  uint64_t num_assignments = 0;
+  // Assignments past the expert capacity, which the layer dropped
+  uint64_t num_dropped = 0;
+};
+
+/**
+ * @brief Result of ExpertLoadBalancer::plan_placement.
+ */
+struct ExpertPlacement {
+  // Per expert: the device that holds it
+  std::vector<int> expert_device;
+  // Per device: the experts it holds
+  std::vector<std::vector<int>> device_experts;
+  // Per device: estimated time of one step, i.e., its tokens times its
+  // per-token cost
+  std::vector<double> device_time;
+  // Time of the slowest device, which bounds the step
+  double makespan() const;
+};
+
+/**
+ * @brief Collects per-step expert routing and plans expert placements that
+ * follow it.
+ *
+ * @details MoE operators report how many assignments each of their experts
+ * received in a step (before capacity is applied). With a skewed router a
+ * few experts take most tokens, and the devices that hold them bound the
+ * step while the rest idle or drop tokens. plan_placement turns the
+ * observed load into a placement that spreads hot experts apart and packs
+ * cold ones together, given the per-token cost of each device (e.g., the
+ * Simulator cost of an Experts view divided by its tokens). Each expert
+ * has a single copy: the Experts operator routes a token to exactly one
+ * holder of its expert, so replicating a hot expert would need the
+ * operator to split its tokens first. Recording is
+ * thread-safe, since every point task of a layer reports on its own.
+ * Operators only report every --expert-routing-interval steps, and the
+ * stats are saved to --expert-routing-file at exit so that the next run can
+ * place its Experts blocks with them.
+ */
+class ExpertLoadBalancer {
+public:
+  // Weight of the history in the moving average of the load
+  static constexpr double LOAD_DECAY = 0.9;
+
+  static ExpertLoadBalancer *get_load_balancer();
+  // Record one step of a layer: counts[e] assignments to expert e, of which
+  // the ones past capacity were dropped
+  void record_routing(std::string const &layer,
+                      std::vector<int> const &counts,
+                      int capacity);
+  ExpertRoutingStats get_routing_stats(std::string const &layer) const;
+  std::vector<std::string> get_layers() const;
+  void reset();
+  // One line per layer: its quoted name, step and assignment counts, and
+  // the load of each expert
+  void write_routing_stats(std::ostream &os) const;
+  // Replaces the stats with the ones written by write_routing_stats; returns
+  // false (and keeps the stats) if the stream is malformed
+  bool load_routing_stats(std::istream &is);
+  // write_routing_stats of the global load balancer to the file given to
+  // set_routing_file (--expert-routing-file); registered with std::atexit
+  static void save_routing_stats();
+  static void set_routing_file(std::string const &path);
+
+  /**
+   * @brief Place experts with the given per-step loads on
+   * device_token_cost.size() devices that hold up to slots_per_device
+   * experts each.
+   *
+   * @details Experts are placed heaviest first, each on the device with a
+   * free slot that would finish earliest with it, which keeps hot experts
+   * apart and packs cold experts into the slack of the devices holding hot
+   * ones.
+   */
+  static ExpertPlacement
+      plan_placement(std::vector<double> const &expert_load,
+                     std::vector<double> const &device_token_cost,
+                     int slots_per_device);
+  // plan_placement on the recorded load of layer
+  ExpertPlacement
+      plan_placement(std::string const &layer,
+                     std::vector<double> const &device_token_cost,
+                     int slots_per_device) const;
+
+private:
+  mutable std::mutex mutex;
+  std::unordered_map<std::string, ExpertRoutingStats> stats;
+  static std::string routing_file;
+};
+
+}; // namespace FlexFlow
+
+#endif // __FLEXFLOW_EXPERT_LOAD_BALANCER_H__
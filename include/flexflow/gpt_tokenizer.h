@@ -3,6 +3,9 @@
 // SPDX-License-Identifier: MIT
 // Copyright (c) 2019-2020 zili wang <wzlnot@gmail.com>.
 
+#ifndef __FLEXFLOW_GPT_TOKENIZER_H__
+#define __FLEXFLOW_GPT_TOKENIZER_H__
+
 #include <algorithm>
 #include <cctype>
 #include <codecvt>
@@ -219,3 +222,5 @@ private:
   std::vector<std::string> split(std::string const &s,
                                  std::regex rgx = std::regex("\\s+"));
 };
+
+#endif // __FLEXFLOW_GPT_TOKENIZER_H__
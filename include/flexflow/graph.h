@@ -16,6 +16,7 @@
 #ifndef _FLEXFLOW_GRAPH_H_
 #define _FLEXFLOW_GRAPH_H_
 #include "flexflow/basic_graph.h"
+#include "flexflow/compact_graph.h"
 #include "flexflow/graph_structures.h"
 #include "flexflow/memory_optimization.h"
 #include "flexflow/model.h"
@@ -89,6 +90,16 @@ struct NodeCompare {
   };
 };
 
+// The per-node hash of Graph::hash, so that a CompactPCG of a graph has the
+// same hash as the graph
+struct NodePtrHash {
+  size_t operator()(Node const &n) const {
+    return std::hash<size_t>()((size_t)n.ptr);
+  }
+};
+
+using CompactPCG = Utils::CompactGraph<Node, NodePtrHash>;
+
 struct GraphOptimalViewSerialized {
 #ifdef LEGION_MAX_RETURN_SIZE
   static const size_t buffer_size = LEGION_MAX_RETURN_SIZE - 8;
@@ -293,6 +304,8 @@ struct SimplificationSettings {
 class Graph {
 public:
   Graph(FFModel *model);
+  // Materialize a CSR graph, e.g., a candidate derived by the search
+  Graph(FFModel *model, CompactPCG const &graph);
   void add_edge(Node const &srcOp, Node const &dstOp, int srcIdx, int dstIdx);
   void add_node(Node const &);
   void add_edge(Edge const &e);
@@ -320,6 +333,8 @@ public:
   Node declone_node(Node const &);
 
   size_t hash(void) const;
+  // Immutable CSR snapshot for read-only passes over the whole graph
+  CompactPCG compact() const;
   void print(void) const;
   void print_dot() const;
   void print_dot(std::ostream &) const;
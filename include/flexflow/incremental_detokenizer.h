@@ -0,0 +1,65 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __FLEXFLOW_INCREMENTAL_DETOKENIZER_H__
+#define __FLEXFLOW_INCREMENTAL_DETOKENIZER_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace FlexFlow {
+
+/**
+ * @brief Turns the tokens a request generates into text one step at a time.
+ *
+ * @details Each step decodes only a window of the token history: a few
+ * tokens already returned as text, which give the decoder the context that
+ * decides leading spaces (SentencePiece drops the space of the first piece
+ * it decodes), and the new tokens. The new text is the decoded window minus
+ * the decoded context. Text ending in U+FFFD, which decoders emit for an
+ * incomplete UTF-8 character (e.g., split across byte-level or byte-fallback
+ * tokens), is held back until a later token completes it.
+ */
+class IncrementalDetokenizer {
+public:
+  using Decoder = std::function<std::string(std::vector<int32_t> const &)>;
+  // Tokens already returned as text that are decoded again as context
+  static size_t const CONTEXT_TOKENS = 5;
+
+  // Starts after the first num_tokens tokens, whose text the caller has
+  explicit IncrementalDetokenizer(size_t num_tokens = 0);
+  // Number of tokens whose text has been returned
+  size_t num_tokens_read() const {
+    return read_offset;
+  }
+  // Returns the text finalized by the tokens appended since the last call.
+  // With flush, text is returned even if it ends in an incomplete
+  // character, so that the text of all steps adds up to decoding all tokens.
+  std::string step(std::vector<int32_t> const &tokens,
+                   Decoder const &decode,
+                   bool flush = false);
+
+private:
+  // Start of the context and of the tokens not yet returned as text
+  size_t prefix_offset, read_offset;
+};
+
+}; // namespace FlexFlow
+
+#endif // __FLEXFLOW_INCREMENTAL_DETOKENIZER_H__
@@ -0,0 +1,87 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __FLEXFLOW_INFERENCE_FUSION_H__
+#define __FLEXFLOW_INFERENCE_FUSION_H__
+
+#include "flexflow/ffconst.h"
+#include <utility>
+#include <vector>
+
+namespace FlexFlow {
+
+// Transformer-block patterns rewritten into an existing fused operator
+enum InferenceFusionPattern {
+  // Linear followed by ReLU or sigmoid -> Linear with the activation
+  // applied to the output tile
+  FUSE_LINEAR_ACTIVATION,
+  // residual add followed by RMSNorm -> ResidualRMSNorm; the sum stays an
+  // output, so the residual stream can still read it
+  FUSE_RESIDUAL_RMS_NORM,
+  // residual add followed by LayerNorm -> ResidualLayerNorm
+  FUSE_RESIDUAL_LAYER_NORM,
+  // x * sigmoid(x) * y -> SigmoidSiluMulti, i.e., the SwiGLU gate
+  FUSE_SIGMOID_SILU_MULTI,
+  NUM_INFERENCE_FUSION_PATTERNS,
+};
+
+/**
+ * @brief One operator of the graph handed to plan_inference_fusion.
+ */
+struct FusionNode {
+  OperatorType op_type = OP_NOOP;
+  // Per input: the node and output index that writes it; node -1 for
+  // tensors written outside the graph
+  std::vector<std::pair<int, int>> inputs;
+  int num_outputs = 1;
+  // Nodes of different groups are never fused (e.g., different pipeline
+  // stages)
+  int group = 0;
+  // Whether the node can take part in a pattern at all, e.g., a Linear
+  // that has no activation yet, or an element-wise op without broadcast
+  bool fusible = true;
+};
+
+/**
+ * @brief One rewrite found by plan_inference_fusion.
+ */
+struct FusionMatch {
+  InferenceFusionPattern pattern;
+  // Matched nodes in graph order. The last one is the anchor: the fused
+  // operator takes its place, and its outputs are those of the matched
+  // nodes that the pattern keeps (the anchor's last).
+  std::vector<int> nodes;
+  // Inputs of the fused operator
+  std::vector<std::pair<int, int>> inputs;
+};
+
+/**
+ * @brief Find the fusion patterns of an inference graph.
+ *
+ * @details nodes must be in topological order. The graph is scanned once:
+ * each node is tried as the anchor of every pattern, looking back at its
+ * producers, and a node joins at most one match. Intermediate tensors that
+ * a fused operator does not output must have no other reader, and the ones
+ * it does output no reader before the anchor, whose place it takes.
+ */
+std::vector<FusionMatch>
+    plan_inference_fusion(std::vector<FusionNode> const &nodes);
+
+char const *get_inference_fusion_pattern_name(InferenceFusionPattern pattern);
+
+}; // namespace FlexFlow
+
+#endif // __FLEXFLOW_INFERENCE_FUSION_H__
@@ -18,8 +18,11 @@
 
 #include "default_mapper.h"
 #include "legion.h"
+#include "mapper_profiling.h"
 #include "model.h"
 #include "null_mapper.h"
+#include <memory>
+#include <mutex>
 
 namespace FlexFlow {
 
@@ -44,6 +47,23 @@ private:
   MachineView machine_view;
 };
 
+// Policies used by FFMapper::map_task to derive task priorities on top of
+// the critical-path ranks registered through set_region_priorities
+enum class TaskPriorityPolicy {
+  NONE,          // all tasks get priority 0
+  CRITICAL_PATH, // use critical-path ranks only
+  COMM_FIRST,    // also boost backward and gradient-synchronization tasks
+  DECODE_FIRST,  // also boost inference tasks, demote background work
+};
+
+// Policies used by FFMapper::slice_task to choose between the CPU and GPU
+// variants of a task when both are registered
+enum class VariantSelectionPolicy {
+  MACHINE_VIEW,   // run on the device type of the op's machine view
+  SIZE_THRESHOLD, // run launches touching few elements on CPUs
+  MEASURED_COST,  // run on the processor kind with the lower measured time
+};
+
 struct InstanceCreationLog {
   std::string task_name;
   size_t size;
@@ -58,7 +78,11 @@ public:
            Processor local,
            char const *mapper_name, // const std::string& strategyFile,
            bool _enable_control_replication,
-           bool _log_instance_creation);
+           bool _log_instance_creation,
+           TaskPriorityPolicy _priority_policy,
+           std::map<TaskID, int> const &_task_priorities,
+           VariantSelectionPolicy _variant_policy,
+           size_t _cpu_variant_max_elements);
   ~FFMapper();
   virtual char const *get_mapper_name(void) const;
   virtual MapperSyncModel get_mapper_sync_model(void) const;
@@ -68,6 +92,25 @@ public:
                              Runtime *rt,
                              std::set<Processor> const &local_procs);
   static void register_sharding_functor(Runtime *runtime, Machine machine);
+  // Critical-path ranks are attached to region trees so that every task
+  // writing a region inherits the rank of the operator producing it. The
+  // table is published as a whole and read without locking by map_task.
+  static void set_region_priorities(
+      std::unordered_map<RegionTreeID, int> const &priorities);
+  // Parameter hashes of the ops owning each region tree, so that measured
+  // costs of ops sharing a task id and a machine view are kept apart
+  static void set_region_op_hashes(
+      std::unordered_map<RegionTreeID, size_t> const &op_hashes);
+  static bool parse_task_priority_policy(char const *name,
+                                         TaskPriorityPolicy &policy);
+  static bool parse_variant_selection_policy(char const *name,
+                                             VariantSelectionPolicy &policy);
+  // Opt-in collection of task timelines through report_profiling, dumped as
+  // <prefix>.<node>.trace.json and <prefix>.<node>.costs at exit
+  static void enable_profiling(std::string const &prefix,
+                               AddressSpace node,
+                               size_t capacity);
+  static void dump_profiling();
   virtual void select_task_options(const MapperContext ctx,
                                    Task const &task,
                                    TaskOptions &output);
@@ -333,6 +376,19 @@ private:
   unsigned long long compute_task_hash(Task const &task);
   bool is_parameter_server_update_task(TaskID tid);
   bool is_initializer_task(TaskID tid);
+  bool is_backward_task(TaskID tid);
+  bool is_gradient_sync_task(TaskID tid);
+  bool is_inference_task(TaskID tid);
+  bool is_background_task(TaskID tid);
+  int compute_task_priority(Task const &task);
+  std::vector<VariantID> const &find_variants(MapperContext ctx,
+                                              TaskID tid,
+                                              Processor::Kind kind);
+  Processor::Kind select_processor_kind(MapperContext ctx,
+                                        Task const &task,
+                                        MachineView const &view,
+                                        Domain const &domain);
+  Processor get_counterpart_proc(Processor proc, Processor::Kind kind);
   std::vector<Processor> const &all_procs_by_kind(Processor::Kind kind);
 
 protected:
@@ -342,6 +398,12 @@ protected:
   char const *mapper_name;
   bool enable_control_replication;
   bool log_instance_creation;
+  TaskPriorityPolicy priority_policy;
+  std::map<TaskID, int> task_priorities;
+  VariantSelectionPolicy variant_policy;
+  size_t cpu_variant_max_elements;
+  std::map<std::pair<TaskID, Processor::Kind>, std::vector<VariantID>>
+      variant_cache;
   std::vector<Processor> all_gpus, all_cpus, all_pys, local_gpus, local_cpus,
       local_pys;
   std::map<Processor, Memory> proc_fbmems, proc_zcmems;
@@ -351,6 +413,20 @@ protected:
   std::map<std::pair<Memory::Kind, FieldSpace>, LayoutConstraintID>
       layout_constraint_cache;
   std::vector<InstanceCreationLog> created_instances;
+
+private:
+  static std::shared_ptr<std::unordered_map<RegionTreeID, int> const>
+      region_priorities;
+  static std::shared_ptr<std::unordered_map<RegionTreeID, size_t> const>
+      region_op_hashes;
+  static std::unique_ptr<MapperProfilingBuffer> profiling_buffer;
+  static std::string profiling_prefix;
+  static AddressSpace profiling_node;
+  // Measured execution time per (task id, processor kind) and the kinds
+  // pinned for stateful operators, shared by all mapper instances of a
+  // process
+  static std::mutex variant_cost_mutex;
+  static MeasuredVariantSelector variant_costs;
 };
 
 }; // namespace FlexFlow
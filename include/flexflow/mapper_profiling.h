@@ -0,0 +1,155 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __FLEXFLOW_MAPPER_PROFILING_H__
+#define __FLEXFLOW_MAPPER_PROFILING_H__
+
+#include <atomic>
+#include <cstddef>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <set>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+namespace FlexFlow {
+
+/**
+ * @brief One operation timeline reported to FFMapper::report_profiling.
+ */
+struct MapperProfilingRecord {
+  enum Kind {
+    TASK,
+    COPY,
+  };
+  Kind kind = TASK;
+  unsigned task_id = 0;
+  // The MappingTagID of the launch, i.e., the hash of the op's MachineView
+  size_t view_hash = 0;
+  // The parameter hash of the launching op, or 0 when it is unknown
+  size_t params_hash = 0;
+  unsigned long long proc_id = 0;
+  // Timestamps in nanoseconds
+  long long start_ns = 0, end_ns = 0;
+  char name[48] = {0};
+};
+
+/**
+ * @brief Aggregated execution time of one (task id, machine view, op
+ * parameters) triple.
+ */
+struct MeasuredCost {
+  size_t count = 0;
+  float mean_us = 0, min_us = 0, max_us = 0;
+};
+
+using MeasuredCostKey = std::tuple<unsigned /*task_id*/,
+                                   size_t /*view_hash*/,
+                                   size_t /*params_hash*/>;
+using MeasuredCostTable = std::map<MeasuredCostKey, MeasuredCost>;
+
+/**
+ * @brief The measured-cost choice between the GPU and CPU variants of
+ * each task.
+ *
+ * @details Both kinds are timed for exploration_samples launches before the
+ * lower mean wins, so the kind of a task can change from one launch to the
+ * next. Stateful tasks keep state in their operator's meta that the variant
+ * of the other kind does not see, e.g., the KV caches of the attention
+ * operators: each of their operators stays on the kind first selected for
+ * it. That selection happens on the operator's first launch, before any
+ * launch of the task has been timed, so in practice every operator of a
+ * stateful task is pinned to the GPU (the kind explored first) and only
+ * the stateless tasks choose by measurement; operators created after
+ * exploration follow the averages. Not thread-safe.
+ */
+class MeasuredVariantSelector {
+public:
+  enum Kind {
+    GPU,
+    CPU,
+  };
+  MeasuredVariantSelector(size_t exploration_samples,
+                          std::set<unsigned> const &stateful_tasks);
+
+  // op_key identifies the operator of the launch
+  Kind select(unsigned task_id, size_t op_key);
+  void record(unsigned task_id, Kind kind, float us);
+
+private:
+  size_t exploration_samples;
+  std::set<unsigned> stateful_tasks;
+  std::map<std::pair<unsigned, Kind>, MeasuredCost> costs;
+  std::map<std::pair<unsigned, size_t>, Kind> pinned_kinds;
+};
+
+/**
+ * @brief Fixed-capacity buffer shared by all mapper instances of a process.
+ *
+ * @details Writers reserve a slot with a single atomic increment and publish
+ * it with a release store, so report_profiling never takes a lock. Records
+ * that do not fit are dropped and counted.
+ */
+class MapperProfilingBuffer {
+public:
+  explicit MapperProfilingBuffer(size_t capacity);
+
+  bool record(MapperProfilingRecord const &record);
+  /**
+   * @brief Copy out every published record.
+   */
+  std::vector<MapperProfilingRecord> snapshot() const;
+  size_t dropped() const;
+  size_t capacity() const;
+
+private:
+  struct Slot {
+    MapperProfilingRecord record;
+    std::atomic<bool> ready{false};
+  };
+  std::unique_ptr<Slot[]> slots;
+  size_t num_slots;
+  std::atomic<size_t> next_slot{0};
+  std::atomic<size_t> num_dropped{0};
+};
+
+/**
+ * @brief Average task durations per (task id, machine view, op parameters);
+ * copies are excluded since the Simulator estimates transfers from the
+ * machine model.
+ */
+MeasuredCostTable
+    aggregate_measured_costs(std::vector<MapperProfilingRecord> const &records);
+
+/**
+ * @brief Write records in the Chrome trace event format (chrome://tracing,
+ * Perfetto), one track per processor.
+ */
+void write_chrome_trace(std::ostream &os,
+                        std::vector<MapperProfilingRecord> const &records);
+
+/**
+ * @brief Write the table as text, one "task_id view_hash params_hash count
+ * mean_us min_us max_us" line per entry.
+ */
+void write_measured_cost_table(std::ostream &os,
+                               MeasuredCostTable const &table);
+bool load_measured_cost_table(std::istream &is, MeasuredCostTable &table);
+
+}; // namespace FlexFlow
+
+#endif // __FLEXFLOW_MAPPER_PROFILING_H__
@@ -18,6 +18,8 @@
 
 #include <cassert>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 namespace FlexFlow {
 
@@ -72,8 +74,48 @@ public:
   float search_time{};
   ///< The max of per-device memory usage among all devices
   float max_per_device_mem_all_deivces = 0.0;
+  ///< True if max_per_device_mem_all_deivces is below the per-device cap
+  bool fits_memory_cap = false;
 };
 
+/**
+ * @brief Memory footprint of one operator placed in an execution schedule.
+ * All sizes are per device (i.e., the size of one partition) in MB.
+ */
+struct OpMemoryFootprint {
+  std::vector<int> device_ids; ///< Devices holding a partition of the op
+  float weights_mb = 0.0;      ///< Resident for the whole schedule
+  float outputs_mb = 0.0;      ///< Live from step until last_use_step
+  int step = 0;                ///< Position of the op in the schedule
+  int last_use_step = 0;       ///< Last step that reads the outputs
+};
+
+/**
+ * @brief Estimate the peak memory of every device over a schedule, freeing
+ * each operator's outputs after their last consumer has run instead of
+ * assuming that every tensor is alive at once.
+ *
+ * @return Map from device id to its peak memory usage in MB
+ */
+std::unordered_map<int, float> estimate_peak_memory_per_device(
+    std::vector<OpMemoryFootprint> const &footprints);
+
+/**
+ * @brief One strategy explored by the memory-aware search.
+ */
+struct MemorySearchPoint {
+  float lambda;          ///< run_time_cost_factor used in the search
+  float run_time_cost;   ///< Simulated run time of the strategy
+  float peak_memory_mb;  ///< Max per-device peak memory of the strategy
+};
+
+/**
+ * @brief Return the points that are not dominated in both run time and peak
+ * memory, sorted by increasing run time.
+ */
+std::vector<MemorySearchPoint>
+    pareto_frontier(std::vector<MemorySearchPoint> const &points);
+
 namespace PCG {
 
 /**
@@ -249,6 +249,7 @@ enum TaskIDs {
   RM_PREPARE_NEXT_BATCH_BEAM_TASK_ID,
   RM_PREPARE_NEXT_BATCH_VERIFY_TASK_ID,
   RM_BACKGROUND_SERVING_TASK_ID,
+  RM_RECORD_STAGE_FINISH_TASK_ID,
   // Custom tasks
   CUSTOM_GPU_TASK_ID_FIRST,
   CUSTOM_GPU_TASK_ID_1,
@@ -1045,10 +1046,23 @@ public:
       std::vector<Op *> &new_operators,
       std::unordered_map<ParallelTensor, std::vector<ParallelTensor>>
           *parallel_tensor_mapping = nullptr);
+  // Same merges as calling apply_fusion until it fails, found in a single
+  // pass over operators; returns the number of operators merged
+  int apply_fusion_pass(
+      std::vector<Op *> const &operators,
+      std::vector<Op *> &new_operators,
+      std::unordered_map<ParallelTensor, std::vector<ParallelTensor>>
+          *parallel_tensor_mapping = nullptr);
   bool check_operators_integrity(
       std::vector<Op *> const &old_operators,
       std::unordered_map<ParallelTensor, std::vector<ParallelTensor>>
           *pt_mapping = nullptr);
+  void assign_critical_path_priorities(
+      std::unordered_map<ParallelTensor, std::vector<ParallelTensor>>
+          *pt_mapping = nullptr);
+  void assign_region_op_hashes(
+      std::unordered_map<ParallelTensor, std::vector<ParallelTensor>>
+          *pt_mapping = nullptr);
   Op *get_final_operator() const;
   void compile(LossType loss_type,
                std::vector<MetricsType> const &metrics,
@@ -1102,6 +1116,10 @@ public:
   Legion::IndexSpace get_task_is(ParallelConfig const &pc) const;
   Legion::IndexSpace get_task_is(MachineView const &view) const;
   bool is_mlp_block(int layer_idx) const;
+  // Rewrite the transformer-block patterns of layers (see
+  // inference_fusion.h) into fused layers before compile_inference creates
+  // their operators
+  void apply_inference_fusion_patterns();
   void create_operators_from_layers();
   Op *create_operator_from_layer(Layer *layer,
                                  std::vector<ParallelTensor> const &inputs);
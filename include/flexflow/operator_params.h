@@ -92,6 +92,8 @@ using OperatorParameters = mp::variant<AggregateParams,
                                        FusedParallelOpParams>;
 
 tl::optional<OperatorParameters> get_op_parameters(Op const *op);
+// Identifies the op in measured-cost tables; 0 for ops without parameters
+size_t get_op_parameters_hash(Op const *op);
 
 }; // namespace FlexFlow
 
@@ -62,6 +62,11 @@ public:
                            std::vector<Legion::PhysicalRegion> const &regions,
                            Legion::Context ctx,
                            Legion::Runtime *runtime);
+  static void
+      forward_task_cpu(Legion::Task const *task,
+                       std::vector<Legion::PhysicalRegion> const &regions,
+                       Legion::Context ctx,
+                       Legion::Runtime *runtime);
   static void forward_kernel_wrapper(AggregateMeta const *m,
                                      float **exp_preds,
                                      int const *acc_gate_assign_ptr,
@@ -49,6 +49,9 @@ public:
   float **batch_outputs2;
   float **dev_batch_outputs1;
   float **dev_batch_outputs2;
+  // Tokens packed by expert for the grouped GEMMs (--experts-grouped-gemm)
+  bool grouped_gemm = false;
+  float *packed_tokens = nullptr;
 
   int num_experts;
   int experts_start_idx;
@@ -62,6 +65,14 @@ public:
   float alpha;
   bool use_bias;
   ActiMode activation;
+  // Report the routing of every routing_interval-th step to
+  // ExpertLoadBalancer (0: never, as for the Simulator's measurements);
+  // each report copies the counts back and syncs the stream
+  int routing_interval = 0;
+  mutable int routing_step = 0;
+  bool sample_routing() const {
+    return routing_interval > 0 && routing_step++ % routing_interval == 0;
+  }
 #if defined(FF_USE_CUDA) || defined(FF_USE_HIP_CUDA)
   cudnnActivationDescriptor_t actiDesc;
   cudnnTensorDescriptor_t resultTensorDesc1;
@@ -142,6 +153,12 @@ public:
                                      int chosen_experts,
                                      int batch_size,
                                      int out_dim);
+  // Copy a host routing (expert indices and their gate weights) to the
+  // device, for the Simulator's measurements
+  static void copy_routing_to_device(std::vector<int> const &indices,
+                                     std::vector<float> const &topk_gate_preds,
+                                     int *indices_ptr,
+                                     float *topk_gate_preds_ptr);
   static void backward_task(Legion::Task const *task,
                             std::vector<Legion::PhysicalRegion> const &regions,
                             Legion::Context ctx,
@@ -150,9 +167,18 @@ public:
                              std::vector<Legion::PhysicalRegion> const &regions,
                              Legion::Context ctx,
                              Legion::Runtime *runtime);
+  static void
+      inference_task_cpu(Legion::Task const *task,
+                         std::vector<Legion::PhysicalRegion> const &regions,
+                         Legion::Context ctx,
+                         Legion::Runtime *runtime);
   bool measure_operator_cost(Simulator *sim,
                              MachineView const &pc,
                              CostMetrics &cost_metrics) const override;
+  // Time per routed token of the experts on view mv (forward time over the
+  // batch_size * k assignments), the device cost that
+  // ExpertLoadBalancer::plan_placement takes
+  float measure_token_cost(Simulator *sim, MachineView const &mv) const;
 
 public:
   int num_experts;
@@ -14,6 +14,8 @@
 #include "math.h"
 #include <cfloat>
 #include <complex>
+#include <mutex>
+#include <vector>
 #if defined(FF_USE_HIP_ROCM)
 #include <hip/hip_complex.h>
 #endif
@@ -109,6 +111,36 @@ public:
                              std::vector<Legion::PhysicalRegion> const &regions,
                              Legion::Context ctx,
                              Legion::Runtime *runtime);
+  static void
+      inference_task_cpu(Legion::Task const *task,
+                         std::vector<Legion::PhysicalRegion> const &regions,
+                         Legion::Context ctx,
+                         Legion::Runtime *runtime);
+  // Host pieces of the CPU inference variants, shared with the tree and
+  // speculative attention ops. A QKV row is |q|k|v| with cpu_num_kv_heads
+  // distinct KV heads; the host caches hold cpu_cache_length positions per
+  // request slot.
+  static void prepare_cpu_state(IncMultiHeadSelfAttentionMeta *m,
+                                float const *weight,
+                                size_t cache_length);
+  static void compute_qkv_cpu(IncMultiHeadSelfAttentionMeta const *m,
+                              BatchConfig const *bc,
+                              int shard_id,
+                              float const *input,
+                              float const *bias,
+                              float *qkv);
+  static void store_kv_cpu(IncMultiHeadSelfAttentionMeta *m,
+                           float const *qkv_row,
+                           int request_index,
+                           int position);
+  static std::vector<float>
+      alibi_slopes_cpu(IncMultiHeadSelfAttentionMeta const *m, int shard_id);
+  static void compute_o_prod_bias_cpu(IncMultiHeadSelfAttentionMeta const *m,
+                                      int shard_id,
+                                      float const *attn_heads,
+                                      float const *bias,
+                                      float *output,
+                                      int num_tokens);
   bool measure_operator_cost(Simulator *sim,
                              MachineView const &mv,
                              CostMetrics &cost_metrics) const override;
@@ -195,6 +227,16 @@ public:
   BatchConfig::PerRequestInfo *request_infos;
   DataType quantization_type;
   bool offload;
+  // Host state of the CPU inference variants, built on their first call
+  // since weights are loaded after init. The packed QKV projection keeps one
+  // copy of each KV head (the loaded weight replicates them per query head),
+  // and so do the host KV caches.
+  std::vector<float> cpu_packed_qkv, cpu_packed_o;
+  void const *cpu_packed_source;
+  int cpu_num_kv_heads;
+  size_t cpu_cache_length;
+  std::vector<float> cpu_key_cache, cpu_value_cache;
+  std::mutex cpu_mutex;
 #if defined(FF_USE_CUDA) || defined(FF_USE_HIP_CUDA)
   // cudaStream_t task_local_stream;
   cudnnTensorDescriptor_t qk_tensor;
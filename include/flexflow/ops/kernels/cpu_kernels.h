@@ -0,0 +1,367 @@
+#ifndef _FLEXFLOW_OPS_KERNELS_CPU_KERNELS_H
+#define _FLEXFLOW_OPS_KERNELS_CPU_KERNELS_H
+
+#include "flexflow/ffconst.h"
+#include <cstddef>
+#include <cstdint>
+
+namespace FlexFlow {
+namespace Kernels {
+namespace CPU {
+
+// Host kernels behind the LOC_PROC task variants. They operate on fp32
+// data unless noted otherwise; the vector paths are selected at build time
+// with FF_USE_AVX2 or FF_USE_AVX512 and fall back to scalar code otherwise.
+// Each kernel runs on the calling thread: parallelism comes from the index
+// launch, which places one point task on each Legion CPU processor. Kernels
+// with a num_threads argument can additionally use the cores of a CPU
+// processor that Legion gives a single thread; those worker threads are
+// started once per processor and reused across calls.
+
+float dot(float const *a, float const *b, int n);
+
+void apply_activation(float *data, size_t num_elements, ActiMode activation);
+
+// output[b][o] = act(sum_k input[b][k] * weight[o][k] + bias[o]), i.e., the
+// layout used by Linear (weight rows are the in_dim-contiguous columns of
+// the kernel). bias may be nullptr.
+void linear_forward(float const *input,
+                    float const *weight,
+                    float const *bias,
+                    float *output,
+                    int in_dim,
+                    int out_dim,
+                    int batch_size,
+                    ActiMode activation);
+
+// Number of floats pack_linear_weight writes for an in_dim x out_dim weight
+size_t packed_linear_weight_size(int in_dim, int out_dim);
+
+// Repack a Linear weight (out_dim rows of in_dim) into column panels: each
+// panel holds a fixed number of output columns interleaved along in_dim, so
+// the micro-kernel streams it with unit stride. The last panel is
+// zero-padded.
+void pack_linear_weight(float const *weight,
+                        float *packed,
+                        int in_dim,
+                        int out_dim);
+
+// Same contract as linear_forward, on a weight produced by
+// pack_linear_weight. Bias and activation are applied while the output tile
+// is still in registers/L1.
+void linear_forward_packed(float const *input,
+                           float const *packed_weight,
+                           float const *bias,
+                           float *output,
+                           int in_dim,
+                           int out_dim,
+                           int batch_size,
+                           ActiMode activation,
+                           int num_threads);
+
+// o[i] = a[i] * b[i] for each of the batch matrices, with a (n x k),
+// b (k x m) and o (n x m) row-major. Leading dimensions and batch strides
+// follow the strided-batched layout BatchMatmul hands to cuBLAS, so the
+// sequence-length trimming of the GPU path carries over unchanged.
+void batch_matmul_forward(float const *a,
+                          float const *b,
+                          float *o,
+                          int m,
+                          int n,
+                          int k,
+                          int lda,
+                          int ldb,
+                          int ldo,
+                          size_t stride_a,
+                          size_t stride_b,
+                          size_t stride_o,
+                          int batch,
+                          int num_threads);
+
+// Expand a weight in the grouped INT4/INT8 layout written by
+// FileDataLoader::load_quantization_weight, |values|offsets|scales|, into
+// out_dim rows of in_dim floats. Same arithmetic as
+// decompress_int{4,8}_general_weights on the GPU.
+void decompress_quantized_weight(char const *weight,
+                                 float *output,
+                                 int in_dim,
+                                 int out_dim,
+                                 DataType quantization_type);
+
+// Same contract as linear_forward on a weight in the grouped INT4/INT8
+// layout (fp32 scales and offsets). The bytes are widened in registers
+// instead of being decompressed first, so the weight is read at its
+// quantized size. out_dim must be a multiple of
+// INT4_NUM_OF_ELEMENTS_PER_GROUP.
+void linear_forward_quantized(float const *input,
+                              char const *weight,
+                              float const *bias,
+                              float *output,
+                              int in_dim,
+                              int out_dim,
+                              int batch_size,
+                              DataType quantization_type,
+                              ActiMode activation,
+                              int num_threads);
+
+// Rotate each of the num_heads head_dim-wide heads of x in place for the
+// given position, pairing element i with i + head_dim / 2 as
+// apply_rotary_embedding_hf does
+void rotary_embedding(float *x, int num_heads, int head_dim, int position);
+
+// The new tokens of one request in a causal_attention call
+struct AttentionRequest {
+  int token_offset; // first row of q and output
+  int num_tokens;   // new tokens of the request in this batch
+  int first_depth;  // position of the first new token in the request
+  int cache_slot;   // KV cache slot of the request
+};
+
+// output[t][h] = softmax_k(scale * q[t][h] . key[k] + bias) value[k] over
+// the cache positions k <= depth(t) of the token's request, i.e., causal
+// attention of the new tokens, whose keys and values must already be in the
+// cache. Query head h reads KV head h / (num_q_heads / num_kv_heads), which
+// covers multi-head, multi-query and grouped-query layouts. Heads are
+// head_dim apart within a row; cache rows are at
+// slot * cache_slot_stride + position * cache_pos_stride. alibi_slopes (one
+// per query head, or nullptr) adds slope * (k - depth(t)) to the scores.
+// The softmax is computed online over key blocks, so no score matrix is
+// materialized; work is spread over requests, KV heads and query blocks.
+void causal_attention(float const *q,
+                      size_t q_stride,
+                      float const *key_cache,
+                      float const *value_cache,
+                      size_t cache_slot_stride,
+                      size_t cache_pos_stride,
+                      float *output,
+                      size_t output_stride,
+                      AttentionRequest const *requests,
+                      int num_requests,
+                      int num_q_heads,
+                      int num_kv_heads,
+                      int head_dim,
+                      float scale,
+                      float const *alibi_slopes,
+                      int num_threads);
+
+// The new tokens of one request in a tree_attention call. Query t of the
+// request may read cache position k iff k < num_keys and either
+// k < non_tree_cache_size or bit first_query_bit + t of
+// mask[k - non_tree_cache_size] is set, i.e., the BatchConfig::BitMask
+// convention.
+struct TreeAttentionRequest {
+  int token_offset; // first row of q and output
+  int num_tokens;   // queries of the request in this batch
+  int num_keys;     // cache positions the queries may read
+  int non_tree_cache_size;
+  int first_query_bit;
+  int cache_slot;
+  unsigned long long const *mask;
+};
+
+// Same layout and head mapping as causal_attention, with the visibility of
+// each key given by the request's bitmask instead of its position. Each
+// mask word covers up to 64 queries, so a key block is tested for a whole
+// query block with a few word operations and skipped without touching the
+// cache when no query in the block sees it.
+void tree_attention(float const *q,
+                    size_t q_stride,
+                    float const *key_cache,
+                    float const *value_cache,
+                    size_t cache_slot_stride,
+                    size_t cache_pos_stride,
+                    float *output,
+                    size_t output_stride,
+                    TreeAttentionRequest const *requests,
+                    int num_requests,
+                    int num_q_heads,
+                    int num_kv_heads,
+                    int head_dim,
+                    float scale,
+                    int num_threads);
+
+// Storage of a DT_HALF (IEEE binary16) element as seen by host code. The
+// templated kernels below take float or Half tensors and always accumulate
+// in fp32.
+struct Half {
+  uint16_t bits;
+};
+
+float half_to_float(Half h);
+
+// Rounds to nearest even
+Half float_to_half(float x);
+
+void convert(Half const *input, float *output, size_t num_elements);
+void convert(float const *input, Half *output, size_t num_elements);
+
+// pack_linear_weight for a DT_HALF weight. The panels are fp32, so a half
+// weight runs on the same micro-kernel as an fp32 one.
+void pack_linear_weight(Half const *weight,
+                        float *packed,
+                        int in_dim,
+                        int out_dim);
+
+// The normalization kernels work on rows of dim elements and spread rows
+// over num_threads. The residual variants read their inputs once: the sum
+// is written to residual_output while its moments are accumulated, and the
+// second pass normalizes from that row while it is still in L1. Statistics
+// are taken on the stored (rounded) residual, as the GPU kernels do.
+
+// output[r] = input[r] * weight / sqrt(mean(input[r]^2) + eps)
+template <typename T>
+void rms_norm_forward(T const *input,
+                      T const *weight,
+                      T *output,
+                      int dim,
+                      int num_rows,
+                      float eps,
+                      int num_threads);
+
+// residual_output = input1 + input2;
+// output = rms_norm_forward(residual_output)
+template <typename T>
+void residual_rms_norm_forward(T const *input1,
+                               T const *input2,
+                               T const *weight,
+                               T *residual_output,
+                               T *output,
+                               int dim,
+                               int num_rows,
+                               float eps,
+                               int num_threads);
+
+// residual_output = input + residual1 + residual2 + bias;
+// output = (residual_output - mean) / sqrt(var + eps) * gamma + beta.
+// residual1, residual2, bias (one value per column), gamma and beta may be
+// nullptr; with no residuals this is a plain layer norm that also copies its
+// input to residual_output.
+template <typename T>
+void residual_layer_norm_forward(T const *input,
+                                 T const *residual1,
+                                 T const *residual2,
+                                 T const *bias,
+                                 T const *gamma,
+                                 T const *beta,
+                                 T *residual_output,
+                                 T *output,
+                                 int dim,
+                                 int num_rows,
+                                 float eps,
+                                 int num_threads);
+
+// output = input1 * sigmoid(input1) * input2
+template <typename T>
+void sigmoid_silu_multi(T const *input1,
+                        T const *input2,
+                        T *output,
+                        size_t num_elements,
+                        int num_threads);
+
+template <typename T>
+void argmax(T const *input, int *indices, int vocab_size, int num_rows);
+
+// Top-p (nucleus) sampling of each row of probabilities: indices[r] is the
+// first token, in order of decreasing probability (ties by index), at which
+// the running mass reaches uniforms[r] * top_p, with uniforms[r] in [0, 1).
+// Only the prefix of the order that the draw needs is sorted.
+template <typename T>
+void sampling_top_p(T const *probs,
+                    float const *uniforms,
+                    int *indices,
+                    int vocab_size,
+                    int num_rows,
+                    float top_p);
+
+// AGGR_MODE_NONE gathers one row per index; SUM and AVG reduce in_dim
+// consecutive indices into one output row
+template <typename IT, typename T>
+void embedding_lookup(IT const *indices,
+                      T const *weight,
+                      T *output,
+                      int in_dim,
+                      int out_dim,
+                      int batch_size,
+                      AggrMode aggr);
+
+// Sort-based MoE dispatch of the batch_size * k expert assignments in
+// assign (k per token, row-major). A counting sort by expert keeps the
+// assignments of each expert in token order, so slots[i] is the row of
+// assignment i in its expert's buffer, or -1 if it lands past capacity and
+// is dropped: the same first-come order as the GPU GroupBy and Aggregate
+// kernels. counts[e] receives the number of assignments to expert e before
+// capping, i.e., the routing load of the step. order (batch_size * k
+// entries, may be nullptr) receives the kept assignments grouped by expert,
+// expert e starting at the sum of min(counts, capacity) of the experts
+// before it.
+void moe_dispatch(int const *assign,
+                  int *slots,
+                  int *order,
+                  int *counts,
+                  int n,
+                  int k,
+                  int capacity,
+                  int batch_size);
+
+// outputs[e][r] = input[t] for the r-th kept assignment (t, j) of expert e.
+// Each expert buffer is written front to back from the dispatch order
+// instead of scanning a dense token x expert mask; rows past an expert's
+// kept assignments are left untouched. counts as in moe_dispatch.
+void group_by_forward(float const *input,
+                      int const *assign,
+                      float *const *outputs,
+                      int *counts,
+                      int n,
+                      int k,
+                      int capacity,
+                      int batch_size,
+                      int data_dim,
+                      int num_threads);
+
+// output[t] = sum_j gate_preds[t][j] * exp_preds[assign[t][j]][slot], the
+// row of exp_preds the matching group_by_forward wrote the token to;
+// dropped assignments contribute nothing
+void aggregate_forward(float const *const *exp_preds,
+                       int const *assign,
+                       float const *gate_preds,
+                       float *output,
+                       int n,
+                       int k,
+                       int capacity,
+                       int batch_size,
+                       int out_dim,
+                       int num_threads);
+
+// Forward of the Experts operator for the block of experts
+// [experts_start_idx, experts_start_idx + num_experts): output[t] =
+// sum_j topk_gate_preds[t][j] * expert(indices[t][j], input[t]), where an
+// expert is one or two Linear layers (weights and biases laid out as in
+// Experts, biases may be nullptr) with the activation after each. Each
+// expert takes at most capacity tokens, in token order; other assignments
+// contribute nothing. The kept tokens are packed into one ragged batch with
+// per-expert offsets and every expert runs as a GEMM over its rows. counts
+// (num_experts entries, may be nullptr) as in moe_dispatch.
+void experts_forward(float const *input,
+                     int const *indices,
+                     float const *topk_gate_preds,
+                     float *output,
+                     float const *weights,
+                     float const *biases,
+                     int *counts,
+                     int num_tokens,
+                     int k,
+                     int num_experts,
+                     int experts_start_idx,
+                     int capacity,
+                     int data_dim,
+                     int out_dim,
+                     int num_layers,
+                     int internal_dim,
+                     ActiMode activation,
+                     int num_threads);
+
+} // namespace CPU
+} // namespace Kernels
+} // namespace FlexFlow
+
+#endif // _FLEXFLOW_OPS_KERNELS_CPU_KERNELS_H
@@ -5,6 +5,8 @@
 #include "flexflow/fftype.h"
 #include "flexflow/op_meta.h"
 #include "flexflow/ops/linear.h"
+#include <mutex>
+#include <vector>
 
 namespace FlexFlow {
 
@@ -35,6 +37,16 @@ public:
   float kernel_reg_lambda;
   bool use_bias, add_bias_only_once;
   Realm::RegionInstance reserveInst;
+  // Panel-packed copy of the fp32 kernel used by the CPU inference variant.
+  // Weights are loaded after init, so it is built on the first CPU inference
+  // and rebuilt if the kernel instance moves. It is held next to the kernel
+  // instance, which Legion keeps (the layouts differ, and the last panel is
+  // padded), so the operator's resident weight memory doubles; with
+  // --disable-cpu-weight-packing the variant reads the instance directly
+  // with the unpacked, single-threaded linear_forward instead.
+  std::vector<float> cpu_packed_weight;
+  void const *cpu_packed_source;
+  std::mutex cpu_pack_mutex;
 };
 
 namespace Kernels {
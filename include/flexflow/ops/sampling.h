@@ -13,6 +13,8 @@
 #include <hiprand/hiprand_kernel.h>
 #endif
 #include "flexflow/utils/memory_allocator.h"
+#include <mutex>
+#include <random>
 
 namespace FlexFlow {
 
@@ -32,6 +34,9 @@ public:
 #elif defined(FF_USE_HIP_ROCM)
   hiprandState *state;
 #endif
+  // Draws of the CPU variant
+  std::mt19937 cpu_generator;
+  std::mutex cpu_mutex;
   SamplingMeta(FFHandler handle,
                Op const *op,
                int batch_size,
@@ -83,6 +88,11 @@ public:
                      std::vector<Legion::PhysicalRegion> const &regions,
                      Legion::Context ctx,
                      Legion::Runtime *runtime);
+  static InferenceResult
+      inference_task_cpu(Legion::Task const *task,
+                         std::vector<Legion::PhysicalRegion> const &regions,
+                         Legion::Context ctx,
+                         Legion::Runtime *runtime);
   void serialize(Legion::Serializer &s) const override;
   static PCG::Node deserialize(FFModel &ff,
                                Legion::Deserializer &d,
@@ -106,6 +106,11 @@ public:
                              std::vector<Legion::PhysicalRegion> const &regions,
                              Legion::Context ctx,
                              Legion::Runtime *runtime);
+  static void
+      inference_task_cpu(Legion::Task const *task,
+                         std::vector<Legion::PhysicalRegion> const &regions,
+                         Legion::Context ctx,
+                         Legion::Runtime *runtime);
   bool measure_operator_cost(Simulator *sim,
                              MachineView const &mv,
                              CostMetrics &cost_metrics) const override;
@@ -149,6 +154,9 @@ public:
   TreeVerifyBatchConfig::CommittedTokensInfo *committed_token_infos;
   bool *request_completed;
   BatchConfig::BitMask *causalMask;
+  // QKV rows of the previous batch on the CPU variant, from which the keys
+  // and values of committed tokens are written back to the cache
+  std::vector<float> cpu_last_qkv;
 };
 
 }; // namespace FlexFlow
@@ -0,0 +1,62 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __FLEXFLOW_PIPELINE_STAGE_PROFILER_H__
+#define __FLEXFLOW_PIPELINE_STAGE_PROFILER_H__
+
+#include <map>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace FlexFlow {
+
+/**
+ * @brief Per-stage utilization of a pipeline-parallel model, derived from
+ * when each stage finished each launch.
+ *
+ * @details InferenceManager::inference reports, for every launch of a
+ * model, the time its batch became available (stage -1) and the time each
+ * pipeline stage finished all of its operators. A stage is taken to be busy
+ * with a launch from the later of its own previous finish and the finish
+ * of the stage before it, up to its own finish, so idle time between
+ * micro-batches shows up as the stage waiting on its input. The busy time
+ * is an upper bound, since a stage also counts the transfer of its input.
+ * Recording is thread-safe.
+ */
+class PipelineStageProfiler {
+public:
+  PipelineStageProfiler(int num_stages = 1);
+  // Stage -1 marks when the batch of the launch became available
+  void record(int launch, int stage, double time_us);
+  int get_num_stages() const;
+  // Per stage: time busy with some launch, in microseconds
+  std::vector<double> busy_time() const;
+  // Per stage: busy time over the span from the first batch to the last
+  // finish of the last stage
+  std::vector<double> utilization() const;
+  void reset();
+
+private:
+  mutable std::mutex mutex;
+  int num_stages;
+  // (launch, stage) -> finish time
+  std::map<std::pair<int, int>, double> finish_time;
+};
+
+}; // namespace FlexFlow
+
+#endif // __FLEXFLOW_PIPELINE_STAGE_PROFILER_H__
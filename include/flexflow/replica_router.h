@@ -0,0 +1,70 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#ifndef __FLEXFLOW_REPLICA_ROUTER_H__
+#define __FLEXFLOW_REPLICA_ROUTER_H__
+
+#include <cstddef>
+#include <unordered_map>
+#include <vector>
+
+namespace FlexFlow {
+
+/**
+ * @brief Assigns requests to the data-parallel replicas of a model served by
+ * one RequestManager.
+ *
+ * @details Each replica holds its own KV cache and batch stream. The load of
+ * a replica is the number of tokens it still has to prefill for the
+ * requests routed to it, plus the number of tokens its running requests
+ * hold in its KV cache. A new request goes to the replica with the least
+ * load (the lowest index on ties), so long prompts and long-running
+ * generations both count against a replica. Not thread-safe; RequestManager
+ * calls it under its request queue lock.
+ */
+class ReplicaRouter {
+public:
+  using RequestGuid = size_t;
+
+  ReplicaRouter(int num_replicas = 1);
+  int get_num_replicas() const;
+  // Pick a replica for a request of num_tokens prompt tokens and charge
+  // them to it as queued
+  int route(RequestGuid guid, size_t num_tokens);
+  // The request now has num_cached_tokens in the KV cache of its replica
+  void update(RequestGuid guid, size_t num_cached_tokens);
+  // The request finished and its KV cache entries are free again
+  void release(RequestGuid guid);
+  int get_replica(RequestGuid guid) const;
+  // Per replica, in tokens
+  std::vector<size_t> queued_tokens() const;
+  std::vector<size_t> cached_tokens() const;
+
+private:
+  struct RequestLoad {
+    int replica;
+    size_t num_prompt_tokens;
+    size_t num_cached_tokens;
+  };
+  size_t queued(RequestLoad const &load) const;
+  int num_replicas;
+  std::unordered_map<RequestGuid, RequestLoad> requests;
+  std::vector<size_t> queued_load, cached_load;
+};
+
+}; // namespace FlexFlow
+
+#endif // __FLEXFLOW_REPLICA_ROUTER_H__
@@ -16,10 +16,15 @@
 #pragma once
 
 #include "flexflow/batch_config.h"
+#include "flexflow/incremental_detokenizer.h"
 #include "flexflow/inference.h"
 #include "flexflow/model.h"
+#include "flexflow/pipeline_stage_profiler.h"
+#include "flexflow/replica_router.h"
 #include "flexflow/utils/file_loader.h"
+#include <functional>
 #include <future>
+#include <memory>
 #include <mutex>
 #include <tokenizers_cpp.h>
 
@@ -51,10 +56,41 @@ public:
   void load_inference_metadata_batch_config(FFModel *model,
                                             BatchConfigFuture const &bc,
                                             FFHandler *handlers);
+  // Load the metadata on the devices of one pipeline stage of one
+  // data-parallel replica only, after they finished the previous launch of
+  // the replica
+  void load_inference_metadata_batch_config(FFModel *model,
+                                            BatchConfigFuture const &bc,
+                                            FFHandler *handlers,
+                                            int stage,
+                                            int replica);
+  // When each pipeline stage of a replica of the model finished each
+  // launch; only recorded for models with more than one stage
+  PipelineStageProfiler *get_stage_profiler(FFModel *model, int replica = 0);
+  static void record_stage_finish_task(
+      Legion::Task const *task,
+      std::vector<Legion::PhysicalRegion> const &regions,
+      Legion::Context ctx,
+      Legion::Runtime *runtime);
+
+private:
+  void record_stage_finish(FFModel *model,
+                           int replica,
+                           int launch,
+                           int stage,
+                           std::vector<Legion::Future> const &wait_for);
 
 public:
   std::unordered_map<ParallelTensor, std::vector<ParallelTensor>> tensor_buffer;
   std::unordered_map<FFModel *, FileDataLoader *> model_weights_loaders;
+
+private:
+  // Per (model, data-parallel replica): the futures of every operator of
+  // each stage in the previous launch, and the number of launches so far
+  using ReplicaKey = std::pair<FFModel *, int>;
+  std::map<ReplicaKey, std::vector<std::vector<Legion::Future>>> stage_futures;
+  std::map<ReplicaKey, int> num_launches;
+  std::map<ReplicaKey, std::unique_ptr<PipelineStageProfiler>> stage_profilers;
 };
 
 struct Request {
@@ -72,6 +108,8 @@ struct Request {
 
   Status status = PENDING;
   std::vector<BatchConfig::TokenId> tokens;
+  // Decodes tokens into the output text of the request's GenerationResult
+  IncrementalDetokenizer detokenizer;
 
   std::vector<struct BeamTree> beam_trees;
 };
@@ -115,6 +153,12 @@ public:
   void set_max_tokens_per_batch(int max_num_tokens);
   int get_max_tokens_per_batch();
   int get_max_verify_tokens_per_batch();
+  // Incremental decoding splits the requests into num_micro_batches groups
+  // that advance independently, so that pipeline stages work on different
+  // groups at the same time. 0 (the default) uses one group per pipeline
+  // stage.
+  void set_num_micro_batches(int num_micro_batches);
+  int get_num_micro_batches();
   void set_max_sequence_length(int max_seq_length);
   void push_spec_infer_tree_width(int tree_width);
   int get_max_sequence_length();
@@ -145,6 +189,13 @@ public:
                                    int max_sequence_length);
   RequestGuid register_new_request(std::vector<TokenId> const &prompt,
                                    int max_sequence_length);
+  // Tokenizes the prompts on num_threads threads (0 for one per core), then
+  // adds them to the pending queue in order under one lock. Returns one guid
+  // per prompt, INVALID_GUID for prompts that are too long.
+  std::vector<RequestGuid>
+      register_new_requests(std::vector<std::string> const &prompts,
+                            int max_sequence_length,
+                            int num_threads = 0);
   // Methods to start and terminate request manager's background task
   void start_background_server(FFModel *model);
   bool is_background_server_terminated();
@@ -153,11 +204,19 @@ public:
   // Methods to check and mark request completion
   bool is_request_completed(RequestGuid const &guid);
   void trigger_request_completion_future(RequestGuid const &guid);
-  // Methods for preparing next batches
+  // Methods for preparing next batches. A micro-batch only uses the request
+  // slots i with i % num_micro_batches == micro_batch and its share of
+  // max_tokens_per_batch. Each data-parallel replica of the llm has its own
+  // request slots and KV cache, and only starts the requests that
+  // replica_router assigned to it.
   BatchConfig prepare_next_batch(BatchConfig const &bc,
-                                 InferenceResult const &result);
+                                 InferenceResult const &result,
+                                 int micro_batch = 0,
+                                 int replica = 0);
   BatchConfigFuture prepare_next_batch(BatchConfigFuture const &bc,
                                        InferenceResultFuture const &result,
+                                       int micro_batch,
+                                       int replica,
                                        Legion::Context ctx,
                                        Legion::Runtime *runtime);
   BeamSearchBatchConfig
@@ -256,10 +315,24 @@ public:
       Legion::Runtime *runtime);
 
 private:
+  // Appends the prompt to request.tokens after the BOS token, or returns
+  // false if the prompt is too long
+  bool load_prompt_tokens(std::vector<int32_t> const &tokens,
+                          Request &request);
+  // Assigns request a guid and adds it to the pending queue. Must be called
+  // with request_queue_mutex held.
+  RequestGuid enqueue_request(Request &request, std::string const &prompt);
+  // Appends the text of the tokens added to request since the last call to
+  // its GenerationResult, and returns the full output text. With flush, an
+  // incomplete trailing character is not held back. Must be called with
+  // request_queue_mutex held.
+  std::string const &update_output_text(Request &request, bool flush = false);
+
   // configuration parameters
   int max_requests_per_batch;
   int max_tokens_per_batch;
   int max_sequence_length;
+  int num_micro_batches;
   Status request_manager_status;
 
   // tree width in each speculative step, if not specified 1
@@ -267,12 +340,21 @@ private:
 
   // private fields
   std::unique_ptr<Tokenizer> tokenizer_;
+  // Creates a tokenizer from the files given to register_tokenizer
+  std::function<std::unique_ptr<Tokenizer>()> tokenizer_factory;
+  // Tokenizers of the register_new_requests workers
+  std::vector<std::unique_ptr<Tokenizer>> worker_tokenizers;
+  std::mutex worker_tokenizers_mutex;
   bool verbose;
   ModelType model_type;
   int bos_token_id;
   int eos_token_id;
   std::string output_filepath;
   std::queue<Request> pending_request_queue;
+  // Incremental decoding: requests routed to each data-parallel replica
+  // that it has not started yet
+  ReplicaRouter replica_router;
+  std::vector<std::queue<Request>> replica_queues;
   std::unordered_map<RequestGuid, Request> all_requests;
   std::unordered_map<RequestGuid, GenerationResult> request_generation_results;
   std::mutex request_queue_mutex;
@@ -17,6 +17,7 @@
 
 #include "config.h"
 #include "ffconst.h"
+#include "flexflow/mapper_profiling.h"
 #include "flexflow/operator_params.h"
 #include "flexflow/utils/hash_utils.h"
 #include "mpark/variant.hpp"
@@ -729,6 +730,11 @@ public:
                            std::vector<Legion::PhysicalRegion> const &regions,
                            Legion::Context ctx,
                            Legion::Runtime *runtime);
+  /**
+   * @brief Load execution times collected by the mapper (--mapper-profiling);
+   * they replace the microbenchmarked times of matching operators.
+   */
+  bool load_measured_costs(std::string const &file_name);
 
 public:
   Realm::RegionInstance simulatorInst;
@@ -749,6 +755,7 @@ public:
   std::unordered_map<size_t, CostMetrics> hash_to_operator_cost;
   std::unordered_map<ProfilingRecordKey, CostMetrics>
       strict_hash_to_operator_cost;
+  MeasuredCostTable measured_costs;
 
 public:
   Conv2DMeta *conv2d_meta;
@@ -768,6 +775,9 @@ public:
   int max_num_segments; // simulation could be slow if the number of segments
                         // are too large
 private:
+  void apply_measured_costs(Op const *op,
+                            MachineView const &mv,
+                            CostMetrics &cost_metrics) const;
   float estimate_repartition_xfer_cost(
       int repartition_dim,
       int repartition_degree,
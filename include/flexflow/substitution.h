@@ -120,6 +120,10 @@ void create_xfer(GraphXfer &xfer, sl::Rule const &r, int parallel_degree);
 std::vector<GraphXfer *> create_xfers(FFModel *model,
                                       sl::RuleCollection const &rules,
                                       int parallel_degree);
+std::vector<GraphXfer *>
+    create_xfers(FFModel *model,
+                 sl::CompiledRuleCollection const &compiled,
+                 int parallel_degree);
 
 class GraphCompare {
 public:
@@ -211,6 +215,11 @@ public:
 
   Graph *create_new_graph(Graph const *graph,
                           SimplificationSettings const &settings);
+  Graph *create_new_graph(CompactPCG const &graph,
+                          SimplificationSettings const &settings);
+  // The graph resulting from applying the current match to graph, derived
+  // without copying the nodes and edges that the match leaves untouched
+  CompactPCG rewrite_compact(CompactPCG const &graph);
   bool create_new_operator(OpX const *opx, Node &op);
 
   std::string get_name() const;
@@ -219,6 +228,7 @@ public:
   void
       run(int depth,
           Graph *graph,
+          CompactPCG const &compact_graph,
           std::priority_queue<Graph *, std::vector<Graph *>, GraphComparator> &,
           std::unordered_set<size_t> &,
           float threshold,
@@ -187,6 +187,35 @@ void from_json(json const &j, RuleCollection &c);
 RuleCollection load_rule_collection(std::istream &s);
 RuleCollection load_rule_collection_from_path(std::string const &path);
 
+/**
+ * @brief A rule collection preprocessed for fast loading and matching.
+ *
+ * Structurally identical rules are removed, the parameters of every source
+ * operator are reordered so that the most selective checks come first, and
+ * the output mappings are sorted by source tensor.
+ */
+struct CompiledRuleCollection {
+  std::vector<Rule> rules;
+  size_t num_duplicates_removed = 0;
+};
+
+CompiledRuleCollection compile_rule_collection(RuleCollection const &c);
+void save_compiled_rule_collection(CompiledRuleCollection const &c,
+                                   std::ostream &s);
+bool load_compiled_rule_collection(std::istream &s, CompiledRuleCollection &c);
+/**
+ * @brief The binary cache of the rule collection at path, under
+ * $XDG_CACHE_HOME/flexflow (~/.cache/flexflow by default); empty when
+ * neither variable is set.
+ */
+std::string compiled_rule_cache_path(std::string const &path);
+/**
+ * @brief Load and compile the JSON rule collection at path, using (and
+ * refreshing) its binary cache.
+ */
+CompiledRuleCollection
+    load_compiled_rule_collection_from_path(std::string const &path);
+
 } // namespace substitution_loader
 } // namespace FlexFlow
 
@@ -44,6 +44,12 @@ ff_arg_to_sysarg = {
     "inference_debugging": "--inference-debugging",
     "fusion": "--fusion",
     "disable_control_replication": "--disable-control-replication",
+    "task_priority_policy": "--task-priority-policy",
+    "task_priority": "--task-priority",
+    "mapper_profiling": "--mapper-profiling",
+    "mapper_profiling_capacity": "--mapper-profiling-capacity",
+    "measured_costs": "--measured-costs",
+    "variant_selection": "--variant-selection",
     # Training args
     "epochs": "--epochs",
     "batch_size": "--batch-size",
@@ -64,6 +70,11 @@ ff_arg_to_sysarg = {
     "enable_parameter_parallel": "--enable-parameter-parallel",
     "enable_attribute_parallel": "--enable-attribute-parallel",
     "allow_tensor_op_math_conversion": "--allow-tensor-op-math-conversion",
+    "cpu_kernel_threads": "--cpu-kernel-threads",
+    "disable_cpu_weight_packing": "--disable-cpu-weight-packing",
+    "experts_grouped_gemm": "--experts-grouped-gemm",
+    "expert_routing_interval": "--expert-routing-interval",
+    "expert_routing_file": "--expert-routing-file",
     "search_overlap_backward_update": "--overlap",
     "export_strategy_task_graph_file": "--taskgraph",
     "include_costs_dot_graph": "--include-costs-dot-graph",
@@ -132,6 +143,11 @@ def init_flexflow_runtime(configs_dict: Optional[dict] = None, **kwargs):
                     if type(ff_args[arg]) == bool:
                         if ff_args[arg] is not True:
                             continue
+                    elif type(ff_args[arg]) in (list, tuple):
+                        # Repeated flags, e.g., task_priority=["12:5", "40:3"]
+                        sys_arg = []
+                        for value in ff_args[arg]:
+                            sys_arg += [ff_arg_to_sysarg[arg], str(value)]
                     else:
                         sys_arg += [str(ff_args[arg])]
                     sys.argv += sys_arg
@@ -4204,6 +4204,10 @@ class RequestManager(object):
         return ffc().flexflow_request_manager_set_max_sequence_length(
             self.handle, max_length)
 
+    def set_num_micro_batches(self, num_micro_batches):
+        return ffc().flexflow_request_manager_set_num_micro_batches(
+            self.handle, num_micro_batches)
+
     def start_server(self, model):
         return ffc().flexflow_request_manager_start_background_server(
             self.handle, model.handle
@@ -2589,6 +2589,13 @@ void flexflow_request_manager_set_max_sequence_length(
   DEBUG_PRINT("[RequestManager] set max_sequence_length %d", max_seq_length);
 }
 
+void flexflow_request_manager_set_num_micro_batches(
+    flexflow_request_manager_t handle_, int num_micro_batches) {
+  RequestManager *handle = FFCObjectWrapper::unwrap(handle_);
+  handle->set_num_micro_batches(num_micro_batches);
+  DEBUG_PRINT("[RequestManager] set num_micro_batches %d", num_micro_batches);
+}
+
 void flexflow_request_manager_register_tokenizer(
     flexflow_request_manager_t handle_,
     enum ModelType model_type,
@@ -14,6 +14,7 @@
  */
 
 #include "flexflow/mapper.h"
+#include <fstream>
 
 namespace FlexFlow {
 
@@ -22,6 +23,34 @@ using namespace Mapping;
 
 LegionRuntime::Logger::Category log_ff_mapper("Mapper");
 
+std::shared_ptr<std::unordered_map<RegionTreeID, int> const>
+    FFMapper::region_priorities;
+std::shared_ptr<std::unordered_map<RegionTreeID, size_t> const>
+    FFMapper::region_op_hashes;
+std::unique_ptr<MapperProfilingBuffer> FFMapper::profiling_buffer;
+std::string FFMapper::profiling_prefix;
+AddressSpace FFMapper::profiling_node = 0;
+
+// Number of launches timed on each processor kind before MEASURED_COST
+// trusts the averages
+static size_t const VARIANT_EXPLORATION_SAMPLES = 3;
+
+std::mutex FFMapper::variant_cost_mutex;
+// The CPU and GPU variants of the attention operators keep separate KV
+// caches, so an operator must not change kind between decoding steps. All of
+// them are first launched in the first step, before any timing, so they stay
+// on the GPU; the CPU attention variants are only reached through the
+// machine-view and size-threshold policies.
+MeasuredVariantSelector
+    FFMapper::variant_costs(VARIANT_EXPLORATION_SAMPLES,
+                            {INC_MULTIHEAD_SELF_ATTENTION_INF_TASK_ID,
+                             TREE_INC_MULTIHEAD_SELF_ATTENTION_INF_TASK_ID,
+                             SPEC_INC_MULTIHEAD_SELF_ATTENTION_INF_TASK_ID});
+
+// Policy boosts dominate critical-path ranks, which are bounded by the
+// number of operators in the PCG
+static int const POLICY_PRIORITY_BOOST = 1 << 16;
+
 FFShardingFunctor::FFShardingFunctor(int _gpus_per_node,
                                      int _cpus_per_node,
                                      int _num_nodes,
@@ -63,11 +92,18 @@ FFMapper::FFMapper(MapperRuntime *rt,
                    char const *_mapper_name,
                    // const std::string& strategyFile,
                    bool _enable_control_replication,
-                   bool _log_instance_creation)
+                   bool _log_instance_creation,
+                   TaskPriorityPolicy _priority_policy,
+                   std::map<TaskID, int> const &_task_priorities,
+                   VariantSelectionPolicy _variant_policy,
+                   size_t _cpu_variant_max_elements)
     : NullMapper(rt, machine), local_processor(_local),
       node_id(_local.address_space()), mapper_name(_mapper_name),
       enable_control_replication(_enable_control_replication),
-      log_instance_creation(_log_instance_creation) {
+      log_instance_creation(_log_instance_creation),
+      priority_policy(_priority_policy), task_priorities(_task_priorities),
+      variant_policy(_variant_policy),
+      cpu_variant_max_elements(_cpu_variant_max_elements) {
   std::vector<Machine::ProcessorMemoryAffinity> proc_mem_affinities;
   machine.get_proc_mem_affinity(proc_mem_affinities);
   Machine::ProcessorQuery proc_query(machine);
@@ -251,6 +287,352 @@ bool FFMapper::is_initializer_task(TaskID tid) {
   }
 }
 
+bool FFMapper::is_backward_task(TaskID tid) {
+  switch (tid) {
+    case ELEMENTBINARY_BWD_TASK_ID:
+    case ELEMENTUNARY_BWD_TASK_ID:
+    case EXPERTS_BWD_TASK_ID:
+    case CONV2D_BWD_TASK_ID:
+    case DROPOUT_BWD_TASK_ID:
+    case EMBED_BWD_TASK_ID:
+    case GATHER_BWD_TASK_ID:
+    case GROUP_BY_BWD_TASK_ID:
+    case CAST_BWD_TASK_ID:
+    case AGGREGATE_BWD_TASK_ID:
+    case AGG_SPEC_BWD_TASK_ID:
+    case POOL2D_BWD_TASK_ID:
+    case BATCHNORM_BWD_TASK_ID:
+    case BATCHMATMUL_BWD_TASK_ID:
+    case LAYERNORM_BWD_TASK_ID:
+    case LINEAR_BWD_TASK_ID:
+    case LINEAR_BWD2_TASK_ID:
+    case FLAT_BWD_TASK_ID:
+    case SOFTMAX_BWD_TASK_ID:
+    case CONCAT_BWD_TASK_ID:
+    case SPLIT_BWD_TASK_ID:
+    case REDUCE_BWD_TASK_ID:
+    case RESHAPE_BWD_TASK_ID:
+    case REVERSE_BWD_TASK_ID:
+    case TOPK_BWD_TASK_ID:
+    case TRANSPOSE_BWD_TASK_ID:
+    case ATTENTION_BWD_TASK_ID:
+    case INC_MULTIHEAD_SELF_ATTENTION_BWD_TASK_ID:
+    case MSELOSS_BWD_TASK_ID:
+    case FUSEDOP_BWD_TASK_ID:
+    case LOSS_BWD_TASK_ID:
+    case REPARTITION_BWD_TASK_ID:
+    case COMBINE_BWD_TASK_ID:
+    case REPLICATE_BWD_TASK_ID:
+    case REDUCTION_BWD_TASK_ID:
+    case PIPELINE_BWD_TASK_ID:
+    case FUSED_PARALLELOP_BWD_TASK_ID:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool FFMapper::is_gradient_sync_task(TaskID tid) {
+  switch (tid) {
+    case ALLREDUCE_BWD_TASK_ID:
+    case SGD_UPD_NCCL_TASK_ID:
+    case ADAM_UPD_NCCL_TASK_ID:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool FFMapper::is_inference_task(TaskID tid) {
+  switch (tid) {
+    case ELEMENTBINARY_INF_TASK_ID:
+    case ELEMENTUNARY_INF_TASK_ID:
+    case EXPERTS_INF_TASK_ID:
+    case EMBED_INF_TASK_ID:
+    case LAYERNORM_INF_TASK_ID:
+    case RESIDUAL_LAYERNORM_INF_TASK_ID:
+    case ADD_BIAS_RESIDUAL_LAYERNORM_INF_TASK_ID:
+    case SIGMOID_SILU_MULTI_INF_TASK_ID:
+    case LINEAR_INF_TASK_ID:
+    case SOFTMAX_INF_TASK_ID:
+    case ARG_TOPK_INF_TASK_ID:
+    case SAMPLING_INF_TASK_ID:
+    case ARGMAX_BEAM_INF_TASK_ID:
+    case ARGMAX_NORM_INF_TASK_ID:
+    case RMSNORM_INF_TASK_ID:
+    case RESIDUAL_RMSNORM_INF_TASK_ID:
+    case BEAM_TOPK_INF_TASK_ID:
+    case INC_MULTIHEAD_SELF_ATTENTION_INF_TASK_ID:
+    case SPEC_INC_MULTIHEAD_SELF_ATTENTION_INF_TASK_ID:
+    case TREE_INC_MULTIHEAD_SELF_ATTENTION_INF_TASK_ID:
+    case FUSEDOP_INF_TASK_ID:
+    case ALLREDUCE_INF_TASK_ID:
+    case RM_LOAD_TOKENS_TASK_ID:
+    case RM_LOAD_POSITION_TASK_ID:
+    case RM_LOAD_BATCH_CONFIG_TASK_ID:
+    case RM_PREPARE_NEXT_BATCH_TASK_ID:
+    case RM_PREPARE_NEXT_BATCH_INIT_TASK_ID:
+    case RM_PREPARE_NEXT_BATCH_BEAM_TASK_ID:
+    case RM_PREPARE_NEXT_BATCH_VERIFY_TASK_ID:
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool FFMapper::is_background_task(TaskID tid) {
+  switch (tid) {
+    case METRICS_COMP_TASK_ID:
+    case UPDATE_METRICS_TASK_ID:
+      return true;
+    default:
+      return is_initializer_task(tid);
+  }
+}
+
+void FFMapper::set_region_priorities(
+    std::unordered_map<RegionTreeID, int> const &priorities) {
+  // Mapper calls that still hold the previous table keep it alive
+  std::atomic_store(
+      &region_priorities,
+      std::make_shared<std::unordered_map<RegionTreeID, int> const>(
+          priorities));
+}
+
+void FFMapper::set_region_op_hashes(
+    std::unordered_map<RegionTreeID, size_t> const &op_hashes) {
+  std::atomic_store(
+      &region_op_hashes,
+      std::make_shared<std::unordered_map<RegionTreeID, size_t> const>(
+          op_hashes));
+}
+
+bool FFMapper::parse_task_priority_policy(char const *name,
+                                          TaskPriorityPolicy &policy) {
+  if (!strcmp(name, "none")) {
+    policy = TaskPriorityPolicy::NONE;
+  } else if (!strcmp(name, "critical-path")) {
+    policy = TaskPriorityPolicy::CRITICAL_PATH;
+  } else if (!strcmp(name, "comm-first")) {
+    policy = TaskPriorityPolicy::COMM_FIRST;
+  } else if (!strcmp(name, "decode-first")) {
+    policy = TaskPriorityPolicy::DECODE_FIRST;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool FFMapper::parse_variant_selection_policy(
+    char const *name, VariantSelectionPolicy &policy) {
+  if (!strcmp(name, "machine-view")) {
+    policy = VariantSelectionPolicy::MACHINE_VIEW;
+  } else if (!strcmp(name, "size-threshold")) {
+    policy = VariantSelectionPolicy::SIZE_THRESHOLD;
+  } else if (!strcmp(name, "measured-cost")) {
+    policy = VariantSelectionPolicy::MEASURED_COST;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+std::vector<VariantID> const &FFMapper::find_variants(MapperContext ctx,
+                                                      TaskID tid,
+                                                      Processor::Kind kind) {
+  auto key = std::make_pair(tid, kind);
+  auto it = variant_cache.find(key);
+  if (it == variant_cache.end()) {
+    std::vector<VariantID> variant_ids;
+    runtime->find_valid_variants(ctx, tid, variant_ids, kind);
+    it = variant_cache.emplace(key, variant_ids).first;
+  }
+  return it->second;
+}
+
+Processor::Kind FFMapper::select_processor_kind(MapperContext ctx,
+                                                Task const &task,
+                                                MachineView const &view,
+                                                Domain const &domain) {
+  Processor::Kind preferred = view.device_type == MachineView::GPU
+                                  ? Processor::TOC_PROC
+                                  : Processor::LOC_PROC;
+  // Processor availability: a kind is usable only if the task has a variant
+  // for it and the machine has processors of that kind
+  bool gpu_ok = !all_gpus.empty() &&
+                !find_variants(ctx, task.task_id, Processor::TOC_PROC).empty();
+  bool cpu_ok = !all_cpus.empty() &&
+                !find_variants(ctx, task.task_id, Processor::LOC_PROC).empty();
+  switch (task.task_id) {
+    case INC_MULTIHEAD_SELF_ATTENTION_INF_TASK_ID:
+    case SPEC_INC_MULTIHEAD_SELF_ATTENTION_INF_TASK_ID:
+    case TREE_INC_MULTIHEAD_SELF_ATTENTION_INF_TASK_ID: {
+      // The CPU attention variants compute in fp32 only, so half models
+      // keep their attention on the GPU
+      FieldSpace fs = task.regions[0].region.get_field_space();
+      if (runtime->get_field_size(ctx, fs, FID_DATA) != sizeof(float)) {
+        cpu_ok = false;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  assert(gpu_ok || cpu_ok);
+  if (!gpu_ok) {
+    return Processor::LOC_PROC;
+  }
+  if (!cpu_ok) {
+    return Processor::TOC_PROC;
+  }
+  switch (variant_policy) {
+    case VariantSelectionPolicy::MACHINE_VIEW:
+      return preferred;
+    case VariantSelectionPolicy::SIZE_THRESHOLD: {
+      if (preferred == Processor::LOC_PROC) {
+        return preferred;
+      }
+      // Elements touched by each point task
+      size_t volume = 0;
+      for (size_t i = 0; i < task.regions.size(); i++) {
+        if (task.regions[i].parent == LogicalRegion::NO_REGION) {
+          continue;
+        }
+        volume += runtime
+                      ->get_index_space_domain(
+                          ctx, task.regions[i].parent.get_index_space())
+                      .get_volume();
+      }
+      volume /= std::max((size_t)1, domain.get_volume());
+      return volume <= cpu_variant_max_elements ? Processor::LOC_PROC
+                                                : Processor::TOC_PROC;
+    }
+    case VariantSelectionPolicy::MEASURED_COST: {
+      // The operator of a launch is identified by the region trees it
+      // accesses, which include its weights
+      size_t op_key = 0;
+      for (size_t i = 0; i < task.regions.size(); i++) {
+        if (task.regions[i].parent != LogicalRegion::NO_REGION) {
+          op_key = op_key * 1000003 + task.regions[i].parent.get_tree_id();
+        }
+      }
+      const std::lock_guard<std::mutex> lock(variant_cost_mutex);
+      return variant_costs.select(task.task_id, op_key) ==
+                     MeasuredVariantSelector::CPU
+                 ? Processor::LOC_PROC
+                 : Processor::TOC_PROC;
+    }
+    default:
+      assert(false);
+  }
+  return preferred;
+}
+
+Processor FFMapper::get_counterpart_proc(Processor proc,
+                                         Processor::Kind kind) {
+  std::vector<Processor> const &candidates =
+      kind == Processor::TOC_PROC ? all_gpus : all_cpus;
+  std::vector<Processor> const &peers =
+      proc.kind() == Processor::TOC_PROC ? all_gpus : all_cpus;
+  // Stay on the same node and spread the peers of proc round-robin
+  std::vector<Processor> same_node;
+  for (Processor const &p : candidates) {
+    if (p.address_space() == proc.address_space()) {
+      same_node.push_back(p);
+    }
+  }
+  assert(!same_node.empty());
+  size_t local_idx = 0;
+  for (Processor const &p : peers) {
+    if (p == proc) {
+      break;
+    }
+    if (p.address_space() == proc.address_space()) {
+      local_idx++;
+    }
+  }
+  return same_node[local_idx % same_node.size()];
+}
+
+void FFMapper::enable_profiling(std::string const &prefix,
+                                AddressSpace node,
+                                size_t capacity) {
+  assert(profiling_buffer == nullptr);
+  profiling_buffer.reset(new MapperProfilingBuffer(capacity));
+  profiling_prefix = prefix;
+  profiling_node = node;
+  std::atexit(FFMapper::dump_profiling);
+}
+
+void FFMapper::dump_profiling() {
+  if (profiling_buffer == nullptr) {
+    return;
+  }
+  std::vector<MapperProfilingRecord> records = profiling_buffer->snapshot();
+  std::string base = profiling_prefix + "." + std::to_string(profiling_node);
+  std::ofstream trace(base + ".trace.json");
+  write_chrome_trace(trace, records);
+  std::ofstream costs(base + ".costs");
+  write_measured_cost_table(costs, aggregate_measured_costs(records));
+  if (profiling_buffer->dropped() > 0) {
+    log_ff_mapper.warning("Mapper profiling buffer full: dropped %zu of %zu "
+                          "records, increase --mapper-profiling-capacity",
+                          profiling_buffer->dropped(),
+                          profiling_buffer->dropped() + records.size());
+  }
+  log_ff_mapper.print("Wrote %zu profiling records to %s.{trace.json,costs}",
+                      records.size(),
+                      base.c_str());
+}
+
+int FFMapper::compute_task_priority(Task const &task) {
+  // Explicit per-task-id priorities always win
+  auto override_it = task_priorities.find(task.task_id);
+  if (override_it != task_priorities.end()) {
+    return override_it->second;
+  }
+  if (priority_policy == TaskPriorityPolicy::NONE) {
+    return 0;
+  }
+  // Critical-path rank: the largest rank among the regions this task writes
+  int priority = 0;
+  auto priorities = std::atomic_load(&region_priorities);
+  for (size_t i = 0; priorities != nullptr && i < task.regions.size(); i++) {
+    RegionRequirement const &req = task.regions[i];
+    if (req.privilege == LEGION_NO_ACCESS ||
+        req.privilege == LEGION_READ_ONLY) {
+      continue;
+    }
+    auto it = priorities->find(req.region.get_tree_id());
+    if (it != priorities->end()) {
+      priority = std::max(priority, it->second);
+    }
+  }
+  switch (priority_policy) {
+    case TaskPriorityPolicy::COMM_FIRST: {
+      // Gradient synchronization overlaps with the remaining backward pass
+      // only if it is issued as soon as its inputs are ready
+      if (is_gradient_sync_task(task.task_id)) {
+        priority += 2 * POLICY_PRIORITY_BOOST;
+      } else if (is_backward_task(task.task_id)) {
+        priority += POLICY_PRIORITY_BOOST;
+      }
+      break;
+    }
+    case TaskPriorityPolicy::DECODE_FIRST: {
+      if (is_inference_task(task.task_id)) {
+        priority += POLICY_PRIORITY_BOOST;
+      } else if (is_background_task(task.task_id)) {
+        priority -= POLICY_PRIORITY_BOOST;
+      }
+      break;
+    }
+    default:
+      break;
+  }
+  return priority;
+}
+
 char const *FFMapper::get_mapper_name(void) const {
   return mapper_name;
 }
@@ -381,6 +763,8 @@ void FFMapper::slice_task(const MapperContext ctx,
   output.slices.resize(input.domain.get_volume());
   std::vector<Processor> const *devices;
   MachineView view;
+  // Processor kind of the chosen variant, NO_KIND keeps the view's devices
+  Processor::Kind target_kind = Processor::NO_KIND;
   if ((task.task_id == TOP_LEVEL_TASK_ID) ||
       ((task.task_id >= CUSTOM_CPU_TASK_ID_FIRST) &&
        (task.task_id <= CUSTOM_CPU_TASK_ID_LAST))) {
@@ -411,13 +795,9 @@ void FFMapper::slice_task(const MapperContext ctx,
     assert(hash != 0);
     if (machine_views.find(hash) == machine_views.end()) {
       // No strategy found, use default data parallelism
-      std::vector<VariantID> variant_ids;
-      runtime->find_valid_variants(
-          ctx, task.task_id, variant_ids, Processor::TOC_PROC);
-      if (variant_ids.size() > 0) {
+      if (!all_gpus.empty() &&
+          !find_variants(ctx, task.task_id, Processor::TOC_PROC).empty()) {
         // Use GPU implementation
-        // Currently assume there is exactly one variant
-        assert(variant_ids.size() == 1);
         // Assert data parallelism must be 1-d index space
         // since all other dims with a degree of 1 should be eliminated
         assert(input.domain.get_dim() == 1);
@@ -426,9 +806,7 @@ void FFMapper::slice_task(const MapperContext ctx,
         view = machine_views[FFConfig::DataParallelism_GPU];
       } else {
         // Use CPU implementation
-        runtime->find_valid_variants(
-            ctx, task.task_id, variant_ids, Processor::LOC_PROC);
-        assert(variant_ids.size() == 1);
+        assert(!find_variants(ctx, task.task_id, Processor::LOC_PROC).empty());
         // Assert data parallelism must be 1-d index space
         // since all other dims with a degree of 1 should be eliminated
         assert(input.domain.get_dim() == 1);
@@ -447,6 +825,7 @@ void FFMapper::slice_task(const MapperContext ctx,
     } else {
       devices = &all_cpus;
     }
+    target_kind = select_processor_kind(ctx, task, view, input.domain);
   }
   switch (input.domain.get_dim()) {
 #define DIMFUNC(DIM)                                                           \
@@ -459,8 +838,11 @@ void FFMapper::slice_task(const MapperContext ctx,
         idx += (pir[i] - task.index_domain.lo()[i]) * view.stride[i];          \
       assert((size_t)idx < devices->size());                                   \
       Rect<DIM> slice(*pir, *pir);                                             \
+      Processor proc = (*devices)[idx];                                        \
+      if (target_kind != Processor::NO_KIND && proc.kind() != target_kind)     \
+        proc = get_counterpart_proc(proc, target_kind);                        \
       output.slices[cnt++] = TaskSlice(                                        \
-          slice, (*devices)[idx], false /*recurse*/, false /*stealable*/);     \
+          slice, proc, false /*recurse*/, false /*stealable*/);                \
     }                                                                          \
     break;                                                                     \
   }
@@ -491,15 +873,22 @@ void FFMapper::map_task(const MapperContext ctx,
                         Task const &task,
                         MapTaskInput const &input,
                         MapTaskOutput &output) {
-  std::vector<VariantID> variant_ids;
-  runtime->find_valid_variants(
-      ctx, task.task_id, variant_ids, task.target_proc.kind());
-  // Currently assume there is exactly one variant
-  assert(variant_ids.size() == 1);
+  // The processor kind was decided in slice_task; among the variants for
+  // that kind, the first registered one is the default
+  std::vector<VariantID> const &variant_ids =
+      find_variants(ctx, task.task_id, task.target_proc.kind());
+  assert(variant_ids.size() > 0);
   output.chosen_variant = variant_ids[0];
-  // TODO: assign priorities
-  output.task_priority = 0;
+  output.task_priority = compute_task_priority(task);
   output.postmap_task = false;
+  if ((profiling_buffer != nullptr ||
+       variant_policy == VariantSelectionPolicy::MEASURED_COST) &&
+      task.get_depth() > 0) {
+    output.task_prof_requests
+        .add_measurement<ProfilingMeasurements::OperationTimeline>();
+    output.task_prof_requests
+        .add_measurement<ProfilingMeasurements::OperationProcessorUsage>();
+  }
   if (task.target_proc.address_space() != node_id) {
     assert(false);
     output.target_procs.push_back(task.target_proc);
@@ -698,7 +1087,10 @@ void FFMapper::select_task_variant(const MapperContext ctx,
                                    Task const &task,
                                    SelectVariantInput const &input,
                                    SelectVariantOutput &output) {
-  assert(false);
+  std::vector<VariantID> const &variant_ids =
+      find_variants(ctx, task.task_id, input.processor.kind());
+  assert(variant_ids.size() > 0);
+  output.chosen_variant = variant_ids[0];
 }
 
 void FFMapper::postmap_task(const MapperContext ctx,
@@ -809,7 +1201,43 @@ void FFMapper::speculate(const MapperContext ctx,
 void FFMapper::report_profiling(const MapperContext ctx,
                                 Task const &task,
                                 TaskProfilingInfo const &input) {
-  assert(false);
+  // Only requested by map_task when profiling or measured-cost variant
+  // selection is enabled
+  ProfilingMeasurements::OperationTimeline timeline;
+  if (!input.profiling_responses.get_measurement(timeline)) {
+    return;
+  }
+  if (variant_policy == VariantSelectionPolicy::MEASURED_COST) {
+    const std::lock_guard<std::mutex> lock(variant_cost_mutex);
+    variant_costs.record(task.task_id,
+                         task.target_proc.kind() == Processor::LOC_PROC
+                             ? MeasuredVariantSelector::CPU
+                             : MeasuredVariantSelector::GPU,
+                         (timeline.end_time - timeline.start_time) / 1e3f);
+  }
+  if (profiling_buffer == nullptr) {
+    return;
+  }
+  MapperProfilingRecord record;
+  record.kind = MapperProfilingRecord::TASK;
+  record.task_id = task.task_id;
+  record.view_hash = task.tag;
+  auto op_hashes = std::atomic_load(&region_op_hashes);
+  for (size_t i = 0; op_hashes != nullptr && i < task.regions.size(); i++) {
+    auto it = op_hashes->find(task.regions[i].region.get_tree_id());
+    if (it != op_hashes->end()) {
+      record.params_hash = it->second;
+      break;
+    }
+  }
+  record.start_ns = timeline.start_time;
+  record.end_ns = timeline.end_time;
+  ProfilingMeasurements::OperationProcessorUsage usage;
+  if (input.profiling_responses.get_measurement(usage)) {
+    record.proc_id = usage.proc.id;
+  }
+  strncpy(record.name, task.get_task_name(), sizeof(record.name) - 1);
+  profiling_buffer->record(record);
 }
 
 void FFMapper::select_sharding_functor(const MapperContext ctx,
@@ -996,7 +1424,21 @@ void FFMapper::speculate(const MapperContext ctx,
 void FFMapper::report_profiling(const MapperContext ctx,
                                 Copy const &copy,
                                 CopyProfilingInfo const &input) {
-  assert(false);
+  // Data movement between machine views is performed by parallel-op tasks,
+  // which are recorded as tasks; explicit copies are recorded here
+  if (profiling_buffer == nullptr) {
+    return;
+  }
+  ProfilingMeasurements::OperationTimeline timeline;
+  if (!input.profiling_responses.get_measurement(timeline)) {
+    return;
+  }
+  MapperProfilingRecord record;
+  record.kind = MapperProfilingRecord::COPY;
+  record.view_hash = copy.tag;
+  record.start_ns = timeline.start_time;
+  record.end_ns = timeline.end_time;
+  profiling_buffer->record(record);
 }
 
 void FFMapper::select_sharding_functor(const MapperContext ctx,
@@ -1467,6 +1909,12 @@ void FFMapper::update_mappers(Machine machine,
 
   bool enable_control_replication = true;
   bool log_instance_creation = false;
+  TaskPriorityPolicy priority_policy = TaskPriorityPolicy::CRITICAL_PATH;
+  std::map<TaskID, int> task_priorities;
+  std::string profiling_prefix = "";
+  size_t profiling_capacity = 1 << 20;
+  VariantSelectionPolicy variant_policy = VariantSelectionPolicy::MACHINE_VIEW;
+  size_t cpu_variant_max_elements = 4096;
   for (int i = 1; i < argc; i++) {
     // if ((!strcmp(argv[i], "--import")) || (!strcmp(argv[i],
     // "--import-strategy"))) {
@@ -1481,6 +1929,54 @@ void FFMapper::update_mappers(Machine machine,
       log_instance_creation = true;
       continue;
     }
+    if (!strcmp(argv[i], "--task-priority-policy") && i + 1 < argc) {
+      if (!parse_task_priority_policy(argv[++i], priority_policy)) {
+        log_ff_mapper.warning("Unknown task priority policy %s, expected "
+                              "none|critical-path|comm-first|decode-first",
+                              argv[i]);
+      }
+      continue;
+    }
+    if (!strcmp(argv[i], "--variant-selection") && i + 1 < argc) {
+      if (!parse_variant_selection_policy(argv[++i], variant_policy)) {
+        log_ff_mapper.warning("Unknown variant selection policy %s, expected "
+                              "machine-view|size-threshold|measured-cost",
+                              argv[i]);
+      }
+      continue;
+    }
+    if (!strcmp(argv[i], "--cpu-variant-max-elements") && i + 1 < argc) {
+      cpu_variant_max_elements = atoll(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--mapper-profiling") && i + 1 < argc) {
+      profiling_prefix = std::string(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--mapper-profiling-capacity") && i + 1 < argc) {
+      profiling_capacity = atoll(argv[++i]);
+      continue;
+    }
+    // --task-priority <task_id>:<priority>, may be repeated
+    if (!strcmp(argv[i], "--task-priority") && i + 1 < argc) {
+      unsigned task_id = 0;
+      int priority = 0;
+      if (sscanf(argv[++i], "%u:%d", &task_id, &priority) == 2) {
+        task_priorities[(TaskID)task_id] = priority;
+      } else {
+        log_ff_mapper.warning("Ignoring malformed --task-priority %s, "
+                              "expected <task_id>:<priority>",
+                              argv[i]);
+      }
+      continue;
+    }
+  }
+
+  if (!profiling_prefix.empty() && !local_procs.empty() &&
+      profiling_buffer == nullptr) {
+    FFMapper::enable_profiling(profiling_prefix,
+                               local_procs.begin()->address_space(),
+                               profiling_capacity);
   }
 
   for (std::set<Processor>::const_iterator it = local_procs.begin();
@@ -1491,7 +1987,11 @@ void FFMapper::update_mappers(Machine machine,
                                     *it,
                                     "FlexFlow Mapper",
                                     enable_control_replication,
-                                    log_instance_creation);
+                                    log_instance_creation,
+                                    priority_policy,
+                                    task_priorities,
+                                    variant_policy,
+                                    cpu_variant_max_elements);
     runtime->replace_default_mapper(mapper, *it);
   }
 }
@@ -0,0 +1,186 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/mapper_profiling.h"
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <string>
+
+namespace FlexFlow {
+
+MeasuredVariantSelector::MeasuredVariantSelector(
+    size_t _exploration_samples, std::set<unsigned> const &_stateful_tasks)
+    : exploration_samples(_exploration_samples),
+      stateful_tasks(_stateful_tasks) {}
+
+MeasuredVariantSelector::Kind
+    MeasuredVariantSelector::select(unsigned task_id, size_t op_key) {
+  auto pinned = pinned_kinds.find(std::make_pair(task_id, op_key));
+  if (pinned != pinned_kinds.end()) {
+    return pinned->second;
+  }
+  MeasuredCost const &gpu_cost = costs[std::make_pair(task_id, GPU)];
+  MeasuredCost const &cpu_cost = costs[std::make_pair(task_id, CPU)];
+  Kind kind;
+  if (gpu_cost.count < exploration_samples ||
+      cpu_cost.count < exploration_samples) {
+    // Explore both kinds before trusting the averages
+    kind = gpu_cost.count <= cpu_cost.count ? GPU : CPU;
+  } else {
+    kind = cpu_cost.mean_us < gpu_cost.mean_us ? CPU : GPU;
+  }
+  if (stateful_tasks.count(task_id)) {
+    pinned_kinds[std::make_pair(task_id, op_key)] = kind;
+  }
+  return kind;
+}
+
+void MeasuredVariantSelector::record(unsigned task_id, Kind kind, float us) {
+  MeasuredCost &cost = costs[std::make_pair(task_id, kind)];
+  cost.count++;
+  cost.mean_us += (us - cost.mean_us) / cost.count;
+}
+
+MapperProfilingBuffer::MapperProfilingBuffer(size_t capacity)
+    : slots(new Slot[capacity]), num_slots(capacity) {}
+
+bool MapperProfilingBuffer::record(MapperProfilingRecord const &record) {
+  size_t idx = next_slot.fetch_add(1, std::memory_order_relaxed);
+  if (idx >= num_slots) {
+    num_dropped.fetch_add(1, std::memory_order_relaxed);
+    return false;
+  }
+  slots[idx].record = record;
+  slots[idx].ready.store(true, std::memory_order_release);
+  return true;
+}
+
+std::vector<MapperProfilingRecord> MapperProfilingBuffer::snapshot() const {
+  size_t end = std::min(next_slot.load(std::memory_order_acquire), num_slots);
+  std::vector<MapperProfilingRecord> records;
+  records.reserve(end);
+  for (size_t i = 0; i < end; i++) {
+    // Slots that are reserved but not yet published are skipped
+    if (slots[i].ready.load(std::memory_order_acquire)) {
+      records.push_back(slots[i].record);
+    }
+  }
+  return records;
+}
+
+size_t MapperProfilingBuffer::dropped() const {
+  return num_dropped.load(std::memory_order_relaxed);
+}
+
+size_t MapperProfilingBuffer::capacity() const {
+  return num_slots;
+}
+
+MeasuredCostTable aggregate_measured_costs(
+    std::vector<MapperProfilingRecord> const &records) {
+  MeasuredCostTable table;
+  for (MapperProfilingRecord const &r : records) {
+    if (r.kind != MapperProfilingRecord::TASK) {
+      continue;
+    }
+    assert(r.end_ns >= r.start_ns);
+    float us = (r.end_ns - r.start_ns) / 1e3f;
+    MeasuredCost &cost = table[{r.task_id, r.view_hash, r.params_hash}];
+    if (cost.count == 0) {
+      cost.min_us = cost.max_us = us;
+    } else {
+      cost.min_us = std::min(cost.min_us, us);
+      cost.max_us = std::max(cost.max_us, us);
+    }
+    // Running mean to avoid accumulating large sums in float
+    cost.count++;
+    cost.mean_us += (us - cost.mean_us) / cost.count;
+  }
+  return table;
+}
+
+static std::string escape_json(char const *s) {
+  std::string out;
+  for (; *s != '\0'; s++) {
+    if (*s == '"' || *s == '\\') {
+      out.push_back('\\');
+    }
+    if ((unsigned char)*s >= 0x20) {
+      out.push_back(*s);
+    }
+  }
+  return out;
+}
+
+void write_chrome_trace(std::ostream &os,
+                        std::vector<MapperProfilingRecord> const &records) {
+  long long origin = 0;
+  if (!records.empty()) {
+    origin = records[0].start_ns;
+    for (MapperProfilingRecord const &r : records) {
+      origin = std::min(origin, r.start_ns);
+    }
+  }
+  os << "{\"traceEvents\":[";
+  for (size_t i = 0; i < records.size(); i++) {
+    MapperProfilingRecord const &r = records[i];
+    bool is_copy = r.kind == MapperProfilingRecord::COPY;
+    std::string name = r.name[0] != '\0'
+                           ? escape_json(r.name)
+                           : (is_copy ? std::string("copy")
+                                      : "task " + std::to_string(r.task_id));
+    os << (i > 0 ? ",\n" : "\n") << "{\"name\":\"" << name << "\","
+       << "\"cat\":\"" << (is_copy ? "copy" : "task") << "\","
+       << "\"ph\":\"X\",\"pid\":0,\"tid\":" << r.proc_id << ","
+       << "\"ts\":" << (r.start_ns - origin) / 1e3 << ","
+       << "\"dur\":" << (r.end_ns - r.start_ns) / 1e3 << ","
+       << "\"args\":{\"task_id\":" << r.task_id << ",\"view_hash\":\""
+       << r.view_hash << "\",\"params_hash\":\"" << r.params_hash << "\"}}";
+  }
+  os << "\n]}\n";
+}
+
+void write_measured_cost_table(std::ostream &os,
+                               MeasuredCostTable const &table) {
+  os << "# task_id view_hash params_hash count mean_us min_us max_us\n";
+  for (auto const &it : table) {
+    os << std::get<0>(it.first) << " " << std::get<1>(it.first) << " "
+       << std::get<2>(it.first) << " " << it.second.count << " "
+       << it.second.mean_us << " " << it.second.min_us << " "
+       << it.second.max_us << "\n";
+  }
+}
+
+bool load_measured_cost_table(std::istream &is, MeasuredCostTable &table) {
+  std::string line;
+  while (std::getline(is, line)) {
+    if (line.empty() || line[0] == '#') {
+      continue;
+    }
+    std::istringstream ls(line);
+    unsigned task_id;
+    size_t view_hash, params_hash;
+    MeasuredCost cost;
+    if (!(ls >> task_id >> view_hash >> params_hash >> cost.count >>
+          cost.mean_us >> cost.min_us >> cost.max_us)) {
+      return false;
+    }
+    table[{task_id, view_hash, params_hash}] = cost;
+  }
+  return true;
+}
+
+}; // namespace FlexFlow
@@ -15,6 +15,7 @@
 
 #include "flexflow/ops/add_bias_residual_layer_norm.h"
 #include "flexflow/model.h"
+#include "flexflow/ops/kernels/cpu_kernels.h"
 #include "flexflow/utils/hash_utils.h"
 #include "legion/legion_utilities.h"
 
@@ -742,6 +743,110 @@ void AddBiasResidualLayerNorm::inference_task(
   }
 }
 
+template <typename T>
+static void
+    add_bias_residual_layer_norm_cpu(AddBiasResidualLayerNormMeta const *m,
+                                     int num_rows,
+                                     GenericTensorAccessorR const &input,
+                                     GenericTensorAccessorR const &residual,
+                                     GenericTensorAccessorR const &attn_bias,
+                                     GenericTensorAccessorW const &added_output,
+                                     GenericTensorAccessorW const &output,
+                                     GenericTensorAccessorR const &gamma,
+                                     GenericTensorAccessorR const &beta) {
+  // Optional tensors have a null ptr when absent
+  Kernels::CPU::residual_layer_norm_forward(
+      static_cast<T const *>(input.ptr),
+      static_cast<T const *>(residual.ptr),
+      static_cast<T const *>(nullptr),
+      static_cast<T const *>(attn_bias.ptr),
+      static_cast<T const *>(gamma.ptr),
+      static_cast<T const *>(beta.ptr),
+      static_cast<T *>(added_output.ptr),
+      static_cast<T *>(output.ptr),
+      m->effective_num_elements,
+      num_rows,
+      m->eps,
+      m->handle.cpu_kernel_threads);
+}
+
+void AddBiasResidualLayerNorm::inference_task_cpu(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  assert(task->regions.size() == regions.size());
+  BatchConfig const *bc = BatchConfig::from_future(task->futures[0]);
+  if (bc->num_tokens == 0) {
+    return;
+  }
+  AddBiasResidualLayerNormMeta *m =
+      *((AddBiasResidualLayerNormMeta **)task->local_args);
+  assert(regions.size() ==
+         5 + (m->elementwise_affine ? (m->use_bias ? 2 : 1) : 0));
+  assert(m->input_type[0] == m->output_type[0]);
+
+  GenericTensorAccessorR input = helperGetGenericTensorAccessorRO(
+      m->input_type[0], regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  GenericTensorAccessorR residual = helperGetGenericTensorAccessorRO(
+      m->input_type[1], regions[1], task->regions[1], FID_DATA, ctx, runtime);
+  GenericTensorAccessorW added_output = helperGetGenericTensorAccessorWO(
+      m->output_type[0], regions[2], task->regions[2], FID_DATA, ctx, runtime);
+  GenericTensorAccessorW output = helperGetGenericTensorAccessorWO(
+      m->output_type[1], regions[3], task->regions[3], FID_DATA, ctx, runtime);
+  GenericTensorAccessorR attn_bias = helperGetGenericTensorAccessorRO(
+      m->weight_type[0], regions[4], task->regions[4], FID_DATA, ctx, runtime);
+  GenericTensorAccessorR gamma, beta;
+  if (m->elementwise_affine) {
+    gamma = helperGetGenericTensorAccessorRO(m->weight_type[1],
+                                             regions[5],
+                                             task->regions[5],
+                                             FID_DATA,
+                                             ctx,
+                                             runtime);
+    assert(gamma.domain.get_volume() == m->effective_num_elements);
+    if (m->use_bias) {
+      beta = helperGetGenericTensorAccessorRO(m->weight_type[2],
+                                              regions[6],
+                                              task->regions[6],
+                                              FID_DATA,
+                                              ctx,
+                                              runtime);
+    }
+  }
+  // The bias is added per column of the normalized rows
+  assert(attn_bias.domain.get_volume() == m->effective_num_elements);
+  assert(input.domain.get_volume() ==
+         m->effective_num_elements * m->effective_batch_size);
+
+  // Rows past the active tokens hold stale data and are skipped
+  int num_rows = std::min(bc->num_active_tokens(),
+                          static_cast<int>(m->effective_batch_size));
+  if (m->input_type[0] == DT_FLOAT) {
+    add_bias_residual_layer_norm_cpu<float>(m,
+                                            num_rows,
+                                            input,
+                                            residual,
+                                            attn_bias,
+                                            added_output,
+                                            output,
+                                            gamma,
+                                            beta);
+  } else if (m->input_type[0] == DT_HALF) {
+    add_bias_residual_layer_norm_cpu<Kernels::CPU::Half>(m,
+                                                         num_rows,
+                                                         input,
+                                                         residual,
+                                                         attn_bias,
+                                                         added_output,
+                                                         output,
+                                                         gamma,
+                                                         beta);
+  } else {
+    assert(false && "Unsupported data type");
+  }
+}
+
 bool AddBiasResidualLayerNorm::measure_operator_cost(
     Simulator *sim, MachineView const &mv, CostMetrics &cost_metrics) const {
   return false;
@@ -15,6 +15,7 @@
 
 #include "flexflow/ops/aggregate.h"
 #include "flexflow/model.h"
+#include "flexflow/ops/kernels/cpu_kernels.h"
 #include "flexflow/utils/hash_utils.h"
 #include "legion/legion_utilities.h"
 
@@ -414,6 +415,61 @@ void Aggregate::forward_task(Task const *task,
                                     out_dim);
 }
 
+/*
+  regions[0](I): gate_preds
+  regions[1](I): gate_assign
+  regions[2..n+1](I): exp_preds
+  regions[n+2](O): output
+*/
+void Aggregate::forward_task_cpu(Task const *task,
+                                 std::vector<PhysicalRegion> const &regions,
+                                 Context ctx,
+                                 Runtime *runtime) {
+  assert(regions.size() == task->regions.size());
+  int n = regions.size() - 3;
+  AggregateMeta const *m = *((AggregateMeta **)task->local_args);
+
+  float const *gate_pred_ptr = helperGetTensorPointerRO<float>(
+      regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  int const *gate_assign_ptr = helperGetTensorPointerRO<int>(
+      regions[1], task->regions[1], FID_DATA, ctx, runtime);
+  float *output_ptr = helperGetTensorPointerWO<float>(
+      regions[n + 2], task->regions[n + 2], FID_DATA, ctx, runtime);
+  Domain gate_domain = runtime->get_index_space_domain(
+      ctx, task->regions[1].region.get_index_space());
+  Domain output_domain = runtime->get_index_space_domain(
+      ctx, task->regions[n + 2].region.get_index_space());
+  int k = gate_domain.hi()[0] - gate_domain.lo()[0] + 1;
+  int batch_size = gate_domain.hi()[1] - gate_domain.lo()[1] + 1;
+  int out_dim = output_domain.hi()[0] - output_domain.lo()[0] + 1;
+  assert(batch_size == output_domain.hi()[1] - output_domain.lo()[1] + 1);
+
+  // The expert predictions come back in the rows GroupBy dispatched the
+  // tokens to, so the number of rows is the expert capacity
+  std::vector<float const *> exp_preds(n);
+  int rows = -1;
+  for (int i = 0; i < n; i++) {
+    exp_preds[i] = helperGetTensorPointerRO<float>(
+        regions[i + 2], task->regions[i + 2], FID_DATA, ctx, runtime);
+    Domain exp_domain = runtime->get_index_space_domain(
+        ctx, task->regions[i + 2].region.get_index_space());
+    assert(out_dim == exp_domain.hi()[0] - exp_domain.lo()[0] + 1);
+    assert(rows < 0 || rows == exp_domain.hi()[1] - exp_domain.lo()[1] + 1);
+    rows = exp_domain.hi()[1] - exp_domain.lo()[1] + 1;
+  }
+
+  Kernels::CPU::aggregate_forward(exp_preds.data(),
+                                  gate_assign_ptr,
+                                  gate_pred_ptr,
+                                  output_ptr,
+                                  n,
+                                  k,
+                                  rows,
+                                  batch_size,
+                                  out_dim,
+                                  m->handle.cpu_kernel_threads);
+}
+
 void Aggregate::backward(FFModel const &ff) {
   ArgumentMap argmap;
   Context ctx = ff.config.lg_ctx;
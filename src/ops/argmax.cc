@@ -15,6 +15,7 @@
 
 #include "flexflow/ops/argmax.h"
 #include "flexflow/model.h"
+#include "flexflow/ops/kernels/cpu_kernels.h"
 #include "flexflow/utils/hash_utils.h"
 #include "legion/legion_utilities.h"
 #if defined(FF_USE_CUDA) || defined(FF_USE_HIP_CUDA)
@@ -406,6 +407,43 @@ InferenceResult
   return ir;
 }
 
+InferenceResult
+    ArgMax::inference_task_norm_cpu(Task const *task,
+                                    std::vector<PhysicalRegion> const &regions,
+                                    Context ctx,
+                                    Runtime *runtime) {
+  assert(regions.size() == 2);
+  assert(task->regions.size() == 2);
+  ArgMaxMeta *m = *((ArgMaxMeta **)task->local_args);
+  BatchConfig const *bc = BatchConfig::from_future(task->futures[0]);
+  InferenceResult ir;
+  if (bc->num_tokens == 0) {
+    return ir;
+  }
+  assert(!m->beam_search);
+  assert(m->input_type[0] == DT_FLOAT || m->input_type[0] == DT_HALF);
+  GenericTensorAccessorR input = helperGetGenericTensorAccessorRO(
+      m->input_type[0], regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  GenericTensorAccessorW indices = helperGetGenericTensorAccessorWO(
+      DT_INT32, regions[1], task->regions[1], FID_DATA, ctx, runtime);
+  int vocab_size = input.domain.hi()[0] - input.domain.lo()[0] + 1;
+  int batch_size = bc->num_active_tokens();
+  if (m->input_type[0] == DT_HALF) {
+    Kernels::CPU::argmax(static_cast<Kernels::CPU::Half const *>(input.ptr),
+                         indices.get_int32_ptr(),
+                         vocab_size,
+                         batch_size);
+  } else {
+    Kernels::CPU::argmax(
+        input.get_float_ptr(), indices.get_int32_ptr(), vocab_size, batch_size);
+  }
+  // The indices live in host memory, so no download is needed
+  std::copy(indices.get_int32_ptr(),
+            indices.get_int32_ptr() + batch_size,
+            ir.token_ids);
+  return ir;
+}
+
 void ArgMax::backward(FFModel const &ff) {
   // ArgMax does not support backward
   assert(false);
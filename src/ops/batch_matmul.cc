@@ -15,6 +15,7 @@
 
 #include "flexflow/ops/batch_matmul.h"
 #include "flexflow/ops/kernels/batch_matmul_kernels.h"
+#include "flexflow/ops/kernels/cpu_kernels.h"
 #include "legion/legion_utilities.h"
 
 namespace FlexFlow {
@@ -402,6 +403,87 @@ void BatchMatmul::forward_task(Task const *task,
                          iter_config->seq_length);
 }
 
+/*
+  regions[0](O): output
+  regions[1](I): A
+  regions[2](I): B
+*/
+void BatchMatmul::forward_task_cpu(Task const *task,
+                                   std::vector<PhysicalRegion> const &regions,
+                                   Context ctx,
+                                   Runtime *runtime) {
+  assert(regions.size() == 3);
+  assert(task->regions.size() == 3);
+  FFIterationConfig const *iter_config = (FFIterationConfig const *)task->args;
+  BatchMatmulMeta const *meta = *((BatchMatmulMeta **)task->local_args);
+  Domain out_domain = runtime->get_index_space_domain(
+      ctx, task->regions[0].region.get_index_space());
+  Domain a_domain = runtime->get_index_space_domain(
+      ctx, task->regions[1].region.get_index_space());
+  Domain b_domain = runtime->get_index_space_domain(
+      ctx, task->regions[2].region.get_index_space());
+  int m = b_domain.hi()[0] - b_domain.lo()[0] + 1;
+  assert(m == out_domain.hi()[0] - out_domain.lo()[0] + 1);
+  int n = a_domain.hi()[1] - a_domain.lo()[1] + 1;
+  assert(n == out_domain.hi()[1] - out_domain.lo()[1] + 1);
+  int k = a_domain.hi()[0] - a_domain.lo()[0] + 1;
+  assert(k == b_domain.hi()[1] - b_domain.lo()[1] + 1);
+  assert(a_domain.get_dim() == b_domain.get_dim());
+  assert(a_domain.get_dim() == out_domain.get_dim());
+  int batch = 1;
+  for (int i = 2; i < a_domain.get_dim(); i++) {
+    int dim_size = a_domain.hi()[i] - a_domain.lo()[i] + 1;
+    assert(dim_size == b_domain.hi()[i] - b_domain.lo()[i] + 1);
+    assert(dim_size == out_domain.hi()[i] - out_domain.lo()[i] + 1);
+    batch *= dim_size;
+  }
+  float *out_ptr = helperGetTensorPointerWO<float>(
+      regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  float const *a_ptr = helperGetTensorPointerRO<float>(
+      regions[1], task->regions[1], FID_DATA, ctx, runtime);
+  float const *b_ptr = helperGetTensorPointerRO<float>(
+      regions[2], task->regions[2], FID_DATA, ctx, runtime);
+
+  // Leading dimensions and strides keep the full extents; only the
+  // multiplied block shrinks to seq_length, as in the cuBLAS path
+  int lda = k, ldb = m, ldo = m;
+  size_t stride_a = (size_t)n * k;
+  size_t stride_b = (size_t)k * m;
+  size_t stride_o = (size_t)n * m;
+  int const seq_length = iter_config->seq_length;
+  if (seq_length >= 0) {
+    if (meta->a_seq_length_dim == 0) {
+      assert(seq_length <= k && meta->b_seq_length_dim == 1);
+      k = seq_length;
+    } else if (meta->a_seq_length_dim == 1) {
+      assert(seq_length <= n);
+      n = seq_length;
+    } else {
+      assert(meta->a_seq_length_dim < 0);
+    }
+    if (meta->b_seq_length_dim == 0) {
+      assert(seq_length <= m);
+      m = seq_length;
+    } else {
+      assert(meta->b_seq_length_dim < 0 || meta->a_seq_length_dim == 0);
+    }
+  }
+  Kernels::CPU::batch_matmul_forward(a_ptr,
+                                     b_ptr,
+                                     out_ptr,
+                                     m,
+                                     n,
+                                     k,
+                                     lda,
+                                     ldb,
+                                     ldo,
+                                     stride_a,
+                                     stride_b,
+                                     stride_o,
+                                     batch,
+                                     meta->handle.cpu_kernel_threads);
+}
+
 void BatchMatmul::backward(FFModel const &ff) {
   int dim = outputs[0]->num_dims;
   switch (dim) {
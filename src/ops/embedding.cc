@@ -15,6 +15,7 @@
 
 #include "flexflow/ops/embedding.h"
 #include "flexflow/model.h"
+#include "flexflow/ops/kernels/cpu_kernels.h"
 #include "flexflow/ops/kernels/embedding_kernels.h"
 #include "flexflow/utils/hash_utils.h"
 
@@ -635,6 +636,71 @@ void Embedding::inference_task(Task const *task,
   }
 }
 
+void Embedding::inference_task_cpu(Task const *task,
+                                   std::vector<PhysicalRegion> const &regions,
+                                   Context ctx,
+                                   Runtime *runtime) {
+  EmbeddingMeta *m = *((EmbeddingMeta **)task->local_args);
+  assert(regions.size() == 3);
+  assert(task->regions.size() == 3);
+  BatchConfig const *bc = BatchConfig::from_future(task->futures[0]);
+  if (bc->num_active_tokens() == 0) {
+    return;
+  }
+  assert(m->weight_type[0] == DT_FLOAT || m->weight_type[0] == DT_HALF);
+  assert(m->output_type[0] == m->weight_type[0]);
+  assert(m->input_type[0] == DT_INT32 || m->input_type[0] == DT_INT64);
+  GenericTensorAccessorR input = helperGetGenericTensorAccessorRO(
+      m->input_type[0], regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  GenericTensorAccessorW output = helperGetGenericTensorAccessorWO(
+      m->output_type[0], regions[1], task->regions[1], FID_DATA, ctx, runtime);
+  GenericTensorAccessorR kernel = helperGetGenericTensorAccessorRO(
+      m->weight_type[0], regions[2], task->regions[2], FID_DATA, ctx, runtime);
+  int in_dim = m->aggr == AGGR_MODE_NONE
+                   ? 1
+                   : input.domain.hi()[0] - input.domain.lo()[0] + 1;
+  int out_dim = output.domain.hi()[0] - output.domain.lo()[0] + 1;
+  size_t effective_batch_size = output.domain.get_volume() / out_dim;
+  assert(effective_batch_size * in_dim == input.domain.get_volume());
+  assert(kernel.domain.hi()[0] - kernel.domain.lo()[0] + 1 == out_dim);
+  if (m->weight_type[0] == DT_HALF) {
+    using Kernels::CPU::Half;
+    if (m->input_type[0] == DT_INT32) {
+      Kernels::CPU::embedding_lookup(input.get_int32_ptr(),
+                                     static_cast<Half const *>(kernel.ptr),
+                                     static_cast<Half *>(output.ptr),
+                                     in_dim,
+                                     out_dim,
+                                     effective_batch_size,
+                                     m->aggr);
+    } else {
+      Kernels::CPU::embedding_lookup(input.get_int64_ptr(),
+                                     static_cast<Half const *>(kernel.ptr),
+                                     static_cast<Half *>(output.ptr),
+                                     in_dim,
+                                     out_dim,
+                                     effective_batch_size,
+                                     m->aggr);
+    }
+  } else if (m->input_type[0] == DT_INT32) {
+    Kernels::CPU::embedding_lookup(input.get_int32_ptr(),
+                                   kernel.get_float_ptr(),
+                                   output.get_float_ptr(),
+                                   in_dim,
+                                   out_dim,
+                                   effective_batch_size,
+                                   m->aggr);
+  } else {
+    Kernels::CPU::embedding_lookup(input.get_int64_ptr(),
+                                   kernel.get_float_ptr(),
+                                   output.get_float_ptr(),
+                                   in_dim,
+                                   out_dim,
+                                   effective_batch_size,
+                                   m->aggr);
+  }
+}
+
 void Embedding::backward(FFModel const &ff) {
   ArgumentMap argmap;
   Context ctx = ff.config.lg_ctx;
@@ -14,6 +14,8 @@
  */
 
 #include "flexflow/ops/experts.h"
+#include "flexflow/expert_load_balancer.h"
+#include "flexflow/ops/kernels/cpu_kernels.h"
 #ifdef INFERENCE_TESTS
 #include "flexflow/utils/cuda_helper.h"
 #endif
@@ -1133,6 +1135,67 @@ void Experts::inference_task(Task const *task,
   }
 }
 
+void Experts::inference_task_cpu(Task const *task,
+                                 std::vector<PhysicalRegion> const &regions,
+                                 Context ctx,
+                                 Runtime *runtime) {
+  assert(regions.size() == task->regions.size());
+  ExpertsMeta *m = *((ExpertsMeta **)task->local_args);
+  BatchConfig const *bc = BatchConfig::from_future(task->futures[0]);
+  if (bc->num_tokens == 0) {
+    return;
+  }
+  assert(regions.size() - 4 == (1 + m->use_bias));
+
+  GenericTensorAccessorR input = helperGetGenericTensorAccessorRO(
+      DT_FLOAT, regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  GenericTensorAccessorR indices = helperGetGenericTensorAccessorRO(
+      DT_INT32, regions[1], task->regions[1], FID_DATA, ctx, runtime);
+  GenericTensorAccessorR topk_gate_preds = helperGetGenericTensorAccessorRO(
+      DT_FLOAT, regions[2], task->regions[2], FID_DATA, ctx, runtime);
+  GenericTensorAccessorW output = helperGetGenericTensorAccessorWO(
+      DT_FLOAT, regions[3], task->regions[3], FID_DATA, ctx, runtime);
+  float const *weights_ptr = helperGetTensorPointerRO<float>(
+      regions[4], task->regions[4], FID_DATA, ctx, runtime);
+  float const *bias_ptr = nullptr;
+  if (m->use_bias) {
+    bias_ptr = helperGetTensorPointerRO<float>(
+        regions[5], task->regions[5], FID_DATA, ctx, runtime);
+  }
+  Domain indices_domain = runtime->get_index_space_domain(
+      ctx, task->regions[1].region.get_index_space());
+  int chosen_experts = indices_domain.hi()[0] - indices_domain.lo()[0] + 1;
+  assert(chosen_experts == m->num_chosen_experts);
+  assert(input.domain.hi()[0] - input.domain.lo()[0] + 1 == m->data_dim);
+  assert(output.domain.hi()[0] - output.domain.lo()[0] + 1 == m->out_dim);
+
+  int num_tokens = bc->num_active_tokens();
+  assert(num_tokens <= m->effective_batch_size);
+  std::vector<int> counts(m->num_experts);
+  Kernels::CPU::experts_forward(input.get_float_ptr(),
+                                indices.get_int32_ptr(),
+                                topk_gate_preds.get_float_ptr(),
+                                output.get_float_ptr(),
+                                weights_ptr,
+                                bias_ptr,
+                                counts.data(),
+                                num_tokens,
+                                chosen_experts,
+                                m->num_experts,
+                                m->experts_start_idx,
+                                m->expert_capacity,
+                                m->data_dim,
+                                m->out_dim,
+                                m->experts_num_layers,
+                                m->experts_internal_dim_size,
+                                m->activation,
+                                m->handle.cpu_kernel_threads);
+  if (m->sample_routing()) {
+    ExpertLoadBalancer::get_load_balancer()->record_routing(
+        m->op_name, counts, m->expert_capacity);
+  }
+}
+
 void Experts::forward_task(Task const *task,
                            std::vector<PhysicalRegion> const &regions,
                            Context ctx,
@@ -1156,11 +1219,109 @@ void Experts::print_layer(FFModel const &ff) {
 }
 
 bool Experts::measure_operator_cost(Simulator *sim,
-                                    MachineView const &c,
+                                    MachineView const &mv,
                                     CostMetrics &cost_metrics) const {
-  // This is an inference only operator
-  assert(false && "Experts is designed for inference only");
-  return false;
+  ParallelTensorBase sub_input, sub_indices, sub_topk_gate_preds, sub_output;
+  if (!inputs[0]->get_sub_tensor(mv, sub_input) ||
+      !inputs[1]->get_sub_tensor(mv, sub_indices) ||
+      !inputs[2]->get_sub_tensor(mv, sub_topk_gate_preds) ||
+      !outputs[0]->get_sub_tensor(mv, sub_output)) {
+    return false;
+  }
+
+  ExpertsMeta *m = new ExpertsMeta(sim->handler,
+                                   num_experts,
+                                   experts_start_idx,
+                                   data_dim,
+                                   out_dim,
+                                   experts_num_layers,
+                                   experts_internal_dim_size,
+                                   effective_batch_size,
+                                   num_chosen_experts,
+                                   alpha,
+                                   use_bias,
+                                   activation);
+  m->routing_interval = 0;
+
+  // allocate
+  sim->free_all();
+  float *input_ptr = (float *)sim->allocate(sub_input.get_volume(), DT_FLOAT);
+  int *indices_ptr = (int *)sim->allocate(sub_indices.get_volume(), DT_INT32);
+  float *topk_gate_pred_ptr =
+      (float *)sim->allocate(sub_topk_gate_preds.get_volume(), DT_FLOAT);
+  cost_metrics.inputs_memory += cost_metrics.total_mem_diff_from(sim->offset);
+  float *output_ptr = (float *)sim->allocate(sub_output.get_volume(), DT_FLOAT);
+  cost_metrics.outputs_memory += cost_metrics.total_mem_diff_from(sim->offset);
+  // One copy of the weights of the block on each device
+  size_t nparams_weight =
+      (experts_num_layers == 1)
+          ? (data_dim * out_dim)
+          : experts_internal_dim_size * (data_dim + out_dim);
+  size_t nparams_bias = (experts_num_layers == 1)
+                            ? out_dim
+                            : (experts_internal_dim_size + out_dim);
+  float *weights_ptr =
+      (float *)sim->allocate(nparams_weight * num_experts, DT_FLOAT);
+  float *bias_ptr =
+      use_bias ? (float *)sim->allocate(nparams_bias * num_experts, DT_FLOAT)
+               : nullptr;
+  cost_metrics.weights_memory += cost_metrics.total_mem_diff_from(sim->offset);
+
+  if (!input_ptr || !indices_ptr || !topk_gate_pred_ptr || !output_ptr ||
+      !weights_ptr || (use_bias && !bias_ptr)) {
+    cost_metrics.forward_time = Simulator::MAXIMUM_TASK_RUN_TIME;
+    cost_metrics.backward_time = Simulator::MAXIMUM_TASK_RUN_TIME;
+    delete m;
+    return true;
+  }
+
+  assert(m->profiling == false);
+
+  // Route the tokens round-robin over the experts of the block with equal
+  // weights, so that the measurement (and the per-token cost derived from
+  // it) is of a balanced load rather than of whatever the buffers held
+  {
+    std::vector<int> indices(sub_indices.get_volume());
+    std::vector<float> topk_gate_preds(sub_topk_gate_preds.get_volume(),
+                                       1.0f / num_chosen_experts);
+    for (size_t i = 0; i < indices.size(); i++) {
+      indices[i] = experts_start_idx + i % num_experts;
+    }
+    copy_routing_to_device(
+        indices, topk_gate_preds, indices_ptr, topk_gate_pred_ptr);
+  }
+
+  // compute
+  std::function<void()> forward, backward;
+  forward = [&] {
+    forward_kernel_wrapper(m,
+                           input_ptr,
+                           indices_ptr,
+                           topk_gate_pred_ptr,
+                           output_ptr,
+                           weights_ptr,
+                           bias_ptr,
+                           effective_batch_size,
+                           num_chosen_experts,
+                           effective_batch_size,
+                           out_dim);
+  };
+
+  inner_measure_operator_cost(sim, forward, backward, cost_metrics);
+  log_measure.debug("[Measure Experts] name(%s) forward_time(%.4lf)\n",
+                    name,
+                    cost_metrics.forward_time);
+
+  cost_metrics.backward_time = 0.0f; // inference only
+  delete m;
+  return true;
+}
+
+float Experts::measure_token_cost(Simulator *sim,
+                                  MachineView const &mv) const {
+  CostMetrics cost_metrics = sim->measure_operator_cost(this, mv);
+  return cost_metrics.forward_time /
+         ((float)effective_batch_size * num_chosen_experts);
 }
 
 }; // namespace FlexFlow
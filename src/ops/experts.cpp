@@ -19,6 +19,21 @@
 
 namespace FlexFlow {
 
+/*static*/
+void Experts::copy_routing_to_device(std::vector<int> const &indices,
+                                     std::vector<float> const &topk_gate_preds,
+                                     int *indices_ptr,
+                                     float *topk_gate_preds_ptr) {
+  checkCUDA(hipMemcpy(indices_ptr,
+                      indices.data(),
+                      indices.size() * sizeof(int),
+                      hipMemcpyHostToDevice));
+  checkCUDA(hipMemcpy(topk_gate_preds_ptr,
+                      topk_gate_preds.data(),
+                      topk_gate_preds.size() * sizeof(float),
+                      hipMemcpyHostToDevice));
+}
+
 /*static*/
 void Experts::forward_kernel_wrapper(ExpertsMeta const *m,
                                      float const *input,
@@ -53,7 +68,9 @@ ExpertsMeta::ExpertsMeta(FFHandler handler,
       experts_internal_dim_size(_experts_internal_dim_size),
       effective_batch_size(_effective_batch_size),
       num_chosen_experts(_num_chosen_experts), alpha(_alpha),
-      use_bias(_use_bias), activation(_activation) {}
+      use_bias(_use_bias), activation(_activation) {
+  routing_interval = handler.expert_routing_interval;
+}
 ExpertsMeta::~ExpertsMeta(void) {}
 
 }; // namespace FlexFlow
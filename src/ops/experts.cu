@@ -13,6 +13,7 @@
  * limitations under the License.
  */
 
+#include "flexflow/expert_load_balancer.h"
 #include "flexflow/ops/experts.h"
 #include "flexflow/utils/cuda_helper.h"
 #include <cublas_v2.h>
@@ -484,6 +485,117 @@ void experts_forward_GemmBatched_kernel(ExpertsMeta const *m,
   }
 }
 
+__global__ void experts_gather_tokens_kernel(int num_rows,
+                                             int data_dim,
+                                             float const **token_idx_array,
+                                             float *packed_tokens) {
+  CUDA_KERNEL_LOOP(i, num_rows * data_dim) {
+    packed_tokens[i] = token_idx_array[i / data_dim][i % data_dim];
+  }
+}
+
+__global__ void experts_add_bias_kernel(int num_rows,
+                                        int dim,
+                                        float const **bias_idx_array,
+                                        float *results) {
+  CUDA_KERNEL_LOOP(i, num_rows * dim) {
+    results[i] += bias_idx_array[i / dim][i % dim];
+  }
+}
+
+// Grouped execution of the expert layers. The kept tokens are packed into a
+// ragged batch, where the rows of the i-th non-zero expert start at the sum
+// of the capped counts of the experts before it, i.e., the
+// destination_start_indices the prepare kernel used. Each expert is then one
+// GEMM over its rows, which reads its weight once per layer instead of once
+// per token. labels and counts are the host copies of
+// non_zero_expert_labels and num_assignments_per_expert.
+void experts_forward_grouped_gemm(ExpertsMeta const *m,
+                                  float const *weights,
+                                  std::vector<int> const &labels,
+                                  std::vector<int> const &counts,
+                                  int gemm_batch_count,
+                                  ffStream_t stream) {
+  checkCUDA(cublasSetStream(m->handle.blas, stream));
+  checkCUDNN(cudnnSetStream(m->handle.dnn, stream));
+
+  int data_dim = m->data_dim;
+  int out_dim = m->out_dim;
+  int internal_dim = m->experts_internal_dim_size;
+  int dim1 = m->experts_num_layers == 1 ? out_dim : internal_dim;
+  size_t weight_params_count =
+      m->experts_num_layers == 1 ? (size_t)data_dim * out_dim
+                                 : (size_t)internal_dim * (data_dim + out_dim);
+  float alpha = 1.0f, beta = 0.0f;
+
+  int parallelism = gemm_batch_count * data_dim;
+  experts_gather_tokens_kernel<<<GET_BLOCKS(parallelism),
+                                 min(CUDA_NUM_THREADS, parallelism),
+                                 0,
+                                 stream>>>(gemm_batch_count,
+                                           data_dim,
+                                           m->token_idx_array,
+                                           m->packed_tokens);
+
+  for (int layer = 0; layer < m->experts_num_layers; layer++) {
+    int in_dim = layer == 0 ? data_dim : internal_dim;
+    int dim = layer == 0 ? dim1 : out_dim;
+    float const *input = layer == 0 ? m->packed_tokens : m->batch_outputs1[0];
+    float *results = layer == 0 ? m->batch_outputs1[0] : m->batch_outputs2[0];
+    int start = 0;
+    for (size_t i = 0; i < labels.size(); i++) {
+      int rows = std::min(counts[i], m->expert_capacity);
+      float const *weight = weights + labels[i] * weight_params_count +
+                            (layer == 0 ? 0 : (size_t)data_dim * internal_dim);
+      checkCUDA(cublasGemmEx(m->handle.blas,
+                             CUBLAS_OP_T, // Weight, shape (in_dim, dim)
+                             CUBLAS_OP_N, // Tokens, shape (in_dim, rows)
+                             dim,
+                             rows,
+                             in_dim,
+                             &alpha,
+                             weight,
+                             CUDA_R_32F,
+                             in_dim,
+                             input + (size_t)start * in_dim,
+                             CUDA_R_32F,
+                             in_dim,
+                             &beta,
+                             results + (size_t)start * dim,
+                             CUDA_R_32F,
+                             dim,
+                             CUBLAS_COMPUTE_32F,
+                             CUBLAS_GEMM_DEFAULT_TENSOR_OP));
+      start += rows;
+    }
+    assert(start == gemm_batch_count);
+
+    if (m->use_bias) {
+      parallelism = gemm_batch_count * dim;
+      experts_add_bias_kernel<<<GET_BLOCKS(parallelism),
+                                min(CUDA_NUM_THREADS, parallelism),
+                                0,
+                                stream>>>(gemm_batch_count,
+                                          dim,
+                                          layer == 0 ? m->bias_idx_array1
+                                                     : m->bias_idx_array2,
+                                          results);
+    }
+    if (use_activation(m->activation)) {
+      cudnnTensorDescriptor_t desc =
+          layer == 0 ? m->resultTensorDesc1 : m->resultTensorDesc2;
+      checkCUDNN(cudnnActivationForward(m->handle.dnn,
+                                        m->actiDesc,
+                                        &alpha,
+                                        desc,
+                                        results,
+                                        &beta,
+                                        desc,
+                                        results));
+    }
+  }
+}
+
 __global__ void experts_forward_aggregate_kernel(int num_tokens,
                                                  int gemm_batch_count,
                                                  int out_dim,
@@ -507,6 +619,21 @@ __global__ void experts_forward_aggregate_kernel(int num_tokens,
   }
 }
 
+/*static*/
+void Experts::copy_routing_to_device(std::vector<int> const &indices,
+                                     std::vector<float> const &topk_gate_preds,
+                                     int *indices_ptr,
+                                     float *topk_gate_preds_ptr) {
+  checkCUDA(cudaMemcpy(indices_ptr,
+                       indices.data(),
+                       indices.size() * sizeof(int),
+                       cudaMemcpyHostToDevice));
+  checkCUDA(cudaMemcpy(topk_gate_preds_ptr,
+                       topk_gate_preds.data(),
+                       topk_gate_preds.size() * sizeof(float),
+                       cudaMemcpyHostToDevice));
+}
+
 /*static*/
 void Experts::forward_kernel_wrapper(ExpertsMeta const *m,
                                      float const *input,
@@ -824,6 +951,35 @@ void Experts::forward_kernel_wrapper(ExpertsMeta const *m,
   assert(num_valid_assignments <= num_indices);
   assert(gemm_batch_count <= num_valid_assignments);
 
+  // Routing load of the block, before capacity, for placement rebalancing
+  // and for the per-expert GEMMs of the grouped mode. The Thrust calls above
+  // already synchronized the stream on their results, so the copies only
+  // wait for the last transform.
+  bool const record_routing = m->sample_routing();
+  std::vector<int> expert_counts(num_experts_per_block, 0);
+  std::vector<int> labels(non_zero_experts_count);
+  std::vector<int> counts(non_zero_experts_count);
+  if ((record_routing || m->grouped_gemm) && non_zero_experts_count > 0) {
+    checkCUDA(cudaMemcpyAsync(labels.data(),
+                              m->non_zero_expert_labels,
+                              non_zero_experts_count * sizeof(int),
+                              cudaMemcpyDeviceToHost,
+                              stream));
+    checkCUDA(cudaMemcpyAsync(counts.data(),
+                              m->num_assignments_per_expert,
+                              non_zero_experts_count * sizeof(int),
+                              cudaMemcpyDeviceToHost,
+                              stream));
+    checkCUDA(cudaStreamSynchronize(stream));
+    for (int i = 0; i < non_zero_experts_count; i++) {
+      expert_counts[labels[i]] = counts[i];
+    }
+  }
+  if (record_routing) {
+    ExpertLoadBalancer::get_load_balancer()->record_routing(
+        m->op_name, expert_counts, expert_capacity);
+  }
+
   if (num_valid_assignments == 0) {
     if (m->profiling) {
       cudaEventRecord(t_end, stream);
@@ -1186,23 +1342,28 @@ void Experts::forward_kernel_wrapper(ExpertsMeta const *m,
   free(dev_batch_outputs_cuda);
 #endif
 
-  experts_forward_GemmBatched_kernel(m,
-                                     (void const **)m->weight_idx_array1,
-                                     (void const **)m->weight_idx_array2,
-                                     (void const **)m->token_idx_array,
-                                     (void **)m->dev_batch_outputs1,
-                                     (void **)m->dev_batch_outputs2,
-                                     (void const **)m->bias_idx_array1,
-                                     (void const **)m->bias_idx_array2,
-                                     activation,
-                                     data_dim,
-                                     out_dim,
-                                     m->experts_num_layers,
-                                     m->experts_internal_dim_size,
-                                     num_tokens,
-                                     num_chosen_experts,
-                                     gemm_batch_count,
-                                     stream);
+  if (m->grouped_gemm) {
+    experts_forward_grouped_gemm(
+        m, weights, labels, counts, gemm_batch_count, stream);
+  } else {
+    experts_forward_GemmBatched_kernel(m,
+                                       (void const **)m->weight_idx_array1,
+                                       (void const **)m->weight_idx_array2,
+                                       (void const **)m->token_idx_array,
+                                       (void **)m->dev_batch_outputs1,
+                                       (void **)m->dev_batch_outputs2,
+                                       (void const **)m->bias_idx_array1,
+                                       (void const **)m->bias_idx_array2,
+                                       activation,
+                                       data_dim,
+                                       out_dim,
+                                       m->experts_num_layers,
+                                       m->experts_internal_dim_size,
+                                       num_tokens,
+                                       num_chosen_experts,
+                                       gemm_batch_count,
+                                       stream);
+  }
 
   // checkCUDA(cudaStreamSynchronize(stream));
 
@@ -1291,6 +1452,13 @@ ExpertsMeta::ExpertsMeta(FFHandler handler,
   checkCUDA(
       cudaMalloc(&output_idx_array,
                  num_chosen_experts * effective_batch_size * sizeof(float *)));
+  grouped_gemm = handler.experts_grouped_gemm;
+  routing_interval = handler.expert_routing_interval;
+  if (grouped_gemm) {
+    checkCUDA(cudaMalloc(&packed_tokens,
+                         data_dim * num_chosen_experts * effective_batch_size *
+                             sizeof(float)));
+  }
   batch_outputs1 = new float *[num_chosen_experts * effective_batch_size];
   int batch_outputs1_dim =
       (experts_num_layers == 1) ? out_dim : experts_internal_dim_size;
@@ -1427,6 +1595,9 @@ ExpertsMeta::~ExpertsMeta(void) {
   checkCUDA(cudaFree(weight_idx_array2));
   checkCUDA(cudaFree(coefficient_idx_array));
   checkCUDA(cudaFree(output_idx_array));
+  if (grouped_gemm) {
+    checkCUDA(cudaFree(packed_tokens));
+  }
   checkCUDA(cudaFree(dev_batch_outputs1));
   checkCUDA(cudaFree(dev_batch_outputs2));
   checkCUDA(cudaFree(bias_idx_array1));
@@ -13,8 +13,10 @@
  * limitations under the License.
  */
 
+#include "flexflow/expert_load_balancer.h"
 #include "flexflow/model.h"
 #include "flexflow/ops/groupby.h"
+#include "flexflow/ops/kernels/cpu_kernels.h"
 #include "flexflow/utils/hash_utils.h"
 #include "legion/legion_utilities.h"
 #include <math.h>
@@ -434,6 +436,61 @@ void Group_by::forward_task(Task const *task,
   }
 }
 
+/*
+  regions[0](I): input
+  regions[1](I): assign
+  regions[2..n+1](O): one buffer of capacity rows per expert
+*/
+void Group_by::forward_task_cpu(Task const *task,
+                                std::vector<PhysicalRegion> const &regions,
+                                Context ctx,
+                                Runtime *runtime) {
+  int n = (int)regions.size() - 2;
+  assert((int)task->regions.size() == n + 2);
+  GroupByMeta const *m = *((GroupByMeta **)task->local_args);
+
+  float const *input_ptr = helperGetTensorPointerRO<float>(
+      regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  int const *assign_ptr = helperGetTensorPointerRO<int>(
+      regions[1], task->regions[1], FID_DATA, ctx, runtime);
+  Domain input_domain = runtime->get_index_space_domain(
+      ctx, task->regions[0].region.get_index_space());
+  Domain assign_domain = runtime->get_index_space_domain(
+      ctx, task->regions[1].region.get_index_space());
+  int batch_size = input_domain.hi()[1] - input_domain.lo()[1] + 1;
+  int data_dim = input_domain.hi()[0] - input_domain.lo()[0] + 1;
+  int k = assign_domain.hi()[0] - assign_domain.lo()[0] + 1;
+  assert(batch_size == assign_domain.hi()[1] - assign_domain.lo()[1] + 1);
+
+  // The expert buffers hold ceil(alpha * k / n * batch_size) rows each
+  std::vector<float *> outputs(n);
+  int capacity = -1;
+  for (int i = 0; i < n; i++) {
+    outputs[i] = helperGetTensorPointerWO<float>(
+        regions[i + 2], task->regions[i + 2], FID_DATA, ctx, runtime);
+    Domain out_domain = runtime->get_index_space_domain(
+        ctx, task->regions[i + 2].region.get_index_space());
+    int rows = out_domain.hi()[1] - out_domain.lo()[1] + 1;
+    assert(out_domain.hi()[0] - out_domain.lo()[0] + 1 == data_dim);
+    assert(capacity < 0 || capacity == rows);
+    capacity = rows;
+  }
+
+  std::vector<int> counts(n);
+  Kernels::CPU::group_by_forward(input_ptr,
+                                 assign_ptr,
+                                 outputs.data(),
+                                 counts.data(),
+                                 n,
+                                 k,
+                                 capacity,
+                                 batch_size,
+                                 data_dim,
+                                 m->handle.cpu_kernel_threads);
+  ExpertLoadBalancer::get_load_balancer()->record_routing(
+      m->op_name, counts, capacity);
+}
+
 void Group_by::backward(FFModel const &ff) {
   ArgumentMap argmap;
   Context ctx = ff.config.lg_ctx;
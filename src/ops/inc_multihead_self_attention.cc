@@ -16,6 +16,8 @@
 #include "flexflow/ops/inc_multihead_self_attention.h"
 #include "flexflow/ffconst_utils.h"
 #include "flexflow/model.h"
+#include "flexflow/ops/kernels/cpu_kernels.h"
+#include "flexflow/ops/kernels/inc_multihead_self_attention_kernels.h"
 #if defined(FF_USE_CUDA) || defined(FF_USE_HIP_CUDA)
 #include "flexflow/utils/cuda_helper.h"
 #else
@@ -23,6 +25,7 @@
 #endif
 #include "flexflow/utils/hash_utils.h"
 #include "legion/legion_utilities.h"
+#include <algorithm>
 
 namespace FlexFlow {
 
@@ -874,6 +877,288 @@ void IncMultiHeadSelfAttention::inference_task(
   }
 }
 
+/*static*/
+void IncMultiHeadSelfAttention::prepare_cpu_state(
+    IncMultiHeadSelfAttentionMeta *m,
+    float const *weight,
+    size_t cache_length) {
+  std::lock_guard<std::mutex> lock(m->cpu_mutex);
+  int const head_dim = m->qProjSize;
+  int const num_q_heads = m->num_q_heads;
+  int const hidden_size = m->hidden_size;
+  if (m->cpu_packed_source != weight) {
+    // The loaded weight repeats each KV head for all of its query heads, so
+    // only one representative per group is projected and cached. Query
+    // heads h and h' of this shard share a KV head iff h / local_rep ==
+    // h' / local_rep; when the shard boundaries cut through a group, fall
+    // back to one KV head per query head.
+    int rep = m->global_num_q_heads / m->global_num_kv_heads;
+    int local_rep = 1;
+    if (num_q_heads % rep == 0) {
+      local_rep = rep;
+    } else if (rep % num_q_heads == 0) {
+      local_rep = num_q_heads;
+    }
+    int const num_kv_heads = num_q_heads / local_rep;
+    int const qkv_dim = hidden_size + 2 * num_kv_heads * head_dim;
+    int const attn_dim = m->vProjSize * num_q_heads;
+    std::vector<float> qkv_weight(static_cast<size_t>(qkv_dim) * m->qSize);
+    float *dst = qkv_weight.data();
+    size_t q_rows = static_cast<size_t>(hidden_size) * m->qSize;
+    std::copy(weight, weight + q_rows, dst);
+    dst += q_rows;
+    for (int part = 1; part <= 2; part++) {
+      for (int j = 0; j < num_kv_heads; j++) {
+        size_t row = static_cast<size_t>(part) * hidden_size +
+                     static_cast<size_t>(j) * local_rep * head_dim;
+        size_t len = static_cast<size_t>(head_dim) * m->qSize;
+        std::copy(
+            weight + row * m->qSize, weight + row * m->qSize + len, dst);
+        dst += len;
+      }
+    }
+    m->cpu_packed_qkv.resize(
+        Kernels::CPU::packed_linear_weight_size(m->qSize, qkv_dim));
+    Kernels::CPU::pack_linear_weight(
+        qkv_weight.data(), m->cpu_packed_qkv.data(), m->qSize, qkv_dim);
+    m->cpu_packed_o.resize(
+        Kernels::CPU::packed_linear_weight_size(attn_dim, m->oProjSize));
+    Kernels::CPU::pack_linear_weight(
+        weight + static_cast<size_t>(m->qSize) * hidden_size * QKV_WEIGHT_NUM,
+        m->cpu_packed_o.data(),
+        attn_dim,
+        m->oProjSize);
+    m->cpu_num_kv_heads = num_kv_heads;
+    m->cpu_packed_source = weight;
+  }
+  if (m->cpu_key_cache.empty()) {
+    size_t size = static_cast<size_t>(BatchConfig::max_requests_per_batch()) *
+                  cache_length * m->cpu_num_kv_heads * head_dim;
+    m->cpu_key_cache.resize(size);
+    m->cpu_value_cache.resize(size);
+    m->cpu_cache_length = cache_length;
+  }
+}
+
+/*static*/
+void IncMultiHeadSelfAttention::compute_qkv_cpu(
+    IncMultiHeadSelfAttentionMeta const *m,
+    BatchConfig const *bc,
+    int shard_id,
+    float const *input,
+    float const *bias,
+    float *qkv) {
+  int const head_dim = m->qProjSize;
+  int const num_q_heads = m->num_q_heads;
+  int const num_kv_heads = m->cpu_num_kv_heads;
+  int const hidden_size = m->hidden_size;
+  int const kv_size = num_kv_heads * head_dim;
+  int const qkv_dim = hidden_size + 2 * kv_size;
+  int const local_rep = num_q_heads / num_kv_heads;
+  int const num_tokens = bc->num_active_tokens();
+  std::vector<float> qkv_bias;
+  if (*m->qkv_bias) {
+    // The bias is not sharded: |q|k|v|o| over the global query heads
+    size_t global_q = static_cast<size_t>(head_dim) * m->global_num_q_heads;
+    size_t first_head = static_cast<size_t>(shard_id) * num_q_heads;
+    qkv_bias.resize(qkv_dim);
+    float const *q_bias = bias + first_head * head_dim;
+    std::copy(q_bias, q_bias + hidden_size, qkv_bias.begin());
+    for (int part = 1; part <= 2; part++) {
+      for (int j = 0; j < num_kv_heads; j++) {
+        float const *src =
+            bias + part * global_q + (first_head + j * local_rep) * head_dim;
+        std::copy(src,
+                  src + head_dim,
+                  qkv_bias.begin() + hidden_size + (part - 1) * kv_size +
+                      j * head_dim);
+      }
+    }
+  }
+  Kernels::CPU::linear_forward_packed(input,
+                                      m->cpu_packed_qkv.data(),
+                                      *m->qkv_bias ? qkv_bias.data() : nullptr,
+                                      qkv,
+                                      m->qSize,
+                                      qkv_dim,
+                                      num_tokens,
+                                      AC_MODE_NONE,
+                                      m->handle.cpu_kernel_threads);
+  for (int t = 0; t < num_tokens; t++) {
+    float *row = qkv + static_cast<size_t>(t) * qkv_dim;
+    if (*m->scaling_query) {
+      for (int i = 0; i < hidden_size; i++) {
+        row[i] *= m->scaling_factor;
+      }
+    }
+    if (*m->apply_rotary_embedding) {
+      int position = bc->tokensInfo[t].abs_depth_in_request;
+      Kernels::CPU::rotary_embedding(row, num_q_heads, head_dim, position);
+      Kernels::CPU::rotary_embedding(
+          row + hidden_size, num_kv_heads, head_dim, position);
+    }
+  }
+}
+
+/*static*/
+void IncMultiHeadSelfAttention::store_kv_cpu(
+    IncMultiHeadSelfAttentionMeta *m,
+    float const *qkv_row,
+    int request_index,
+    int position) {
+  size_t const kv_size =
+      static_cast<size_t>(m->cpu_num_kv_heads) * m->kProjSize;
+  float const *k = qkv_row + m->hidden_size;
+  size_t offset = (request_index * m->cpu_cache_length + position) * kv_size;
+  std::copy(k, k + kv_size, m->cpu_key_cache.data() + offset);
+  std::copy(k + kv_size, k + 2 * kv_size, m->cpu_value_cache.data() + offset);
+}
+
+/*static*/
+std::vector<float> IncMultiHeadSelfAttention::alibi_slopes_cpu(
+    IncMultiHeadSelfAttentionMeta const *m, int shard_id) {
+  std::vector<float> slopes;
+  if (*m->position_bias) {
+    slopes.resize(m->num_q_heads);
+    for (int h = 0; h < m->num_q_heads; h++) {
+      int global_head = shard_id * m->num_q_heads + h;
+      slopes[h] =
+          1.0f / powf(2.0f, (global_head + 1) * 8.0f / m->global_num_q_heads);
+    }
+  }
+  return slopes;
+}
+
+/*static*/
+void IncMultiHeadSelfAttention::compute_o_prod_bias_cpu(
+    IncMultiHeadSelfAttentionMeta const *m,
+    int shard_id,
+    float const *attn_heads,
+    float const *bias,
+    float *output,
+    int num_tokens) {
+  float const *o_bias = nullptr;
+  if (*m->final_bias && shard_id == 0) {
+    o_bias = bias + static_cast<size_t>(m->qProjSize) * m->global_num_q_heads *
+                        QKV_WEIGHT_NUM;
+  }
+  Kernels::CPU::linear_forward_packed(attn_heads,
+                                      m->cpu_packed_o.data(),
+                                      o_bias,
+                                      output,
+                                      m->vProjSize * m->num_q_heads,
+                                      m->oProjSize,
+                                      num_tokens,
+                                      AC_MODE_NONE,
+                                      m->handle.cpu_kernel_threads);
+}
+
+/*
+  regions[0](I): input
+  regions[1](I): weight
+  regions[2](O): output
+  regions[3](I): bias (optional)
+*/
+void IncMultiHeadSelfAttention::inference_task_cpu(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  assert(task->regions.size() == regions.size());
+  BatchConfig const *bc = BatchConfig::from_future(task->futures[0]);
+  if (bc->num_tokens == 0) {
+    return;
+  }
+  IncMultiHeadSelfAttentionMeta *m =
+      *((IncMultiHeadSelfAttentionMeta **)task->local_args);
+  assert(((*m->qkv_bias || *m->final_bias) ? regions.size() == 4
+                                           : regions.size() == 3));
+  // The CPU variant covers unquantized fp32 weights and activations
+  assert(m->input_type[0] == DT_FLOAT);
+  assert(m->weight_type[0] == DT_FLOAT);
+  assert(m->output_type[0] == DT_FLOAT);
+  assert(m->quantization_type == DT_NONE);
+  assert(m->qProjSize == m->kProjSize && m->kProjSize == m->vProjSize);
+  assert(task->index_point.get_dim() == 1);
+  int shard_id = task->index_point.point_data[0];
+
+  GenericTensorAccessorR input = helperGetGenericTensorAccessorRO(
+      m->input_type[0], regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  GenericTensorAccessorR weight = helperGetGenericTensorAccessorRO(
+      m->weight_type[0], regions[1], task->regions[1], FID_DATA, ctx, runtime);
+  GenericTensorAccessorW output = helperGetGenericTensorAccessorWO(
+      m->output_type[0], regions[2], task->regions[2], FID_DATA, ctx, runtime);
+  float const *bias_ptr = nullptr;
+  if (*m->qkv_bias || *m->final_bias) {
+    GenericTensorAccessorR biases =
+        helperGetGenericTensorAccessorRO(m->weight_type[1],
+                                         regions[3],
+                                         task->regions[3],
+                                         FID_DATA,
+                                         ctx,
+                                         runtime);
+    bias_ptr = biases.get_float_ptr();
+  }
+  assert(weight.domain.get_volume() * sizeof(float) == m->weightSize);
+
+  prepare_cpu_state(
+      m, weight.get_float_ptr(), BatchConfig::max_sequence_length());
+  int const num_tokens = bc->num_active_tokens();
+  int const head_dim = m->qProjSize;
+  int const kv_size = m->cpu_num_kv_heads * head_dim;
+  int const qkv_dim = m->hidden_size + 2 * kv_size;
+  int const attn_dim = m->vProjSize * m->num_q_heads;
+  std::vector<float> qkv(static_cast<size_t>(num_tokens) * qkv_dim);
+  compute_qkv_cpu(
+      m, bc, shard_id, input.get_float_ptr(), bias_ptr, qkv.data());
+  for (int t = 0; t < num_tokens; t++) {
+    store_kv_cpu(m,
+                 qkv.data() + static_cast<size_t>(t) * qkv_dim,
+                 bc->tokensInfo[t].request_index,
+                 bc->tokensInfo[t].abs_depth_in_request);
+  }
+
+  std::vector<Kernels::CPU::AttentionRequest> requests;
+  for (int i = 0; i < bc->max_requests_per_batch(); i++) {
+    if (bc->request_completed[i] ||
+        bc->requestsInfo[i].num_tokens_in_batch == 0) {
+      continue;
+    }
+    Kernels::CPU::AttentionRequest r;
+    r.token_offset = bc->requestsInfo[i].first_token_offset_in_batch;
+    r.num_tokens = bc->requestsInfo[i].num_tokens_in_batch;
+    r.first_depth = bc->requestsInfo[i].first_token_depth_in_request;
+    r.cache_slot = i;
+    requests.push_back(r);
+  }
+  std::vector<float> alibi_slopes = alibi_slopes_cpu(m, shard_id);
+  std::vector<float> attn_heads(static_cast<size_t>(num_tokens) * attn_dim);
+  float scale = *m->qk_prod_scaling ? 1.0f / sqrtf(m->kProjSize) : 1.0f;
+  Kernels::CPU::causal_attention(
+      qkv.data(),
+      qkv_dim,
+      m->cpu_key_cache.data(),
+      m->cpu_value_cache.data(),
+      m->cpu_cache_length * kv_size,
+      kv_size,
+      attn_heads.data(),
+      attn_dim,
+      requests.data(),
+      static_cast<int>(requests.size()),
+      m->num_q_heads,
+      m->cpu_num_kv_heads,
+      head_dim,
+      scale,
+      *m->position_bias ? alibi_slopes.data() : nullptr,
+      m->handle.cpu_kernel_threads);
+  compute_o_prod_bias_cpu(m,
+                          shard_id,
+                          attn_heads.data(),
+                          bias_ptr,
+                          output.get_float_ptr(),
+                          num_tokens);
+}
+
 void IncMultiHeadSelfAttention::backward(FFModel const &ff) {
   // IncMultiHeadSelfAttention does not support backward
   assert(false);
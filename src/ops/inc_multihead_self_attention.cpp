@@ -882,7 +882,8 @@ IncMultiHeadSelfAttentionMeta::IncMultiHeadSelfAttentionMeta(
     int _num_kv_heads,
     DataType _quantization_type,
     bool _offload)
-    : OpMeta(handler, attn), weight_ptr(nullptr), bias_ptr(nullptr) {
+    : OpMeta(handler, attn), weight_ptr(nullptr), bias_ptr(nullptr),
+      cpu_packed_source(nullptr), cpu_num_kv_heads(0), cpu_cache_length(0) {
   hipStream_t stream;
   checkCUDA(get_legion_stream(&stream));
   checkCUDNN(miopenSetStream(handler.dnn, stream));
@@ -0,0 +1,1887 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/ops/kernels/cpu_kernels.h"
+#include "flexflow/ffconst_utils.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#if defined(FF_USE_AVX512) || defined(FF_USE_AVX2)
+#include <immintrin.h>
+#endif
+
+namespace FlexFlow {
+namespace Kernels {
+namespace CPU {
+
+namespace {
+
+// A minimal vector abstraction so that every kernel has one body for the
+// AVX-512, AVX2 and scalar builds
+#if defined(FF_USE_AVX512)
+using vfloat = __m512;
+constexpr int VLEN = 16;
+inline vfloat vzero() {
+  return _mm512_setzero_ps();
+}
+inline vfloat vload(float const *p) {
+  return _mm512_loadu_ps(p);
+}
+inline void vstore(float *p, vfloat v) {
+  _mm512_storeu_ps(p, v);
+}
+inline vfloat vset1(float x) {
+  return _mm512_set1_ps(x);
+}
+inline vfloat vfma(vfloat a, vfloat b, vfloat c) {
+  return _mm512_fmadd_ps(a, b, c);
+}
+inline vfloat vmul(vfloat a, vfloat b) {
+  return _mm512_mul_ps(a, b);
+}
+inline vfloat vadd(vfloat a, vfloat b) {
+  return _mm512_add_ps(a, b);
+}
+inline vfloat vsub(vfloat a, vfloat b) {
+  return _mm512_sub_ps(a, b);
+}
+inline vfloat vload(Half const *p) {
+  return _mm512_cvtph_ps(_mm256_loadu_si256((__m256i const *)p));
+}
+inline void vstore(Half *p, vfloat v) {
+  _mm256_storeu_si256((__m256i *)p,
+                      _mm512_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+}
+inline float vsum(vfloat v) {
+  return _mm512_reduce_add_ps(v);
+}
+inline vfloat vload_uint8(uint8_t const *p) {
+  return _mm512_cvtepi32_ps(
+      _mm512_cvtepu8_epi32(_mm_loadu_si128((__m128i const *)p)));
+}
+inline vfloat vload_uint4(uint8_t const *p) {
+  // Duplicate each byte into two lanes, then keep the high nibble in the
+  // even lane and the low nibble in the odd one
+  __m128i bytes = _mm_loadl_epi64((__m128i const *)p);
+  __m512i lanes = _mm512_cvtepu8_epi32(_mm_unpacklo_epi8(bytes, bytes));
+  __m512i shifts =
+      _mm512_set_epi32(0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4, 0, 4);
+  lanes = _mm512_and_si512(_mm512_srlv_epi32(lanes, shifts),
+                           _mm512_set1_epi32(0xF));
+  return _mm512_cvtepi32_ps(lanes);
+}
+#elif defined(FF_USE_AVX2)
+using vfloat = __m256;
+constexpr int VLEN = 8;
+inline vfloat vzero() {
+  return _mm256_setzero_ps();
+}
+inline vfloat vload(float const *p) {
+  return _mm256_loadu_ps(p);
+}
+inline void vstore(float *p, vfloat v) {
+  _mm256_storeu_ps(p, v);
+}
+inline vfloat vset1(float x) {
+  return _mm256_set1_ps(x);
+}
+inline vfloat vfma(vfloat a, vfloat b, vfloat c) {
+  return _mm256_fmadd_ps(a, b, c);
+}
+inline vfloat vmul(vfloat a, vfloat b) {
+  return _mm256_mul_ps(a, b);
+}
+inline vfloat vadd(vfloat a, vfloat b) {
+  return _mm256_add_ps(a, b);
+}
+inline vfloat vsub(vfloat a, vfloat b) {
+  return _mm256_sub_ps(a, b);
+}
+inline vfloat vload(Half const *p) {
+  return _mm256_cvtph_ps(_mm_loadu_si128((__m128i const *)p));
+}
+inline void vstore(Half *p, vfloat v) {
+  _mm_storeu_si128((__m128i *)p,
+                   _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+}
+inline float vsum(vfloat v) {
+  __m128 lo = _mm256_castps256_ps128(v);
+  __m128 hi = _mm256_extractf128_ps(v, 1);
+  lo = _mm_add_ps(lo, hi);
+  lo = _mm_hadd_ps(lo, lo);
+  lo = _mm_hadd_ps(lo, lo);
+  return _mm_cvtss_f32(lo);
+}
+inline vfloat vload_uint8(uint8_t const *p) {
+  return _mm256_cvtepi32_ps(
+      _mm256_cvtepu8_epi32(_mm_loadl_epi64((__m128i const *)p)));
+}
+inline vfloat vload_uint4(uint8_t const *p) {
+  int32_t word;
+  std::memcpy(&word, p, sizeof(word));
+  __m128i bytes = _mm_cvtsi32_si128(word);
+  __m256i lanes = _mm256_cvtepu8_epi32(_mm_unpacklo_epi8(bytes, bytes));
+  __m256i shifts = _mm256_set_epi32(0, 4, 0, 4, 0, 4, 0, 4);
+  lanes = _mm256_and_si256(_mm256_srlv_epi32(lanes, shifts),
+                           _mm256_set1_epi32(0xF));
+  return _mm256_cvtepi32_ps(lanes);
+}
+#else
+using vfloat = float;
+constexpr int VLEN = 1;
+inline vfloat vzero() {
+  return 0.0f;
+}
+inline vfloat vload(float const *p) {
+  return *p;
+}
+inline void vstore(float *p, vfloat v) {
+  *p = v;
+}
+inline vfloat vset1(float x) {
+  return x;
+}
+inline vfloat vfma(vfloat a, vfloat b, vfloat c) {
+  return a * b + c;
+}
+inline vfloat vmul(vfloat a, vfloat b) {
+  return a * b;
+}
+inline vfloat vadd(vfloat a, vfloat b) {
+  return a + b;
+}
+inline vfloat vsub(vfloat a, vfloat b) {
+  return a - b;
+}
+inline float vsum(vfloat v) {
+  return v;
+}
+inline vfloat vload(Half const *p) {
+  return half_to_float(*p);
+}
+inline void vstore(Half *p, vfloat v) {
+  *p = float_to_half(v);
+}
+#endif
+
+// Scalar access to float or Half tensors, for loop remainders
+inline float sload(float const *p) {
+  return *p;
+}
+inline float sload(Half const *p) {
+  return half_to_float(*p);
+}
+inline void sstore(float *p, float x) {
+  *p = x;
+}
+inline void sstore(Half *p, float x) {
+  *p = float_to_half(x);
+}
+
+// Store v and return the value that was stored, i.e., v rounded to T
+inline vfloat vstore_rounded(float *p, vfloat v) {
+  vstore(p, v);
+  return v;
+}
+inline vfloat vstore_rounded(Half *p, vfloat v) {
+  vstore(p, v);
+  return vload(p);
+}
+inline float sstore_rounded(float *p, float x) {
+  *p = x;
+  return x;
+}
+inline float sstore_rounded(Half *p, float x) {
+  *p = float_to_half(x);
+  return half_to_float(*p);
+}
+
+// Register tile of the linear micro-kernel: ROWS batch rows by COLS output
+// columns, so each loaded input vector is reused COLS times and each weight
+// vector ROWS times
+constexpr int LINEAR_TILE_ROWS = 2;
+constexpr int LINEAR_TILE_COLS = 4;
+// Batch rows processed against one panel of weights while it stays in L2
+constexpr int LINEAR_BLOCK_ROWS = 64;
+
+template <int ROWS, int COLS>
+inline void linear_micro_kernel(float const *input,
+                                float const *weight,
+                                float *output,
+                                int in_dim,
+                                int out_dim) {
+  vfloat acc[ROWS][COLS];
+  for (int r = 0; r < ROWS; r++) {
+    for (int c = 0; c < COLS; c++) {
+      acc[r][c] = vzero();
+    }
+  }
+  int k = 0;
+  for (; k + VLEN <= in_dim; k += VLEN) {
+    vfloat w[COLS];
+    for (int c = 0; c < COLS; c++) {
+      w[c] = vload(weight + (size_t)c * in_dim + k);
+    }
+    for (int r = 0; r < ROWS; r++) {
+      vfloat x = vload(input + (size_t)r * in_dim + k);
+      for (int c = 0; c < COLS; c++) {
+        acc[r][c] = vfma(x, w[c], acc[r][c]);
+      }
+    }
+  }
+  for (int r = 0; r < ROWS; r++) {
+    for (int c = 0; c < COLS; c++) {
+      float sum = vsum(acc[r][c]);
+      for (int kk = k; kk < in_dim; kk++) {
+        sum += input[(size_t)r * in_dim + kk] * weight[(size_t)c * in_dim + kk];
+      }
+      output[(size_t)r * out_dim + c] = sum;
+    }
+  }
+}
+
+// Packed GEMM blocking: a panel holds GEMM_NR output columns (two vectors),
+// the register tile is GEMM_MR rows by one panel, each pass covers GEMM_KC
+// of the reduction so the panel slice stays in L1, and GEMM_MC input rows
+// are reused against every panel of a thread while they sit in L2
+constexpr int GEMM_NR = 2 * VLEN;
+constexpr int GEMM_MR = 4;
+constexpr int GEMM_KC = 256;
+constexpr int GEMM_MC = 64;
+
+int num_panels(int n) {
+  return (n + GEMM_NR - 1) / GEMM_NR;
+}
+
+// packed[p][kk][j] = src[(p * GEMM_NR + j) * col_stride + kk * k_stride],
+// zero for the columns past n
+template <typename T>
+void pack_panels(T const *src,
+                 float *packed,
+                 int k,
+                 int n,
+                 size_t col_stride,
+                 size_t k_stride) {
+  for (int p = 0; p < num_panels(n); p++) {
+    float *dst = packed + (size_t)p * k * GEMM_NR;
+    int const col0 = p * GEMM_NR;
+    int const cols = std::min(GEMM_NR, n - col0);
+    if (k_stride == 1) {
+      // Columns are contiguous along k (Linear weights): read each one once
+      for (int j = 0; j < GEMM_NR; j++) {
+        T const *col = src + (size_t)(col0 + j) * col_stride;
+        for (int kk = 0; kk < k; kk++) {
+          dst[(size_t)kk * GEMM_NR + j] = j < cols ? sload(col + kk) : 0.0f;
+        }
+      }
+    } else {
+      for (int kk = 0; kk < k; kk++) {
+        T const *row = src + (size_t)kk * k_stride + col0 * col_stride;
+        for (int j = 0; j < GEMM_NR; j++) {
+          dst[(size_t)kk * GEMM_NR + j] =
+              j < cols ? sload(row + j * col_stride) : 0.0f;
+        }
+      }
+    }
+  }
+}
+
+// c[ROWS][GEMM_NR] (+)= a[ROWS][depth] * panel[depth][GEMM_NR]. Short tiles
+// (decode steps) would serialize on the FMA latency and leave the memory
+// system one stream to prefetch, so they split depth into U segments with
+// independent partial sums and combine them at the end.
+template <int ROWS>
+inline void gemm_micro_kernel(float const *a,
+                              size_t lda,
+                              float const *panel,
+                              float *c,
+                              size_t ldc,
+                              int depth,
+                              bool accumulate) {
+  constexpr int U = ROWS >= 4 ? 1 : (ROWS >= 2 ? 2 : 4);
+  vfloat acc[U][ROWS][2];
+  for (int u = 0; u < U; u++) {
+    for (int r = 0; r < ROWS; r++) {
+      acc[u][r][0] = vzero();
+      acc[u][r][1] = vzero();
+    }
+  }
+  if (accumulate) {
+    for (int r = 0; r < ROWS; r++) {
+      acc[0][r][0] = vload(c + r * ldc);
+      acc[0][r][1] = vload(c + r * ldc + VLEN);
+    }
+  }
+  int const seg = depth / U;
+  for (int kk = 0; kk < seg; kk++) {
+    for (int u = 0; u < U; u++) {
+      int const ku = u * seg + kk;
+      vfloat const b0 = vload(panel + (size_t)ku * GEMM_NR);
+      vfloat const b1 = vload(panel + (size_t)ku * GEMM_NR + VLEN);
+      for (int r = 0; r < ROWS; r++) {
+        vfloat const x = vset1(a[r * lda + ku]);
+        acc[u][r][0] = vfma(x, b0, acc[u][r][0]);
+        acc[u][r][1] = vfma(x, b1, acc[u][r][1]);
+      }
+    }
+  }
+  for (int kk = U * seg; kk < depth; kk++) {
+    vfloat const b0 = vload(panel + (size_t)kk * GEMM_NR);
+    vfloat const b1 = vload(panel + (size_t)kk * GEMM_NR + VLEN);
+    for (int r = 0; r < ROWS; r++) {
+      vfloat const x = vset1(a[r * lda + kk]);
+      acc[0][r][0] = vfma(x, b0, acc[0][r][0]);
+      acc[0][r][1] = vfma(x, b1, acc[0][r][1]);
+    }
+  }
+  for (int r = 0; r < ROWS; r++) {
+    for (int u = 1; u < U; u++) {
+      acc[0][r][0] = vadd(acc[0][r][0], acc[u][r][0]);
+      acc[0][r][1] = vadd(acc[0][r][1], acc[u][r][1]);
+    }
+    vstore(c + r * ldc, acc[0][r][0]);
+    vstore(c + r * ldc + VLEN, acc[0][r][1]);
+  }
+}
+
+inline void gemm_tile(int rows,
+                      float const *a,
+                      size_t lda,
+                      float const *panel,
+                      float *c,
+                      size_t ldc,
+                      int depth,
+                      bool accumulate) {
+  static_assert(GEMM_MR == 4, "gemm_tile dispatches up to four rows");
+  switch (rows) {
+    case 4:
+      gemm_micro_kernel<4>(a, lda, panel, c, ldc, depth, accumulate);
+      break;
+    case 3:
+      gemm_micro_kernel<3>(a, lda, panel, c, ldc, depth, accumulate);
+      break;
+    case 2:
+      gemm_micro_kernel<2>(a, lda, panel, c, ldc, depth, accumulate);
+      break;
+    default:
+      gemm_micro_kernel<1>(a, lda, panel, c, ldc, depth, accumulate);
+  }
+}
+
+// c = act(a * B + bias) for the columns covered by panels [p0, p1) of the
+// packed B. The epilogue runs on each tile right after its last pass.
+void gemm_packed_panels(float const *a,
+                        size_t lda,
+                        float const *packed,
+                        float const *bias,
+                        float *c,
+                        size_t ldc,
+                        int rows,
+                        int k,
+                        int n,
+                        ActiMode activation,
+                        int p0,
+                        int p1) {
+  assert(k > 0);
+  // Partial panels are computed here and copied out, so the micro-kernel
+  // never writes past column n
+  float tile[GEMM_MR * GEMM_NR];
+  // A single register tile reuses nothing across panels, so it streams each
+  // panel end to end instead of revisiting it once per depth pass
+  int const kc = rows > GEMM_MR ? GEMM_KC : k;
+  for (int k0 = 0; k0 < k; k0 += kc) {
+    int const depth = std::min(kc, k - k0);
+    bool const accumulate = k0 > 0;
+    bool const last = k0 + depth == k;
+    for (int r0 = 0; r0 < rows; r0 += GEMM_MC) {
+      int const r1 = std::min(rows, r0 + GEMM_MC);
+      for (int p = p0; p < p1; p++) {
+        float const *panel = packed + ((size_t)p * k + k0) * GEMM_NR;
+        int const col0 = p * GEMM_NR;
+        int const cols = std::min(GEMM_NR, n - col0);
+        for (int r = r0; r < r1; r += GEMM_MR) {
+          int const tile_rows = std::min(GEMM_MR, r1 - r);
+          float const *x = a + r * lda + k0;
+          float *y = c + r * ldc + col0;
+          if (cols == GEMM_NR) {
+            gemm_tile(tile_rows, x, lda, panel, y, ldc, depth, accumulate);
+          } else {
+            for (int i = 0; accumulate && i < tile_rows; i++) {
+              std::memcpy(
+                  tile + i * GEMM_NR, y + i * ldc, sizeof(float) * cols);
+            }
+            gemm_tile(
+                tile_rows, x, lda, panel, tile, GEMM_NR, depth, accumulate);
+            for (int i = 0; i < tile_rows; i++) {
+              std::memcpy(
+                  y + i * ldc, tile + i * GEMM_NR, sizeof(float) * cols);
+            }
+          }
+          if (!last) {
+            continue;
+          }
+          for (int i = 0; i < tile_rows; i++) {
+            float *yi = y + i * ldc;
+            if (bias != nullptr) {
+              for (int j = 0; j < cols; j++) {
+                yi[j] += bias[col0 + j];
+              }
+            }
+            apply_activation(yi, cols, activation);
+          }
+        }
+      }
+    }
+  }
+}
+
+// Worker threads of one Legion CPU processor (i.e., of the thread that
+// runs its tasks), started on first use and kept until that thread exits,
+// so that a kernel does not create and join threads on every call
+class WorkerPool {
+public:
+  static WorkerPool &get() {
+    thread_local WorkerPool pool;
+    return pool;
+  }
+  ~WorkerPool() {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      stop = true;
+    }
+    start.notify_all();
+    for (std::thread &w : workers) {
+      w.join();
+    }
+  }
+  // Run task(t) for every t in [0, num_tasks): t = 0 on the calling thread
+  // and the rest on the workers; returns once all of them have finished
+  void run(int num_tasks, std::function<void(int)> const &task) {
+    if (busy) {
+      // Called from a task of this pool: run inline instead of waiting on
+      // workers that wait on us
+      for (int t = 0; t < num_tasks; t++) {
+        task(t);
+      }
+      return;
+    }
+    busy = true;
+    while ((int)workers.size() < num_tasks - 1) {
+      workers.emplace_back(
+          &WorkerPool::work, this, (int)workers.size() + 1, generation);
+    }
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      current = &task;
+      current_tasks = num_tasks;
+      pending = num_tasks - 1;
+      generation++;
+    }
+    start.notify_all();
+    task(0);
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return pending == 0; });
+    current = nullptr;
+    busy = false;
+  }
+
+private:
+  void work(int id, uint64_t seen) {
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true) {
+      start.wait(lock, [&] { return stop || generation != seen; });
+      if (stop) {
+        return;
+      }
+      seen = generation;
+      if (id >= current_tasks) {
+        continue;
+      }
+      std::function<void(int)> const *task = current;
+      lock.unlock();
+      (*task)(id);
+      lock.lock();
+      if (--pending == 0) {
+        done.notify_one();
+      }
+    }
+  }
+
+  std::mutex mutex;
+  std::condition_variable start, done;
+  std::vector<std::thread> workers;
+  std::function<void(int)> const *current = nullptr;
+  int current_tasks = 0;
+  int pending = 0;
+  uint64_t generation = 0;
+  bool stop = false;
+  // Only touched by the owning thread
+  bool busy = false;
+};
+
+// Split [0, n) into one contiguous range per thread and run fn(begin, end)
+// on each; the calling thread takes the first range
+template <typename F>
+void parallel_ranges(int n, int num_threads, F const &fn) {
+  num_threads = std::max(1, std::min(num_threads, n));
+  if (num_threads == 1) {
+    fn(0, n);
+    return;
+  }
+  int const chunk = (n + num_threads - 1) / num_threads;
+  int const num_ranges = (n + chunk - 1) / chunk;
+  WorkerPool::get().run(num_ranges, [&](int t) {
+    fn(t * chunk, std::min(n, (t + 1) * chunk));
+  });
+}
+
+// Element k of a row in the grouped layout of load_quantization_weight:
+// INT8 stores one unsigned value per byte, INT4 two per byte with the even
+// element in the high nibble
+template <DataType QT>
+inline float quantized_value(uint8_t const *row, size_t k) {
+  if (QT == DT_INT8) {
+    return row[k];
+  }
+  return (row[k / 2] >> (k % 2 == 0 ? 4 : 0)) & 0xF;
+}
+
+// Elements [k, k + VLEN) of a quantized row, k a multiple of VLEN
+template <DataType QT>
+inline vfloat vload_quantized(uint8_t const *row, int k) {
+#if defined(FF_USE_AVX512) || defined(FF_USE_AVX2)
+  return QT == DT_INT8 ? vload_uint8(row + k) : vload_uint4(row + k / 2);
+#else
+  return quantized_value<QT>(row, k);
+#endif
+}
+
+// output[r][c] = sum_k xs[r][k] * q[c][k] + bias[r] for a ROWS x COLS tile,
+// where the group scales are already folded into xs
+template <DataType QT, int ROWS, int COLS>
+inline void quantized_micro_kernel(float const *xs,
+                                   uint8_t const *q,
+                                   size_t row_bytes,
+                                   float const *bias,
+                                   float *output,
+                                   int in_dim,
+                                   int out_dim) {
+  vfloat acc[ROWS][COLS];
+  for (int r = 0; r < ROWS; r++) {
+    for (int c = 0; c < COLS; c++) {
+      acc[r][c] = vzero();
+    }
+  }
+  int k = 0;
+  for (; k + VLEN <= in_dim; k += VLEN) {
+    vfloat w[COLS];
+    for (int c = 0; c < COLS; c++) {
+      w[c] = vload_quantized<QT>(q + c * row_bytes, k);
+    }
+    for (int r = 0; r < ROWS; r++) {
+      vfloat x = vload(xs + (size_t)r * in_dim + k);
+      for (int c = 0; c < COLS; c++) {
+        acc[r][c] = vfma(x, w[c], acc[r][c]);
+      }
+    }
+  }
+  for (int r = 0; r < ROWS; r++) {
+    for (int c = 0; c < COLS; c++) {
+      float sum = vsum(acc[r][c]) + bias[r];
+      for (int kk = k; kk < in_dim; kk++) {
+        sum += xs[(size_t)r * in_dim + kk] *
+               quantized_value<QT>(q + c * row_bytes, kk);
+      }
+      output[(size_t)r * out_dim + c] = sum;
+    }
+  }
+}
+
+// Output rows [g0, g1) * INT4_NUM_OF_ELEMENTS_PER_GROUP of a weight-only
+// quantized linear, before bias and activation. Since
+//   sum_k x[k] * (q[o][k] / scale[g][k] + offset[g][k])
+//     = sum_k (x[k] / scale[g][k]) * q[o][k] + sum_k x[k] * offset[g][k],
+// each group scales the inputs once and adds one offset dot product, and
+// the inner loop only widens the quantized bytes.
+template <DataType QT>
+void quantized_linear_groups(float const *input,
+                             char const *weight,
+                             float *output,
+                             int in_dim,
+                             int out_dim,
+                             int batch_size,
+                             int g0,
+                             int g1) {
+  int const G = INT4_NUM_OF_ELEMENTS_PER_GROUP;
+  int const R = LINEAR_TILE_ROWS, C = LINEAR_TILE_COLS;
+  size_t const num_elements = (size_t)in_dim * out_dim;
+  size_t const row_bytes = QT == DT_INT4 ? in_dim / 2 : in_dim;
+  uint8_t const *values = (uint8_t const *)weight;
+  float const *offsets =
+      (float const *)(weight + (QT == DT_INT4 ? num_elements / 2
+                                              : num_elements));
+  float const *scales = offsets + num_elements / G;
+  std::vector<float> xs((size_t)LINEAR_BLOCK_ROWS * in_dim);
+  float shift[LINEAR_BLOCK_ROWS];
+  for (int b0 = 0; b0 < batch_size; b0 += LINEAR_BLOCK_ROWS) {
+    int const rows = std::min(LINEAR_BLOCK_ROWS, batch_size - b0);
+    for (int g = g0; g < g1; g++) {
+      float const *offset = offsets + (size_t)g * in_dim;
+      float const *scale = scales + (size_t)g * in_dim;
+      for (int r = 0; r < rows; r++) {
+        float const *x = input + (size_t)(b0 + r) * in_dim;
+        float *y = xs.data() + (size_t)r * in_dim;
+        for (int k = 0; k < in_dim; k++) {
+          y[k] = x[k] / scale[k];
+        }
+        shift[r] = dot(x, offset, in_dim);
+      }
+      for (int o = g * G; o < (g + 1) * G; o += C) {
+        uint8_t const *q = values + (size_t)o * row_bytes;
+        int b = 0;
+        for (; b + R <= rows; b += R) {
+          quantized_micro_kernel<QT, R, C>(
+              xs.data() + (size_t)b * in_dim,
+              q,
+              row_bytes,
+              shift + b,
+              output + (size_t)(b0 + b) * out_dim + o,
+              in_dim,
+              out_dim);
+        }
+        for (; b < rows; b++) {
+          quantized_micro_kernel<QT, 1, C>(
+              xs.data() + (size_t)b * in_dim,
+              q,
+              row_bytes,
+              shift + b,
+              output + (size_t)(b0 + b) * out_dim + o,
+              in_dim,
+              out_dim);
+        }
+      }
+    }
+  }
+}
+
+// Run fn(i) for every i in [0, n), handing out items one at a time so that
+// uneven items (requests with different context lengths) balance out
+template <typename F>
+void parallel_items(int n, int num_threads, F const &fn) {
+  num_threads = std::max(1, std::min(num_threads, n));
+  std::atomic<int> next(0);
+  auto worker = [&]() {
+    for (int i = next++; i < n; i = next++) {
+      fn(i);
+    }
+  };
+  if (num_threads == 1) {
+    worker();
+    return;
+  }
+  WorkerPool::get().run(num_threads, [&](int) { worker(); });
+}
+
+// y = a * y + b * x
+inline void scale_add(float a, float *y, float b, float const *x, int n) {
+  vfloat const va = vset1(a), vb = vset1(b);
+  int i = 0;
+  for (; i + VLEN <= n; i += VLEN) {
+    vstore(y + i, vfma(vb, vload(x + i), vmul(va, vload(y + i))));
+  }
+  for (; i < n; i++) {
+    y[i] = a * y[i] + b * x[i];
+  }
+}
+
+// Attention blocking: each work item covers ATTN_QUERY_BLOCK new tokens of
+// one request and all query heads sharing a KV head, and walks the cache in
+// blocks of ATTN_KEY_BLOCK positions so every key and value row is loaded
+// once per item rather than once per query
+constexpr int ATTN_QUERY_BLOCK = 16;
+constexpr int ATTN_KEY_BLOCK = 64;
+
+} // namespace
+
+float dot(float const *a, float const *b, int n) {
+  vfloat acc0 = vzero(), acc1 = vzero();
+  int i = 0;
+  for (; i + 2 * VLEN <= n; i += 2 * VLEN) {
+    acc0 = vfma(vload(a + i), vload(b + i), acc0);
+    acc1 = vfma(vload(a + i + VLEN), vload(b + i + VLEN), acc1);
+  }
+  for (; i + VLEN <= n; i += VLEN) {
+    acc0 = vfma(vload(a + i), vload(b + i), acc0);
+  }
+  float sum = vsum(acc0) + vsum(acc1);
+  for (; i < n; i++) {
+    sum += a[i] * b[i];
+  }
+  return sum;
+}
+
+void apply_activation(float *data, size_t num_elements, ActiMode activation) {
+  switch (activation) {
+    case AC_MODE_NONE:
+      break;
+    case AC_MODE_RELU:
+      for (size_t i = 0; i < num_elements; i++) {
+        data[i] = std::max(data[i], 0.0f);
+      }
+      break;
+    case AC_MODE_SIGMOID:
+      for (size_t i = 0; i < num_elements; i++) {
+        data[i] = 1.0f / (1.0f + std::exp(-data[i]));
+      }
+      break;
+    case AC_MODE_TANH:
+      for (size_t i = 0; i < num_elements; i++) {
+        data[i] = std::tanh(data[i]);
+      }
+      break;
+    case AC_MODE_GELU: {
+      // Same tanh approximation as gelu_forward_kernel
+      float const B = 0.7978845608028654f;   // sqrt(2.0/M_PI)
+      float const C = 0.035677408136300125f; // 0.044715 * sqrt(2.0/M_PI)
+      for (size_t i = 0; i < num_elements; i++) {
+        float const in = data[i];
+        data[i] = in * (0.5f + 0.5f * std::tanh(in * (C * in * in + B)));
+      }
+      break;
+    }
+    default:
+      assert(false && "Unsupported activation for CPU kernels");
+  }
+}
+
+void linear_forward(float const *input,
+                    float const *weight,
+                    float const *bias,
+                    float *output,
+                    int in_dim,
+                    int out_dim,
+                    int batch_size,
+                    ActiMode activation) {
+  int const R = LINEAR_TILE_ROWS, C = LINEAR_TILE_COLS;
+  for (int b0 = 0; b0 < batch_size; b0 += LINEAR_BLOCK_ROWS) {
+    int const b1 = std::min(batch_size, b0 + LINEAR_BLOCK_ROWS);
+    for (int o = 0; o < out_dim; o += C) {
+      float const *w = weight + (size_t)o * in_dim;
+      int const cols = std::min(C, out_dim - o);
+      int b = b0;
+      for (; b + R <= b1; b += R) {
+        float const *x = input + (size_t)b * in_dim;
+        float *y = output + (size_t)b * out_dim + o;
+        if (cols == C) {
+          linear_micro_kernel<R, C>(x, w, y, in_dim, out_dim);
+        } else {
+          for (int c = 0; c < cols; c++) {
+            linear_micro_kernel<R, 1>(
+                x, w + (size_t)c * in_dim, y + c, in_dim, out_dim);
+          }
+        }
+      }
+      for (; b < b1; b++) {
+        float const *x = input + (size_t)b * in_dim;
+        float *y = output + (size_t)b * out_dim + o;
+        if (cols == C) {
+          linear_micro_kernel<1, C>(x, w, y, in_dim, out_dim);
+        } else {
+          for (int c = 0; c < cols; c++) {
+            linear_micro_kernel<1, 1>(
+                x, w + (size_t)c * in_dim, y + c, in_dim, out_dim);
+          }
+        }
+      }
+    }
+  }
+  if (bias != nullptr) {
+    for (int b = 0; b < batch_size; b++) {
+      float *y = output + (size_t)b * out_dim;
+      for (int o = 0; o < out_dim; o++) {
+        y[o] += bias[o];
+      }
+    }
+  }
+  apply_activation(output, (size_t)out_dim * batch_size, activation);
+}
+
+size_t packed_linear_weight_size(int in_dim, int out_dim) {
+  return (size_t)num_panels(out_dim) * in_dim * GEMM_NR;
+}
+
+void pack_linear_weight(float const *weight,
+                        float *packed,
+                        int in_dim,
+                        int out_dim) {
+  pack_panels(weight, packed, in_dim, out_dim, in_dim, 1);
+}
+
+void pack_linear_weight(Half const *weight,
+                        float *packed,
+                        int in_dim,
+                        int out_dim) {
+  pack_panels(weight, packed, in_dim, out_dim, in_dim, 1);
+}
+
+void linear_forward_packed(float const *input,
+                           float const *packed_weight,
+                           float const *bias,
+                           float *output,
+                           int in_dim,
+                           int out_dim,
+                           int batch_size,
+                           ActiMode activation,
+                           int num_threads) {
+  // Threads own disjoint output columns, so no two write the same tile and
+  // each streams only its share of the weight (the bottleneck at batch 1)
+  parallel_ranges(num_panels(out_dim), num_threads, [&](int p0, int p1) {
+    gemm_packed_panels(input,
+                       in_dim,
+                       packed_weight,
+                       bias,
+                       output,
+                       out_dim,
+                       batch_size,
+                       in_dim,
+                       out_dim,
+                       activation,
+                       p0,
+                       p1);
+  });
+}
+
+void batch_matmul_forward(float const *a,
+                          float const *b,
+                          float *o,
+                          int m,
+                          int n,
+                          int k,
+                          int lda,
+                          int ldb,
+                          int ldo,
+                          size_t stride_a,
+                          size_t stride_b,
+                          size_t stride_o,
+                          int batch,
+                          int num_threads) {
+  size_t const packed_size = (size_t)num_panels(m) * k * GEMM_NR;
+  auto multiply = [&](int i, float *packed, int p0, int p1) {
+    gemm_packed_panels(a + i * stride_a,
+                       lda,
+                       packed,
+                       nullptr,
+                       o + i * stride_o,
+                       ldo,
+                       n,
+                       k,
+                       m,
+                       AC_MODE_NONE,
+                       p0,
+                       p1);
+  };
+  if (batch >= num_threads) {
+    // Enough matrices to keep every thread busy with whole products
+    parallel_ranges(batch, num_threads, [&](int begin, int end) {
+      std::vector<float> packed(packed_size);
+      for (int i = begin; i < end; i++) {
+        pack_panels(b + i * stride_b, packed.data(), k, m, 1, ldb);
+        multiply(i, packed.data(), 0, num_panels(m));
+      }
+    });
+  } else {
+    std::vector<float> packed(packed_size);
+    for (int i = 0; i < batch; i++) {
+      pack_panels(b + i * stride_b, packed.data(), k, m, 1, ldb);
+      parallel_ranges(num_panels(m), num_threads, [&](int p0, int p1) {
+        multiply(i, packed.data(), p0, p1);
+      });
+    }
+  }
+}
+
+void decompress_quantized_weight(char const *weight,
+                                 float *output,
+                                 int in_dim,
+                                 int out_dim,
+                                 DataType quantization_type) {
+  size_t const num_elements = (size_t)in_dim * out_dim;
+  size_t const num_groups = num_elements / INT4_NUM_OF_ELEMENTS_PER_GROUP;
+  uint8_t const *values = (uint8_t const *)weight;
+  float const *offsets =
+      (float const *)(weight + (quantization_type == DT_INT4 ? num_elements / 2
+                                                             : num_elements));
+  float const *scales = offsets + num_groups;
+  for (size_t idx = 0; idx < num_elements; idx++) {
+    size_t const group_idx =
+        (idx / ((size_t)in_dim * INT4_NUM_OF_ELEMENTS_PER_GROUP)) * in_dim +
+        idx % in_dim;
+    float const q = quantization_type == DT_INT4
+                        ? quantized_value<DT_INT4>(values, idx)
+                        : quantized_value<DT_INT8>(values, idx);
+    output[idx] = q / scales[group_idx] + offsets[group_idx];
+  }
+}
+
+void linear_forward_quantized(float const *input,
+                              char const *weight,
+                              float const *bias,
+                              float *output,
+                              int in_dim,
+                              int out_dim,
+                              int batch_size,
+                              DataType quantization_type,
+                              ActiMode activation,
+                              int num_threads) {
+  int const G = INT4_NUM_OF_ELEMENTS_PER_GROUP;
+  assert(out_dim % G == 0 && G % LINEAR_TILE_COLS == 0);
+  assert(quantization_type == DT_INT8 ||
+         (quantization_type == DT_INT4 && in_dim % 2 == 0));
+  // Threads own whole groups of output columns, so each reads its scales,
+  // offsets and quantized rows exactly once
+  parallel_ranges(out_dim / G, num_threads, [&](int g0, int g1) {
+    if (quantization_type == DT_INT4) {
+      quantized_linear_groups<DT_INT4>(
+          input, weight, output, in_dim, out_dim, batch_size, g0, g1);
+    } else {
+      quantized_linear_groups<DT_INT8>(
+          input, weight, output, in_dim, out_dim, batch_size, g0, g1);
+    }
+    for (int b = 0; b < batch_size; b++) {
+      float *y = output + (size_t)b * out_dim + g0 * G;
+      int const cols = (g1 - g0) * G;
+      if (bias != nullptr) {
+        for (int j = 0; j < cols; j++) {
+          y[j] += bias[g0 * G + j];
+        }
+      }
+      apply_activation(y, cols, activation);
+    }
+  });
+}
+
+void rotary_embedding(float *x, int num_heads, int head_dim, int position) {
+  int const half = head_dim / 2;
+  for (int i = 0; i < half; i++) {
+    double const freq =
+        position / std::pow(10000.0, (double)(2 * i) / head_dim);
+    float const c = (float)std::cos(freq), s = (float)std::sin(freq);
+    for (int h = 0; h < num_heads; h++) {
+      float *head = x + (size_t)h * head_dim;
+      float const re = head[i], im = head[i + half];
+      head[i] = re * c - im * s;
+      head[i + half] = re * s + im * c;
+    }
+  }
+}
+
+void causal_attention(float const *q,
+                      size_t q_stride,
+                      float const *key_cache,
+                      float const *value_cache,
+                      size_t cache_slot_stride,
+                      size_t cache_pos_stride,
+                      float *output,
+                      size_t output_stride,
+                      AttentionRequest const *requests,
+                      int num_requests,
+                      int num_q_heads,
+                      int num_kv_heads,
+                      int head_dim,
+                      float scale,
+                      float const *alibi_slopes,
+                      int num_threads) {
+  assert(num_q_heads % num_kv_heads == 0);
+  int const group = num_q_heads / num_kv_heads;
+  struct Item {
+    int request, kv_head, first_token;
+  };
+  std::vector<Item> items;
+  for (int r = 0; r < num_requests; r++) {
+    for (int g = 0; g < num_kv_heads; g++) {
+      for (int t = 0; t < requests[r].num_tokens; t += ATTN_QUERY_BLOCK) {
+        items.push_back({r, g, t});
+      }
+    }
+  }
+  parallel_items((int)items.size(), num_threads, [&](int i) {
+    Item const &item = items[i];
+    AttentionRequest const &req = requests[item.request];
+    int const rows =
+        std::min(ATTN_QUERY_BLOCK, req.num_tokens - item.first_token);
+    int const queries = rows * group;
+    float const *keys = key_cache + req.cache_slot * cache_slot_stride +
+                        (size_t)item.kv_head * head_dim;
+    float const *values = value_cache + req.cache_slot * cache_slot_stride +
+                          (size_t)item.kv_head * head_dim;
+    // Streaming softmax state per query: running max, running sum of
+    // exponentials and the unnormalized output
+    std::vector<float> row_max(queries, -INFINITY), row_sum(queries, 0.0f);
+    std::vector<float> acc((size_t)queries * head_dim, 0.0f);
+    float scores[ATTN_KEY_BLOCK];
+    int const last_depth = req.first_depth + item.first_token + rows - 1;
+    for (int k0 = 0; k0 <= last_depth; k0 += ATTN_KEY_BLOCK) {
+      for (int t = 0; t < rows; t++) {
+        int const token = item.first_token + t;
+        int const depth = req.first_depth + token;
+        int const k1 = std::min(depth + 1, k0 + ATTN_KEY_BLOCK);
+        for (int j = 0; j < group; j++) {
+          int const h = item.kv_head * group + j;
+          int const qi = t * group + j;
+          float const *qv =
+              q + (size_t)(req.token_offset + token) * q_stride + h * head_dim;
+          float block_max = -INFINITY;
+          for (int k = k0; k < k1; k++) {
+            float s = scale * dot(qv, keys + k * cache_pos_stride, head_dim);
+            if (alibi_slopes != nullptr) {
+              s += alibi_slopes[h] * (k - depth);
+            }
+            scores[k - k0] = s;
+            block_max = std::max(block_max, s);
+          }
+          if (k1 <= k0) {
+            continue;
+          }
+          float const new_max = std::max(row_max[qi], block_max);
+          float const correction = std::exp(row_max[qi] - new_max);
+          float *out = acc.data() + (size_t)qi * head_dim;
+          row_sum[qi] *= correction;
+          for (int k = k0; k < k1; k++) {
+            float const p = std::exp(scores[k - k0] - new_max);
+            row_sum[qi] += p;
+            scale_add(k == k0 ? correction : 1.0f,
+                      out,
+                      p,
+                      values + k * cache_pos_stride,
+                      head_dim);
+          }
+          row_max[qi] = new_max;
+        }
+      }
+    }
+    for (int t = 0; t < rows; t++) {
+      for (int j = 0; j < group; j++) {
+        int const qi = t * group + j;
+        int const h = item.kv_head * group + j;
+        float *y = output +
+                   (size_t)(req.token_offset + item.first_token + t) *
+                       output_stride +
+                   h * head_dim;
+        float const inv = 1.0f / row_sum[qi];
+        for (int d = 0; d < head_dim; d++) {
+          y[d] = acc[(size_t)qi * head_dim + d] * inv;
+        }
+      }
+    }
+  });
+}
+
+void tree_attention(float const *q,
+                    size_t q_stride,
+                    float const *key_cache,
+                    float const *value_cache,
+                    size_t cache_slot_stride,
+                    size_t cache_pos_stride,
+                    float *output,
+                    size_t output_stride,
+                    TreeAttentionRequest const *requests,
+                    int num_requests,
+                    int num_q_heads,
+                    int num_kv_heads,
+                    int head_dim,
+                    float scale,
+                    int num_threads) {
+  assert(num_q_heads % num_kv_heads == 0);
+  int const group = num_q_heads / num_kv_heads;
+  struct Item {
+    int request, kv_head, first_token;
+  };
+  std::vector<Item> items;
+  for (int r = 0; r < num_requests; r++) {
+    assert(requests[r].first_query_bit + requests[r].num_tokens <= 64);
+    for (int g = 0; g < num_kv_heads; g++) {
+      for (int t = 0; t < requests[r].num_tokens; t += ATTN_QUERY_BLOCK) {
+        items.push_back({r, g, t});
+      }
+    }
+  }
+  parallel_items((int)items.size(), num_threads, [&](int i) {
+    Item const &item = items[i];
+    TreeAttentionRequest const &req = requests[item.request];
+    int const rows =
+        std::min(ATTN_QUERY_BLOCK, req.num_tokens - item.first_token);
+    int const queries = rows * group;
+    int const shift = req.first_query_bit + item.first_token;
+    uint64_t const all_rows = (uint64_t(1) << rows) - 1;
+    float const *keys = key_cache + req.cache_slot * cache_slot_stride +
+                        (size_t)item.kv_head * head_dim;
+    float const *values = value_cache + req.cache_slot * cache_slot_stride +
+                          (size_t)item.kv_head * head_dim;
+    std::vector<float> row_max(queries, -INFINITY), row_sum(queries, 0.0f);
+    std::vector<float> acc((size_t)queries * head_dim, 0.0f);
+    // seen[k - k0]: bit t set iff row t of the block reads key k
+    uint64_t seen[ATTN_KEY_BLOCK];
+    float scores[ATTN_KEY_BLOCK];
+    int visible[ATTN_KEY_BLOCK];
+    for (int k0 = 0; k0 < req.num_keys; k0 += ATTN_KEY_BLOCK) {
+      int const k1 = std::min(req.num_keys, k0 + ATTN_KEY_BLOCK);
+      uint64_t any = 0;
+      for (int k = k0; k < k1; k++) {
+        uint64_t bits = all_rows;
+        if (k >= req.non_tree_cache_size) {
+          bits &= req.mask[k - req.non_tree_cache_size] >> shift;
+        }
+        seen[k - k0] = bits;
+        any |= bits;
+      }
+      if (any == 0) {
+        continue;
+      }
+      for (int t = 0; t < rows; t++) {
+        if (!((any >> t) & 1)) {
+          continue;
+        }
+        int num_visible = 0;
+        for (int k = k0; k < k1; k++) {
+          if ((seen[k - k0] >> t) & 1) {
+            visible[num_visible++] = k;
+          }
+        }
+        int const token = item.first_token + t;
+        for (int j = 0; j < group; j++) {
+          int const h = item.kv_head * group + j;
+          int const qi = t * group + j;
+          float const *qv =
+              q + (size_t)(req.token_offset + token) * q_stride + h * head_dim;
+          float block_max = -INFINITY;
+          for (int v = 0; v < num_visible; v++) {
+            scores[v] =
+                scale * dot(qv, keys + visible[v] * cache_pos_stride, head_dim);
+            block_max = std::max(block_max, scores[v]);
+          }
+          float const new_max = std::max(row_max[qi], block_max);
+          float const correction = std::exp(row_max[qi] - new_max);
+          float *out = acc.data() + (size_t)qi * head_dim;
+          row_sum[qi] *= correction;
+          for (int v = 0; v < num_visible; v++) {
+            float const p = std::exp(scores[v] - new_max);
+            row_sum[qi] += p;
+            scale_add(v == 0 ? correction : 1.0f,
+                      out,
+                      p,
+                      values + visible[v] * cache_pos_stride,
+                      head_dim);
+          }
+          row_max[qi] = new_max;
+        }
+      }
+    }
+    for (int t = 0; t < rows; t++) {
+      for (int j = 0; j < group; j++) {
+        int const qi = t * group + j;
+        int const h = item.kv_head * group + j;
+        float *y = output +
+                   (size_t)(req.token_offset + item.first_token + t) *
+                       output_stride +
+                   h * head_dim;
+        // A query that sees no key (an empty mask row) yields zeros
+        float const inv = row_sum[qi] > 0.0f ? 1.0f / row_sum[qi] : 0.0f;
+        for (int d = 0; d < head_dim; d++) {
+          y[d] = acc[(size_t)qi * head_dim + d] * inv;
+        }
+      }
+    }
+  });
+}
+
+float half_to_float(Half h) {
+  uint32_t const sign = (uint32_t)(h.bits & 0x8000) << 16;
+  uint32_t const exponent = (h.bits >> 10) & 0x1F;
+  uint32_t mantissa = h.bits & 0x3FF;
+  uint32_t bits;
+  if (exponent == 0x1F) {
+    bits = sign | 0x7F800000 | (mantissa << 13);
+  } else if (exponent != 0) {
+    bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+  } else if (mantissa == 0) {
+    bits = sign;
+  } else {
+    // Subnormal: renormalize into the fp32 exponent range
+    int shift = 0;
+    while (!(mantissa & 0x400)) {
+      mantissa <<= 1;
+      shift++;
+    }
+    bits = sign | ((uint32_t)(113 - shift) << 23) | ((mantissa & 0x3FF) << 13);
+  }
+  float x;
+  std::memcpy(&x, &bits, sizeof(x));
+  return x;
+}
+
+Half float_to_half(float x) {
+  uint32_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  uint32_t const sign = (bits >> 16) & 0x8000;
+  uint32_t const magnitude = bits & 0x7FFFFFFF;
+  Half h;
+  if (magnitude >= 0x7F800000) {
+    // Infinity, or a quiet NaN
+    h.bits = sign | 0x7C00 | (magnitude > 0x7F800000 ? 0x200 : 0);
+  } else if (magnitude >= 0x477FF000) {
+    // Rounds past the largest half (65504)
+    h.bits = sign | 0x7C00;
+  } else if (magnitude < 0x38800000) {
+    // Subnormal or zero: count units of 2^-24, rounding to nearest even
+    float y;
+    std::memcpy(&y, &magnitude, sizeof(y));
+    h.bits = sign | (uint16_t)std::nearbyint(y * 16777216.0f);
+  } else {
+    uint32_t const rounded = magnitude + 0xFFF + ((magnitude >> 13) & 1);
+    h.bits = sign | ((rounded - 0x38000000) >> 13);
+  }
+  return h;
+}
+
+void convert(Half const *input, float *output, size_t num_elements) {
+  size_t i = 0;
+  for (; i + VLEN <= num_elements; i += VLEN) {
+    vstore(output + i, vload(input + i));
+  }
+  for (; i < num_elements; i++) {
+    output[i] = half_to_float(input[i]);
+  }
+}
+
+void convert(float const *input, Half *output, size_t num_elements) {
+  size_t i = 0;
+  for (; i + VLEN <= num_elements; i += VLEN) {
+    vstore(output + i, vload(input + i));
+  }
+  for (; i < num_elements; i++) {
+    output[i] = float_to_half(input[i]);
+  }
+}
+
+template <typename T>
+void rms_norm_forward(T const *input,
+                      T const *weight,
+                      T *output,
+                      int dim,
+                      int num_rows,
+                      float eps,
+                      int num_threads) {
+  parallel_ranges(num_rows, num_threads, [&](int r0, int r1) {
+    for (int r = r0; r < r1; r++) {
+      T const *x = input + (size_t)r * dim;
+      T *y = output + (size_t)r * dim;
+      vfloat acc = vzero();
+      int i = 0;
+      for (; i + VLEN <= dim; i += VLEN) {
+        vfloat const v = vload(x + i);
+        acc = vfma(v, v, acc);
+      }
+      float sum = vsum(acc);
+      for (; i < dim; i++) {
+        sum += sload(x + i) * sload(x + i);
+      }
+      float const rms = 1.0f / std::sqrt(sum / dim + eps);
+      vfloat const vrms = vset1(rms);
+      for (i = 0; i + VLEN <= dim; i += VLEN) {
+        vstore(y + i, vmul(vmul(vload(x + i), vrms), vload(weight + i)));
+      }
+      for (; i < dim; i++) {
+        sstore(y + i, sload(x + i) * rms * sload(weight + i));
+      }
+    }
+  });
+}
+
+template <typename T>
+void residual_rms_norm_forward(T const *input1,
+                               T const *input2,
+                               T const *weight,
+                               T *residual_output,
+                               T *output,
+                               int dim,
+                               int num_rows,
+                               float eps,
+                               int num_threads) {
+  parallel_ranges(num_rows, num_threads, [&](int r0, int r1) {
+    for (int r = r0; r < r1; r++) {
+      size_t const offset = (size_t)r * dim;
+      T const *a = input1 + offset;
+      T const *b = input2 + offset;
+      T *x = residual_output + offset;
+      T *y = output + offset;
+      vfloat acc = vzero();
+      int i = 0;
+      for (; i + VLEN <= dim; i += VLEN) {
+        vfloat const v =
+            vstore_rounded(x + i, vadd(vload(a + i), vload(b + i)));
+        acc = vfma(v, v, acc);
+      }
+      float sum = vsum(acc);
+      for (; i < dim; i++) {
+        float const v = sstore_rounded(x + i, sload(a + i) + sload(b + i));
+        sum += v * v;
+      }
+      float const rms = 1.0f / std::sqrt(sum / dim + eps);
+      vfloat const vrms = vset1(rms);
+      for (i = 0; i + VLEN <= dim; i += VLEN) {
+        vstore(y + i, vmul(vmul(vload(x + i), vrms), vload(weight + i)));
+      }
+      for (; i < dim; i++) {
+        sstore(y + i, sload(x + i) * rms * sload(weight + i));
+      }
+    }
+  });
+}
+
+template <typename T>
+void residual_layer_norm_forward(T const *input,
+                                 T const *residual1,
+                                 T const *residual2,
+                                 T const *bias,
+                                 T const *gamma,
+                                 T const *beta,
+                                 T *residual_output,
+                                 T *output,
+                                 int dim,
+                                 int num_rows,
+                                 float eps,
+                                 int num_threads) {
+  parallel_ranges(num_rows, num_threads, [&](int r0, int r1) {
+    for (int r = r0; r < r1; r++) {
+      size_t const offset = (size_t)r * dim;
+      T const *in = input + offset;
+      T const *res1 = residual1 == nullptr ? nullptr : residual1 + offset;
+      T const *res2 = residual2 == nullptr ? nullptr : residual2 + offset;
+      T *x = residual_output + offset;
+      T *y = output + offset;
+      // Single pass over the inputs: sum and sum of squares together
+      vfloat acc1 = vzero(), acc2 = vzero();
+      int i = 0;
+      for (; i + VLEN <= dim; i += VLEN) {
+        vfloat v = vload(in + i);
+        if (res1 != nullptr) {
+          v = vadd(v, vload(res1 + i));
+        }
+        if (res2 != nullptr) {
+          v = vadd(v, vload(res2 + i));
+        }
+        if (bias != nullptr) {
+          v = vadd(v, vload(bias + i));
+        }
+        v = vstore_rounded(x + i, v);
+        acc1 = vadd(acc1, v);
+        acc2 = vfma(v, v, acc2);
+      }
+      float sum1 = vsum(acc1), sum2 = vsum(acc2);
+      for (; i < dim; i++) {
+        float v = sload(in + i);
+        if (res1 != nullptr) {
+          v += sload(res1 + i);
+        }
+        if (res2 != nullptr) {
+          v += sload(res2 + i);
+        }
+        if (bias != nullptr) {
+          v += sload(bias + i);
+        }
+        v = sstore_rounded(x + i, v);
+        sum1 += v;
+        sum2 += v * v;
+      }
+      float const mean = sum1 / dim;
+      float const var = std::max(sum2 / dim - mean * mean, 0.0f);
+      float const rstd = 1.0f / std::sqrt(var + eps);
+      // y = x * (rstd * gamma) + (beta - mean * rstd * gamma)
+      vfloat const vmean = vset1(mean), vrstd = vset1(rstd);
+      for (i = 0; i + VLEN <= dim; i += VLEN) {
+        vfloat const g =
+            gamma == nullptr ? vrstd : vmul(vrstd, vload(gamma + i));
+        vfloat const b = beta == nullptr ? vzero() : vload(beta + i);
+        vstore(y + i, vfma(vsub(vload(x + i), vmean), g, b));
+      }
+      for (; i < dim; i++) {
+        float const g = gamma == nullptr ? rstd : rstd * sload(gamma + i);
+        float const b = beta == nullptr ? 0.0f : sload(beta + i);
+        sstore(y + i, (sload(x + i) - mean) * g + b);
+      }
+    }
+  });
+}
+
+template <typename T>
+void sigmoid_silu_multi(T const *input1,
+                        T const *input2,
+                        T *output,
+                        size_t num_elements,
+                        int num_threads) {
+  // Split into cache-line multiples so threads never share a line of output
+  size_t const chunk = 1024;
+  int const num_chunks = (int)((num_elements + chunk - 1) / chunk);
+  parallel_ranges(num_chunks, num_threads, [&](int c0, int c1) {
+    size_t const end = std::min(num_elements, (size_t)c1 * chunk);
+    for (size_t i = (size_t)c0 * chunk; i < end; i++) {
+      float const x = sload(input1 + i);
+      sstore(output + i, x / (1.0f + std::exp(-x)) * sload(input2 + i));
+    }
+  });
+}
+
+template void rms_norm_forward<float>(float const *input,
+                                      float const *weight,
+                                      float *output,
+                                      int dim,
+                                      int num_rows,
+                                      float eps,
+                                      int num_threads);
+template void residual_rms_norm_forward<float>(float const *input1,
+                                               float const *input2,
+                                               float const *weight,
+                                               float *residual_output,
+                                               float *output,
+                                               int dim,
+                                               int num_rows,
+                                               float eps,
+                                               int num_threads);
+template void residual_layer_norm_forward<float>(float const *input,
+                                                 float const *residual1,
+                                                 float const *residual2,
+                                                 float const *bias,
+                                                 float const *gamma,
+                                                 float const *beta,
+                                                 float *residual_output,
+                                                 float *output,
+                                                 int dim,
+                                                 int num_rows,
+                                                 float eps,
+                                                 int num_threads);
+template void sigmoid_silu_multi<float>(float const *input1,
+                                        float const *input2,
+                                        float *output,
+                                        size_t num_elements,
+                                        int num_threads);
+template void rms_norm_forward<Half>(Half const *input,
+                                     Half const *weight,
+                                     Half *output,
+                                     int dim,
+                                     int num_rows,
+                                     float eps,
+                                     int num_threads);
+template void residual_rms_norm_forward<Half>(Half const *input1,
+                                              Half const *input2,
+                                              Half const *weight,
+                                              Half *residual_output,
+                                              Half *output,
+                                              int dim,
+                                              int num_rows,
+                                              float eps,
+                                              int num_threads);
+template void residual_layer_norm_forward<Half>(Half const *input,
+                                                Half const *residual1,
+                                                Half const *residual2,
+                                                Half const *bias,
+                                                Half const *gamma,
+                                                Half const *beta,
+                                                Half *residual_output,
+                                                Half *output,
+                                                int dim,
+                                                int num_rows,
+                                                float eps,
+                                                int num_threads);
+template void sigmoid_silu_multi<Half>(Half const *input1,
+                                       Half const *input2,
+                                       Half *output,
+                                       size_t num_elements,
+                                       int num_threads);
+
+template <typename T>
+void argmax(T const *input, int *indices, int vocab_size, int num_rows) {
+  for (int r = 0; r < num_rows; r++) {
+    T const *x = input + (size_t)r * vocab_size;
+    // Ties resolve to the smallest index, matching cub::ArgMax
+    int best = 0;
+    float best_value = sload(x);
+    for (int i = 1; i < vocab_size; i++) {
+      float const value = sload(x + i);
+      if (value > best_value) {
+        best = i;
+        best_value = value;
+      }
+    }
+    indices[r] = best;
+  }
+}
+
+template void argmax<float>(float const *input,
+                            int *indices,
+                            int vocab_size,
+                            int num_rows);
+template void argmax<Half>(Half const *input,
+                           int *indices,
+                           int vocab_size,
+                           int num_rows);
+
+template <typename T>
+void sampling_top_p(T const *probs,
+                    float const *uniforms,
+                    int *indices,
+                    int vocab_size,
+                    int num_rows,
+                    float top_p) {
+  std::vector<int> order(vocab_size);
+  for (int r = 0; r < num_rows; r++) {
+    T const *p = probs + (size_t)r * vocab_size;
+    auto more_likely = [p](int a, int b) {
+      float const pa = sload(p + a), pb = sload(p + b);
+      return pa > pb || (pa == pb && a < b);
+    };
+    for (int i = 0; i < vocab_size; i++) {
+      order[i] = i;
+    }
+    float const target = uniforms[r] * top_p;
+    float mass = 0.0f;
+    // Rounding can leave the mass short of the target; the least likely
+    // token is the fallback, as in the GPU kernel
+    indices[r] = -1;
+    for (int sorted = 0, k = std::min(vocab_size, 64); indices[r] < 0;
+         sorted = k, k = std::min(vocab_size, 2 * k)) {
+      std::partial_sort(order.begin() + sorted,
+                        order.begin() + k,
+                        order.end(),
+                        more_likely);
+      for (int j = sorted; j < k; j++) {
+        mass += sload(p + order[j]);
+        if (mass >= target || j == vocab_size - 1) {
+          indices[r] = order[j];
+          break;
+        }
+      }
+    }
+  }
+}
+
+template void sampling_top_p<float>(float const *probs,
+                                    float const *uniforms,
+                                    int *indices,
+                                    int vocab_size,
+                                    int num_rows,
+                                    float top_p);
+template void sampling_top_p<Half>(Half const *probs,
+                                   float const *uniforms,
+                                   int *indices,
+                                   int vocab_size,
+                                   int num_rows,
+                                   float top_p);
+
+template <typename IT, typename T>
+void embedding_lookup(IT const *indices,
+                      T const *weight,
+                      T *output,
+                      int in_dim,
+                      int out_dim,
+                      int batch_size,
+                      AggrMode aggr) {
+  // SUM and AVG reduce in fp32 and round once, when the row is stored
+  std::vector<float> acc(aggr == AGGR_MODE_NONE ? 0 : out_dim);
+  for (int b = 0; b < batch_size; b++) {
+    T *y = output + (size_t)b * out_dim;
+    if (aggr == AGGR_MODE_NONE) {
+      assert(in_dim == 1);
+      std::memcpy(
+          y, weight + (size_t)indices[b] * out_dim, sizeof(T) * out_dim);
+      continue;
+    }
+    std::fill(acc.begin(), acc.end(), 0.0f);
+    for (int k = 0; k < in_dim; k++) {
+      T const *w = weight + (size_t)indices[(size_t)b * in_dim + k] * out_dim;
+      int i = 0;
+      for (; i + VLEN <= out_dim; i += VLEN) {
+        vstore(&acc[i], vfma(vset1(1.0f), vload(w + i), vload(&acc[i])));
+      }
+      for (; i < out_dim; i++) {
+        acc[i] += sload(w + i);
+      }
+    }
+    float const scale = aggr == AGGR_MODE_AVG ? 1.0f / in_dim : 1.0f;
+    for (int i = 0; i < out_dim; i++) {
+      sstore(y + i, acc[i] * scale);
+    }
+  }
+}
+
+template void embedding_lookup<int32_t, float>(int32_t const *indices,
+                                               float const *weight,
+                                               float *output,
+                                               int in_dim,
+                                               int out_dim,
+                                               int batch_size,
+                                               AggrMode aggr);
+template void embedding_lookup<int64_t, float>(int64_t const *indices,
+                                               float const *weight,
+                                               float *output,
+                                               int in_dim,
+                                               int out_dim,
+                                               int batch_size,
+                                               AggrMode aggr);
+template void embedding_lookup<int32_t, Half>(int32_t const *indices,
+                                              Half const *weight,
+                                              Half *output,
+                                              int in_dim,
+                                              int out_dim,
+                                              int batch_size,
+                                              AggrMode aggr);
+template void embedding_lookup<int64_t, Half>(int64_t const *indices,
+                                              Half const *weight,
+                                              Half *output,
+                                              int in_dim,
+                                              int out_dim,
+                                              int batch_size,
+                                              AggrMode aggr);
+
+void moe_dispatch(int const *assign,
+                  int *slots,
+                  int *order,
+                  int *counts,
+                  int n,
+                  int k,
+                  int capacity,
+                  int batch_size) {
+  int const num_assignments = batch_size * k;
+  std::fill(counts, counts + n, 0);
+  for (int i = 0; i < num_assignments; i++) {
+    assert(assign[i] >= 0 && assign[i] < n);
+    slots[i] = counts[assign[i]]++;
+  }
+  if (order == nullptr) {
+    for (int i = 0; i < num_assignments; i++) {
+      if (slots[i] >= capacity) {
+        slots[i] = -1;
+      }
+    }
+    return;
+  }
+  // Exclusive prefix sum of the capped counts gives each expert's range
+  std::vector<int> offsets(n);
+  int total = 0;
+  for (int e = 0; e < n; e++) {
+    offsets[e] = total;
+    total += std::min(counts[e], capacity);
+  }
+  for (int i = 0; i < num_assignments; i++) {
+    if (slots[i] >= capacity) {
+      slots[i] = -1;
+    } else {
+      order[offsets[assign[i]] + slots[i]] = i;
+    }
+  }
+}
+
+void group_by_forward(float const *input,
+                      int const *assign,
+                      float *const *outputs,
+                      int *counts,
+                      int n,
+                      int k,
+                      int capacity,
+                      int batch_size,
+                      int data_dim,
+                      int num_threads) {
+  std::vector<int> slots((size_t)batch_size * k);
+  std::vector<int> order((size_t)batch_size * k);
+  moe_dispatch(
+      assign, slots.data(), order.data(), counts, n, k, capacity, batch_size);
+  std::vector<int> offsets(n + 1, 0);
+  for (int e = 0; e < n; e++) {
+    offsets[e + 1] = offsets[e] + std::min(counts[e], capacity);
+  }
+  // Routing is skewed, so experts are handed out one at a time
+  parallel_items(n, num_threads, [&](int e) {
+    float *y = outputs[e];
+    for (int p = offsets[e]; p < offsets[e + 1]; p++, y += data_dim) {
+      std::memcpy(y,
+                  input + (size_t)(order[p] / k) * data_dim,
+                  sizeof(float) * data_dim);
+    }
+  });
+}
+
+void aggregate_forward(float const *const *exp_preds,
+                       int const *assign,
+                       float const *gate_preds,
+                       float *output,
+                       int n,
+                       int k,
+                       int capacity,
+                       int batch_size,
+                       int out_dim,
+                       int num_threads) {
+  std::vector<int> slots((size_t)batch_size * k);
+  std::vector<int> counts(n);
+  moe_dispatch(
+      assign, slots.data(), nullptr, counts.data(), n, k, capacity, batch_size);
+  parallel_ranges(batch_size, num_threads, [&](int begin, int end) {
+    for (int t = begin; t < end; t++) {
+      float *y = output + (size_t)t * out_dim;
+      std::fill(y, y + out_dim, 0.0f);
+      for (int j = 0; j < k; j++) {
+        int const a = t * k + j;
+        if (slots[a] < 0) {
+          continue;
+        }
+        float const *x = exp_preds[assign[a]] + (size_t)slots[a] * out_dim;
+        vfloat const g = vset1(gate_preds[a]);
+        int i = 0;
+        for (; i + VLEN <= out_dim; i += VLEN) {
+          vstore(y + i, vfma(g, vload(x + i), vload(y + i)));
+        }
+        for (; i < out_dim; i++) {
+          y[i] += gate_preds[a] * x[i];
+        }
+      }
+    }
+  });
+}
+
+void experts_forward(float const *input,
+                     int const *indices,
+                     float const *topk_gate_preds,
+                     float *output,
+                     float const *weights,
+                     float const *biases,
+                     int *counts,
+                     int num_tokens,
+                     int k,
+                     int num_experts,
+                     int experts_start_idx,
+                     int capacity,
+                     int data_dim,
+                     int out_dim,
+                     int num_layers,
+                     int internal_dim,
+                     ActiMode activation,
+                     int num_threads) {
+  assert(num_layers == 1 || num_layers == 2);
+  int const num_assignments = num_tokens * k;
+  int const dim1 = num_layers == 1 ? out_dim : internal_dim;
+  size_t const weight_size =
+      num_layers == 1 ? (size_t)data_dim * out_dim
+                      : (size_t)internal_dim * (data_dim + out_dim);
+  int const bias_size = num_layers == 1 ? out_dim : internal_dim + out_dim;
+  // Experts of other blocks share an extra bucket, which sorts last and is
+  // never computed
+  std::vector<int> local(num_assignments);
+  for (int i = 0; i < num_assignments; i++) {
+    int const e = indices[i] - experts_start_idx;
+    local[i] = e >= 0 && e < num_experts ? e : num_experts;
+  }
+  std::vector<int> slots(num_assignments), order(num_assignments);
+  std::vector<int> bucket_counts(num_experts + 1);
+  moe_dispatch(local.data(),
+               slots.data(),
+               order.data(),
+               bucket_counts.data(),
+               num_experts + 1,
+               k,
+               capacity,
+               num_tokens);
+  std::vector<int> offsets(num_experts + 1, 0);
+  for (int e = 0; e < num_experts; e++) {
+    offsets[e + 1] = offsets[e] + std::min(bucket_counts[e], capacity);
+  }
+  if (counts != nullptr) {
+    std::copy(bucket_counts.begin(), bucket_counts.end() - 1, counts);
+  }
+  int const num_rows = offsets[num_experts];
+
+  // Ragged batch: the kept tokens of each expert are packed back to back,
+  // so every expert is one GEMM over its rows instead of one GEMV per token
+  std::vector<float> packed((size_t)num_rows * data_dim);
+  std::vector<float> hidden((size_t)num_rows * dim1);
+  std::vector<float> results(num_layers == 1 ? 0 : (size_t)num_rows * out_dim);
+  float *expert_outputs = num_layers == 1 ? hidden.data() : results.data();
+  struct Tile {
+    int expert, row, num_rows;
+  };
+  std::vector<Tile> tiles;
+  for (int e = 0; e < num_experts; e++) {
+    for (int r = offsets[e]; r < offsets[e + 1]; r += LINEAR_BLOCK_ROWS) {
+      tiles.push_back({e, r, std::min(LINEAR_BLOCK_ROWS, offsets[e + 1] - r)});
+    }
+  }
+  // Tiles of all experts go to the threads in one pass, so a hot expert is
+  // split across threads while cold ones are not padded to its size
+  parallel_items((int)tiles.size(), num_threads, [&](int i) {
+    Tile const &tile = tiles[i];
+    float *x = packed.data() + (size_t)tile.row * data_dim;
+    for (int r = 0; r < tile.num_rows; r++) {
+      std::memcpy(x + (size_t)r * data_dim,
+                  input + (size_t)(order[tile.row + r] / k) * data_dim,
+                  sizeof(float) * data_dim);
+    }
+    float const *w = weights + tile.expert * weight_size;
+    float const *b =
+        biases == nullptr ? nullptr : biases + tile.expert * bias_size;
+    float *h = hidden.data() + (size_t)tile.row * dim1;
+    linear_forward(x, w, b, h, data_dim, dim1, tile.num_rows, activation);
+    if (num_layers == 2) {
+      linear_forward(h,
+                     w + (size_t)data_dim * internal_dim,
+                     b == nullptr ? nullptr : b + internal_dim,
+                     results.data() + (size_t)tile.row * out_dim,
+                     internal_dim,
+                     out_dim,
+                     tile.num_rows,
+                     activation);
+    }
+  });
+
+  parallel_ranges(num_tokens, num_threads, [&](int begin, int end) {
+    for (int t = begin; t < end; t++) {
+      float *y = output + (size_t)t * out_dim;
+      std::fill(y, y + out_dim, 0.0f);
+      for (int j = 0; j < k; j++) {
+        int const a = t * k + j;
+        if (local[a] == num_experts || slots[a] < 0) {
+          continue;
+        }
+        float const *x =
+            expert_outputs + (size_t)(offsets[local[a]] + slots[a]) * out_dim;
+        vfloat const g = vset1(topk_gate_preds[a]);
+        int i = 0;
+        for (; i + VLEN <= out_dim; i += VLEN) {
+          vstore(y + i, vfma(g, vload(x + i), vload(y + i)));
+        }
+        for (; i < out_dim; i++) {
+          y[i] += topk_gate_preds[a] * x[i];
+        }
+      }
+    }
+  });
+}
+
+} // namespace CPU
+} // namespace Kernels
+} // namespace FlexFlow
@@ -24,7 +24,7 @@ LinearMeta::LinearMeta(FFHandler handler,
                        Linear const *li,
                        MemoryAllocator gpu_mem_allocator,
                        int weightSize)
-    : OpMeta(handler, li) {
+    : OpMeta(handler, li), cpu_packed_source(nullptr) {
   // Allocate an all-one's vector
   float *dram_one_ptr = (float *)malloc(sizeof(float) * batch_size);
   for (int i = 0; i < batch_size; i++) {
@@ -25,7 +25,7 @@ LinearMeta::LinearMeta(FFHandler handler,
                        Linear const *li,
                        MemoryAllocator gpu_mem_allocator,
                        int weightSize)
-    : OpMeta(handler, li), weight_ptr(nullptr) {
+    : OpMeta(handler, li), weight_ptr(nullptr), cpu_packed_source(nullptr) {
   DataType data_type = li->data_type;
   // allocate weight and bias in the reserve space for cpu offloading
   if (li->offload) {
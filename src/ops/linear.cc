@@ -2,6 +2,7 @@
 #include "flexflow/ffconst_utils.h"
 #include "flexflow/layer.h"
 #include "flexflow/model.h"
+#include "flexflow/ops/kernels/cpu_kernels.h"
 #include "flexflow/ops/kernels/linear_kernels.h"
 #include "flexflow/utils/hash_utils.h"
 #include "legion/legion_utilities.h"
@@ -670,6 +671,157 @@ void Linear::inference_task(Task const *task,
   }
 }
 
+/*
+  regions[0](I): input
+  regions[1](O): output
+  regions[2](I): kernel
+  regions[3](I): bias
+*/
+void Linear::inference_task_cpu(Task const *task,
+                                std::vector<PhysicalRegion> const &regions,
+                                Context ctx,
+                                Runtime *runtime) {
+  LinearMeta *m = *((LinearMeta **)task->local_args);
+  BatchConfig const *bc = BatchConfig::from_future(task->futures[0]);
+  if (bc->num_tokens == 0) {
+    return;
+  }
+  assert(regions.size() == (3 + static_cast<size_t>(m->use_bias)));
+  assert(task->regions.size() == (3 + static_cast<size_t>(m->use_bias)));
+  // The CPU variant covers fp32 or fp16 activations with weights of the
+  // same type, or INT4/INT8 weights whose scales and offsets are fp32
+  // (--use-full-precision)
+  using Kernels::CPU::Half;
+  assert(m->input_type[0] == m->output_type[0]);
+  if (m->quantization_type == DT_NONE) {
+    assert(m->input_type[0] == DT_FLOAT || m->input_type[0] == DT_HALF);
+    assert(m->weight_type[0] == m->input_type[0]);
+  } else {
+    assert(m->input_type[0] == DT_FLOAT);
+  }
+
+  GenericTensorAccessorR input = helperGetGenericTensorAccessorRO(
+      m->input_type[0], regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  GenericTensorAccessorW output = helperGetGenericTensorAccessorWO(
+      m->output_type[0], regions[1], task->regions[1], FID_DATA, ctx, runtime);
+  GenericTensorAccessorR weight = helperGetGenericTensorAccessorRO(
+      m->weight_type[0], regions[2], task->regions[2], FID_DATA, ctx, runtime);
+  int in_dim = input.domain.hi()[0] - input.domain.lo()[0] + 1;
+  int out_dim = output.domain.hi()[0] - output.domain.lo()[0] + 1;
+  if (m->quantization_type == DT_NONE) {
+    assert(weight.domain.get_volume() ==
+           static_cast<size_t>(in_dim) * static_cast<size_t>(out_dim));
+  } else {
+    assert(weight.domain.get_volume() ==
+           get_quantization_to_byte_size(
+               DT_FLOAT, m->quantization_type, in_dim) *
+               static_cast<size_t>(out_dim));
+  }
+
+  int batch_size = bc->num_active_tokens();
+  float const *bias_ptr = nullptr;
+  std::vector<float> half_bias;
+  if (m->use_bias &&
+      !(m->add_bias_only_once && task->index_point.point_data[0] != 0)) {
+    GenericTensorAccessorR bias =
+        helperGetGenericTensorAccessorRO(m->weight_type[1],
+                                         regions[3],
+                                         task->regions[3],
+                                         FID_DATA,
+                                         ctx,
+                                         runtime);
+    assert(bias.domain.get_volume() == static_cast<size_t>(out_dim));
+    if (m->weight_type[1] == DT_HALF) {
+      half_bias.resize(out_dim);
+      Kernels::CPU::convert(
+          static_cast<Half const *>(bias.ptr), half_bias.data(), out_dim);
+      bias_ptr = half_bias.data();
+    } else {
+      bias_ptr = bias.get_float_ptr();
+    }
+  }
+  if (m->quantization_type != DT_NONE) {
+    // Computes on the quantized bytes directly; there is no decompressed
+    // copy of the weight on this path
+    Kernels::CPU::linear_forward_quantized(input.get_float_ptr(),
+                                           weight.get_byte_ptr(),
+                                           bias_ptr,
+                                           output.get_float_ptr(),
+                                           in_dim,
+                                           out_dim,
+                                           batch_size,
+                                           m->quantization_type,
+                                           m->activation,
+                                           m->handle.cpu_kernel_threads);
+    return;
+  }
+  // Half weights are always packed: the panels are fp32, which is what the
+  // micro-kernel reads
+  if (!m->handle.cpu_weight_packing && m->weight_type[0] == DT_FLOAT) {
+    Kernels::CPU::linear_forward(input.get_float_ptr(),
+                                 weight.get_float_ptr(),
+                                 bias_ptr,
+                                 output.get_float_ptr(),
+                                 in_dim,
+                                 out_dim,
+                                 batch_size,
+                                 m->activation);
+    return;
+  }
+  float const *packed_weight = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(m->cpu_pack_mutex);
+    if (m->cpu_packed_source != weight.ptr) {
+      m->cpu_packed_weight.resize(
+          Kernels::CPU::packed_linear_weight_size(in_dim, out_dim));
+      if (m->weight_type[0] == DT_HALF) {
+        Kernels::CPU::pack_linear_weight(static_cast<Half const *>(weight.ptr),
+                                         m->cpu_packed_weight.data(),
+                                         in_dim,
+                                         out_dim);
+      } else {
+        Kernels::CPU::pack_linear_weight(weight.get_float_ptr(),
+                                         m->cpu_packed_weight.data(),
+                                         in_dim,
+                                         out_dim);
+      }
+      m->cpu_packed_source = weight.ptr;
+    }
+    packed_weight = m->cpu_packed_weight.data();
+  }
+  if (m->input_type[0] == DT_FLOAT) {
+    Kernels::CPU::linear_forward_packed(input.get_float_ptr(),
+                                        packed_weight,
+                                        bias_ptr,
+                                        output.get_float_ptr(),
+                                        in_dim,
+                                        out_dim,
+                                        batch_size,
+                                        m->activation,
+                                        m->handle.cpu_kernel_threads);
+    return;
+  }
+  // fp16 activations are widened to fp32 rows, and the output is rounded
+  // once, after the bias and activation
+  std::vector<float> input_rows((size_t)in_dim * batch_size);
+  std::vector<float> output_rows((size_t)out_dim * batch_size);
+  Kernels::CPU::convert(static_cast<Half const *>(input.ptr),
+                        input_rows.data(),
+                        input_rows.size());
+  Kernels::CPU::linear_forward_packed(input_rows.data(),
+                                      packed_weight,
+                                      bias_ptr,
+                                      output_rows.data(),
+                                      in_dim,
+                                      out_dim,
+                                      batch_size,
+                                      m->activation,
+                                      m->handle.cpu_kernel_threads);
+  Kernels::CPU::convert(output_rows.data(),
+                        static_cast<Half *>(output.ptr),
+                        output_rows.size());
+}
+
 void Linear::forward_task(Task const *task,
                           std::vector<PhysicalRegion> const &regions,
                           Context ctx,
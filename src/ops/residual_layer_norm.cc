@@ -15,6 +15,7 @@
 
 #include "flexflow/ops/residual_layer_norm.h"
 #include "flexflow/model.h"
+#include "flexflow/ops/kernels/cpu_kernels.h"
 #include "flexflow/utils/hash_utils.h"
 #include "legion/legion_utilities.h"
 
@@ -764,6 +765,142 @@ void ResidualLayerNorm::inference_task(
   }
 }
 
+template <typename T>
+static void residual_layer_norm_cpu(ResidualLayerNormMeta const *m,
+                                    int num_rows,
+                                    GenericTensorAccessorR const &input,
+                                    GenericTensorAccessorR const &residual1,
+                                    GenericTensorAccessorR const &residual2,
+                                    GenericTensorAccessorW const &added_output,
+                                    GenericTensorAccessorW const &output,
+                                    GenericTensorAccessorR const &gamma,
+                                    GenericTensorAccessorR const &beta) {
+  // Optional tensors have a null ptr when absent
+  Kernels::CPU::residual_layer_norm_forward(
+      static_cast<T const *>(input.ptr),
+      static_cast<T const *>(residual1.ptr),
+      static_cast<T const *>(residual2.ptr),
+      static_cast<T const *>(nullptr),
+      static_cast<T const *>(gamma.ptr),
+      static_cast<T const *>(beta.ptr),
+      static_cast<T *>(added_output.ptr),
+      static_cast<T *>(output.ptr),
+      m->effective_num_elements,
+      num_rows,
+      m->eps,
+      m->handle.cpu_kernel_threads);
+}
+
+void ResidualLayerNorm::inference_task_cpu(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  assert(task->regions.size() == regions.size());
+  BatchConfig const *bc = BatchConfig::from_future(task->futures[0]);
+  if (bc->num_tokens == 0) {
+    return;
+  }
+  ResidualLayerNormMeta *m = *((ResidualLayerNormMeta **)task->local_args);
+  assert(regions.size() ==
+         4 + m->use_two_residuals +
+             (m->elementwise_affine ? (m->use_bias ? 2 : 1) : 0));
+  assert(m->input_type[0] == m->output_type[0]);
+
+  int region_idx = 0;
+  GenericTensorAccessorR input =
+      helperGetGenericTensorAccessorRO(m->input_type[0],
+                                       regions[region_idx],
+                                       task->regions[region_idx],
+                                       FID_DATA,
+                                       ctx,
+                                       runtime);
+  region_idx++;
+  GenericTensorAccessorR residual1 =
+      helperGetGenericTensorAccessorRO(m->input_type[1],
+                                       regions[region_idx],
+                                       task->regions[region_idx],
+                                       FID_DATA,
+                                       ctx,
+                                       runtime);
+  region_idx++;
+  GenericTensorAccessorR residual2;
+  if (m->use_two_residuals) {
+    residual2 = helperGetGenericTensorAccessorRO(m->input_type[2],
+                                                 regions[region_idx],
+                                                 task->regions[region_idx],
+                                                 FID_DATA,
+                                                 ctx,
+                                                 runtime);
+    region_idx++;
+  }
+  GenericTensorAccessorW added_output =
+      helperGetGenericTensorAccessorWO(m->output_type[0],
+                                       regions[region_idx],
+                                       task->regions[region_idx],
+                                       FID_DATA,
+                                       ctx,
+                                       runtime);
+  region_idx++;
+  GenericTensorAccessorW output =
+      helperGetGenericTensorAccessorWO(m->output_type[1],
+                                       regions[region_idx],
+                                       task->regions[region_idx],
+                                       FID_DATA,
+                                       ctx,
+                                       runtime);
+  region_idx++;
+  GenericTensorAccessorR gamma, beta;
+  if (m->elementwise_affine) {
+    gamma = helperGetGenericTensorAccessorRO(m->weight_type[0],
+                                             regions[region_idx],
+                                             task->regions[region_idx],
+                                             FID_DATA,
+                                             ctx,
+                                             runtime);
+    region_idx++;
+    assert(gamma.domain.get_volume() == m->effective_num_elements);
+    if (m->use_bias) {
+      beta = helperGetGenericTensorAccessorRO(m->weight_type[1],
+                                              regions[region_idx],
+                                              task->regions[region_idx],
+                                              FID_DATA,
+                                              ctx,
+                                              runtime);
+      region_idx++;
+    }
+  }
+  assert(input.domain.get_volume() ==
+         m->effective_num_elements * m->effective_batch_size);
+
+  // Rows past the active tokens hold stale data and are skipped
+  int num_rows = std::min(bc->num_active_tokens(),
+                          static_cast<int>(m->effective_batch_size));
+  if (m->input_type[0] == DT_FLOAT) {
+    residual_layer_norm_cpu<float>(m,
+                                   num_rows,
+                                   input,
+                                   residual1,
+                                   residual2,
+                                   added_output,
+                                   output,
+                                   gamma,
+                                   beta);
+  } else if (m->input_type[0] == DT_HALF) {
+    residual_layer_norm_cpu<Kernels::CPU::Half>(m,
+                                                num_rows,
+                                                input,
+                                                residual1,
+                                                residual2,
+                                                added_output,
+                                                output,
+                                                gamma,
+                                                beta);
+  } else {
+    assert(false && "Unsupported data type");
+  }
+}
+
 bool ResidualLayerNorm::measure_operator_cost(Simulator *sim,
                                               MachineView const &mv,
                                               CostMetrics &cost_metrics) const {
@@ -15,6 +15,7 @@
 
 #include "flexflow/ops/residual_rms_norm.h"
 #include "flexflow/model.h"
+#include "flexflow/ops/kernels/cpu_kernels.h"
 #include "flexflow/ops/kernels/residual_rms_norm_kernels.h"
 #include "flexflow/utils/hash_utils.h"
 #include "legion/legion_utilities.h"
@@ -456,6 +457,61 @@ void ResidualRMSNorm::inference_task(Task const *task,
   }
 }
 
+void ResidualRMSNorm::inference_task_cpu(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  assert(task->regions.size() == 5);
+  assert(regions.size() == 5);
+  BatchConfig const *bc = BatchConfig::from_future(task->futures[0]);
+  if (bc->num_tokens == 0) {
+    return;
+  }
+  ResidualRMSNormMeta *m = *((ResidualRMSNormMeta **)task->local_args);
+  assert(m->input_type[0] == m->input_type[1]);
+  assert(m->input_type[0] == m->output_type[0]);
+  assert(m->input_type[0] == m->weight_type[0]);
+  GenericTensorAccessorR input1 = helperGetGenericTensorAccessorRO(
+      m->input_type[0], regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  GenericTensorAccessorR input2 = helperGetGenericTensorAccessorRO(
+      m->input_type[1], regions[1], task->regions[1], FID_DATA, ctx, runtime);
+  GenericTensorAccessorW residual_output = helperGetGenericTensorAccessorWO(
+      m->output_type[0], regions[2], task->regions[2], FID_DATA, ctx, runtime);
+  GenericTensorAccessorW output = helperGetGenericTensorAccessorWO(
+      m->output_type[1], regions[3], task->regions[3], FID_DATA, ctx, runtime);
+  GenericTensorAccessorR weight = helperGetGenericTensorAccessorRO(
+      m->weight_type[0], regions[4], task->regions[4], FID_DATA, ctx, runtime);
+  assert(weight.domain.get_volume() == static_cast<size_t>(m->in_dim));
+  // Rows past the active tokens hold stale data and are skipped
+  int num_rows = std::min(bc->num_active_tokens(), m->batch_size);
+  if (m->input_type[0] == DT_FLOAT) {
+    Kernels::CPU::residual_rms_norm_forward(input1.get_float_ptr(),
+                                            input2.get_float_ptr(),
+                                            weight.get_float_ptr(),
+                                            residual_output.get_float_ptr(),
+                                            output.get_float_ptr(),
+                                            m->in_dim,
+                                            num_rows,
+                                            m->eps,
+                                            m->handle.cpu_kernel_threads);
+  } else if (m->input_type[0] == DT_HALF) {
+    using Kernels::CPU::Half;
+    Kernels::CPU::residual_rms_norm_forward(
+        static_cast<Half const *>(input1.ptr),
+        static_cast<Half const *>(input2.ptr),
+        static_cast<Half const *>(weight.ptr),
+        static_cast<Half *>(residual_output.ptr),
+        static_cast<Half *>(output.ptr),
+        m->in_dim,
+        num_rows,
+        m->eps,
+        m->handle.cpu_kernel_threads);
+  } else {
+    assert(false && "Unsupported data type");
+  }
+}
+
 void ResidualRMSNorm::serialize(Legion::Serializer &sez) const {
   sez.serialize(this->layer_guid.id);
   sez.serialize(this->layer_guid.transformer_layer_id);
@@ -15,6 +15,7 @@
 
 #include "flexflow/ops/sampling.h"
 #include "flexflow/model.h"
+#include "flexflow/ops/kernels/cpu_kernels.h"
 #include "flexflow/utils/hash_utils.h"
 #include "legion/legion_utilities.h"
 #if defined(FF_USE_CUDA) || defined(FF_USE_HIP_CUDA)
@@ -321,6 +322,57 @@ InferenceResult
   return ir;
 }
 
+InferenceResult
+    Sampling::inference_task_cpu(Task const *task,
+                                 std::vector<PhysicalRegion> const &regions,
+                                 Context ctx,
+                                 Runtime *runtime) {
+  assert(regions.size() == 2);
+  assert(task->regions.size() == 2);
+  BatchConfig const *bc = BatchConfig::from_future(task->futures[0]);
+  SamplingMeta *m = *((SamplingMeta **)task->local_args);
+  InferenceResult ir;
+  if (bc->num_tokens == 0) {
+    return ir;
+  }
+  assert(m->input_type[0] == DT_FLOAT || m->input_type[0] == DT_HALF);
+  GenericTensorAccessorR input = helperGetGenericTensorAccessorRO(
+      m->input_type[0], regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  GenericTensorAccessorW indices = helperGetGenericTensorAccessorWO(
+      DT_INT32, regions[1], task->regions[1], FID_DATA, ctx, runtime);
+  int vocab_size = input.domain.hi()[0] - input.domain.lo()[0] + 1;
+  int batch_size = bc->num_active_tokens();
+  std::vector<float> uniforms(batch_size);
+  {
+    std::lock_guard<std::mutex> lock(m->cpu_mutex);
+    std::uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    for (float &u : uniforms) {
+      u = uniform(m->cpu_generator);
+    }
+  }
+  if (m->input_type[0] == DT_HALF) {
+    Kernels::CPU::sampling_top_p(
+        static_cast<Kernels::CPU::Half const *>(input.ptr),
+        uniforms.data(),
+        indices.get_int32_ptr(),
+        vocab_size,
+        batch_size,
+        m->top_p);
+  } else {
+    Kernels::CPU::sampling_top_p(input.get_float_ptr(),
+                                 uniforms.data(),
+                                 indices.get_int32_ptr(),
+                                 vocab_size,
+                                 batch_size,
+                                 m->top_p);
+  }
+  // The indices live in host memory, so no download is needed
+  std::copy(indices.get_int32_ptr(),
+            indices.get_int32_ptr() + batch_size,
+            ir.token_ids);
+  return ir;
+}
+
 void Sampling::backward(FFModel const &ff) {
   // Sampling does not support backward
   assert(false);
@@ -15,6 +15,7 @@
 
 #include "flexflow/ops/sigmoid_silu_multi.h"
 #include "flexflow/model.h"
+#include "flexflow/ops/kernels/cpu_kernels.h"
 #include "flexflow/utils/hash_utils.h"
 #include "legion/legion_utilities.h"
 
@@ -359,6 +360,51 @@ void SigmoidSiluMulti::inference_task(
   }
 }
 
+void SigmoidSiluMulti::inference_task_cpu(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  assert(task->regions.size() == regions.size());
+  assert(regions.size() == 3);
+  BatchConfig const *bc = BatchConfig::from_future(task->futures[0]);
+  if (bc->num_tokens == 0) {
+    return;
+  }
+  SigmoidSiluMultiMeta *m = *((SigmoidSiluMultiMeta **)task->local_args);
+  assert(m->input_type[0] == m->input_type[1]);
+  assert(m->input_type[0] == m->output_type[0]);
+
+  GenericTensorAccessorR input1 = helperGetGenericTensorAccessorRO(
+      m->input_type[0], regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  GenericTensorAccessorR input2 = helperGetGenericTensorAccessorRO(
+      m->input_type[1], regions[1], task->regions[1], FID_DATA, ctx, runtime);
+  GenericTensorAccessorW output = helperGetGenericTensorAccessorWO(
+      m->output_type[0], regions[2], task->regions[2], FID_DATA, ctx, runtime);
+  assert(input1.domain == input2.domain);
+  assert(input1.domain == output.domain);
+
+  size_t dim = input1.domain.hi()[0] - input1.domain.lo()[0] + 1;
+  size_t num_elements = std::min(input1.domain.get_volume(),
+                                 dim * bc->num_active_tokens());
+  if (m->input_type[0] == DT_FLOAT) {
+    Kernels::CPU::sigmoid_silu_multi(input1.get_float_ptr(),
+                                     input2.get_float_ptr(),
+                                     output.get_float_ptr(),
+                                     num_elements,
+                                     m->handle.cpu_kernel_threads);
+  } else if (m->input_type[0] == DT_HALF) {
+    using Kernels::CPU::Half;
+    Kernels::CPU::sigmoid_silu_multi(static_cast<Half const *>(input1.ptr),
+                                     static_cast<Half const *>(input2.ptr),
+                                     static_cast<Half *>(output.ptr),
+                                     num_elements,
+                                     m->handle.cpu_kernel_threads);
+  } else {
+    assert(false && "Unsupported data type");
+  }
+}
+
 bool SigmoidSiluMulti::measure_operator_cost(Simulator *sim,
                                              MachineView const &mv,
                                              CostMetrics &cost_metrics) const {
@@ -16,6 +16,7 @@
 #include "flexflow/ops/spec_inc_multihead_self_attention.h"
 #include "flexflow/ffconst_utils.h"
 #include "flexflow/model.h"
+#include "flexflow/ops/kernels/cpu_kernels.h"
 #if defined(FF_USE_CUDA) || defined(FF_USE_HIP_CUDA)
 #include "flexflow/utils/cuda_helper.h"
 #else
@@ -792,6 +793,155 @@ void SpecIncMultiHeadSelfAttention::inference_task(
   }
 }
 
+/*
+  regions[0](I): input
+  regions[1](I): weight
+  regions[2](O): output
+  regions[3](I): bias (optional)
+*/
+void SpecIncMultiHeadSelfAttention::inference_task_cpu(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  assert(task->regions.size() == regions.size());
+  BeamSearchBatchConfig const &bc =
+      Future(task->futures[0]).get_result<BeamSearchBatchConfig>();
+  if (bc.num_tokens == 0) {
+    return;
+  }
+  SpecIncMultiHeadSelfAttentionMeta *m =
+      *((SpecIncMultiHeadSelfAttentionMeta **)task->local_args);
+  assert(((*m->qkv_bias || *m->final_bias) ? regions.size() == 4
+                                           : regions.size() == 3));
+  assert(m->input_type[0] == DT_FLOAT);
+  assert(m->weight_type[0] == DT_FLOAT);
+  assert(m->output_type[0] == DT_FLOAT);
+  assert(m->quantization_type == DT_NONE);
+  assert(m->qProjSize == m->kProjSize && m->kProjSize == m->vProjSize);
+  assert(task->index_point.get_dim() == 1);
+  int shard_id = task->index_point.point_data[0];
+
+  GenericTensorAccessorR input = helperGetGenericTensorAccessorRO(
+      m->input_type[0], regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  GenericTensorAccessorR weight = helperGetGenericTensorAccessorRO(
+      m->weight_type[0], regions[1], task->regions[1], FID_DATA, ctx, runtime);
+  GenericTensorAccessorW output = helperGetGenericTensorAccessorWO(
+      m->output_type[0], regions[2], task->regions[2], FID_DATA, ctx, runtime);
+  float const *bias_ptr = nullptr;
+  if (*m->qkv_bias || *m->final_bias) {
+    GenericTensorAccessorR biases =
+        helperGetGenericTensorAccessorRO(m->weight_type[1],
+                                         regions[3],
+                                         task->regions[3],
+                                         FID_DATA,
+                                         ctx,
+                                         runtime);
+    bias_ptr = biases.get_float_ptr();
+  }
+
+  IncMultiHeadSelfAttention::prepare_cpu_state(
+      m,
+      weight.get_float_ptr(),
+      BatchConfig::max_sequence_length() +
+          BatchConfig::MAX_SPEC_TREE_TOKEN_NUM);
+  int const head_dim = m->qProjSize;
+  int const kv_size = m->cpu_num_kv_heads * head_dim;
+  int const qkv_dim = m->hidden_size + 2 * kv_size;
+  int const attn_dim = m->vProjSize * m->num_q_heads;
+  int const num_tokens = bc.num_active_tokens();
+  std::vector<float> qkv(static_cast<size_t>(num_tokens) * qkv_dim);
+  IncMultiHeadSelfAttention::compute_qkv_cpu(
+      m, &bc, shard_id, input.get_float_ptr(), bias_ptr, qkv.data());
+
+  std::vector<Kernels::CPU::AttentionRequest> prompts;
+  std::vector<Kernels::CPU::TreeAttentionRequest> layers;
+  for (int i = 0; i < bc.max_requests_per_batch(); i++) {
+    BatchConfig::PerRequestInfo const &info = bc.requestsInfo[i];
+    if (bc.request_completed[i] || info.num_tokens_in_batch == 0) {
+      continue;
+    }
+    // The tokens of the current beam layer follow the prompt and the
+    // earlier layers of the speculated tree in the cache
+    BatchConfig::BitMask const &bitmask = bc.causalMask[i];
+    int const cache_size =
+        bitmask.non_tree_cache_size + bitmask.tree_size + bitmask.prompt_size;
+    for (int t = 0; t < info.num_tokens_in_batch; t++) {
+      int token = info.first_token_offset_in_batch + t;
+      IncMultiHeadSelfAttention::store_kv_cpu(
+          m,
+          qkv.data() + static_cast<size_t>(token) * qkv_dim,
+          i,
+          cache_size - 1 - bitmask.this_layer_size + t);
+    }
+    if (info.prompt_phase) {
+      Kernels::CPU::AttentionRequest r;
+      r.token_offset = info.first_token_offset_in_batch;
+      r.num_tokens = info.num_tokens_in_batch;
+      r.first_depth = info.first_token_depth_in_request;
+      r.cache_slot = i;
+      prompts.push_back(r);
+    } else {
+      int const branches = bc.beamRequestsInfo[i].sub_request_num;
+      Kernels::CPU::TreeAttentionRequest r;
+      r.token_offset = info.first_token_offset_in_batch;
+      r.num_tokens = branches;
+      r.num_keys = cache_size - 1;
+      r.non_tree_cache_size = bitmask.non_tree_cache_size;
+      r.first_query_bit =
+          bitmask.prompt_size + bitmask.tree_size - 1 - branches;
+      r.cache_slot = i;
+      r.mask = bitmask.mask;
+      layers.push_back(r);
+    }
+  }
+
+  std::vector<float> attn_heads(static_cast<size_t>(num_tokens) * attn_dim);
+  float scale = *m->qk_prod_scaling ? 1.0f / sqrtf(m->kProjSize) : 1.0f;
+  size_t const slot_stride = m->cpu_cache_length * kv_size;
+  // As on the GPU, position bias only applies to prompt tokens
+  std::vector<float> alibi_slopes =
+      IncMultiHeadSelfAttention::alibi_slopes_cpu(m, shard_id);
+  Kernels::CPU::causal_attention(
+      qkv.data(),
+      qkv_dim,
+      m->cpu_key_cache.data(),
+      m->cpu_value_cache.data(),
+      slot_stride,
+      kv_size,
+      attn_heads.data(),
+      attn_dim,
+      prompts.data(),
+      static_cast<int>(prompts.size()),
+      m->num_q_heads,
+      m->cpu_num_kv_heads,
+      head_dim,
+      scale,
+      *m->position_bias ? alibi_slopes.data() : nullptr,
+      m->handle.cpu_kernel_threads);
+  Kernels::CPU::tree_attention(qkv.data(),
+                               qkv_dim,
+                               m->cpu_key_cache.data(),
+                               m->cpu_value_cache.data(),
+                               slot_stride,
+                               kv_size,
+                               attn_heads.data(),
+                               attn_dim,
+                               layers.data(),
+                               static_cast<int>(layers.size()),
+                               m->num_q_heads,
+                               m->cpu_num_kv_heads,
+                               head_dim,
+                               scale,
+                               m->handle.cpu_kernel_threads);
+  IncMultiHeadSelfAttention::compute_o_prod_bias_cpu(m,
+                                                     shard_id,
+                                                     attn_heads.data(),
+                                                     bias_ptr,
+                                                     output.get_float_ptr(),
+                                                     num_tokens);
+}
+
 void SpecIncMultiHeadSelfAttention::backward(FFModel const &ff) {
   // SpecIncMultiHeadSelfAttention does not support backward
   assert(false);
@@ -16,6 +16,7 @@
 #include "flexflow/ops/tree_inc_multihead_self_attention.h"
 #include "flexflow/ffconst_utils.h"
 #include "flexflow/model.h"
+#include "flexflow/ops/kernels/cpu_kernels.h"
 #if defined(FF_USE_CUDA) || defined(FF_USE_HIP_CUDA)
 #include "flexflow/utils/cuda_helper.h"
 #else
@@ -873,6 +874,162 @@ void TreeIncMultiHeadSelfAttention::inference_task(
   }
 }
 
+/*
+  regions[0](I): input
+  regions[1](I): weight
+  regions[2](O): output
+  regions[3](I): bias (optional)
+*/
+void TreeIncMultiHeadSelfAttention::inference_task_cpu(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  assert(task->regions.size() == regions.size());
+  TreeVerifyBatchConfig const &bc =
+      Future(task->futures[0]).get_result<TreeVerifyBatchConfig>();
+  if (bc.num_tokens == 0) {
+    return;
+  }
+  TreeIncMultiHeadSelfAttentionMeta *m =
+      *((TreeIncMultiHeadSelfAttentionMeta **)task->local_args);
+  assert(((*m->qkv_bias || *m->final_bias) ? regions.size() == 4
+                                           : regions.size() == 3));
+  assert(m->input_type[0] == DT_FLOAT);
+  assert(m->weight_type[0] == DT_FLOAT);
+  assert(m->output_type[0] == DT_FLOAT);
+  assert(m->quantization_type == DT_NONE);
+  assert(m->qProjSize == m->kProjSize && m->kProjSize == m->vProjSize);
+  assert(task->index_point.get_dim() == 1);
+  int shard_id = task->index_point.point_data[0];
+
+  GenericTensorAccessorR input = helperGetGenericTensorAccessorRO(
+      m->input_type[0], regions[0], task->regions[0], FID_DATA, ctx, runtime);
+  GenericTensorAccessorR weight = helperGetGenericTensorAccessorRO(
+      m->weight_type[0], regions[1], task->regions[1], FID_DATA, ctx, runtime);
+  GenericTensorAccessorW output = helperGetGenericTensorAccessorWO(
+      m->output_type[0], regions[2], task->regions[2], FID_DATA, ctx, runtime);
+  float const *bias_ptr = nullptr;
+  if (*m->qkv_bias || *m->final_bias) {
+    GenericTensorAccessorR biases =
+        helperGetGenericTensorAccessorRO(m->weight_type[1],
+                                         regions[3],
+                                         task->regions[3],
+                                         FID_DATA,
+                                         ctx,
+                                         runtime);
+    bias_ptr = biases.get_float_ptr();
+  }
+
+  IncMultiHeadSelfAttention::prepare_cpu_state(
+      m,
+      weight.get_float_ptr(),
+      BatchConfig::max_sequence_length() +
+          BatchConfig::MAX_SPEC_TREE_TOKEN_NUM);
+  int const head_dim = m->qProjSize;
+  int const kv_size = m->cpu_num_kv_heads * head_dim;
+  int const qkv_dim = m->hidden_size + 2 * kv_size;
+  int const attn_dim = m->vProjSize * m->num_q_heads;
+
+  // Tokens accepted from the previous tree are moved from their slots in
+  // the previous batch to their final depths before the new tree reuses the
+  // positions after them
+  for (int i = 0; i < bc.num_tokens_to_commit; i++) {
+    auto const &info = bc.committed_tokens[i];
+    assert(info.token_index < m->num_active_tokens);
+    size_t row = static_cast<size_t>(info.token_index) * qkv_dim;
+    IncMultiHeadSelfAttention::store_kv_cpu(m,
+                                            m->cpu_last_qkv.data() + row,
+                                            info.request_index,
+                                            info.token_depth);
+  }
+
+  int const num_tokens = bc.num_active_tokens();
+  std::vector<float> qkv(static_cast<size_t>(num_tokens) * qkv_dim);
+  IncMultiHeadSelfAttention::compute_qkv_cpu(
+      m, &bc, shard_id, input.get_float_ptr(), bias_ptr, qkv.data());
+
+  std::vector<Kernels::CPU::AttentionRequest> prompts;
+  std::vector<Kernels::CPU::TreeAttentionRequest> trees;
+  for (int i = 0; i < bc.max_requests_per_batch(); i++) {
+    BatchConfig::PerRequestInfo const &info = bc.requestsInfo[i];
+    if (bc.request_completed[i] || info.num_tokens_in_batch == 0) {
+      continue;
+    }
+    // Tree tokens are cached contiguously after the committed prefix; their
+    // depths repeat across branches, so the position comes from the slot
+    for (int t = 0; t < info.num_tokens_in_batch; t++) {
+      int token = info.first_token_offset_in_batch + t;
+      IncMultiHeadSelfAttention::store_kv_cpu(
+          m,
+          qkv.data() + static_cast<size_t>(token) * qkv_dim,
+          i,
+          info.first_token_depth_in_request + t);
+    }
+    if (info.prompt_phase) {
+      Kernels::CPU::AttentionRequest r;
+      r.token_offset = info.first_token_offset_in_batch;
+      r.num_tokens = info.num_tokens_in_batch;
+      r.first_depth = info.first_token_depth_in_request;
+      r.cache_slot = i;
+      prompts.push_back(r);
+    } else {
+      Kernels::CPU::TreeAttentionRequest r;
+      r.token_offset = info.first_token_offset_in_batch;
+      r.num_tokens = info.num_tokens_in_batch;
+      r.num_keys = info.first_token_depth_in_request + info.num_tokens_in_batch;
+      r.non_tree_cache_size = bc.causalMask[i].non_tree_cache_size;
+      r.first_query_bit = 0;
+      r.cache_slot = i;
+      r.mask = bc.causalMask[i].mask;
+      trees.push_back(r);
+    }
+  }
+
+  std::vector<float> attn_heads(static_cast<size_t>(num_tokens) * attn_dim);
+  float scale = *m->qk_prod_scaling ? 1.0f / sqrtf(m->kProjSize) : 1.0f;
+  size_t const slot_stride = m->cpu_cache_length * kv_size;
+  Kernels::CPU::causal_attention(qkv.data(),
+                                 qkv_dim,
+                                 m->cpu_key_cache.data(),
+                                 m->cpu_value_cache.data(),
+                                 slot_stride,
+                                 kv_size,
+                                 attn_heads.data(),
+                                 attn_dim,
+                                 prompts.data(),
+                                 static_cast<int>(prompts.size()),
+                                 m->num_q_heads,
+                                 m->cpu_num_kv_heads,
+                                 head_dim,
+                                 scale,
+                                 nullptr,
+                                 m->handle.cpu_kernel_threads);
+  Kernels::CPU::tree_attention(qkv.data(),
+                               qkv_dim,
+                               m->cpu_key_cache.data(),
+                               m->cpu_value_cache.data(),
+                               slot_stride,
+                               kv_size,
+                               attn_heads.data(),
+                               attn_dim,
+                               trees.data(),
+                               static_cast<int>(trees.size()),
+                               m->num_q_heads,
+                               m->cpu_num_kv_heads,
+                               head_dim,
+                               scale,
+                               m->handle.cpu_kernel_threads);
+  IncMultiHeadSelfAttention::compute_o_prod_bias_cpu(m,
+                                                     shard_id,
+                                                     attn_heads.data(),
+                                                     bias_ptr,
+                                                     output.get_float_ptr(),
+                                                     num_tokens);
+  m->cpu_last_qkv.swap(qkv);
+  m->num_active_tokens = num_tokens;
+}
+
 void TreeIncMultiHeadSelfAttention::backward(FFModel const &ff) {
   // TreeIncMultiHeadSelfAttention does not support backward
   assert(false);
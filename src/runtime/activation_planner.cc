@@ -0,0 +1,87 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/activation_planner.h"
+#include <algorithm>
+#include <cassert>
+#include <functional>
+#include <map>
+#include <queue>
+#include <utility>
+
+namespace FlexFlow {
+
+ActivationPlan
+    plan_activation_memory(std::vector<ActivationInterval> const &tensors) {
+  ActivationPlan plan;
+  int num_arenas = 0;
+  for (ActivationInterval const &t : tensors) {
+    assert(t.first_op <= t.last_op);
+    assert(t.arena >= 0);
+    num_arenas = std::max(num_arenas, t.arena + 1);
+  }
+  plan.naive_bytes.assign(num_arenas, 0);
+  plan.reused_bytes.assign(num_arenas, 0);
+  for (ActivationInterval const &t : tensors) {
+    plan.naive_bytes[t.arena] += t.bytes;
+  }
+
+  // Buffer binding: walk the tensors in schedule order and release each
+  // buffer once the last reader of its current tensor has run
+  std::vector<int> order(tensors.size());
+  for (size_t i = 0; i < order.size(); i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    return tensors[a].first_op < tensors[b].first_op;
+  });
+  using Release = std::pair<int /*last_op*/, int /*buffer*/>;
+  std::priority_queue<Release, std::vector<Release>, std::greater<Release>>
+      busy;
+  std::map<std::pair<int, int>, std::vector<int>> free_buffers;
+  std::vector<std::pair<int, int>> buffer_key;
+  std::vector<int> buffer_arena;
+  plan.buffer.assign(tensors.size(), -1);
+  for (int t : order) {
+    ActivationInterval const &tensor = tensors[t];
+    while (!busy.empty() && busy.top().first < tensor.first_op) {
+      int b = busy.top().second;
+      busy.pop();
+      free_buffers[buffer_key[b]].push_back(b);
+    }
+    std::pair<int, int> key(tensor.arena, tensor.reuse_class);
+    std::vector<int> &candidates = free_buffers[key];
+    int b;
+    if (!candidates.empty()) {
+      // The most recently released buffer is the likeliest to be cached
+      b = candidates.back();
+      candidates.pop_back();
+      plan.buffer_bytes[b] = std::max(plan.buffer_bytes[b], tensor.bytes);
+    } else {
+      b = plan.buffer_bytes.size();
+      plan.buffer_bytes.push_back(tensor.bytes);
+      buffer_key.push_back(key);
+      buffer_arena.push_back(tensor.arena);
+    }
+    plan.buffer[t] = b;
+    busy.push(Release(tensor.last_op, b));
+  }
+  for (size_t b = 0; b < plan.buffer_bytes.size(); b++) {
+    plan.reused_bytes[buffer_arena[b]] += plan.buffer_bytes[b];
+  }
+  return plan;
+}
+
+}; // namespace FlexFlow
@@ -0,0 +1,627 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "flexflow/bpe_tokenizer.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <fstream>
+#include <functional>
+#include <nlohmann/json.hpp>
+#include <sstream>
+#include <thread>
+
+namespace FlexFlow {
+
+namespace {
+
+struct CodeRange {
+  uint32_t first, last;
+};
+
+// The letter and number classes of GPT_Tokenizer's pattern
+CodeRange const LETTER_RANGES[] = {
+    {0x0041, 0x005A}, {0x0061, 0x007A}, {0x00AA, 0x00AA}, {0x00B5, 0x00B5},
+    {0x00BA, 0x00BA}, {0x00C0, 0x00D6}, {0x00D8, 0x00F6}, {0x00F8, 0x02C1},
+    {0x02C6, 0x02D1}, {0x02E0, 0x02E4}, {0x02EC, 0x02EC}, {0x02EE, 0x02EE},
+    {0x0370, 0x0374}, {0x0376, 0x0377}, {0x037A, 0x037D}, {0x037F, 0x037F},
+    {0x0386, 0x0386}, {0x0388, 0x038A}, {0x038C, 0x038C}, {0x038E, 0x03A1},
+    {0x03A3, 0x03F5}, {0x03F7, 0x0481}, {0x048A, 0x052F}, {0x0531, 0x0556},
+    {0x0559, 0x0559}, {0x0560, 0x0588}, {0x05D0, 0x05EA}, {0x05EF, 0x05F2},
+    {0x0620, 0x064A}, {0x066E, 0x066F}, {0x0671, 0x06D3}, {0x06D5, 0x06D5},
+    {0x06E5, 0x06E6}, {0x06EE, 0x06EF}, {0x06FA, 0x06FC}, {0x06FF, 0x06FF},
+    {0x0710, 0x0710}, {0x0712, 0x072F}, {0x074D, 0x07A5}, {0x07B1, 0x07B1},
+    {0x07CA, 0x07EA}, {0x07F4, 0x07F5}, {0x07FA, 0x07FA}, {0x0800, 0x0815},
+    {0x081A, 0x081A}, {0x0824, 0x0824}, {0x0828, 0x0828}, {0x0840, 0x0858},
+    {0x0860, 0x086A}, {0x08A0, 0x08B4}, {0x08B6, 0x08C7}, {0x0904, 0x0939},
+    {0x093D, 0x093D}, {0x0950, 0x0950}, {0x0958, 0x0961}, {0x0971, 0x0980},
+    {0x0985, 0x098C}, {0x098F, 0x0990}, {0x0993, 0x09A8}, {0x09AA, 0x09B0},
+    {0x09B2, 0x09B2}, {0x09B6, 0x09B9}, {0x09BD, 0x09BD}, {0x09CE, 0x09CE},
+    {0x09DC, 0x09DD}, {0x09DF, 0x09E1}, {0x09F0, 0x09F1}, {0x09FC, 0x09FC},
+    {0x0A05, 0x0A0A}, {0x0A0F, 0x0A10}, {0x0A13, 0x0A28}, {0x0A2A, 0x0A30},
+    {0x0A32, 0x0A33}, {0x0A35, 0x0A36}, {0x0A38, 0x0A39}, {0x0A59, 0x0A5C},
+    {0x0A5E, 0x0A5E}, {0x0A72, 0x0A74}, {0x0A85, 0x0A8D}, {0x0A8F, 0x0A91},
+    {0x0A93, 0x0AA8}, {0x0AAA, 0x0AB0}, {0x0AB2, 0x0AB3}, {0x0AB5, 0x0AB9},
+    {0x0ABD, 0x0ABD}, {0x0AD0, 0x0AD0}, {0x0AE0, 0x0AE1}, {0x0AF9, 0x0AF9},
+    {0x0B05, 0x0B0C}, {0x0B0F, 0x0B10}, {0x0B13, 0x0B28}, {0x0B2A, 0x0B30},
+    {0x0B32, 0x0B33}, {0x0B35, 0x0B39}, {0x0B3D, 0x0B3D}, {0x0B5C, 0x0B5D},
+    {0x0B5F, 0x0B61}, {0x0B71, 0x0B71}, {0x0B83, 0x0B83}, {0x0B85, 0x0B8A},
+    {0x0B8E, 0x0B90}, {0x0B92, 0x0B95}, {0x0B99, 0x0B9A}, {0x0B9C, 0x0B9C},
+    {0x0B9E, 0x0B9F}, {0x0BA3, 0x0BA4}, {0x0BA8, 0x0BAA}, {0x0BAE, 0x0BB9},
+    {0x0BD0, 0x0BD0}, {0x0C05, 0x0C0C}, {0x0C0E, 0x0C10}, {0x0C12, 0x0C28},
+    {0x0C2A, 0x0C39}, {0x0C3D, 0x0C3D}, {0x0C58, 0x0C5A}, {0x0C60, 0x0C61},
+    {0x0C80, 0x0C80}, {0x0C85, 0x0C8C}, {0x0C8E, 0x0C90}, {0x0C92, 0x0CA8},
+    {0x0CAA, 0x0CB3}, {0x0CB5, 0x0CB9}, {0x0CBD, 0x0CBD}, {0x0CDE, 0x0CDE},
+    {0x0CE0, 0x0CE1}, {0x0CF1, 0x0CF2}, {0x0D04, 0x0D0C}, {0x0D0E, 0x0D10},
+    {0x0D12, 0x0D3A}, {0x0D3D, 0x0D3D}, {0x0D4E, 0x0D4E}, {0x0D54, 0x0D56},
+    {0x0D5F, 0x0D61}, {0x0D7A, 0x0D7F}, {0x0D85, 0x0D96}, {0x0D9A, 0x0DB1},
+    {0x0DB3, 0x0DBB}, {0x0DBD, 0x0DBD}, {0x0DC0, 0x0DC6}, {0x0E01, 0x0E30},
+    {0x0E32, 0x0E33}, {0x0E40, 0x0E46}, {0x0E81, 0x0E82}, {0x0E84, 0x0E84},
+    {0x0E86, 0x0E8A}, {0x0E8C, 0x0EA3}, {0x0EA5, 0x0EA5}, {0x0EA7, 0x0EB0},
+    {0x0EB2, 0x0EB3}, {0x0EBD, 0x0EBD}, {0x0EC0, 0x0EC4}, {0x0EC6, 0x0EC6},
+    {0x0EDC, 0x0EDF}, {0x0F00, 0x0F00}, {0x0F40, 0x0F47}, {0x0F49, 0x0F6C},
+    {0x0F88, 0x0F8C}, {0x1000, 0x102A}, {0x103F, 0x103F}, {0x1050, 0x1055},
+    {0x105A, 0x105D}, {0x1061, 0x1061}, {0x1065, 0x1066}, {0x106E, 0x1070},
+    {0x1075, 0x1081}, {0x108E, 0x108E}, {0x10A0, 0x10C5}, {0x10C7, 0x10C7},
+    {0x10CD, 0x10CD}, {0x10D0, 0x10FA}, {0x10FC, 0x1248}, {0x124A, 0x124D},
+    {0x1250, 0x1256}, {0x1258, 0x1258}, {0x125A, 0x125D}, {0x1260, 0x1288},
+    {0x128A, 0x128D}, {0x1290, 0x12B0}, {0x12B2, 0x12B5}, {0x12B8, 0x12BE},
+    {0x12C0, 0x12C0}, {0x12C2, 0x12C5}, {0x12C8, 0x12D6}, {0x12D8, 0x1310},
+    {0x1312, 0x1315}, {0x1318, 0x135A}, {0x1380, 0x138F}, {0x13A0, 0x13F5},
+    {0x13F8, 0x13FD}, {0x1401, 0x166C}, {0x166F, 0x167F}, {0x1681, 0x169A},
+    {0x16A0, 0x16EA}, {0x16F1, 0x16F8}, {0x1700, 0x170C}, {0x170E, 0x1711},
+    {0x1720, 0x1731}, {0x1740, 0x1751}, {0x1760, 0x176C}, {0x176E, 0x1770},
+    {0x1780, 0x17B3}, {0x17D7, 0x17D7}, {0x17DC, 0x17DC}, {0x1820, 0x1878},
+    {0x1880, 0x1884}, {0x1887, 0x18A8}, {0x18AA, 0x18AA}, {0x18B0, 0x18F5},
+    {0x1900, 0x191E}, {0x1950, 0x196D}, {0x1970, 0x1974}, {0x1980, 0x19AB},
+    {0x19B0, 0x19C9}, {0x1A00, 0x1A16}, {0x1A20, 0x1A54}, {0x1AA7, 0x1AA7},
+    {0x1B05, 0x1B33}, {0x1B45, 0x1B4B}, {0x1B83, 0x1BA0}, {0x1BAE, 0x1BAF},
+    {0x1BBA, 0x1BE5}, {0x1C00, 0x1C23}, {0x1C4D, 0x1C4F}, {0x1C5A, 0x1C7D},
+    {0x1C80, 0x1C88}, {0x1C90, 0x1CBA}, {0x1CBD, 0x1CBF}, {0x1CE9, 0x1CEC},
+    {0x1CEE, 0x1CF3}, {0x1CF5, 0x1CF6}, {0x1CFA, 0x1CFA}, {0x1D00, 0x1DBF},
+    {0x1E00, 0x1F15}, {0x1F18, 0x1F1D}, {0x1F20, 0x1F45}, {0x1F48, 0x1F4D},
+    {0x1F50, 0x1F57}, {0x1F59, 0x1F59}, {0x1F5B, 0x1F5B}, {0x1F5D, 0x1F5D},
+    {0x1F5F, 0x1F7D}, {0x1F80, 0x1FB4}, {0x1FB6, 0x1FBC}, {0x1FBE, 0x1FBE},
+    {0x1FC2, 0x1FC4}, {0x1FC6, 0x1FCC}, {0x1FD0, 0x1FD3}, {0x1FD6, 0x1FDB},
+    {0x1FE0, 0x1FEC}, {0x1FF2, 0x1FF4}, {0x1FF6, 0x1FFC}, {0x2071, 0x2071},
+    {0x207F, 0x207F}, {0x2090, 0x209C}, {0x2102, 0x2102}, {0x2107, 0x2107},
+    {0x210A, 0x2113}, {0x2115, 0x2115}, {0x2119, 0x211D}, {0x2124, 0x2124},
+    {0x2126, 0x2126}, {0x2128, 0x2128}, {0x212A, 0x212D}, {0x212F, 0x2139},
+    {0x213C, 0x213F}, {0x2145, 0x2149}, {0x214E, 0x214E}, {0x2183, 0x2184},
+    {0x2C00, 0x2C2E}, {0x2C30, 0x2C5E}, {0x2C60, 0x2CE4}, {0x2CEB, 0x2CEE},
+    {0x2CF2, 0x2CF3}, {0x2D00, 0x2D25}, {0x2D27, 0x2D27}, {0x2D2D, 0x2D2D},
+    {0x2D30, 0x2D67}, {0x2D6F, 0x2D6F}, {0x2D80, 0x2D96}, {0x2DA0, 0x2DA6},
+    {0x2DA8, 0x2DAE}, {0x2DB0, 0x2DB6}, {0x2DB8, 0x2DBE}, {0x2DC0, 0x2DC6},
+    {0x2DC8, 0x2DCE}, {0x2DD0, 0x2DD6}, {0x2DD8, 0x2DDE}, {0x2E2F, 0x2E2F},
+    {0x3005, 0x3006}, {0x3031, 0x3035}, {0x303B, 0x303C}, {0x3041, 0x3096},
+    {0x309D, 0x309F}, {0x30A1, 0x30FA}, {0x30FC, 0x30FF}, {0x3105, 0x312F},
+    {0x3131, 0x318E}, {0x31A0, 0x31BF}, {0x31F0, 0x31FF}, {0x3400, 0x4DBF},
+    {0x4E00, 0x9FFC}, {0xA000, 0xA48C}, {0xA4D0, 0xA4FD}, {0xA500, 0xA60C},
+    {0xA610, 0xA61F}, {0xA62A, 0xA62B}, {0xA640, 0xA66E}, {0xA67F, 0xA69D},
+    {0xA6A0, 0xA6E5}, {0xA717, 0xA71F}, {0xA722, 0xA788}, {0xA78B, 0xA7BF},
+    {0xA7C2, 0xA7CA}, {0xA7F5, 0xA801}, {0xA803, 0xA805}, {0xA807, 0xA80A},
+    {0xA80C, 0xA822}, {0xA840, 0xA873}, {0xA882, 0xA8B3}, {0xA8F2, 0xA8F7},
+    {0xA8FB, 0xA8FB}, {0xA8FD, 0xA8FE}, {0xA90A, 0xA925}, {0xA930, 0xA946},
+    {0xA960, 0xA97C}, {0xA984, 0xA9B2}, {0xA9CF, 0xA9CF}, {0xA9E0, 0xA9E4},
+    {0xA9E6, 0xA9EF}, {0xA9FA, 0xA9FE}, {0xAA00, 0xAA28}, {0xAA40, 0xAA42},
+    {0xAA44, 0xAA4B}, {0xAA60, 0xAA76}, {0xAA7A, 0xAA7A}, {0xAA7E, 0xAAAF},
+    {0xAAB1, 0xAAB1}, {0xAAB5, 0xAAB6}, {0xAAB9, 0xAABD}, {0xAAC0, 0xAAC0},
+    {0xAAC2, 0xAAC2}, {0xAADB, 0xAADD}, {0xAAE0, 0xAAEA}, {0xAAF2, 0xAAF4},
+    {0xAB01, 0xAB06}, {0xAB09, 0xAB0E}, {0xAB11, 0xAB16}, {0xAB20, 0xAB26},
+    {0xAB28, 0xAB2E}, {0xAB30, 0xAB5A}, {0xAB5C, 0xAB69}, {0xAB70, 0xABE2},
+    {0xAC00, 0xD7A3}, {0xD7B0, 0xD7C6}, {0xD7CB, 0xD7FB}, {0xF900, 0xFA6D},
+    {0xFA70, 0xFAD9}, {0xFB00, 0xFB06}, {0xFB13, 0xFB17}, {0xFB1D, 0xFB1D},
+    {0xFB1F, 0xFB28}, {0xFB2A, 0xFB36}, {0xFB38, 0xFB3C}, {0xFB3E, 0xFB3E},
+    {0xFB40, 0xFB41}, {0xFB43, 0xFB44}, {0xFB46, 0xFBB1}, {0xFBD3, 0xFD3D},
+    {0xFD50, 0xFD8F}, {0xFD92, 0xFDC7}, {0xFDF0, 0xFDFB}, {0xFE70, 0xFE74},
+    {0xFE76, 0xFEFC}, {0xFF21, 0xFF3A}, {0xFF41, 0xFF5A}, {0xFF66, 0xFFBE},
+    {0xFFC2, 0xFFC7}, {0xFFCA, 0xFFCF}, {0xFFD2, 0xFFD7}, {0xFFDA, 0xFFDC},
+};
+
+CodeRange const NUMBER_RANGES[] = {
+    {0x0030, 0x0039}, {0x00B2, 0x00B3}, {0x00B9, 0x00B9}, {0x00BC, 0x00BE},
+    {0x0660, 0x0669}, {0x06F0, 0x06F9}, {0x07C0, 0x07C9}, {0x0966, 0x096F},
+    {0x09E6, 0x09EF}, {0x09F4, 0x09F9}, {0x0A66, 0x0A6F}, {0x0AE6, 0x0AEF},
+    {0x0B66, 0x0B6F}, {0x0B72, 0x0B77}, {0x0BE6, 0x0BF2}, {0x0C66, 0x0C6F},
+    {0x0C78, 0x0C7E}, {0x0CE6, 0x0CEF}, {0x0D58, 0x0D5E}, {0x0D66, 0x0D78},
+    {0x0DE6, 0x0DEF}, {0x0E50, 0x0E59}, {0x0ED0, 0x0ED9}, {0x0F20, 0x0F33},
+    {0x1040, 0x1049}, {0x1090, 0x1099}, {0x1369, 0x137C}, {0x16EE, 0x16F0},
+    {0x17E0, 0x17E9}, {0x17F0, 0x17F9}, {0x1810, 0x1819}, {0x1946, 0x194F},
+    {0x19D0, 0x19DA}, {0x1A80, 0x1A89}, {0x1A90, 0x1A99}, {0x1B50, 0x1B59},
+    {0x1BB0, 0x1BB9}, {0x1C40, 0x1C49}, {0x1C50, 0x1C59}, {0x2070, 0x2070},
+    {0x2074, 0x2079}, {0x2080, 0x2089}, {0x2150, 0x2182}, {0x2185, 0x2189},
+    {0x2460, 0x249B}, {0x24EA, 0x24FF}, {0x2776, 0x2793}, {0x2CFD, 0x2CFD},
+    {0x3007, 0x3007}, {0x3021, 0x3029}, {0x3038, 0x303A}, {0x3192, 0x3195},
+    {0x3220, 0x3229}, {0x3248, 0x324F}, {0x3251, 0x325F}, {0x3280, 0x3289},
+    {0x32B1, 0x32BF}, {0xA620, 0xA629}, {0xA6E6, 0xA6EF}, {0xA830, 0xA835},
+    {0xA8D0, 0xA8D9}, {0xA900, 0xA909}, {0xA9D0, 0xA9D9}, {0xA9F0, 0xA9F9},
+    {0xAA50, 0xAA59}, {0xABF0, 0xABF9}, {0xFF10, 0xFF19},
+};
+
+enum CharClass { CHAR_SPACE, CHAR_LETTER, CHAR_NUMBER, CHAR_OTHER };
+
+template <size_t N>
+bool in_ranges(CodeRange const (&ranges)[N], uint32_t c) {
+  CodeRange const *it = std::upper_bound(
+      ranges, ranges + N, c, [](uint32_t c, CodeRange const &r) {
+        return c < r.first;
+      });
+  return it != ranges && c <= (it - 1)->last;
+}
+
+CharClass char_class(uint32_t c) {
+  if (c < 0x80) {
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z')) {
+      return CHAR_LETTER;
+    }
+    if (c >= '0' && c <= '9') {
+      return CHAR_NUMBER;
+    }
+    // \s of std::wregex, which only matches ASCII white space
+    if (c == ' ' || (c >= '\t' && c <= '\r')) {
+      return CHAR_SPACE;
+    }
+    return CHAR_OTHER;
+  }
+  if (in_ranges(LETTER_RANGES, c)) {
+    return CHAR_LETTER;
+  }
+  if (in_ranges(NUMBER_RANGES, c)) {
+    return CHAR_NUMBER;
+  }
+  return CHAR_OTHER;
+}
+
+// Decodes the code point at s[i], setting *length to its bytes. Malformed
+// bytes decode as one code point each.
+uint32_t decode_utf8(char const *s, size_t n, size_t i, size_t *length) {
+  uint8_t const c = s[i];
+  size_t extra;
+  uint32_t code;
+  if (c < 0x80) {
+    *length = 1;
+    return c;
+  } else if ((c & 0xE0) == 0xC0) {
+    extra = 1;
+    code = c & 0x1F;
+  } else if ((c & 0xF0) == 0xE0) {
+    extra = 2;
+    code = c & 0x0F;
+  } else if ((c & 0xF8) == 0xF0) {
+    extra = 3;
+    code = c & 0x07;
+  } else {
+    *length = 1;
+    return 0xFFFD;
+  }
+  if (i + extra >= n) {
+    *length = 1;
+    return 0xFFFD;
+  }
+  for (size_t k = 1; k <= extra; k++) {
+    uint8_t const cont = s[i + k];
+    if ((cont & 0xC0) != 0x80) {
+      *length = 1;
+      return 0xFFFD;
+    }
+    code = (code << 6) | (cont & 0x3F);
+  }
+  *length = extra + 1;
+  return code;
+}
+
+CharClass class_at(char const *s, size_t n, size_t i, size_t *length) {
+  return char_class(decode_utf8(s, n, i, length));
+}
+
+size_t run_end(char const *s, size_t n, size_t i, CharClass cls) {
+  size_t length;
+  while (i < n && class_at(s, n, i, &length) == cls) {
+    i += length;
+  }
+  return i;
+}
+
+// Returns the end of the piece starting at s[i], matching
+//   's|'t|'re|'ve|'m|'ll|'d| ?\p{L}+| ?\p{N}+| ?[^\s\p{L}\p{N}]+|\s+(?!\S)|\s+
+// where alternatives are tried in order, as in the regex engine
+size_t piece_end(char const *s, size_t n, size_t i) {
+  if (s[i] == '\'' && i + 1 < n) {
+    char const c = s[i + 1];
+    if (c == 's' || c == 't' || c == 'm' || c == 'd') {
+      return i + 2;
+    }
+    if (i + 2 < n) {
+      char const d = s[i + 2];
+      if ((c == 'r' && d == 'e') || (c == 'v' && d == 'e') ||
+          (c == 'l' && d == 'l')) {
+        return i + 3;
+      }
+    }
+  }
+  size_t length;
+  CharClass cls = class_at(s, n, i, &length);
+  if (s[i] == ' ' && i + 1 < n) {
+    CharClass const next = class_at(s, n, i + 1, &length);
+    if (next != CHAR_SPACE) {
+      return run_end(s, n, i + 1, next);
+    }
+  }
+  if (cls != CHAR_SPACE) {
+    return run_end(s, n, i, cls);
+  }
+  size_t const end = run_end(s, n, i, CHAR_SPACE);
+  // Leave the last white space to prefix the following word, unless the run
+  // is a single character
+  if (end < n && end - i > 1) {
+    return end - 1;
+  }
+  return end;
+}
+
+// Inverse of the byte -> printable code point map of GPT-2 (bytes_to_unicode
+// in GPT_Tokenizer). Returns false if token has a code point outside it.
+bool unicode_to_bytes(std::string const &token, std::string *bytes) {
+  static std::vector<int> const decoder = [] {
+    std::vector<int> d(512, -1);
+    int n = 0;
+    for (int b = 0; b < 256; b++) {
+      bool const printable = (b >= '!' && b <= '~') ||
+                             (b >= 0xA1 && b <= 0xAC) ||
+                             (b >= 0xAE && b <= 0xFF);
+      d[printable ? b : 256 + n++] = b;
+    }
+    return d;
+  }();
+  bytes->clear();
+  size_t length;
+  for (size_t i = 0; i < token.size(); i += length) {
+    uint32_t const c = decode_utf8(token.data(), token.size(), i, &length);
+    if (c >= decoder.size() || decoder[c] < 0) {
+      return false;
+    }
+    bytes->push_back(char(decoder[c]));
+  }
+  return true;
+}
+
+template <typename F>
+void parallel_for(size_t n, int num_threads, F const &f) {
+  if (num_threads <= 0) {
+    num_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  num_threads = int(std::min(size_t(num_threads), n));
+  if (num_threads <= 1) {
+    for (size_t i = 0; i < n; i++) {
+      f(i);
+    }
+    return;
+  }
+  std::atomic<size_t> next(0);
+  auto worker = [&]() {
+    for (size_t i = next++; i < n; i = next++) {
+      f(i);
+    }
+  };
+  std::vector<std::thread> threads;
+  for (int t = 1; t < num_threads; t++) {
+    threads.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &t : threads) {
+    t.join();
+  }
+}
+
+struct Symbol {
+  int32_t id;
+  // Neighbours in the piece, -1 at either end
+  int32_t prev, next;
+};
+
+struct Candidate {
+  int32_t rank;
+  // Position of the left symbol
+  int32_t pos;
+  int32_t left, right, merged;
+};
+
+bool later_candidate(Candidate const &a, Candidate const &b) {
+  return a.rank > b.rank || (a.rank == b.rank && a.pos > b.pos);
+}
+
+} // namespace
+
+BPETokenizer::BPETokenizer(tokenizer_mode mode_,
+                           std::string const &vocab_file,
+                           std::string const &merge_file,
+                           std::string const &pad_token,
+                           std::string const &unk_token)
+    : mode(mode_) {
+  std::unordered_map<std::string, int32_t> symbols;
+  load_merge(merge_file, &symbols);
+  load_vocab(vocab_file, symbols, pad_token, unk_token);
+}
+
+void BPETokenizer::load_merge(
+    std::string const &merge_file,
+    std::unordered_map<std::string, int32_t> *symbols) {
+  for (int b = 0; b < 256; b++) {
+    symbols->emplace(std::string(1, char(b)), b);
+  }
+  merges.reserve(60000);
+  std::ifstream file_handle(merge_file);
+  assert(file_handle.good() && "file not exists");
+  std::string line, first, second, first_bytes, second_bytes;
+  int32_t rank = 0;
+  while (std::getline(file_handle, line)) {
+    if (line.size() == 0 || line.rfind("#version:", 0) == 0) {
+      continue;
+    }
+    std::istringstream fields(line);
+    fields >> first >> second;
+    assert(!fields.fail() && "unk format");
+    // Ranks count every rule, as in GPT_Tokenizer
+    int32_t const curr_rank = rank++;
+    if (!unicode_to_bytes(first, &first_bytes) ||
+        !unicode_to_bytes(second, &second_bytes)) {
+      continue;
+    }
+    // A side may be the result of a later rule, so every string gets an id
+    int32_t const left_id =
+        symbols->emplace(first_bytes, int32_t(symbols->size())).first->second;
+    int32_t const right_id =
+        symbols->emplace(second_bytes, int32_t(symbols->size()))
+            .first->second;
+    auto merged = symbols->emplace(first_bytes + second_bytes,
+                                   int32_t(symbols->size()));
+    Merge rule;
+    rule.rank = curr_rank;
+    rule.merged = merged.first->second;
+    merges.emplace(pair_key(left_id, right_id), rule);
+  }
+}
+
+void BPETokenizer::load_vocab(
+    std::string const &vocab_file,
+    std::unordered_map<std::string, int32_t> const &symbols,
+    std::string const &pad_token,
+    std::string const &unk_token) {
+  std::ifstream file_handle(vocab_file);
+  assert(file_handle.good() && "file not exists");
+  nlohmann::json vocab_data = nlohmann::json::parse(file_handle,
+                                                    /*parser_callback_t */
+                                                    nullptr,
+                                                    /*allow_exceptions */ true,
+                                                    /*ignore_comments */ true);
+  auto vocab = vocab_data.get<std::unordered_map<std::string, int32_t>>();
+  // GPT_Tokenizer looks missing special tokens up with operator[], which
+  // yields 0
+  auto pad = vocab.find(pad_token);
+  pad_id = pad == vocab.end() ? 0 : pad->second;
+  auto unk = vocab.find(unk_token);
+  unk_id = unk == vocab.end() ? 0 : unk->second;
+  symbol_tokens.assign(symbols.size(), unk_id);
+  std::string bytes;
+  for (auto const &item : vocab) {
+    assert(item.second >= 0);
+    if (size_t(item.second) >= token_bytes.size()) {
+      token_bytes.resize(item.second + 1);
+    }
+    if (unicode_to_bytes(item.first, &bytes)) {
+      auto symbol = symbols.find(bytes);
+      if (symbol != symbols.end()) {
+        symbol_tokens[symbol->second] = item.second;
+      }
+      token_bytes[item.second] = bytes;
+    } else {
+      token_bytes[item.second] = item.first;
+    }
+  }
+}
+
+void BPETokenizer::merge_piece(char const *piece,
+                               size_t length,
+                               std::vector<int32_t> *output) const {
+  static thread_local std::vector<Symbol> symbols;
+  static thread_local std::vector<Candidate> heap, next_round;
+  symbols.resize(length);
+  for (size_t i = 0; i < length; i++) {
+    symbols[i].id = uint8_t(piece[i]);
+    symbols[i].prev = int32_t(i) - 1;
+    symbols[i].next = i + 1 < length ? int32_t(i) + 1 : -1;
+  }
+  auto add_candidate = [&](std::vector<Candidate> &candidates, int32_t pos) {
+    int32_t const next = symbols[pos].next;
+    if (next < 0) {
+      return;
+    }
+    auto rule = merges.find(pair_key(symbols[pos].id, symbols[next].id));
+    if (rule != merges.end()) {
+      Candidate c;
+      c.rank = rule->second.rank;
+      c.pos = pos;
+      c.left = symbols[pos].id;
+      c.right = symbols[next].id;
+      c.merged = rule->second.merged;
+      candidates.push_back(c);
+    }
+  };
+  heap.clear();
+  for (size_t i = 0; i + 1 < length; i++) {
+    add_candidate(heap, i);
+  }
+  std::make_heap(heap.begin(), heap.end(), later_candidate);
+  while (!heap.empty()) {
+    // Apply every occurrence of the lowest-ranked pair left to right before
+    // considering the pairs they form, like the reference implementation
+    int32_t const rank = heap.front().rank;
+    next_round.clear();
+    while (!heap.empty() && heap.front().rank == rank) {
+      std::pop_heap(heap.begin(), heap.end(), later_candidate);
+      Candidate const c = heap.back();
+      heap.pop_back();
+      Symbol &left = symbols[c.pos];
+      // Stale if either side has been merged since
+      if (left.id != c.left || left.next < 0 ||
+          symbols[left.next].id != c.right) {
+        continue;
+      }
+      Symbol &right = symbols[left.next];
+      left.id = c.merged;
+      left.next = right.next;
+      if (right.next >= 0) {
+        symbols[right.next].prev = c.pos;
+      }
+      right.id = -1;
+      if (left.prev >= 0) {
+        add_candidate(next_round, left.prev);
+      }
+      add_candidate(next_round, c.pos);
+    }
+    for (Candidate const &c : next_round) {
+      heap.push_back(c);
+      std::push_heap(heap.begin(), heap.end(), later_candidate);
+    }
+  }
+  for (int32_t i = 0; i >= 0; i = symbols[i].next) {
+    output->push_back(symbol_tokens[symbols[i].id]);
+  }
+}
+
+void BPETokenizer::encode_piece(char const *piece,
+                                size_t length,
+                                std::vector<int32_t> *output) const {
+  if (length == 1) {
+    output->push_back(symbol_tokens[uint8_t(piece[0])]);
+    return;
+  }
+  if (length >= CACHE_PIECE_MAX_BYTES) {
+    merge_piece(piece, length, output);
+    return;
+  }
+  std::string key(piece, length);
+  CacheShard &shard =
+      cache[std::hash<std::string>()(key) % NUM_CACHE_SHARDS];
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.pieces.find(key);
+    if (it != shard.pieces.end()) {
+      output->insert(output->end(), it->second.begin(), it->second.end());
+      return;
+    }
+  }
+  size_t const begin = output->size();
+  merge_piece(piece, length, output);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  if (shard.pieces.size() >= CACHE_SHARD_MAX_SIZE) {
+    shard.pieces.clear();
+  }
+  shard.pieces.emplace(
+      std::move(key),
+      std::vector<int32_t>(output->begin() + begin, output->end()));
+}
+
+std::vector<int32_t> BPETokenizer::encode(std::string const &text) const {
+  std::vector<int32_t> input_ids;
+  input_ids.reserve(text.size() / 4 + 1);
+  char const *s = text.data();
+  size_t const n = text.size();
+  for (size_t i = 0; i < n;) {
+    size_t const end = piece_end(s, n, i);
+    encode_piece(s + i, end - i, &input_ids);
+    i = end;
+  }
+  return input_ids;
+}
+
+void BPETokenizer::encode(std::string const &text,
+                          size_t max_length,
+                          std::vector<int32_t> *input_ids,
+                          std::vector<int32_t> *mask_ids) const {
+  std::vector<int32_t> tokens = encode(text);
+  input_ids->clear();
+  mask_ids->clear();
+  input_ids->reserve(max_length + 1);
+  mask_ids->reserve(max_length + 1);
+  if (mode == OPT_TOKENIZER) {
+    input_ids->push_back(2);
+    mask_ids->push_back(1);
+  }
+  size_t const prefix = input_ids->size();
+  for (int32_t t : tokens) {
+    if (input_ids->size() - prefix == max_length - 1) {
+      break;
+    }
+    input_ids->push_back(t);
+    mask_ids->push_back(1);
+  }
+  while (input_ids->size() - prefix < max_length) {
+    input_ids->push_back(pad_id);
+    mask_ids->push_back(0);
+  }
+}
+
+std::string
+    BPETokenizer::decode(std::vector<int32_t> const &input_ids) const {
+  std::string result;
+  for (int32_t id : input_ids) {
+    assert(id >= 0 && size_t(id) < token_bytes.size());
+    result += token_bytes[id];
+  }
+  return result;
+}
+
+std::string BPETokenizer::decode(std::vector<int32_t> const &input_ids,
+                                 std::vector<int32_t> const &mask_ids) const {
+  std::string result;
+  size_t index = 0;
+  for (size_t i = 0; i < input_ids.size(); i++) {
+    int32_t const id = input_ids[i];
+    if (i == 0 && mode == OPT_TOKENIZER) {
+      if (id == 2) {
+        index++;
+      }
+      continue;
+    }
+    if (mask_ids[index++]) {
+      assert(id >= 0 && size_t(id) < token_bytes.size());
+      result += token_bytes[id];
+    }
+  }
+  return result;
+}
+
+std::vector<std::vector<int32_t>>
+    BPETokenizer::encode_batch(std::vector<std::string> const &texts,
+                               int num_threads) const {
+  std::vector<std::vector<int32_t>> input_ids(texts.size());
+  parallel_for(texts.size(), num_threads, [&](size_t i) {
+    input_ids[i] = encode(texts[i]);
+  });
+  return input_ids;
+}
+
+std::vector<std::string> BPETokenizer::decode_batch(
+    std::vector<std::vector<int32_t>> const &input_ids,
+    int num_threads) const {
+  std::vector<std::string> texts(input_ids.size());
+  parallel_for(input_ids.size(), num_threads, [&](size_t i) {
+    texts[i] = decode(input_ids[i]);
+  });
+  return texts;
+}
+
+}; // namespace FlexFlow
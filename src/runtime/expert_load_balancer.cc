@@ -0,0 +1,206 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "flexflow/expert_load_balancer.h"
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <utility>
+
+namespace FlexFlow {
+
+double ExpertPlacement::makespan() const {
+  double time = 0.0;
+  for (double t : device_time) {
+    time = std::max(time, t);
+  }
+  return time;
+}
+
+ExpertLoadBalancer *ExpertLoadBalancer::get_load_balancer() {
+  static ExpertLoadBalancer load_balancer;
+  return &load_balancer;
+}
+
+void ExpertLoadBalancer::record_routing(std::string const &layer,
+                                        std::vector<int> const &counts,
+                                        int capacity) {
+  std::lock_guard<std::mutex> lock(mutex);
+  ExpertRoutingStats &s = stats[layer];
+  if (s.load.empty()) {
+    s.load.assign(counts.begin(), counts.end());
+  } else {
+    assert(s.load.size() == counts.size());
+    for (size_t e = 0; e < counts.size(); e++) {
+      s.load[e] = LOAD_DECAY * s.load[e] + (1.0 - LOAD_DECAY) * counts[e];
+    }
+  }
+  s.num_steps++;
+  for (int c : counts) {
+    s.num_assignments += c;
+    s.num_dropped += std::max(0, c - capacity);
+  }
+}
+
+ExpertRoutingStats
+    ExpertLoadBalancer::get_routing_stats(std::string const &layer) const {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = stats.find(layer);
+  return it == stats.end() ? ExpertRoutingStats() : it->second;
+}
+
+std::vector<std::string> ExpertLoadBalancer::get_layers() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<std::string> layers;
+  for (auto const &it : stats) {
+    layers.push_back(it.first);
+  }
+  std::sort(layers.begin(), layers.end());
+  return layers;
+}
+
+void ExpertLoadBalancer::reset() {
+  std::lock_guard<std::mutex> lock(mutex);
+  stats.clear();
+}
+
+void ExpertLoadBalancer::write_routing_stats(std::ostream &os) const {
+  std::vector<std::string> layers = get_layers();
+  std::lock_guard<std::mutex> lock(mutex);
+  os << std::setprecision(17);
+  for (std::string const &layer : layers) {
+    ExpertRoutingStats const &s = stats.at(layer);
+    os << std::quoted(layer) << " " << s.num_steps << " " << s.num_assignments
+       << " " << s.num_dropped << " " << s.load.size();
+    for (double l : s.load) {
+      os << " " << l;
+    }
+    os << "\n";
+  }
+}
+
+bool ExpertLoadBalancer::load_routing_stats(std::istream &is) {
+  std::unordered_map<std::string, ExpertRoutingStats> loaded;
+  std::string line;
+  while (std::getline(is, line)) {
+    if (line.empty()) {
+      continue;
+    }
+    std::istringstream iss(line);
+    std::string layer;
+    ExpertRoutingStats s;
+    size_t num_experts = 0;
+    if (!(iss >> std::quoted(layer) >> s.num_steps >> s.num_assignments >>
+          s.num_dropped >> num_experts)) {
+      return false;
+    }
+    s.load.resize(num_experts);
+    for (double &l : s.load) {
+      if (!(iss >> l)) {
+        return false;
+      }
+    }
+    loaded[layer] = s;
+  }
+  std::lock_guard<std::mutex> lock(mutex);
+  stats = std::move(loaded);
+  return true;
+}
+
+std::string ExpertLoadBalancer::routing_file;
+
+/*static*/
+void ExpertLoadBalancer::set_routing_file(std::string const &path) {
+  routing_file = path;
+}
+
+/*static*/
+void ExpertLoadBalancer::save_routing_stats() {
+  ExpertLoadBalancer const *balancer = get_load_balancer();
+  if (routing_file.empty() || balancer->get_layers().empty()) {
+    return;
+  }
+  std::ofstream ofs(routing_file);
+  if (!ofs) {
+    fprintf(stderr,
+            "Cannot write expert routing stats to %s\n",
+            routing_file.c_str());
+    return;
+  }
+  balancer->write_routing_stats(ofs);
+}
+
+/*static*/
+ExpertPlacement ExpertLoadBalancer::plan_placement(
+    std::vector<double> const &expert_load,
+    std::vector<double> const &device_token_cost,
+    int slots_per_device) {
+  int const num_experts = expert_load.size();
+  int const num_devices = device_token_cost.size();
+  assert(num_devices > 0 && num_devices * slots_per_device >= num_experts);
+
+  std::vector<int> order(num_experts);
+  for (int e = 0; e < num_experts; e++) {
+    order[e] = e;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    return expert_load[a] > expert_load[b];
+  });
+  ExpertPlacement placement;
+  placement.expert_device.assign(num_experts, -1);
+  placement.device_experts.resize(num_devices);
+  std::vector<double> device_tokens(num_devices, 0.0);
+  for (int e : order) {
+    int best = -1;
+    double best_time = 0.0;
+    for (int d = 0; d < num_devices; d++) {
+      if ((int)placement.device_experts[d].size() == slots_per_device) {
+        continue;
+      }
+      double const time =
+          (device_tokens[d] + expert_load[e]) * device_token_cost[d];
+      // Ties go to the emptier device, so idle experts spread out
+      if (best < 0 || time < best_time ||
+          (time == best_time && placement.device_experts[d].size() <
+                                    placement.device_experts[best].size())) {
+        best = d;
+        best_time = time;
+      }
+    }
+    assert(best >= 0);
+    placement.expert_device[e] = best;
+    placement.device_experts[best].push_back(e);
+    device_tokens[best] += expert_load[e];
+  }
+  placement.device_time.resize(num_devices);
+  for (int d = 0; d < num_devices; d++) {
+    placement.device_time[d] = device_tokens[d] * device_token_cost[d];
+  }
+  return placement;
+}
+
+ExpertPlacement ExpertLoadBalancer::plan_placement(
+    std::string const &layer,
+    std::vector<double> const &device_token_cost,
+    int slots_per_device) const {
+  return plan_placement(
+      get_routing_stats(layer).load, device_token_cost, slots_per_device);
+}
+
+}; // namespace FlexFlow
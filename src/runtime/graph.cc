@@ -336,6 +336,19 @@ T SearchHelper::find_optimal_nonsequence_graph_time(
 
 Graph::Graph(FFModel *_model) : model(_model), search(_model->search) {}
 
+Graph::Graph(FFModel *_model, CompactPCG const &graph) : Graph(_model) {
+  for (int id = 0; id < graph.num_ids(); id++) {
+    if (!graph.contains(id)) {
+      continue;
+    }
+    Node const &node = graph.node(id);
+    this->add_node(node);
+    for (Utils::CompactEdge const &e : graph.in_edges(id)) {
+      this->add_edge(graph.node(e.src), node, e.src_idx, e.dst_idx);
+    }
+  }
+}
+
 void Graph::add_edge(Node const &srcOp,
                      Node const &dstOp,
                      int srcIdx,
@@ -620,24 +633,38 @@ std::vector<MachineView> SearchHelper::get_valid_machine_views(
 
 Node Graph::find_bottleneck_node(Node const &sink_node,
                                  Node const &source_node) const {
-  using FlexFlow::PCG::Utils::GraphStructure;
-  using FlexFlow::PCG::Utils::imm_post_dominators;
-  using FlexFlow::PCG::Utils::MultisourceGraphStructure;
-  using FlexFlow::PCG::Utils::roots;
+  using FlexFlow::PCG::Utils::CompactEdge;
+  using FlexFlow::PCG::Utils::dense_imm_post_dominators;
 
+  CompactPCG g = this->compact();
   Node source(source_node);
-  std::unordered_map<Node, Node> ipd;
-  std::unordered_set<Node> graph_roots = roots(*this);
+  int source_id;
   if (source_node != Node::INVALID_NODE) {
-    ipd = imm_post_dominators(*this);
-  } else if (graph_roots.size() == 1) {
-    ipd = imm_post_dominators(*this);
-    source = *graph_roots.begin();
+    source_id = g.find(source_node);
   } else {
-    ipd = imm_post_dominators<Graph, MultisourceGraphStructure<Graph>>(*this);
+    std::vector<int> graph_roots;
+    for (int id = 0; id < g.num_ids(); id++) {
+      if (g.in_edges(id).empty()) {
+        graph_roots.push_back(id);
+      }
+    }
+    if (graph_roots.size() == 1) {
+      source_id = graph_roots[0];
+      source = g.node(source_id);
+    } else {
+      // Join the roots under a virtual source, as MultisourceGraphStructure
+      // does
+      source_id = g.num_ids();
+      std::vector<CompactEdge> source_edges;
+      for (int root : graph_roots) {
+        source_edges.push_back({source_id, root, 0, 0});
+      }
+      g = g.rewrite({}, {Node::INVALID_NODE}, source_edges);
+    }
   }
+  assert(source_id != -1);
 
-  Node bn_node = ipd.at(source);
+  Node bn_node = g.node(dense_imm_post_dominators(g).at(source_id));
   if (bn_node == source || bn_node == sink_node) {
     return Node::INVALID_NODE;
   }
@@ -1856,6 +1883,28 @@ T Graph::generic_optimal_cost() const {
   return optimal;
 }
 
+CompactPCG Graph::compact() const {
+  std::vector<Node> nodes;
+  std::unordered_map<Node, int> ids;
+  nodes.reserve(this->inEdges.size());
+  for (auto const &it : this->inEdges) {
+    ids[it.first] = nodes.size();
+    nodes.push_back(it.first);
+  }
+  for (auto const &it : this->outEdges) {
+    if (ids.emplace(it.first, nodes.size()).second) {
+      nodes.push_back(it.first);
+    }
+  }
+  std::vector<Utils::CompactEdge> edges;
+  for (auto const &it : this->inEdges) {
+    for (Edge const &e : it.second) {
+      edges.push_back({ids.at(e.srcOp), ids.at(e.dstOp), e.srcIdx, e.dstIdx});
+    }
+  }
+  return CompactPCG(nodes, edges);
+}
+
 size_t Graph::hash(void) const {
   // Graph hash should be additive and independent to the ordering of the nodes
   size_t total_hash = 0;
@@ -1890,6 +1939,25 @@ size_t dp_state_hash(Graph const *graph,
 
 namespace {
 
+/**
+ * @brief The memory whose capacity bounds each device in the search: the
+ * framebuffer next to proc, or its system memory on machines without GPUs.
+ */
+Memory get_search_device_memory(Processor proc) {
+  Memory mem = Machine::MemoryQuery(Machine::get_machine())
+                   .only_kind(Memory::GPU_FB_MEM)
+                   .best_affinity_to(proc)
+                   .first();
+  if (mem == Memory::NO_MEMORY) {
+    mem = Machine::MemoryQuery(Machine::get_machine())
+              .only_kind(Memory::SYSTEM_MEM)
+              .best_affinity_to(proc)
+              .first();
+  }
+  assert(mem != Memory::NO_MEMORY);
+  return mem;
+}
+
 /**
  * @brief Given a lambda value, perform the search and return the optimized PCG
  * and corresponding MachineView.
@@ -1914,10 +1982,7 @@ std::pair<std::unique_ptr<Graph>, std::unordered_map<Node, MachineView>>
                                     model->config.workersPerNode,
                                     model->config.cpusPerNode,
                                     model->all_valid_views);
-  Memory gpu_mem = Machine::MemoryQuery(Machine::get_machine())
-                       .only_kind(Memory::GPU_FB_MEM)
-                       .best_affinity_to(task->target_proc)
-                       .first();
+  Memory gpu_mem = get_search_device_memory(task->target_proc);
   MachineModel *machine;
   if (model->config.machine_model_version == 0) {
     machine =
@@ -1938,6 +2003,9 @@ std::pair<std::unique_ptr<Graph>, std::unordered_map<Node, MachineView>>
   if (!cached_simulator) {
     cached_simulator = std::make_shared<Simulator>(
         model, model->handlers[0], gpu_mem, machine);
+    if (!model->config.measured_cost_file.empty()) {
+      cached_simulator->load_measured_costs(model->config.measured_cost_file);
+    }
   } else {
     // Update simulator with the new stuff
     cached_simulator->handler = model->handlers[0];
@@ -1976,9 +2044,11 @@ std::pair<std::unique_ptr<Graph>, std::unordered_map<Node, MachineView>>
       data_parallel_view.stride[0] = 1;
       data_parallel_view.start_device_id = 0;
     } else {
-      // Currently assume a 1D machine view is needed
-      assert(model->config.data_parallelism_degree == 1 ||
-             model->config.tensor_parallelism_degree == 1);
+      // A pipeline stage spans data_parallelism_degree *
+      // tensor_parallelism_degree devices. The views below are those of the
+      // first data-parallel replica, whose operators are partitioned over
+      // the first tensor_parallelism_degree devices of each stage;
+      // compile_model_and_allocate_buffer shifts them for the other replicas.
       degree = model->config.data_parallelism_degree *
                model->config.tensor_parallelism_degree;
       num_transformer_layers_per_stage =
@@ -2038,8 +2108,12 @@ std::pair<std::unique_ptr<Graph>, std::unordered_map<Node, MachineView>>
 };
 
 /**
- * @brief Analyze the per-device memory cost and compare with the memory
- * threshold of each device.
+ * @brief Analyze the per-device peak memory of a strategy and compare it with
+ * the memory threshold of each device.
+ * @details Operators are scheduled in topological order; weights stay
+ * resident while outputs are released after their last consumer. In training
+ * mode activations are kept until the backward pass, i.e., until the end of
+ * the forward schedule.
  */
 bool is_valid_strategy(
     std::vector<std::pair<float, MemorySearchResult>> &lambdas_results,
@@ -2047,49 +2121,68 @@ bool is_valid_strategy(
     std::unordered_map<Node, MachineView> &curr_views,
     std::shared_ptr<Simulator> const cached_simulator,
     float memory_threshold) {
+  using FlexFlow::PCG::Utils::topo_sort;
+
   std::cout << "try to check valid for lambda " << lambdas_results.back().first
             << std::endl;
   assert(cached_simulator.get() != nullptr &&
          "cached_simulator cannot be nullptr");
 
-  // Analyze the strategy and update max_per_device_mem_all_deivces in the
-  // lambda_result.
-  std::unordered_map<int, float> device_to_mem{};
-  for (auto const &view : curr_views) {
-    CostMetrics op_cost =
-        cached_simulator->measure_operator_cost(view.first.ptr, view.second);
-    float node_mem_as_mb = op_cost.total_memory_in_mb();
+  std::vector<Node> schedule;
+  topo_sort(*curr_graph, &schedule);
+  std::unordered_map<Node, int> step_of;
+  for (size_t i = 0; i < schedule.size(); i++) {
+    step_of[schedule[i]] = (int)i;
+  }
+  bool const keep_activations =
+      curr_graph->model->config.computationMode == COMP_MODE_TRAINING;
+  int const last_step = (int)schedule.size() - 1;
 
-    for (auto const d_id : view.second.device_ids()) {
-      if (device_to_mem.find(d_id) == device_to_mem.end()) {
-        device_to_mem.emplace(std::make_pair(d_id, node_mem_as_mb));
-      } else {
-        device_to_mem[d_id] += node_mem_as_mb;
+  std::vector<OpMemoryFootprint> footprints;
+  for (Node const &node : schedule) {
+    auto view = curr_views.find(node);
+    if (view == curr_views.end()) {
+      continue;
+    }
+    CostMetrics op_cost =
+        cached_simulator->measure_operator_cost(node.ptr, view->second);
+    OpMemoryFootprint f;
+    f.device_ids = view->second.device_ids();
+    f.weights_mb = (float)(op_cost.weights_memory / 1e4) / 1e2;
+    f.outputs_mb = (float)(op_cost.outputs_memory / 1e4) / 1e2;
+    f.step = step_of.at(node);
+    f.last_use_step = f.step;
+    if (keep_activations) {
+      f.last_use_step = last_step;
+    } else {
+      for (Edge const &e : curr_graph->outEdges[node]) {
+        f.last_use_step = std::max(f.last_use_step, step_of.at(e.dstOp));
       }
     }
+    footprints.push_back(f);
   }
+  std::unordered_map<int, float> device_to_mem =
+      estimate_peak_memory_per_device(footprints);
 
   float max_per_device_mem = 0.0;
   float total_device_mem = 0.0;
   for (auto const &d : device_to_mem) {
-    std::cout << "d_id: " << d.first << ", mem: " << d.second << std::endl;
+    std::cout << "d_id: " << d.first << ", peak mem: " << d.second
+              << std::endl;
     total_device_mem += d.second;
     if (d.second > max_per_device_mem) {
       max_per_device_mem = d.second;
     }
   }
 
-  lambdas_results.back().second.max_per_device_mem_all_deivces =
-      max_per_device_mem;
+  MemorySearchResult &result = lambdas_results.back().second;
+  result.max_per_device_mem_all_deivces = max_per_device_mem;
+  result.fits_memory_cap = max_per_device_mem < memory_threshold;
 
-  std::cout << "max_per_device_mem: "
-            << lambdas_results.back().second.max_per_device_mem_all_deivces
+  std::cout << "max_per_device_mem: " << result.max_per_device_mem_all_deivces
             << ", total_device_mem: " << total_device_mem << std::endl;
 
-  if (max_per_device_mem >= memory_threshold) {
-    return false;
-  }
-  return true;
+  return result.fits_memory_cap;
 };
 
 }; // namespace
@@ -2111,7 +2204,13 @@ GraphOptimalViewSerialized
                                Runtime *runtime) {
   auto model_config = (*((FFModel **)task->args))->config;
   bool perform_memory_search = model_config.perform_memory_search;
+  // Hard per-device cap in MB: -ll:fsize if given, otherwise the capacity of
+  // the memory this task runs next to
   float memory_threshold = model_config.device_mem;
+  if (perform_memory_search && memory_threshold <= 0) {
+    Memory device_mem = get_search_device_memory(task->target_proc);
+    memory_threshold = (float)(device_mem.capacity() / 1e4) / 1e2;
+  }
   bool only_data_parallel = model_config.only_data_parallel;
 
   std::vector<std::pair<float, MemorySearchResult>> lambdas{};
@@ -2177,12 +2276,15 @@ GraphOptimalViewSerialized
                                memory_threshold)) {
           upper = mid;
         } else {
-          // Found a better and valid strategy
-          best_graph = std::move(try_result.first);
-          optimal_views = try_result.second;
-
           lower = mid;
-          best_lambda_index = 1 + bianry_search_num;
+          // A larger lambda favors run time, but the search is heuristic, so
+          // only keep the strategy if it is actually faster
+          if (lambdas.back().second.run_time_cost <
+              lambdas[best_lambda_index].second.run_time_cost) {
+            best_graph = std::move(try_result.first);
+            optimal_views = try_result.second;
+            best_lambda_index = 1 + bianry_search_num;
+          }
         }
       }
     }
@@ -2208,17 +2310,46 @@ GraphOptimalViewSerialized
     }
 
     std::cout << "All lambda results:" << std::endl;
+    std::vector<MemorySearchPoint> explored;
     for (auto l : lambdas) {
       std::cout << "lambda: " << l.first
                 << ", run time cost: " << l.second.run_time_cost
                 << ", memory cost: " << l.second.memory_cost
                 << ", search time: " << l.second.search_time
                 << ", per-device max memory: "
-                << l.second.max_per_device_mem_all_deivces << std::endl;
+                << l.second.max_per_device_mem_all_deivces
+                << (l.second.fits_memory_cap ? "" : " (exceeds cap)")
+                << std::endl;
+      explored.push_back({l.first,
+                          l.second.run_time_cost,
+                          l.second.max_per_device_mem_all_deivces});
+    }
+    std::cout << "Pareto frontier of run time vs per-device peak memory:"
+              << std::endl;
+    for (MemorySearchPoint const &p : pareto_frontier(explored)) {
+      std::cout << "lambda: " << p.lambda
+                << ", run time cost: " << p.run_time_cost
+                << ", per-device peak memory: " << p.peak_memory_mb
+                << std::endl;
     }
   } else if (!only_data_parallel) {
     std::cout << "\nNot doing memory search" << std::endl;
   }
+  if (perform_memory_search && !has_valid_strategy) {
+    // Running a strategy that exceeds the cap would only fail later, when
+    // instances cannot be allocated
+    float min_peak = lambdas[0].second.max_per_device_mem_all_deivces;
+    for (auto const &l : lambdas) {
+      min_peak = std::min(min_peak, l.second.max_per_device_mem_all_deivces);
+    }
+    fprintf(stderr,
+            "No strategy fits the per-device memory cap of %.2f MB (the "
+            "smallest per-device peak found is %.2f MB); raise -ll:fsize or "
+            "reduce the model or batch size\n",
+            memory_threshold,
+            min_peak);
+    exit(1);
+  }
 
   // Following lines are to serialize the optimized PCG.
   // Only need best_graph and optimal_views below.
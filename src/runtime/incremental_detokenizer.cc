@@ -0,0 +1,62 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "flexflow/incremental_detokenizer.h"
+#include <cassert>
+
+namespace FlexFlow {
+
+static bool ends_with_replacement_character(std::string const &text) {
+  static char const replacement[] = "\xEF\xBF\xBD";
+  return text.size() >= 3 && text.compare(text.size() - 3, 3, replacement) == 0;
+}
+
+static size_t context_start(size_t read_offset) {
+  size_t const context = IncrementalDetokenizer::CONTEXT_TOKENS;
+  return read_offset > context ? read_offset - context : 0;
+}
+
+IncrementalDetokenizer::IncrementalDetokenizer(size_t num_tokens)
+    : prefix_offset(context_start(num_tokens)), read_offset(num_tokens) {}
+
+std::string IncrementalDetokenizer::step(std::vector<int32_t> const &tokens,
+                                         Decoder const &decode,
+                                         bool flush) {
+  assert(tokens.size() >= read_offset);
+  if (tokens.size() == read_offset) {
+    return "";
+  }
+  std::vector<int32_t> window(tokens.begin() + prefix_offset,
+                              tokens.begin() + read_offset);
+  std::string const prefix_text = decode(window);
+  window.insert(window.end(), tokens.begin() + read_offset, tokens.end());
+  std::string const new_text = decode(window);
+  bool const complete = new_text.size() > prefix_text.size() &&
+                        !ends_with_replacement_character(new_text);
+  if (!complete && !flush) {
+    return "";
+  }
+  // Any earlier start works as context: the decoder treats the start of
+  // both decodes the same way
+  read_offset = tokens.size();
+  prefix_offset = context_start(read_offset);
+  if (new_text.size() <= prefix_text.size()) {
+    return "";
+  }
+  return new_text.substr(prefix_text.size());
+}
+
+}; // namespace FlexFlow
@@ -0,0 +1,137 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "flexflow/inference_fusion.h"
+#include <cassert>
+
+namespace FlexFlow {
+
+namespace {
+
+// The activations that every Linear kernel applies itself. The GPU kernels
+// have no tanh, and their GELU is the tanh approximation, while OP_GELU is
+// exact.
+bool is_fusible_activation(OperatorType op_type) {
+  return op_type == OP_RELU || op_type == OP_SIGMOID;
+}
+
+} // namespace
+
+std::vector<FusionMatch>
+    plan_inference_fusion(std::vector<FusionNode> const &nodes) {
+  int const num_nodes = nodes.size();
+  // Number of readers of each output, and the first of them in graph order
+  std::vector<std::vector<int>> readers(num_nodes), first_reader(num_nodes);
+  for (int v = 0; v < num_nodes; v++) {
+    readers[v].assign(nodes[v].num_outputs, 0);
+    first_reader[v].assign(nodes[v].num_outputs, -1);
+    for (auto const &input : nodes[v].inputs) {
+      if (input.first >= 0) {
+        assert(input.first < v);
+        if (readers[input.first][input.second]++ == 0) {
+          first_reader[input.first][input.second] = v;
+        }
+      }
+    }
+  }
+  std::vector<bool> matched(num_nodes, false);
+  // The node writing input if it is an unmatched, fusible op_type in group
+  auto producer = [&](std::pair<int, int> const &input,
+                      OperatorType op_type,
+                      int group) {
+    int p = input.first;
+    if (p < 0 || matched[p] || !nodes[p].fusible ||
+        nodes[p].op_type != op_type || nodes[p].group != group) {
+      return -1;
+    }
+    return p;
+  };
+
+  std::vector<FusionMatch> matches;
+  for (int v = 0; v < num_nodes; v++) {
+    FusionNode const &node = nodes[v];
+    if (!node.fusible) {
+      continue;
+    }
+    FusionMatch match;
+    bool found = false;
+    if (is_fusible_activation(node.op_type) && node.inputs.size() == 1) {
+      int u = producer(node.inputs[0], OP_LINEAR, node.group);
+      if (u >= 0 && readers[u][0] == 1) {
+        match.pattern = FUSE_LINEAR_ACTIVATION;
+        match.nodes = {u, v};
+        match.inputs = nodes[u].inputs;
+        found = true;
+      }
+    } else if ((node.op_type == OP_RMS_NORM ||
+                node.op_type == OP_LAYERNORM) &&
+               node.inputs.size() == 1) {
+      // The fused operator outputs the sum at the norm's place, so the sum
+      // may have other readers only after the norm
+      int u = producer(node.inputs[0], OP_EW_ADD, node.group);
+      if (u >= 0 && first_reader[u][0] == v) {
+        match.pattern = node.op_type == OP_RMS_NORM ? FUSE_RESIDUAL_RMS_NORM
+                                                    : FUSE_RESIDUAL_LAYER_NORM;
+        match.nodes = {u, v};
+        match.inputs = nodes[u].inputs;
+        found = true;
+      }
+    } else if (node.op_type == OP_EW_MUL && node.inputs.size() == 2) {
+      // (x * sigmoid(x)) * y, with either operand order in both products
+      for (int side = 0; side < 2 && !found; side++) {
+        int m = producer(node.inputs[side], OP_EW_MUL, node.group);
+        if (m < 0 || readers[m][0] != 1 || nodes[m].inputs.size() != 2) {
+          continue;
+        }
+        for (int k = 0; k < 2 && !found; k++) {
+          int s = producer(nodes[m].inputs[k], OP_SIGMOID, node.group);
+          if (s >= 0 && readers[s][0] == 1 && nodes[s].inputs.size() == 1 &&
+              nodes[s].inputs[0] == nodes[m].inputs[1 - k]) {
+            match.pattern = FUSE_SIGMOID_SILU_MULTI;
+            match.nodes = {s, m, v};
+            match.inputs = {nodes[s].inputs[0], node.inputs[1 - side]};
+            found = true;
+          }
+        }
+      }
+    }
+    if (found) {
+      for (int u : match.nodes) {
+        matched[u] = true;
+      }
+      matches.push_back(match);
+    }
+  }
+  return matches;
+}
+
+char const *get_inference_fusion_pattern_name(InferenceFusionPattern pattern) {
+  switch (pattern) {
+    case FUSE_LINEAR_ACTIVATION:
+      return "Linear+activation";
+    case FUSE_RESIDUAL_RMS_NORM:
+      return "residual+RMSNorm";
+    case FUSE_RESIDUAL_LAYER_NORM:
+      return "residual+LayerNorm";
+    case FUSE_SIGMOID_SILU_MULTI:
+      return "SiLU gate";
+    default:
+      assert(false);
+  }
+  return nullptr;
+}
+
+}; // namespace FlexFlow
@@ -13,13 +13,17 @@
  * limitations under the License.
  */
 
+#include "flexflow/activation_planner.h"
+#include "flexflow/expert_load_balancer.h"
 #include "flexflow/ffconst_utils.h"
 #include "flexflow/graph.h"
+#include "flexflow/inference_fusion.h"
 #include "flexflow/model.h"
 #include "flexflow/ops/fused.h"
 #include "flexflow/ops/noop.h"
 #include "flexflow/parallel_ops/parallel_op.h"
 #include "flexflow/request_manager.h"
+#include <fstream>
 
 namespace FlexFlow {
 
@@ -28,6 +32,77 @@ using namespace Legion;
 LegionRuntime::Logger::Category log_inf_mgr("InferenceManager");
 LegionRuntime::Logger::Category log_offload("Offloading");
 
+// Operators that launch tasks in every decoding step, i.e., all but the
+// input and weight operators
+static int count_operator_launches(std::vector<Op *> const &operators) {
+  int num_launches = 0;
+  for (Op const *op : operators) {
+    if (op->op_type != OP_INPUT && op->op_type != OP_WEIGHT) {
+      num_launches++;
+    }
+  }
+  return num_launches;
+}
+
+// Device (within the tensor-parallel group of its stage) of each Experts
+// block whose output is not partitioned, which would otherwise run on the
+// first device of the stage along with every other block. The blocks of a
+// stage are placed by ExpertLoadBalancer::plan_placement on the recorded
+// routing load of their experts.
+static std::unordered_map<Op const *, int>
+    place_expert_blocks(FFModel const *model,
+                        int num_transformer_layers_per_stage) {
+  std::unordered_map<Op const *, int> devices;
+  int const num_devices = model->config.tensor_parallelism_degree;
+  if (num_devices <= 1) {
+    return devices;
+  }
+  ExpertLoadBalancer const *balancer = ExpertLoadBalancer::get_load_balancer();
+  std::map<int, std::vector<Op const *>> stage_blocks;
+  for (Op const *op : model->operators) {
+    if (op->op_type != OP_EXPERTS) {
+      continue;
+    }
+    int parallel_degree = 1;
+    for (int k = 0; k < op->outputs[0]->num_dims; k++) {
+      parallel_degree *= op->outputs[0]->dims[k].degree;
+    }
+    if (parallel_degree == 1) {
+      stage_blocks[op->layer_guid.transformer_layer_id /
+                   num_transformer_layers_per_stage]
+          .push_back(op);
+    }
+  }
+  for (auto const &it : stage_blocks) {
+    std::vector<Op const *> const &blocks = it.second;
+    std::vector<double> load(blocks.size(), 0.0);
+    bool recorded = false;
+    for (size_t b = 0; b < blocks.size(); b++) {
+      for (double l : balancer->get_routing_stats(blocks[b]->name).load) {
+        load[b] += l;
+        recorded = true;
+      }
+    }
+    if (!recorded) {
+      continue;
+    }
+    int const slots_per_device =
+        (blocks.size() + num_devices - 1) / num_devices;
+    ExpertPlacement placement = ExpertLoadBalancer::plan_placement(
+        load, std::vector<double>(num_devices, 1.0), slots_per_device);
+    for (size_t b = 0; b < blocks.size(); b++) {
+      devices[blocks[b]] = placement.expert_device[b];
+    }
+    log_inf_mgr.print("Placed %zu Experts blocks of stage %d on %d devices "
+                      "by their routing load (makespan %.1f tokens)",
+                      blocks.size(),
+                      it.first,
+                      num_devices,
+                      placement.makespan());
+  }
+  return devices;
+}
+
 InferenceManager::InferenceManager() {}
 
 InferenceManager *inference_manager_singleton = nullptr;
@@ -41,22 +116,11 @@ InferenceManager *InferenceManager::get_inference_manager() {
   return inference_manager_singleton;
 }
 
-bool parallel_tensor_list_overlaps(std::vector<ParallelTensor> const &list1,
-                                   std::vector<ParallelTensor> const &list2) {
-  for (auto const &pt1 : list1) {
-    for (auto const &pt2 : list2) {
-      if (pt1 == pt2) {
-        return true;
-      }
-    }
-  }
-  return false;
-}
-
 void InferenceManager::compile_model_and_allocate_buffer(FFModel *model) {
-  // TODO: currently assume there is a single data-parallel pipeline
-  // (i.e., data-parallel-degree == 1)
-  assert(model->config.data_parallelism_degree == 1);
+  // Each data-parallel replica gets its own copy of the activations, on its
+  // own devices: a pipeline stage spans data_parallelism_degree *
+  // tensor_parallelism_degree devices, of which replica j uses the j-th
+  // group of tensor_parallelism_degree
   model->config.batchSize = BatchConfig::max_tokens_per_batch();
   model->compile_inference();
   Context ctx = model->config.lg_ctx;
@@ -70,6 +134,39 @@ void InferenceManager::compile_model_and_allocate_buffer(FFModel *model) {
   int degree = model->config.data_parallelism_degree *
                model->config.tensor_parallelism_degree;
 
+  std::unordered_map<Op const *, int> expert_devices;
+  if (!model->config.expert_routing_file.empty()) {
+    std::string const &path = model->config.expert_routing_file;
+    std::ifstream ifs(path);
+    if (ifs &&
+        ExpertLoadBalancer::get_load_balancer()->load_routing_stats(ifs)) {
+      expert_devices =
+          place_expert_blocks(model, num_transformer_layers_per_stage);
+    } else if (ifs) {
+      log_inf_mgr.warning("Ignoring malformed expert routing file %s",
+                          path.c_str());
+    }
+    if (model->config.expert_routing_interval > 0) {
+      ExpertLoadBalancer::set_routing_file(path);
+      std::atexit(ExpertLoadBalancer::save_routing_stats);
+    }
+  }
+
+  // Live intervals of the operator outputs over the schedule. Outputs can
+  // only share regions with outputs of the same shape in the same pipeline
+  // stage, since a region is bound to its index space and devices.
+  std::vector<ActivationInterval> intervals;
+  std::vector<std::pair<int /*op_idx*/, int /*output*/>> interval_outputs;
+  std::unordered_map<ParallelTensor, int> output_interval;
+  std::unordered_map<ParallelTensorShape,
+                     std::unordered_map<MachineView, int>>
+      reuse_classes;
+  int num_reuse_classes = 0;
+  std::unordered_map<MachineView, int> stage_arenas;
+  std::vector<MachineView> arena_views;
+  std::vector<std::vector<MachineView>> op_machine_views(
+      model->operators.size());
+
   for (int op_idx = 0; op_idx < model->operators.size(); op_idx++) {
     Op const *op = model->operators[op_idx];
     // Skip weight operators
@@ -105,104 +202,92 @@ void InferenceManager::compile_model_and_allocate_buffer(FFModel *model) {
       }
       mv.start_device_id = degree * (layer_guid.transformer_layer_id /
                                      num_transformer_layers_per_stage);
-      assert(mv == op->outputs[0]->machine_view);
+      if (j == 0) {
+        assert(mv == op->outputs[0]->machine_view);
+      }
+      mv.start_device_id += j * model->config.tensor_parallelism_degree;
+      auto device_it = expert_devices.find(op);
+      if (device_it != expert_devices.end()) {
+        mv.start_device_id += device_it->second;
+      }
       machine_views.push_back(mv);
     }
-    // std::cout << "operator: " << op->name << std::endl;
-    // for (int i = 0; i < op->numInputs; i++) {
-    //   op->inputs[i]->print("input pt");
-    //   std::cout << "input mv: " << op->inputs[i]->machine_view << std::endl;
-    // }
-    // std::cout << "Op " << op->name << ": ";
+    op_machine_views[op_idx] = machine_views;
+    for (int j = 0; j < op->numInputs; j++) {
+      auto it = output_interval.find(op->inputs[j]);
+      if (it != output_interval.end()) {
+        intervals[it->second].last_op = op_idx;
+      }
+    }
     for (int i = 0; i < op->numOutputs; i++) {
       ParallelTensor pt_base = op->outputs[i];
-      assert(tensor_buffer.find(pt_base) == tensor_buffer.end());
-
+      assert(output_interval.find(pt_base) == output_interval.end());
       if (op->op_type == OP_REPLICATE) {
         assert(op->numInputs == 1 && op->numOutputs == 1);
       }
-      // pt_base->print("output pt");
-      // std::cout << "output mv: " << pt_base->machine_view << std::endl;
-
-      std::vector<ParallelTensor> list;
-      bool found_parallel_tensor = false;
-      // Always enable memory reuse
-      // if (model->cpu_offload) {
-      if (true) {
-        for (auto const &pre_pt : tensor_buffer) {
-          bool used_by_future_operator = false;
-          bool used_by_current_operator = false;
-          if (pre_pt.first->get_shape() != pt_base->get_shape()) {
-            // Continue if shape mismatches
-            continue;
-          }
-          // Skip if pre_pt and pt_base are in different pipeline stages
-          // we compare their pipeline stages using the machine views
-          // of the first data pipeline
-          if (pre_pt.second[0]->machine_view != machine_views[0]) {
-            continue;
-          }
-          // Check that pt cannot be used as an input to the current operator
-          for (int j = 0; j < op->numInputs; j++) {
-            if (parallel_tensor_list_overlaps(tensor_buffer[op->inputs[j]],
-                                              pre_pt.second)) {
-              used_by_current_operator = true;
-            }
-          }
-          for (int j = 0; j < i; j++) {
-            assert(tensor_buffer.find(op->outputs[j]) != tensor_buffer.end());
-            if (parallel_tensor_list_overlaps(tensor_buffer[op->outputs[j]],
-                                              pre_pt.second)) {
-              used_by_current_operator = true;
-            }
-          }
-          // Check that pt cannot be used by any subsequent operators
-          for (int op_idx2 = op_idx; op_idx2 < model->operators.size();
-               op_idx2++) {
-            Op const *op2 = model->operators[op_idx2];
-            for (int j = 0; j < op2->numInputs; j++) {
-              if (tensor_buffer.find(op2->inputs[j]) != tensor_buffer.end()) {
-                if (parallel_tensor_list_overlaps(tensor_buffer[op2->inputs[j]],
-                                                  pre_pt.second)) {
-                  used_by_future_operator = true;
-                }
-              }
-            }
-          }
-          if (!used_by_future_operator && !used_by_current_operator) {
-            found_parallel_tensor = true;
-            list = pre_pt.second;
-          }
-        }
-        if (!found_parallel_tensor) {
-          log_offload.print(
-              "Cannot find a previous tensor for operator(%d) output_idx(%d)",
-              op_idx,
-              i);
-        }
+      ParallelTensorShape shape = pt_base->get_shape();
+      auto class_it = reuse_classes[shape].find(machine_views[0]);
+      if (class_it == reuse_classes[shape].end()) {
+        class_it = reuse_classes[shape]
+                       .emplace(machine_views[0], num_reuse_classes++)
+                       .first;
       }
-      if (!found_parallel_tensor) {
-        for (int j = 0; j < model->config.data_parallelism_degree; j++) {
-          // Copy the metadata from pt_base to pt
-          ParallelTensor pt = new ParallelTensorBase(*pt_base);
-          pt->region =
-              runtime->create_logical_region(ctx,
-                                             pt_base->region.get_index_space(),
-                                             pt_base->region.get_field_space());
-          pt->part = runtime->get_logical_partition(
-              ctx, pt->region, pt_base->part.get_index_partition());
-          pt->machine_view = machine_views[j];
-          // std::cout << "output mv: " << pt->machine_view << std::endl;
-          Domain part_domain =
-              runtime->get_index_space_domain(ctx, pt_base->parallel_is);
-          assert(pt->machine_view.get_domain() == part_domain);
-          list.push_back(pt);
-        }
+      auto arena_it = stage_arenas.find(machine_views[0]);
+      if (arena_it == stage_arenas.end()) {
+        arena_it =
+            stage_arenas.emplace(machine_views[0], arena_views.size()).first;
+        arena_views.push_back(machine_views[0]);
       }
-      assert(tensor_buffer.find(pt_base) == tensor_buffer.end());
-      tensor_buffer[pt_base] = list;
+      ActivationInterval interval;
+      interval.first_op = op_idx;
+      interval.last_op = op_idx;
+      interval.bytes = shape.get_piece_size();
+      interval.reuse_class = class_it->second;
+      interval.arena = arena_it->second;
+      output_interval[pt_base] = intervals.size();
+      intervals.push_back(interval);
+      interval_outputs.push_back(std::make_pair(op_idx, i));
     }
-    // std::cout << std::endl;
+  }
+
+  // Bind each output to a region list: outputs planned into the same
+  // buffer share the regions created for the first of them
+  ActivationPlan plan = plan_activation_memory(intervals);
+  std::vector<std::vector<ParallelTensor>> buffers(plan.buffer_bytes.size());
+  for (size_t t = 0; t < intervals.size(); t++) {
+    int op_idx = interval_outputs[t].first;
+    ParallelTensor pt_base =
+        model->operators[op_idx]->outputs[interval_outputs[t].second];
+    std::vector<ParallelTensor> &list = buffers[plan.buffer[t]];
+    if (list.empty()) {
+      for (int j = 0; j < model->config.data_parallelism_degree; j++) {
+        // Copy the metadata from pt_base to pt
+        ParallelTensor pt = new ParallelTensorBase(*pt_base);
+        pt->region =
+            runtime->create_logical_region(ctx,
+                                           pt_base->region.get_index_space(),
+                                           pt_base->region.get_field_space());
+        pt->part = runtime->get_logical_partition(
+            ctx, pt->region, pt_base->part.get_index_partition());
+        pt->machine_view = op_machine_views[op_idx][j];
+        Domain part_domain =
+            runtime->get_index_space_domain(ctx, pt_base->parallel_is);
+        assert(pt->machine_view.get_domain() == part_domain);
+        list.push_back(pt);
+      }
+    }
+    assert(tensor_buffer.find(pt_base) == tensor_buffer.end());
+    tensor_buffer[pt_base] = list;
+  }
+  for (size_t a = 0; a < arena_views.size(); a++) {
+    log_inf_mgr.print("Activation memory per device of the stage starting at "
+                      "device %d: %.2f MB without reuse, %.2f MB with region "
+                      "reuse (%zu outputs, %zu regions)",
+                      arena_views[a].start_device_id,
+                      plan.naive_bytes[a] / 1e6,
+                      plan.reused_bytes[a] / 1e6,
+                      intervals.size(),
+                      buffers.size());
   }
 
   // Perform fusion optimizations
@@ -212,22 +297,20 @@ void InferenceManager::compile_model_and_allocate_buffer(FFModel *model) {
         stderr, "%zu operators before fusion...\n", model->operators.size());
     std::vector<Op *> new_operators;
     std::vector<Op *> old_operators = model->operators;
-    while (
-        model->apply_fusion(model->operators, new_operators, &tensor_buffer)) {
-      for (size_t i = 0; i < new_operators.size(); i++) {
-        for (int idx = 0; idx < new_operators[i]->numInputs; idx++) {
-          for (size_t j = i + 1; j < new_operators.size(); j++) {
-            if (new_operators[i]->inputs[idx]->owner_op == new_operators[j]) {
-              assert(false);
-            }
-          }
-        }
-      }
-      model->operators = new_operators;
-    }
+    int num_merged = model->apply_fusion_pass(
+        model->operators, new_operators, &tensor_buffer);
+    model->operators = new_operators;
     assert(model->check_operators_integrity(old_operators, &tensor_buffer));
     fprintf(stderr, "%zu operators after fusion...\n", model->operators.size());
+    fprintf(stderr,
+            "%d operators merged; operator launches per decoding step: %d "
+            "-> %d\n",
+            num_merged,
+            count_operator_launches(old_operators),
+            count_operator_launches(model->operators));
   }
+  model->assign_critical_path_priorities(&tensor_buffer);
+  model->assign_region_op_hashes(&tensor_buffer);
 
   // print optimized graph
   for (size_t i = 0; i < model->operators.size(); i++) {
@@ -340,6 +423,26 @@ FutureMap InferenceManager::inference(FFModel *model,
   //  We currently assume that the index-th batch will be placed
   //  on the device_index-th device (except for the experts layers)
   int batch_index = index % model->config.data_parallelism_degree;
+  // With pipeline parallelism, launches of independent micro-batches can
+  // overlap, each stage working on a different one, and data-parallel
+  // replicas run different batches at the same time. The per-device
+  // metadata is then loaded on the devices of the replica only, stage by
+  // stage, once the stage is done with the previous launch of the replica.
+  // Stage finish times are recorded when there is more than one stage.
+  int const num_stages = model->config.pipeline_parallelism_degree;
+  int const degree = model->config.data_parallelism_degree *
+                     model->config.tensor_parallelism_degree;
+  bool const per_stage_metadata =
+      num_stages > 1 || model->config.data_parallelism_degree > 1;
+  ReplicaKey const key = std::make_pair(model, batch_index);
+  int launch = 0;
+  // Per stage: the launches of all its operators, since the ones on side
+  // branches (that do not feed the last one) read the metadata too
+  std::map<int, std::vector<FutureMap>> stage_fms;
+  if (num_stages > 1) {
+    launch = num_launches[key]++;
+    record_stage_finish(model, batch_index, launch, -1, {bc});
+  }
   FutureMap fm;
   bool found_input_operator = false;
   for (size_t o = 0; o < model->operators.size(); o++) {
@@ -361,7 +464,14 @@ FutureMap InferenceManager::inference(FFModel *model,
         assert(op->numOutputs == 1);
         ParallelTensor pt = tensor_buffer[op->outputs[0]][batch_index];
         load_input_tokens_from_batch_config(model, bc, pt, model->handlers);
-        load_inference_metadata_batch_config(model, bc, model->handlers);
+        if (per_stage_metadata) {
+          for (int stage = 0; stage < num_stages; stage++) {
+            load_inference_metadata_batch_config(
+                model, bc, model->handlers, stage, batch_index);
+          }
+        } else {
+          load_inference_metadata_batch_config(model, bc, model->handlers);
+        }
       }
     }
 
@@ -386,6 +496,26 @@ FutureMap InferenceManager::inference(FFModel *model,
       assert(outputs[i]->parallel_is != IndexSpace::NO_SPACE);
     }
     fm = op->inference(*model, bc, inputs, outputs);
+    if (per_stage_metadata) {
+      stage_fms[op->outputs[0]->machine_view.start_device_id / degree]
+          .push_back(fm);
+    }
+  }
+  if (per_stage_metadata) {
+    std::vector<std::vector<Future>> &done = stage_futures[key];
+    done.assign(num_stages, std::vector<Future>());
+    for (auto const &it : stage_fms) {
+      for (FutureMap const &op_fm : it.second) {
+        Domain domain = op_fm.get_future_map_domain();
+        for (Domain::DomainPointIterator p(domain); p; p++) {
+          done[it.first].push_back(op_fm.get_future(*p));
+        }
+      }
+      if (num_stages > 1) {
+        record_stage_finish(
+            model, batch_index, launch, it.first, done[it.first]);
+      }
+    }
   }
   return fm;
 };
@@ -463,6 +593,95 @@ void InferenceManager::load_inference_metadata_batch_config(
   runtime->execute_index_space(ctx, launcher);
 }
 
+void InferenceManager::load_inference_metadata_batch_config(
+    FFModel *model,
+    BatchConfigFuture const &bc,
+    FFHandler *handlers,
+    int stage,
+    int replica) {
+  Context ctx = model->config.lg_ctx;
+  Runtime *runtime = model->config.lg_hlr;
+  ArgumentMap argmap;
+
+  // The devices of a replica within a stage are consecutive, see
+  // compile_model_and_allocate_buffer
+  int tp_degree = model->config.tensor_parallelism_degree;
+  int degree = model->config.data_parallelism_degree * tp_degree;
+  int first = stage * degree + replica * tp_degree;
+  Rect<1> task_rect(Point<1>(first), Point<1>(first + tp_degree - 1));
+  for (PointInRectIterator<1> it(task_rect); it(); it++) {
+    FFHandler handler = handlers[(*it)[0]];
+    argmap.set_point(*it, TaskArgument(&handler, sizeof(FFHandler)));
+  }
+
+  IndexLauncher launcher(RM_LOAD_BATCH_CONFIG_TASK_ID,
+                         Domain(task_rect),
+                         TaskArgument(nullptr, 0),
+                         argmap,
+                         Predicate::TRUE_PRED,
+                         false /*must*/,
+                         0 /*mapper_id*/,
+                         FFConfig::DataParallelism_GPU);
+  launcher.add_future(bc);
+  // The operators of the previous launch read the same metadata buffers
+  auto it = stage_futures.find(std::make_pair(model, replica));
+  if (it != stage_futures.end() && stage < (int)it->second.size()) {
+    for (Future const &f : it->second[stage]) {
+      launcher.add_future(f);
+    }
+  }
+  runtime->execute_index_space(ctx, launcher);
+}
+
+PipelineStageProfiler *InferenceManager::get_stage_profiler(FFModel *model,
+                                                            int replica) {
+  std::unique_ptr<PipelineStageProfiler> &profiler =
+      stage_profilers[std::make_pair(model, replica)];
+  if (profiler == nullptr) {
+    profiler.reset(
+        new PipelineStageProfiler(model->config.pipeline_parallelism_degree));
+  }
+  return profiler.get();
+}
+
+struct StageFinishArgs {
+  PipelineStageProfiler *profiler;
+  int launch;
+  int stage;
+};
+
+void InferenceManager::record_stage_finish(
+    FFModel *model,
+    int replica,
+    int launch,
+    int stage,
+    std::vector<Future> const &wait_for) {
+  Context ctx = model->config.lg_ctx;
+  Runtime *runtime = model->config.lg_hlr;
+  StageFinishArgs args;
+  args.profiler = get_stage_profiler(model, replica);
+  args.launch = launch;
+  args.stage = stage;
+  TaskLauncher launcher(RM_RECORD_STAGE_FINISH_TASK_ID,
+                        TaskArgument(&args, sizeof(StageFinishArgs)));
+  for (Future const &f : wait_for) {
+    launcher.add_future(f);
+  }
+  runtime->execute_task(ctx, launcher);
+}
+
+/*static*/
+void InferenceManager::record_stage_finish_task(
+    Task const *task,
+    std::vector<PhysicalRegion> const &regions,
+    Context ctx,
+    Runtime *runtime) {
+  assert(regions.size() == 0);
+  StageFinishArgs const *args = (StageFinishArgs const *)task->args;
+  args->profiler->record(
+      args->launch, args->stage, Realm::Clock::current_time_in_microseconds());
+}
+
 void InferenceManager::load_positions(FFModel *model,
                                       BatchConfigFuture const &bc,
                                       ParallelTensor position_input,
@@ -508,6 +727,168 @@ void FFModel::set_position_offset(int offset) {
   position_offset = offset;
 }
 
+void FFModel::apply_inference_fusion_patterns() {
+  int num_transformer_layers_per_stage =
+      current_transformer_layer_id / config.pipeline_parallelism_degree + 1;
+  std::unordered_map<Layer const *, int> layer_index;
+  for (size_t i = 0; i < layers.size(); i++) {
+    layer_index[layers[i]] = i;
+  }
+  std::vector<FusionNode> nodes(layers.size());
+  for (size_t i = 0; i < layers.size(); i++) {
+    Layer const *l = layers[i];
+    FusionNode &node = nodes[i];
+    node.op_type = l->op_type;
+    node.num_outputs = l->numOutputs;
+    node.group = l->layer_guid.transformer_layer_id /
+                 num_transformer_layers_per_stage;
+    for (int j = 0; j < l->numInputs; j++) {
+      auto it = layer_index.find(l->inputs[j]->owner_layer);
+      if (it == layer_index.end()) {
+        node.inputs.push_back(std::make_pair(-1, 0));
+      } else {
+        node.inputs.push_back(
+            std::make_pair(it->second, l->inputs[j]->owner_idx));
+      }
+    }
+    if (l->op_type == OP_LINEAR) {
+      // The activation slot of the Linear must still be free
+      long long value;
+      l->get_int_property("activation", value);
+      node.fusible = (ActiMode)value == AC_MODE_NONE;
+    } else if (l->op_type == OP_EW_ADD || l->op_type == OP_EW_MUL) {
+      // The fused kernels do not broadcast
+      Tensor const a = l->inputs[0], b = l->inputs[1];
+      node.fusible = a->data_type == b->data_type && a->num_dims == b->num_dims;
+      for (int d = 0; node.fusible && d < a->num_dims; d++) {
+        node.fusible = a->dims[d] == b->dims[d];
+      }
+    }
+  }
+
+  std::vector<FusionMatch> matches = plan_inference_fusion(nodes);
+  std::vector<Layer *> fused_layers(layers.size(), nullptr);
+  std::vector<bool> removed(layers.size(), false);
+  int num_matches[NUM_INFERENCE_FUSION_PATTERNS] = {0};
+  for (FusionMatch const &match : matches) {
+    Layer *anchor = layers[match.nodes.back()];
+    Layer *fused = nullptr;
+    switch (match.pattern) {
+      case FUSE_LINEAR_ACTIVATION: {
+        // The Linear applies the activation and takes over its output
+        fused = layers[match.nodes[0]];
+        assert(anchor->op_type == OP_RELU || anchor->op_type == OP_SIGMOID);
+        ActiMode activation =
+            anchor->op_type == OP_RELU ? AC_MODE_RELU : AC_MODE_SIGMOID;
+        fused->add_int_property("activation", activation);
+        fused->outputs[0] = anchor->outputs[0];
+        break;
+      }
+      case FUSE_RESIDUAL_RMS_NORM:
+      case FUSE_RESIDUAL_LAYER_NORM: {
+        Layer const *add = layers[match.nodes[0]];
+        bool rms = match.pattern == FUSE_RESIDUAL_RMS_NORM;
+        fused = new Layer(this,
+                          rms ? OP_RESIDUAL_RMS_NORM : OP_RESIDUAL_LAYERNORM,
+                          anchor->data_type,
+                          nullptr,
+                          2 /*inputs*/,
+                          anchor->numWeights,
+                          2 /*outputs*/,
+                          add->inputs[0],
+                          add->inputs[1]);
+        long long value;
+        float eps;
+        anchor->get_float_property("eps", eps);
+        fused->add_float_property("eps", eps);
+        if (rms) {
+          anchor->get_int_property("dim", value);
+          fused->add_int_property("dim", value);
+        } else {
+          std::vector<int> axes;
+          anchor->get_int_vector_property("axes", axes);
+          fused->add_int_vector_property("axes", axes);
+          anchor->get_int_property("elementwise_affine", value);
+          fused->add_int_property("elementwise_affine", value);
+          anchor->get_int_property("use_bias", value);
+          fused->add_int_property("use_bias", value);
+          fused->add_int_property("use_two_residuals", 0);
+        }
+        // The norm's weights keep their shapes and their layer name, so the
+        // weight loader finds them under the fused layer
+        for (int w = 0; w < anchor->numWeights; w++) {
+          fused->weights[w] = anchor->weights[w];
+          fused->weights[w]->owner_layer = fused;
+        }
+        fused->outputs[0] = add->outputs[0];
+        fused->outputs[1] = anchor->outputs[0];
+        break;
+      }
+      case FUSE_SIGMOID_SILU_MULTI: {
+        Layer const *sigmoid = layers[match.nodes[0]];
+        Layer const *gate = layers[match.nodes[1]];
+        Tensor up = anchor->inputs[0] == gate->outputs[0] ? anchor->inputs[1]
+                                                          : anchor->inputs[0];
+        fused = new Layer(this,
+                          OP_SIGMOID_SILU_MULTI,
+                          anchor->data_type,
+                          nullptr,
+                          2 /*inputs*/,
+                          0 /*weights*/,
+                          1 /*outputs*/,
+                          sigmoid->inputs[0],
+                          up);
+        fused->outputs[0] = anchor->outputs[0];
+        break;
+      }
+      default:
+        assert(false);
+    }
+    for (int k = 0; k < fused->numOutputs; k++) {
+      fused->outputs[k]->owner_layer = fused;
+      fused->outputs[k]->owner_idx = k;
+    }
+    if (match.pattern != FUSE_LINEAR_ACTIVATION) {
+      // A new layer takes the identity and the place of the anchor
+      std::strcpy(fused->name, anchor->name);
+      fused->layer_guid = anchor->layer_guid;
+      fused->profiling = anchor->profiling;
+      fused->inference_debugging = anchor->inference_debugging;
+      fused_layers[match.nodes.back()] = fused;
+    }
+    for (int u : match.nodes) {
+      removed[u] = layers[u] != fused;
+    }
+    num_matches[match.pattern]++;
+  }
+
+  int num_launches = 0;
+  std::vector<Layer *> new_layers;
+  for (size_t i = 0; i < layers.size(); i++) {
+    if (layers[i]->op_type != OP_INPUT && layers[i]->op_type != OP_WEIGHT) {
+      num_launches++;
+    }
+    if (fused_layers[i] != nullptr) {
+      new_layers.push_back(fused_layers[i]);
+    }
+    if (removed[i]) {
+      delete layers[i];
+    } else {
+      new_layers.push_back(layers[i]);
+    }
+  }
+  layers = new_layers;
+  for (int p = 0; p < NUM_INFERENCE_FUSION_PATTERNS; p++) {
+    log_inf_mgr.print(
+        "Fused %d %s patterns",
+        num_matches[p],
+        get_inference_fusion_pattern_name((InferenceFusionPattern)p));
+  }
+  log_inf_mgr.print("Layer launches per decoding step: %d -> %d",
+                    num_launches,
+                    num_launches - (int)(nodes.size() - layers.size()));
+}
+
 void FFModel::compile_inference() {
   // Request at least four CPU processors for inference runs
   assert(
@@ -518,6 +899,9 @@ void FFModel::compile_inference() {
   Context ctx = config.lg_ctx;
   Runtime *runtime = config.lg_hlr;
   config.computationMode = COMP_MODE_INFERENCE;
+  if (config.perform_fusion) {
+    apply_inference_fusion_patterns();
+  }
   create_operators_from_layers();
   // Launch the graph optimize task
   {
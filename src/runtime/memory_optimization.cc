@@ -14,9 +14,58 @@
  */
 
 #include "flexflow/memory_optimization.h"
+#include <algorithm>
+#include <map>
 
 namespace FlexFlow {
 
+std::unordered_map<int, float> estimate_peak_memory_per_device(
+    std::vector<OpMemoryFootprint> const &footprints) {
+  // Per device, a sweep over (step, delta) events: outputs are allocated at
+  // their producing step and released right after their last use
+  std::unordered_map<int, float> resident;
+  std::unordered_map<int, std::map<int, float>> events;
+  for (OpMemoryFootprint const &f : footprints) {
+    assert(f.last_use_step >= f.step);
+    for (int d : f.device_ids) {
+      resident[d] += f.weights_mb;
+      events[d][f.step] += f.outputs_mb;
+      events[d][f.last_use_step + 1] -= f.outputs_mb;
+    }
+  }
+
+  std::unordered_map<int, float> peak;
+  for (auto const &d : resident) {
+    float live = 0.0f, max_live = 0.0f;
+    for (auto const &e : events[d.first]) {
+      live += e.second;
+      max_live = std::max(max_live, live);
+    }
+    peak[d.first] = d.second + max_live;
+  }
+  return peak;
+}
+
+std::vector<MemorySearchPoint>
+    pareto_frontier(std::vector<MemorySearchPoint> const &points) {
+  std::vector<MemorySearchPoint> sorted = points;
+  std::sort(sorted.begin(),
+            sorted.end(),
+            [](MemorySearchPoint const &a, MemorySearchPoint const &b) {
+              if (a.run_time_cost != b.run_time_cost) {
+                return a.run_time_cost < b.run_time_cost;
+              }
+              return a.peak_memory_mb < b.peak_memory_mb;
+            });
+  std::vector<MemorySearchPoint> frontier;
+  for (MemorySearchPoint const &p : sorted) {
+    if (frontier.empty() || p.peak_memory_mb < frontier.back().peak_memory_mb) {
+      frontier.push_back(p);
+    }
+  }
+  return frontier;
+}
+
 namespace PCG {
 
 std::string MemoryUsage::to_string() const {
@@ -1520,6 +1520,10 @@ FFRuntime::FFRuntime(FFConfig &config) {
         config.cpu_offload ? config.offload_reserve_space_size : 0;
     info.quantization_type = config.quantization_type;
     info.allowTensorOpMathConversion = config.allow_tensor_op_math_conversion;
+    info.cpu_kernel_threads = config.cpu_kernel_threads;
+    info.cpu_weight_packing = config.cpu_weight_packing;
+    info.experts_grouped_gemm = config.experts_grouped_gemm;
+    info.expert_routing_interval = config.expert_routing_interval;
     argmap.set_point(*it, TaskArgument(&info, sizeof(FFInitInfo)));
   }
 
@@ -3024,6 +3028,97 @@ bool FFModel::apply_fusion(
   return false;
 }
 
+int FFModel::apply_fusion_pass(
+    std::vector<Op *> const &operators,
+    std::vector<Op *> &new_operators,
+    std::unordered_map<ParallelTensor, std::vector<ParallelTensor>>
+        *parallel_tensor_mapping) {
+  new_operators.clear();
+  // Position of each operator in new_operators, and the fused operator that
+  // each merged operator went into
+  std::unordered_map<Op const *, size_t> position;
+  std::unordered_map<Op const *, FusedOp *> fused_into;
+  int num_merged = 0;
+  for (size_t l = 0; l < operators.size(); l++) {
+    Op *opl = operators[l];
+    // Redirect inputs written by merged operators to their fused operator and
+    // find the latest producer, as apply_fusion does
+    size_t start = 0;
+    for (int idx = 0; idx < opl->numInputs; idx++) {
+      auto it = fused_into.find(opl->inputs[idx]->owner_op);
+      if (it != fused_into.end()) {
+        FusedOp *fused_op = it->second;
+        int found = -1;
+        for (int k = 0; k < fused_op->numOutputs; k++) {
+          if (fused_op->use_same_regions(fused_op->outputs[k],
+                                         opl->inputs[idx],
+                                         parallel_tensor_mapping)) {
+            assert(found == -1);
+            found = k;
+          }
+        }
+        assert(found >= 0);
+        opl->inputs[idx] = fused_op->outputs[found];
+      }
+      if (opl->inputs[idx]->owner_op != NULL) {
+        auto pos = position.find(opl->inputs[idx]->owner_op);
+        assert(pos != position.end());
+        start = std::max(start, pos->second);
+      }
+    }
+    // Same candidates as apply_fusion: not the first and last operators, no
+    // input and weight operators, and no parallel op except allReduce
+    bool merged = false;
+    if (l > 0 && l + 1 < operators.size() && opl->op_type != OP_INPUT &&
+        opl->op_type != OP_WEIGHT &&
+        (!opl->is_parallel_op() || opl->op_type == OP_ALLREDUCE)) {
+      for (size_t i = start; i < new_operators.size() && !merged; i++) {
+        Op *opi = new_operators[i];
+        if (opl->outputs[0]->machine_view != opi->outputs[0]->machine_view) {
+          continue;
+        }
+        FusedOp *fused_op = nullptr;
+        bool allocate_new_fused_op = false;
+        if (opi->op_type == OP_FUSED) {
+          fused_op = (FusedOp *)opi;
+        } else {
+          if (opi->has_inplace_output() || opi->op_type == OP_INPUT ||
+              opi->op_type == OP_WEIGHT ||
+              (opi->is_parallel_op() && opi->op_type != OP_ALLREDUCE)) {
+            continue;
+          }
+          fused_op = new FusedOp(*this, opi);
+          allocate_new_fused_op = true;
+        }
+        if (fused_op->add_operator(*this, opl, parallel_tensor_mapping)) {
+          if (allocate_new_fused_op) {
+            new_operators[i] = fused_op;
+            position[fused_op] = i;
+            fused_into[opi] = fused_op;
+          }
+          fused_into[opl] = fused_op;
+          merged = true;
+        } else if (allocate_new_fused_op) {
+          // The FusedOp constructor took over the outputs of opi
+          for (int k = 0; k < opi->numOutputs; k++) {
+            opi->outputs[k]->owner_op = opi;
+            opi->outputs[k]->owner_idx = k;
+          }
+          delete fused_op;
+        }
+      }
+    }
+    if (merged) {
+      num_merged++;
+    } else {
+      position[opl] = new_operators.size();
+      new_operators.push_back(opl);
+    }
+  }
+  assert(new_operators.size() + num_merged == operators.size());
+  return num_merged;
+}
+
 Op *FFModel::create_operator_from_layer(
     Layer *layer, std::vector<ParallelTensor> const &inputs) {
   switch (layer->op_type) {
@@ -3666,6 +3761,8 @@ void FFModel::compile(LossType loss_type,
     assert(optimizer != NULL);
     optimizer->init();
   }
+  assign_critical_path_priorities();
+  assign_region_op_hashes();
 
 #ifdef FF_USE_NCCL
   for (size_t l = 0; l < operators.size(); l++) {
@@ -3706,6 +3803,123 @@ void FFModel::compile(LossType loss_type,
 #endif
 }
 
+void FFModel::assign_critical_path_priorities(
+    std::unordered_map<ParallelTensor, std::vector<ParallelTensor>>
+        *pt_mapping) {
+  // operators are stored in topological order, so one pass in each direction
+  // computes the longest path from the sources (depth) and to the sinks
+  // (height) for every operator
+  std::unordered_map<Op const *, int> depth, height;
+  for (size_t l = 0; l < operators.size(); l++) {
+    Op const *op = operators[l];
+    int d = 0;
+    for (int i = 0; i < op->numInputs; i++) {
+      Op const *pre = op->inputs[i]->owner_op;
+      if (pre != nullptr && depth.find(pre) != depth.end()) {
+        d = std::max(d, depth[pre] + 1);
+      }
+    }
+    depth[op] = d;
+    height[op] = 0;
+  }
+  for (int l = (int)operators.size() - 1; l >= 0; l--) {
+    Op const *op = operators[l];
+    for (int i = 0; i < op->numInputs; i++) {
+      Op const *pre = op->inputs[i]->owner_op;
+      if (pre != nullptr && height.find(pre) != height.end()) {
+        height[pre] = std::max(height[pre], height[op] + 1);
+      }
+    }
+  }
+  std::unordered_map<RegionTreeID, int> priorities;
+  auto set_priority = [&](ParallelTensor const &pt, bool grad, int priority) {
+    std::vector<ParallelTensor> tensors;
+    if (pt_mapping != nullptr && pt_mapping->find(pt) != pt_mapping->end()) {
+      tensors = pt_mapping->at(pt);
+    } else {
+      tensors.push_back(pt);
+    }
+    for (auto const &t : tensors) {
+      LogicalRegion region = grad ? t->region_grad : t->region;
+      if (region == LogicalRegion::NO_REGION) {
+        continue;
+      }
+      // A region tree shared by several tensors (e.g., reused inference
+      // buffers) keeps the most critical rank
+      auto it = priorities.find(region.get_tree_id());
+      if (it == priorities.end() || it->second < priority) {
+        priorities[region.get_tree_id()] = priority;
+      }
+    }
+  };
+  for (size_t l = 0; l < operators.size(); l++) {
+    Op const *op = operators[l];
+    // Forward tasks write their outputs: the more work left downstream,
+    // the earlier they should run
+    for (int i = 0; i < op->numOutputs; i++) {
+      set_priority(op->outputs[i], false /*grad*/, height[op]);
+    }
+    // Backward tasks write the gradients of their inputs and weights and
+    // the remaining backward work is bounded by the operator's depth
+    if (config.computationMode == COMP_MODE_TRAINING) {
+      for (int i = 0; i < op->numInputs; i++) {
+        set_priority(op->inputs[i], true /*grad*/, depth[op]);
+      }
+      for (int i = 0; i < op->numWeights; i++) {
+        set_priority(op->weights[i], true /*grad*/, depth[op]);
+      }
+    }
+  }
+  FFMapper::set_region_priorities(priorities);
+}
+
+void FFModel::assign_region_op_hashes(
+    std::unordered_map<ParallelTensor, std::vector<ParallelTensor>>
+        *pt_mapping) {
+  // Weights belong to a single op; outputs can share a region tree with
+  // other ops (e.g., reused inference buffers), in which case the tree is
+  // dropped rather than attributed to the wrong op
+  std::unordered_map<RegionTreeID, size_t> op_hashes;
+  std::set<RegionTreeID> ambiguous;
+  auto assign = [&](ParallelTensor const &pt, size_t hash) {
+    std::vector<ParallelTensor> tensors;
+    if (pt_mapping != nullptr && pt_mapping->find(pt) != pt_mapping->end()) {
+      tensors = pt_mapping->at(pt);
+    } else {
+      tensors.push_back(pt);
+    }
+    for (auto const &t : tensors) {
+      if (t->region == LogicalRegion::NO_REGION) {
+        continue;
+      }
+      RegionTreeID tree_id = t->region.get_tree_id();
+      auto it = op_hashes.find(tree_id);
+      if (it == op_hashes.end()) {
+        op_hashes[tree_id] = hash;
+      } else if (it->second != hash) {
+        ambiguous.insert(tree_id);
+      }
+    }
+  };
+  for (size_t l = 0; l < operators.size(); l++) {
+    Op const *op = operators[l];
+    size_t hash = get_op_parameters_hash(op);
+    if (hash == 0) {
+      continue;
+    }
+    for (int i = 0; i < op->numWeights; i++) {
+      assign(op->weights[i], hash);
+    }
+    for (int i = 0; i < op->numOutputs; i++) {
+      assign(op->outputs[i], hash);
+    }
+  }
+  for (RegionTreeID tree_id : ambiguous) {
+    op_hashes.erase(tree_id);
+  }
+  FFMapper::set_region_op_hashes(op_hashes);
+}
+
 bool FFModel::check_operators_integrity(
     std::vector<Op *> const &old_operators,
     std::unordered_map<ParallelTensor, std::vector<ParallelTensor>>
@@ -4084,6 +4298,10 @@ struct DefaultConfig {
   const static bool enableAttributeParallel = false;
   const static bool enableInplaceOptimizations = false;
   const static bool allowTensorOpMathConversion = false;
+  const static int cpuKernelThreads = 1;
+  const static bool cpuWeightPacking = true;
+  const static bool expertsGroupedGemm = false;
+  const static int expertRoutingInterval = 0;
   const static int machine_model_version = 0;
   const static int simulator_segment_size = 16777216; // 16 MB
   const static int simulator_max_num_segments = 1;
@@ -4105,6 +4323,7 @@ FFConfig::FFConfig() {
   numNodes = DefaultConfig::numNodes;
   cpusPerNode = DefaultConfig::cpusPerNode;
   workersPerNode = DefaultConfig::workersPerNode;
+  device_mem = 0;
   simulator_work_space_size = DefaultConfig::simulatorWorkSpaceSize;
   search_budget = DefaultConfig::searchBudget;
   search_alpha = DefaultConfig::searchAlpha;
@@ -4122,6 +4341,10 @@ FFConfig::FFConfig() {
   enable_attribute_parallel = DefaultConfig::enableAttributeParallel;
   enable_inplace_optimizations = DefaultConfig::enableInplaceOptimizations;
   allow_tensor_op_math_conversion = DefaultConfig::allowTensorOpMathConversion;
+  cpu_kernel_threads = DefaultConfig::cpuKernelThreads;
+  cpu_weight_packing = DefaultConfig::cpuWeightPacking;
+  experts_grouped_gemm = DefaultConfig::expertsGroupedGemm;
+  expert_routing_interval = DefaultConfig::expertRoutingInterval;
   machine_model_version = DefaultConfig::machine_model_version;
   simulator_segment_size = DefaultConfig::simulator_segment_size;
   simulator_max_num_segments = DefaultConfig::simulator_max_num_segments;
@@ -4135,6 +4358,8 @@ FFConfig::FFConfig() {
   export_strategy_computation_graph_file = "";
   dataset_path = "";
   substitution_json_path = tl::nullopt;
+  measured_cost_file = "";
+  expert_routing_file = "";
   syntheticInput = false;
   perform_fusion = false;
   base_optimize_threshold = DefaultConfig::base_optimize_threshold;
@@ -4296,6 +4521,26 @@ void FFConfig::parse_args(char **argv, int argc) {
       allow_tensor_op_math_conversion = true;
       continue;
     }
+    if (!strcmp(argv[i], "--cpu-kernel-threads")) {
+      cpu_kernel_threads = atoi(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--disable-cpu-weight-packing")) {
+      cpu_weight_packing = false;
+      continue;
+    }
+    if (!strcmp(argv[i], "--experts-grouped-gemm")) {
+      experts_grouped_gemm = true;
+      continue;
+    }
+    if (!strcmp(argv[i], "--expert-routing-interval")) {
+      expert_routing_interval = atoi(argv[++i]);
+      continue;
+    }
+    if (!strcmp(argv[i], "--expert-routing-file")) {
+      expert_routing_file = std::string(argv[++i]);
+      continue;
+    }
     if (!strcmp(argv[i], "--fusion")) {
       perform_fusion = true;
       continue;
@@ -4363,6 +4608,10 @@ void FFConfig::parse_args(char **argv, int argc) {
       substitution_json_path = std::string(argv[++i]);
       continue;
     }
+    if (!strcmp(argv[i], "--measured-costs")) {
+      measured_cost_file = std::string(argv[++i]);
+      continue;
+    }
     if (!strcmp(argv[i], "--memory-search")) {
       perform_memory_search = true;
       continue;
@@ -4546,6 +4795,24 @@ void register_flexflow_internal_tasks(Runtime *runtime,
           registrar);
     }
   }
+  // InferenceManager record_stage_finish
+  {
+    TaskVariantRegistrar registrar(RM_RECORD_STAGE_FINISH_TASK_ID,
+                                   "InferenceManager Record Stage Finish");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<
+          InferenceManager::record_stage_finish_task>(
+          registrar, "InferenceManager Record Stage Finish Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<
+          InferenceManager::record_stage_finish_task>(registrar);
+    }
+  }
   // ElementUnary task
   {
     TaskVariantRegistrar registrar(ELEMENTUNARY_INIT_TASK_ID,
@@ -4727,6 +4994,21 @@ void register_flexflow_internal_tasks(Runtime *runtime,
       runtime->register_task_variant<Experts::inference_task>(registrar);
     }
   }
+  {
+    TaskVariantRegistrar registrar(EXPERTS_INF_TASK_ID,
+                                   "Experts Inference CPU");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<Experts::inference_task_cpu>(
+          registrar, "Experts Inference Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<Experts::inference_task_cpu>(registrar);
+    }
+  }
   // Cast
   {
     TaskVariantRegistrar registrar(CAST_INIT_TASK_ID, "Cast Init");
@@ -4906,6 +5188,22 @@ void register_flexflow_internal_tasks(Runtime *runtime,
       runtime->register_task_variant<Embedding::inference_task>(registrar);
     }
   }
+  {
+    TaskVariantRegistrar registrar(EMBED_INF_TASK_ID,
+                                   "Embedding Inference CPU");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<Embedding::inference_task_cpu>(
+          registrar, "Embedding Inference Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<Embedding::inference_task_cpu>(
+          registrar);
+    }
+  }
   {
     TaskVariantRegistrar registrar(EMBED_BWD_TASK_ID, "Embedding Backward");
     registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
@@ -5051,6 +5349,21 @@ void register_flexflow_internal_tasks(Runtime *runtime,
       runtime->register_task_variant<Group_by::forward_task>(registrar);
     }
   }
+  {
+    TaskVariantRegistrar registrar(GROUP_BY_FWD_TASK_ID,
+                                   "Group_by Forward CPU");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<Group_by::forward_task_cpu>(
+          registrar, "Group_by Forward Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<Group_by::forward_task_cpu>(registrar);
+    }
+  }
   {
     TaskVariantRegistrar registrar(GROUP_BY_BWD_TASK_ID, "Group_by Backward");
     registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
@@ -5095,6 +5408,21 @@ void register_flexflow_internal_tasks(Runtime *runtime,
       runtime->register_task_variant<Aggregate::forward_task>(registrar);
     }
   }
+  {
+    TaskVariantRegistrar registrar(AGGREGATE_FWD_TASK_ID,
+                                   "Aggregate Forward CPU");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<Aggregate::forward_task_cpu>(
+          registrar, "Aggregate Forward Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<Aggregate::forward_task_cpu>(registrar);
+    }
+  }
   {
     TaskVariantRegistrar registrar(AGGREGATE_BWD_TASK_ID, "Aggregate Backward");
     registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
@@ -5276,6 +5604,21 @@ void register_flexflow_internal_tasks(Runtime *runtime,
       runtime->register_task_variant<BatchMatmul::forward_task>(registrar);
     }
   }
+  {
+    TaskVariantRegistrar registrar(BATCHMATMUL_FWD_TASK_ID,
+                                   "BatchMatmul Forward CPU");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<BatchMatmul::forward_task_cpu>(
+          registrar, "BatchMatmul Forward Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<BatchMatmul::forward_task_cpu>(registrar);
+    }
+  }
   {
     TaskVariantRegistrar registrar(BATCHMATMUL_BWD_TASK_ID,
                                    "BatchMatmul Backward");
@@ -5369,6 +5712,22 @@ void register_flexflow_internal_tasks(Runtime *runtime,
           registrar);
     }
   }
+  {
+    TaskVariantRegistrar registrar(RESIDUAL_LAYERNORM_INF_TASK_ID,
+                                   "residual_layernorm_fwd_task_cpu");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<ResidualLayerNorm::inference_task_cpu>(
+          registrar, "residual_layernorm_inference_task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<ResidualLayerNorm::inference_task_cpu>(
+          registrar);
+    }
+  }
   // AddBiasResidualLayerNorm task
   {
     TaskVariantRegistrar registrar(ADD_BIAS_RESIDUAL_LAYERNORM_INIT_TASK_ID,
@@ -5405,6 +5764,23 @@ void register_flexflow_internal_tasks(Runtime *runtime,
           registrar);
     }
   }
+  {
+    TaskVariantRegistrar registrar(ADD_BIAS_RESIDUAL_LAYERNORM_INF_TASK_ID,
+                                   "add_bias_residual_layernorm_fwd_task_cpu");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<
+          AddBiasResidualLayerNorm::inference_task_cpu>(
+          registrar, "add_bias_residual_layernorm_inference_task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<
+          AddBiasResidualLayerNorm::inference_task_cpu>(registrar);
+    }
+  }
   // SigmoidSiluMulti task
   {
     TaskVariantRegistrar registrar(SIGMOID_SILU_MULTI_INIT_TASK_ID,
@@ -5438,6 +5814,22 @@ void register_flexflow_internal_tasks(Runtime *runtime,
           registrar);
     }
   }
+  {
+    TaskVariantRegistrar registrar(SIGMOID_SILU_MULTI_INF_TASK_ID,
+                                   "SigmoidSiluMulti Inference CPU");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<SigmoidSiluMulti::inference_task_cpu>(
+          registrar, "SigmoidSiluMulti Inference Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<SigmoidSiluMulti::inference_task_cpu>(
+          registrar);
+    }
+  }
   // rms norm task
   {
     TaskVariantRegistrar registrar(RMSNORM_INIT_TASK_ID, "rmsnorm_init_task");
@@ -5481,6 +5873,21 @@ void register_flexflow_internal_tasks(Runtime *runtime,
       runtime->register_task_variant<RMSNorm::inference_task>(registrar);
     }
   }
+  {
+    TaskVariantRegistrar registrar(RMSNORM_INF_TASK_ID,
+                                   "RMS Norm Inference CPU");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<RMSNorm::inference_task_cpu>(
+          registrar, "RMS Norm Inference Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<RMSNorm::inference_task_cpu>(registrar);
+    }
+  }
   // rms norm task
   {
     TaskVariantRegistrar registrar(RESIDUAL_RMSNORM_INIT_TASK_ID,
@@ -5514,6 +5921,22 @@ void register_flexflow_internal_tasks(Runtime *runtime,
           registrar);
     }
   }
+  {
+    TaskVariantRegistrar registrar(RESIDUAL_RMSNORM_INF_TASK_ID,
+                                   "Residual RMS Norm Inference CPU");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<ResidualRMSNorm::inference_task_cpu>(
+          registrar, "Residual RMS Norm Inference Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<ResidualRMSNorm::inference_task_cpu>(
+          registrar);
+    }
+  }
   {
     TaskVariantRegistrar registrar(LAYERNORM_BWD_TASK_ID, "layernorm_bwd_task");
     registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
@@ -5557,6 +5980,20 @@ void register_flexflow_internal_tasks(Runtime *runtime,
       runtime->register_task_variant<Linear::inference_task>(registrar);
     }
   }
+  {
+    TaskVariantRegistrar registrar(LINEAR_INF_TASK_ID, "Linear Inference CPU");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<Linear::inference_task_cpu>(
+          registrar, "Linear Inference Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<Linear::inference_task_cpu>(registrar);
+    }
+  }
   {
     TaskVariantRegistrar registrar(LINEAR_FWD_TASK_ID, "Linear Forward");
     registrar.add_constraint(ProcessorConstraint(Processor::TOC_PROC));
@@ -6110,6 +6547,23 @@ void register_flexflow_internal_tasks(Runtime *runtime,
           registrar);
     }
   }
+  {
+    TaskVariantRegistrar registrar(SAMPLING_INF_TASK_ID,
+                                   "Sampling Inference CPU");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<InferenceResult,
+                                        Sampling::inference_task_cpu>(
+          registrar, "Sampling Inference Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<InferenceResult,
+                                     Sampling::inference_task_cpu>(registrar);
+    }
+  }
   // ArgMax task
   {
     TaskVariantRegistrar registrar(ARGMAX_INIT_TASK_ID, "ArgMax Init");
@@ -6160,6 +6614,24 @@ void register_flexflow_internal_tasks(Runtime *runtime,
               registrar);
     }
   }
+  {
+    TaskVariantRegistrar registrar(ARGMAX_NORM_INF_TASK_ID,
+                                   "ArgMax Norm Inference CPU");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<InferenceResult,
+                                        ArgMax::inference_task_norm_cpu>(
+          registrar, "ArgMax Inference Task Norm");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<InferenceResult,
+                                     ArgMax::inference_task_norm_cpu>(
+          registrar);
+    }
+  }
   // Transpose task
   {
     TaskVariantRegistrar registrar(TRANSPOSE_INIT_TASK_ID, "Transpose Init");
@@ -6289,6 +6761,23 @@ void register_flexflow_internal_tasks(Runtime *runtime,
           registrar);
     }
   }
+  {
+    TaskVariantRegistrar registrar(INC_MULTIHEAD_SELF_ATTENTION_INF_TASK_ID,
+                                   "IncMultiHeadSelfAttention Inference CPU");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<
+          IncMultiHeadSelfAttention::inference_task_cpu>(
+          registrar, "IncMultiHeadSelfAttention Inference Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<
+          IncMultiHeadSelfAttention::inference_task_cpu>(registrar);
+    }
+  }
   // speculative MultiHeadAttention task
   {
     TaskVariantRegistrar registrar(
@@ -6328,6 +6817,24 @@ void register_flexflow_internal_tasks(Runtime *runtime,
           SpecIncMultiHeadSelfAttention::inference_task>(registrar);
     }
   }
+  {
+    TaskVariantRegistrar registrar(
+        SPEC_INC_MULTIHEAD_SELF_ATTENTION_INF_TASK_ID,
+        "Speculative IncMultiHeadSelfAttention Inference CPU");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<
+          SpecIncMultiHeadSelfAttention::inference_task_cpu>(
+          registrar, "Speculative IncMultiHeadSelfAttention Inference Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<
+          SpecIncMultiHeadSelfAttention::inference_task_cpu>(registrar);
+    }
+  }
   {
     TaskVariantRegistrar registrar(
         TREE_INC_MULTIHEAD_SELF_ATTENTION_INIT_TASK_ID,
@@ -6366,6 +6873,24 @@ void register_flexflow_internal_tasks(Runtime *runtime,
           TreeIncMultiHeadSelfAttention::inference_task>(registrar);
     }
   }
+  {
+    TaskVariantRegistrar registrar(
+        TREE_INC_MULTIHEAD_SELF_ATTENTION_INF_TASK_ID,
+        "TreeIncMultiHeadSelfAttention Inference CPU");
+    registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    registrar.set_leaf();
+    if (pre_register) {
+      Runtime::preregister_task_variant<
+          TreeIncMultiHeadSelfAttention::inference_task_cpu>(
+          registrar, "TreeIncMultiHeadSelfAttention Inference Task");
+    } else {
+      if (enable_control_replication) {
+        registrar.global_registration = false;
+      }
+      runtime->register_task_variant<
+          TreeIncMultiHeadSelfAttention::inference_task_cpu>(registrar);
+    }
+  }
   // NoOp
   {
     TaskVariantRegistrar registrar(NOOP_INIT_TASK_ID, "Weight NCCL Init");
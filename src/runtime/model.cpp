@@ -91,6 +91,10 @@ FFHandler
   FFHandler handle;
   handle.workSpaceSize = info->workSpaceSize;
   handle.allowTensorOpMathConversion = info->allowTensorOpMathConversion;
+  handle.cpu_kernel_threads = info->cpu_kernel_threads;
+  handle.cpu_weight_packing = info->cpu_weight_packing;
+  handle.experts_grouped_gemm = info->experts_grouped_gemm;
+  handle.expert_routing_interval = info->expert_routing_interval;
   checkCUDA(hipblasCreate(&handle.blas));
   if (handle.allowTensorOpMathConversion) {
     // not supported yet
@@ -89,6 +89,10 @@ FFHandler
   handle.offload_reserve_space_size = info->offload_reserve_space_size;
   handle.quantization_type = info->quantization_type;
   handle.allowTensorOpMathConversion = info->allowTensorOpMathConversion;
+  handle.cpu_kernel_threads = info->cpu_kernel_threads;
+  handle.cpu_weight_packing = info->cpu_weight_packing;
+  handle.experts_grouped_gemm = info->experts_grouped_gemm;
+  handle.expert_routing_interval = info->expert_routing_interval;
   checkCUDA(cublasCreate(&handle.blas));
   if (handle.allowTensorOpMathConversion) {
     checkCUDA(cublasSetMathMode(handle.blas, CUBLAS_TENSOR_OP_MATH));
@@ -167,4 +167,12 @@ tl::optional<OperatorParameters> get_op_parameters(Op const *op) {
   }
 }
 
+size_t get_op_parameters_hash(Op const *op) {
+  tl::optional<OperatorParameters> params = get_op_parameters(op);
+  if (!params.has_value()) {
+    return 0;
+  }
+  return std::hash<OperatorParameters>()(params.value());
+}
+
 }; // namespace FlexFlow
@@ -0,0 +1,94 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "flexflow/pipeline_stage_profiler.h"
+#include <algorithm>
+#include <cassert>
+
+namespace FlexFlow {
+
+PipelineStageProfiler::PipelineStageProfiler(int _num_stages)
+    : num_stages(_num_stages) {
+  assert(num_stages > 0);
+}
+
+void PipelineStageProfiler::record(int launch, int stage, double time_us) {
+  assert(stage >= -1 && stage < num_stages);
+  std::lock_guard<std::mutex> lock(mutex);
+  finish_time[std::make_pair(launch, stage)] = time_us;
+}
+
+int PipelineStageProfiler::get_num_stages() const {
+  return num_stages;
+}
+
+std::vector<double> PipelineStageProfiler::busy_time() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<double> busy(num_stages, 0.0);
+  for (int s = 0; s < num_stages; s++) {
+    // Launches in the order the stage finished them
+    std::vector<std::pair<double, int>> finishes;
+    for (auto const &it : finish_time) {
+      if (it.first.second == s) {
+        finishes.push_back(std::make_pair(it.second, it.first.first));
+      }
+    }
+    std::sort(finishes.begin(), finishes.end());
+    double previous = -1.0;
+    for (auto const &f : finishes) {
+      double start = previous;
+      auto input = finish_time.find(std::make_pair(f.second, s - 1));
+      if (input != finish_time.end()) {
+        start = std::max(start, input->second);
+      }
+      if (start >= 0.0) {
+        busy[s] += std::max(0.0, f.first - start);
+      }
+      previous = f.first;
+    }
+  }
+  return busy;
+}
+
+std::vector<double> PipelineStageProfiler::utilization() const {
+  std::vector<double> busy = busy_time();
+  double first = -1.0, last = -1.0;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto const &it : finish_time) {
+      if (it.first.second == -1 && (first < 0.0 || it.second < first)) {
+        first = it.second;
+      }
+      if (it.first.second == num_stages - 1) {
+        last = std::max(last, it.second);
+      }
+    }
+  }
+  std::vector<double> utilization(num_stages, 0.0);
+  if (first >= 0.0 && last > first) {
+    for (int s = 0; s < num_stages; s++) {
+      utilization[s] = busy[s] / (last - first);
+    }
+  }
+  return utilization;
+}
+
+void PipelineStageProfiler::reset() {
+  std::lock_guard<std::mutex> lock(mutex);
+  finish_time.clear();
+}
+
+}; // namespace FlexFlow
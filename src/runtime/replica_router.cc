@@ -0,0 +1,90 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+#include "flexflow/replica_router.h"
+#include <algorithm>
+#include <cassert>
+
+namespace FlexFlow {
+
+ReplicaRouter::ReplicaRouter(int _num_replicas)
+    : num_replicas(_num_replicas), queued_load(_num_replicas, 0),
+      cached_load(_num_replicas, 0) {
+  assert(num_replicas > 0);
+}
+
+int ReplicaRouter::get_num_replicas() const {
+  return num_replicas;
+}
+
+size_t ReplicaRouter::queued(RequestLoad const &load) const {
+  return load.num_prompt_tokens -
+         std::min(load.num_prompt_tokens, load.num_cached_tokens);
+}
+
+int ReplicaRouter::route(RequestGuid guid, size_t num_tokens) {
+  assert(requests.find(guid) == requests.end());
+  int best = 0;
+  for (int r = 1; r < num_replicas; r++) {
+    if (queued_load[r] + cached_load[r] <
+        queued_load[best] + cached_load[best]) {
+      best = r;
+    }
+  }
+  RequestLoad load;
+  load.replica = best;
+  load.num_prompt_tokens = num_tokens;
+  load.num_cached_tokens = 0;
+  requests[guid] = load;
+  queued_load[best] += num_tokens;
+  return best;
+}
+
+void ReplicaRouter::update(RequestGuid guid, size_t num_cached_tokens) {
+  auto it = requests.find(guid);
+  assert(it != requests.end());
+  RequestLoad &load = it->second;
+  queued_load[load.replica] -= queued(load);
+  cached_load[load.replica] -= load.num_cached_tokens;
+  load.num_cached_tokens = num_cached_tokens;
+  queued_load[load.replica] += queued(load);
+  cached_load[load.replica] += load.num_cached_tokens;
+}
+
+void ReplicaRouter::release(RequestGuid guid) {
+  auto it = requests.find(guid);
+  assert(it != requests.end());
+  RequestLoad const &load = it->second;
+  queued_load[load.replica] -= queued(load);
+  cached_load[load.replica] -= load.num_cached_tokens;
+  requests.erase(it);
+}
+
+int ReplicaRouter::get_replica(RequestGuid guid) const {
+  auto it = requests.find(guid);
+  assert(it != requests.end());
+  return it->second.replica;
+}
+
+std::vector<size_t> ReplicaRouter::queued_tokens() const {
+  return queued_load;
+}
+
+std::vector<size_t> ReplicaRouter::cached_tokens() const {
+  return cached_load;
+}
+
+}; // namespace FlexFlow
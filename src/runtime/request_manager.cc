@@ -16,6 +16,7 @@
 #include "flexflow/request_manager.h"
 #include "flexflow/parallel_ops/parallel_op.h"
 // #include "flexflow/tokenizers.h"
+#include <atomic>
 #include <bitset>
 #include <filesystem>
 #include <future>
@@ -23,6 +24,7 @@
 #include <new>
 #include <stack>
 #include <stdexcept>
+#include <thread>
 
 namespace FlexFlow {
 
@@ -45,8 +47,8 @@ std::string LoadBytesFromFile(std::string const &path) {
 
 RequestManager::RequestManager()
     : request_manager_status(INITIALIZED), verbose(false),
-      next_available_guid(1000000), num_processed_requests(0),
-      total_request_run_time(0.0f) {
+      replica_queues(1), next_available_guid(1000000),
+      num_processed_requests(0), total_request_run_time(0.0f) {
   // The following config parameters are set
   // during ffmodel.compile()
   // Initialize them to -1 to make sure no one
@@ -55,6 +57,7 @@ RequestManager::RequestManager()
   max_requests_per_batch = -1;
   max_tokens_per_batch = -1;
   max_sequence_length = -1;
+  num_micro_batches = 0;
 }
 
 void RequestManager::set_max_requests_per_batch(int max_num_requests) {
@@ -80,6 +83,15 @@ int RequestManager::get_max_tokens_per_batch() {
   return max_tokens_per_batch;
 }
 
+void RequestManager::set_num_micro_batches(int _num_micro_batches) {
+  assert(_num_micro_batches >= 0);
+  num_micro_batches = _num_micro_batches;
+}
+
+int RequestManager::get_num_micro_batches() {
+  return std::max(num_micro_batches, 1);
+}
+
 int RequestManager::get_max_verify_tokens_per_batch() {
   assert(max_tokens_per_batch > 0);
   return max_tokens_per_batch +
@@ -117,8 +129,10 @@ void RequestManager::register_tokenizer(ModelType type,
                             (path.size() - strlen("tokenizer.model"));
     std::string tokenizer_filepath =
         path_to_file ? path : tokenizer_folder + "tokenizer.model";
-    this->tokenizer_ =
-        Tokenizer::FromBlobSentencePiece(LoadBytesFromFile(tokenizer_filepath));
+    std::string blob = LoadBytesFromFile(tokenizer_filepath);
+    tokenizer_factory = [blob]() {
+      return Tokenizer::FromBlobSentencePiece(blob);
+    };
   } else if (model_type == ModelType::OPT) {
     std::string vocab_file = tokenizer_folder + "vocab.json";
     std::string merges_file = tokenizer_folder + "merges.txt";
@@ -136,14 +150,22 @@ void RequestManager::register_tokenizer(ModelType type,
     std::string merges = LoadBytesFromFile(path2.string());
     std::string added_tokens = LoadBytesFromFile(path3.string());
 
-    this->tokenizer_ =
-        Tokenizer::FromBlobByteLevelBPE(vocab, merges, added_tokens);
+    tokenizer_factory = [vocab, merges, added_tokens]() {
+      return Tokenizer::FromBlobByteLevelBPE(vocab, merges, added_tokens);
+    };
   } else if (model_type == ModelType::FALCON ||
              model_type == ModelType::STARCODER ||
              model_type == ModelType::MPT) {
     std::string falcon_tokenizer_path = join_path({path, "tokenizer.json"});
-    this->tokenizer_ =
-        Tokenizer::FromBlobJSON(LoadBytesFromFile(falcon_tokenizer_path));
+    std::string blob = LoadBytesFromFile(falcon_tokenizer_path);
+    tokenizer_factory = [blob]() { return Tokenizer::FromBlobJSON(blob); };
+  }
+  if (tokenizer_factory) {
+    this->tokenizer_ = tokenizer_factory();
+  }
+  {
+    const std::lock_guard<std::mutex> lock(worker_tokenizers_mutex);
+    worker_tokenizers.clear();
   }
 }
 
@@ -168,6 +190,74 @@ size_t RequestManager::get_num_ssms() {
   return ssm_models.size();
 }
 
+RequestManager::RequestGuid
+    RequestManager::enqueue_request(Request &request,
+                                    std::string const &prompt) {
+  request.status = Request::PENDING;
+  request.guid = next_available_guid++;
+  for (int i = 0; i < get_num_ssms(); i++) {
+    BeamTree beam_tree = BeamTree{};
+    request.beam_trees.push_back(beam_tree);
+  }
+
+  pending_request_queue.push(request);
+  all_requests[request.guid] = request;
+  {
+    const std::lock_guard<std::mutex> lock(request_to_promise_mutex);
+    request_to_promise[request.guid] = new std::promise<void>();
+  }
+
+  GenerationResult gr;
+  gr.guid = request.guid;
+  gr.input_text = prompt;
+  gr.input_tokens = request.tokens;
+  gr.output_text = prompt;
+  gr.output_tokens = request.tokens;
+  request_generation_results[request.guid] = gr;
+  return request.guid;
+}
+
+std::string const &RequestManager::update_output_text(Request &request,
+                                                     bool flush) {
+  GenerationResult &gr = request_generation_results[request.guid];
+  assert(gr.guid == request.guid);
+  if (request.detokenizer.num_tokens_read() == 0) {
+    // Replace the prompt as given by the prompt as decoded
+    gr.output_text = "";
+    // Unlike Huggingface, the sentencepiece C++ library automatically
+    // removes the BOS token
+    if (model_type == ModelType::LLAMA &&
+        request.tokens.at(0) == bos_token_id) {
+      gr.output_text = "<s> ";
+    }
+  }
+  gr.output_text += request.detokenizer.step(
+      request.tokens,
+      [this](std::vector<int32_t> const &tokens) {
+        return this->tokenizer_->Decode(tokens);
+      },
+      flush);
+  return gr.output_text;
+}
+
+bool RequestManager::load_prompt_tokens(std::vector<int32_t> const &tokens,
+                                        Request &request) {
+  if (tokens.size() >= get_max_sequence_length()) {
+    std::cout << "Warning: too many tokens in prompt, only load up to "
+              << get_max_sequence_length() << " tokens, but got "
+              << tokens.size() << ".\n";
+
+    printf("tokens size: %zu\n", tokens.size());
+    return false;
+  }
+  if (bos_token_id >= 0 && model_type != ModelType::FALCON) {
+    request.tokens.push_back(bos_token_id);
+  }
+  request.tokens.insert(request.tokens.end(), tokens.begin(), tokens.end());
+  request.initial_len = request.tokens.size();
+  return true;
+}
+
 RequestManager::RequestGuid
     RequestManager::register_new_request(std::vector<TokenId> const &prompt,
                                          int max_sequence_length) {
@@ -175,8 +265,6 @@ RequestManager::RequestGuid
 
   // Add a new request
   Request request;
-  request.status = Request::PENDING;
-  request.guid = next_available_guid++;
   request.max_sequence_length = max_sequence_length;
 
   if (prompt.size() >= get_max_sequence_length()) {
@@ -197,17 +285,6 @@ RequestManager::RequestGuid
               << std::endl;
   } else {
     std::cout << "Num of SSMs: " << get_num_ssms() << std::endl;
-    for (int i = 0; i < get_num_ssms(); i++) {
-      BeamTree beam_tree = BeamTree{};
-      request.beam_trees.push_back(beam_tree);
-    }
-  }
-
-  pending_request_queue.push(request);
-  all_requests[request.guid] = request;
-  {
-    const std::lock_guard<std::mutex> lock(request_to_promise_mutex);
-    request_to_promise[request.guid] = new std::promise<void>();
   }
 
   if (verbose) {
@@ -217,15 +294,7 @@ RequestManager::RequestGuid
     }
   }
 
-  GenerationResult gr;
-  gr.guid = request.guid;
-  gr.input_text = "";
-  gr.input_tokens = prompt;
-  gr.output_text = "";
-  gr.output_tokens = prompt;
-  request_generation_results[request.guid] = gr;
-
-  return request.guid;
+  return enqueue_request(request, "");
 }
 
 RequestManager::RequestGuid
@@ -234,26 +303,10 @@ RequestManager::RequestGuid
   const std::lock_guard<std::mutex> lock(request_queue_mutex);
   // Add a new request
   Request request;
-  request.status = Request::PENDING;
-  request.guid = next_available_guid++;
   request.max_sequence_length = max_sequence_length;
-  if (bos_token_id >= 0 && model_type != ModelType::FALCON) {
-    request.tokens.push_back(bos_token_id);
-  }
-  std::vector<int32_t> tokens = this->tokenizer_->Encode(prompt);
-  if (tokens.size() >= get_max_sequence_length()) {
-    std::cout << "Warning: too many tokens in prompt, only load up to "
-              << get_max_sequence_length() << " tokens, but got "
-              << tokens.size() << ".\n";
-
-    printf("tokens size: %zu\n", tokens.size());
+  if (!load_prompt_tokens(this->tokenizer_->Encode(prompt), request)) {
     return INVALID_GUID;
   }
-  for (int i = 0; i < tokens.size(); i++) {
-    std::cout << "[" << i << "]" << tokens.at(i) << "\n";
-  }
-  request.tokens.insert(request.tokens.end(), tokens.begin(), tokens.end());
-  request.initial_len = request.tokens.size();
 
   if (get_num_ssms() == 0) {
     std::cout << "No small speculative model registered, using incremental "
@@ -261,36 +314,75 @@ RequestManager::RequestGuid
               << std::endl;
   } else {
     std::cout << "Num of SSMs: " << get_num_ssms() << std::endl;
-    for (int i = 0; i < get_num_ssms(); i++) {
-      BeamTree beam_tree = BeamTree{};
-      request.beam_trees.push_back(beam_tree);
-    }
-  }
-
-  pending_request_queue.push(request);
-  all_requests[request.guid] = request;
-  {
-    const std::lock_guard<std::mutex> lock(request_to_promise_mutex);
-    request_to_promise[request.guid] = new std::promise<void>();
   }
 
+  RequestGuid guid = enqueue_request(request, prompt);
   {
     std::string output = "New request tokens:";
-    output = "[" + std::to_string(request.guid) + "]" + output;
+    output = "[" + std::to_string(guid) + "]" + output;
     for (int i = 0; i < request.tokens.size(); i++) {
       output = output + " " + std::to_string(request.tokens[i]);
     }
     log_req_mgr.print("%s", output.c_str());
   }
+  return guid;
+}
 
-  GenerationResult gr;
-  gr.guid = request.guid;
-  gr.input_text = prompt;
-  gr.input_tokens = request.tokens;
-  gr.output_text = prompt;
-  gr.output_tokens = request.tokens;
-  request_generation_results[request.guid] = gr;
-  return request.guid;
+std::vector<RequestManager::RequestGuid>
+    RequestManager::register_new_requests(
+        std::vector<std::string> const &prompts,
+        int max_sequence_length,
+        int num_threads) {
+  std::vector<Request> requests(prompts.size());
+  // Not std::vector<bool>, whose elements share bytes
+  std::vector<char> loaded(prompts.size(), false);
+  {
+    // Tokenizer::Encode is not thread-safe, so each worker has its own
+    const std::lock_guard<std::mutex> lock(worker_tokenizers_mutex);
+    assert(tokenizer_factory && "no tokenizer registered");
+    if (num_threads <= 0) {
+      num_threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    num_threads = std::max(1, std::min(num_threads, (int)prompts.size()));
+    while (worker_tokenizers.size() < (size_t)num_threads) {
+      worker_tokenizers.push_back(tokenizer_factory());
+    }
+    std::atomic<size_t> next(0);
+    auto worker = [&](Tokenizer *tokenizer) {
+      for (size_t i = next++; i < prompts.size(); i = next++) {
+        requests[i].max_sequence_length = max_sequence_length;
+        loaded[i] = load_prompt_tokens(tokenizer->Encode(prompts[i]),
+                                       requests[i]);
+      }
+    };
+    std::vector<std::thread> threads;
+    for (int t = 1; t < num_threads; t++) {
+      threads.emplace_back(worker, worker_tokenizers[t].get());
+    }
+    worker(worker_tokenizers[0].get());
+    for (std::thread &t : threads) {
+      t.join();
+    }
+  }
+
+  // Register all requests under one lock, so that they enter the pending
+  // queue in order and together
+  std::vector<RequestGuid> guids(prompts.size(), INVALID_GUID);
+  size_t num_registered = 0;
+  {
+    const std::lock_guard<std::mutex> lock(request_queue_mutex);
+    for (size_t i = 0; i < prompts.size(); i++) {
+      if (loaded[i]) {
+        guids[i] = enqueue_request(requests[i], prompts[i]);
+        num_registered++;
+      }
+    }
+  }
+  log_req_mgr.print("Registered %zu of %zu new requests with %d threads",
+                    num_registered,
+                    prompts.size(),
+                    num_threads);
+  return guids;
 }
 
 bool RequestManager::is_request_completed(RequestGuid const &guid) {
@@ -328,6 +420,8 @@ size_t RequestManager::get_num_processed_requests() {
 BatchConfigFuture
     RequestManager::prepare_next_batch(BatchConfigFuture const &old_bc,
                                        InferenceResultFuture const &result,
+                                       int micro_batch,
+                                       int replica,
                                        Context ctx,
                                        Runtime *runtime) {
   RequestManager *rm = this;
@@ -335,6 +429,8 @@ BatchConfigFuture
                         TaskArgument(&rm, sizeof(RequestManager *)));
   launcher.add_future(old_bc);
   launcher.add_future(result);
+  launcher.add_future(Future::from_value<int>(micro_batch));
+  launcher.add_future(Future::from_value<int>(replica));
   return runtime->execute_task(ctx, launcher);
 }
 
@@ -347,12 +443,22 @@ BatchConfig RequestManager::prepare_next_batch_task(
   BatchConfig const *bc = BatchConfig::from_future(task->futures[0]);
   InferenceResult const &result =
       Future(task->futures[1]).get_result<InferenceResult>();
-  return rm->prepare_next_batch(*bc, result);
+  int micro_batch = Future(task->futures[2]).get_result<int>();
+  int replica = Future(task->futures[3]).get_result<int>();
+  return rm->prepare_next_batch(*bc, result, micro_batch, replica);
 }
 
 BatchConfig RequestManager::prepare_next_batch(BatchConfig const &old_bc,
-                                               InferenceResult const &result) {
+                                               InferenceResult const &result,
+                                               int micro_batch,
+                                               int replica) {
   const std::lock_guard<std::mutex> lock(request_queue_mutex);
+  assert(replica >= 0 && replica < replica_router.get_num_replicas());
+  // The micro-batches of a step share the token budget of one batch
+  int const num_groups = get_num_micro_batches();
+  assert(micro_batch >= 0 && micro_batch < num_groups);
+  int const max_tokens = get_max_tokens_per_batch() / num_groups;
+  assert(max_tokens > 0);
 
   // Step 1: append result from previous iteration to request's tokens
   for (int i = 0; i < old_bc.num_tokens; i++) {
@@ -368,8 +474,7 @@ BatchConfig RequestManager::prepare_next_batch(BatchConfig const &old_bc,
       // This is a decoding token
       log_req_mgr.print("Output token is: %d", result.token_ids[i]);
       request.tokens.push_back(result.token_ids[i]);
-      // std::string output = this->tokenizer_->Decode(request.tokens);
-      // log_req_mgr.print("Output: %s", output.c_str());
+      update_output_text(request);
     }
   }
   int num_generation_tokens = 0;
@@ -396,22 +501,16 @@ BatchConfig RequestManager::prepare_next_batch(BatchConfig const &old_bc,
         request_completed = true;
       }
       if (request_completed) {
-        std::string output = this->tokenizer_->Decode(request.tokens);
-        // Unlike Huggingface, the sentencepiece C++ library automatically
-        // removes the BOS token
-        if (model_type == ModelType::LLAMA &&
-            request.tokens.at(0) == bos_token_id) {
-          output = "<s> " + output;
-        }
+        std::string const &output = update_output_text(request, true);
         {
           // update generation result
           GenerationResult &gr = request_generation_results[request.guid];
           assert(gr.guid == request.guid);
           gr.output_tokens = request.tokens;
-          gr.output_text = output;
         }
         request.status = Request::COMPLETED;
         trigger_request_completion_future(request.guid);
+        replica_router.release(request.guid);
         log_req_mgr.print("[Done] guid(%zu) final_length(%zu)",
                           old_bc.requestsInfo[i].request_guid,
                           request.tokens.size());
@@ -475,7 +574,7 @@ BatchConfig RequestManager::prepare_next_batch(BatchConfig const &old_bc,
         } else {
           // Prompt phase
           new_bc.requestsInfo[i].num_tokens_in_batch =
-              std::min(get_max_tokens_per_batch() - new_bc.num_tokens,
+              std::min(max_tokens - new_bc.num_tokens,
                        (int)request.tokens.size() -
                            new_bc.requestsInfo[i].first_token_depth_in_request);
           new_bc.requestsInfo[i].prompt_phase = true;
@@ -488,6 +587,10 @@ BatchConfig RequestManager::prepare_next_batch(BatchConfig const &old_bc,
           new_bc.tokensInfo[new_bc.num_tokens].token_id = request.tokens[depth];
           new_bc.num_tokens++;
         }
+        replica_router.update(
+            request.guid,
+            new_bc.requestsInfo[i].first_token_depth_in_request +
+                new_bc.requestsInfo[i].num_tokens_in_batch);
         // Update profiling
         profiling_requests[new_bc.requestsInfo[i].request_guid]
             .llm_decoding_steps++;
@@ -496,21 +599,29 @@ BatchConfig RequestManager::prepare_next_batch(BatchConfig const &old_bc,
   }
   new_bc.num_generation_tokens = num_generation_tokens;
 
-  // Step 3: add new requests to the next batch
-  for (int i = 0; i < BatchConfig::max_requests_per_batch(); i++) {
+  // Step 3: add new requests to the next batch. Requests are routed to a
+  // replica the first time any replica prepares a batch after they arrive.
+  while (!pending_request_queue.empty()) {
+    Request &new_request = pending_request_queue.front();
+    int target =
+        replica_router.route(new_request.guid, new_request.tokens.size());
+    replica_queues[target].push(new_request);
+    pending_request_queue.pop();
+  }
+  std::queue<Request> &ready_queue = replica_queues[replica];
+  for (int i = micro_batch; i < BatchConfig::max_requests_per_batch();
+       i += num_groups) {
     if (new_bc.request_completed[i]) {
-      if (!pending_request_queue.empty() &&
-          new_bc.num_tokens < get_max_tokens_per_batch()) {
-        Request new_request = pending_request_queue.front();
-        pending_request_queue.pop();
+      if (!ready_queue.empty() && new_bc.num_tokens < max_tokens) {
+        Request new_request = ready_queue.front();
+        ready_queue.pop();
         // all_requests[new_request.guid] = new_request;
 
         new_bc.requestsInfo[i].first_token_depth_in_request = 0;
         new_bc.requestsInfo[i].first_token_offset_in_batch = new_bc.num_tokens;
         new_bc.requestsInfo[i].request_guid = new_request.guid;
-        new_bc.requestsInfo[i].num_tokens_in_batch =
-            std::min(get_max_tokens_per_batch() - new_bc.num_tokens,
-                     (int)new_request.tokens.size());
+        new_bc.requestsInfo[i].num_tokens_in_batch = std::min(
+            max_tokens - new_bc.num_tokens, (int)new_request.tokens.size());
         new_bc.requestsInfo[i].max_sequence_length =
             new_request.max_sequence_length;
         new_bc.request_completed[i] = false;
@@ -531,7 +642,9 @@ BatchConfig RequestManager::prepare_next_batch(BatchConfig const &old_bc,
               new_request.tokens[depth];
           new_bc.num_tokens++;
         }
-        if (new_bc.num_tokens == get_max_tokens_per_batch()) {
+        replica_router.update(new_request.guid,
+                              new_bc.requestsInfo[i].num_tokens_in_batch);
+        if (new_bc.num_tokens == max_tokens) {
           break;
         }
       }
@@ -667,19 +780,12 @@ BeamSearchBatchConfig
         log_req_mgr.print("[Done] guid(%zu) with final length(%zu)",
                           request.guid,
                           request.tokens.size());
-        std::string output = this->tokenizer_->Decode(request.tokens);
-        // Unlike Huggingface, the sentencepiece C++ library automatically
-        // removes the BOS token
-        if (model_type == ModelType::LLAMA &&
-            request.tokens.at(0) == bos_token_id) {
-          output = "<s> " + output;
-        }
+        std::string const &output = update_output_text(request, true);
         {
           // update generation result
           GenerationResult &gr = request_generation_results[request.guid];
           assert(gr.guid == request.guid);
           gr.output_tokens = request.tokens;
-          gr.output_text = output;
         }
         request.status = Request::COMPLETED;
         trigger_request_completion_future(request.guid);
@@ -806,14 +912,7 @@ BeamSearchBatchConfig
           }
         }
 
-        std::string output = this->tokenizer_->Decode(request.tokens);
-        // Unlike Huggingface, the sentencepiece C++ library automatically
-        // removes the BOS token
-        if (model_type == ModelType::LLAMA &&
-            request.tokens.at(0) == bos_token_id) {
-          output = "<s> " + output;
-        }
-        log_req_mgr.print("Output: %s", output.c_str());
+        log_req_mgr.print("Output: %s", update_output_text(request).c_str());
       }
 
     } else if (request.status == Request::PENDING) {
@@ -855,14 +954,7 @@ BeamSearchBatchConfig
       new_bc.sub_requests[i] = 1;
 
       // Token Info
-      std::string output = this->tokenizer_->Decode(request.tokens);
-      // Unlike Huggingface, the sentencepiece C++ library automatically removes
-      // the BOS token
-      if (model_type == ModelType::LLAMA &&
-          request.tokens.at(0) == bos_token_id) {
-        output = "<s> " + output;
-      }
-      log_req_mgr.print("Output: %s", output.c_str());
+      log_req_mgr.print("Output: %s", update_output_text(request).c_str());
     } else {
       assert(false);
     }
@@ -2285,9 +2377,8 @@ std::vector<GenerationResult>
     FFModel::generate(std::vector<std::string> &prompts, int max_seq_length) {
   RequestManager *rm = RequestManager::get_request_manager();
   std::vector<RequestManager::RequestGuid> guids;
-  for (int i = 0; i < prompts.size(); i++) {
-    RequestManager::RequestGuid guid =
-        rm->register_new_request(prompts.at(i), max_seq_length);
+  for (RequestManager::RequestGuid guid :
+       rm->register_new_requests(prompts, max_seq_length)) {
     if (guid != RequestManager::INVALID_GUID) {
       guids.push_back(guid);
     }
@@ -2365,30 +2456,47 @@ void RequestManager::serve_incr_decoding(FFModel *llm) {
   im->model_weights_loaders[llm]->load_weights(llm);
   // init operators
   im->init_operators_inference(llm);
-  // Legion futures for inc_decoding and spec_infer
-  BatchConfigFuture last_bcf;
-  InferenceResultFuture last_irf;
+  // Each data-parallel replica of the llm serves its own requests, and
+  // each micro-batch is a chain of batches over its own request slots of a
+  // replica. Consecutive launches belong to different chains and do not
+  // depend on each other, so the replicas run side by side and the pipeline
+  // stages of a replica can work on different micro-batches at the same
+  // time.
+  int const num_replicas = llm->config.data_parallelism_degree;
   {
+    std::lock_guard<std::mutex> const lock(request_queue_mutex);
+    replica_router = ReplicaRouter(num_replicas);
+    replica_queues.resize(num_replicas);
+  }
+  if (num_micro_batches == 0) {
+    num_micro_batches = llm->config.pipeline_parallelism_degree;
+  }
+  int const num_groups = get_num_micro_batches();
+  assert(num_groups <= BatchConfig::max_requests_per_batch());
+  int const num_chains = num_groups * num_replicas;
+  // Legion futures for inc_decoding and spec_infer
+  std::vector<BatchConfigFuture> last_bcf(num_chains);
+  std::vector<InferenceResultFuture> last_irf(num_chains);
+  std::queue<std::pair<BatchConfigFuture, InferenceResultFuture>>
+      batch_pipeline;
+  for (int c = 0; c < num_chains; c++) {
     // Initialize futures for incr decoding
     BatchConfig bc;
     InferenceResult ir;
-    last_bcf = Future::from_value<BatchConfig>(bc);
-    last_irf = Future::from_value<InferenceResult>(ir);
+    last_bcf[c] = Future::from_value<BatchConfig>(bc);
+    last_irf[c] = Future::from_value<InferenceResult>(ir);
+    batch_pipeline.push(std::make_pair(last_bcf[c], last_irf[c]));
   }
 
-  std::queue<std::pair<BatchConfigFuture, InferenceResultFuture>>
-      batch_pipeline;
-  { batch_pipeline.push(std::make_pair(last_bcf, last_irf)); }
-
   while (!is_background_server_terminated()) {
 
-    if (batch_pipeline.size() >= 4) {
+    if (batch_pipeline.size() >= 4 * num_chains) {
       // Block here to avoid launching too many batches
       auto const &batch = batch_pipeline.front();
       batch.second.get_void_result();
     }
     // deque finished batches
-    while (batch_pipeline.size() > 1) {
+    while (batch_pipeline.size() > num_chains) {
       auto const &batch = batch_pipeline.front();
       if (batch.second.is_ready()) {
         batch_pipeline.pop();
@@ -2397,17 +2505,36 @@ void RequestManager::serve_incr_decoding(FFModel *llm) {
       }
     }
     runtime->begin_trace(ctx, 12346 /*trace_id*/);
-    auto const &next_batch = batch_pipeline.back();
-    BatchConfigFuture bcf =
-        prepare_next_batch(next_batch.first, next_batch.second, ctx, runtime);
-    FutureMap fm = im->inference(llm, 0, bcf);
-    assert(fm.get_future_map_domain().get_volume() == 1);
-    InferenceResultFuture irf = fm.get_future(0);
-    batch_pipeline.push(std::make_pair(bcf, irf));
-    last_bcf = bcf;
-    last_irf = irf;
+    for (int c = 0; c < num_chains; c++) {
+      int const group = c / num_replicas, replica = c % num_replicas;
+      BatchConfigFuture bcf = prepare_next_batch(
+          last_bcf[c], last_irf[c], group, replica, ctx, runtime);
+      FutureMap fm = im->inference(llm, replica, bcf);
+      assert(fm.get_future_map_domain().get_volume() == 1);
+      InferenceResultFuture irf = fm.get_future(0);
+      batch_pipeline.push(std::make_pair(bcf, irf));
+      last_bcf[c] = bcf;
+      last_irf[c] = irf;
+    }
     runtime->end_trace(ctx, 12346 /*trace_id*/);
   }
+
+  if (llm->config.pipeline_parallelism_degree > 1) {
+    // Wait for the stage finish times of the launches in flight
+    runtime->issue_execution_fence(ctx).get_void_result();
+    for (int replica = 0; replica < num_replicas; replica++) {
+      std::vector<double> utilization =
+          im->get_stage_profiler(llm, replica)->utilization();
+      for (size_t stage = 0; stage < utilization.size(); stage++) {
+        log_req_mgr.print("Replica %d pipeline stage %zu: %.1f%% busy over "
+                          "%d micro-batches",
+                          replica,
+                          stage,
+                          100.0 * utilization[stage],
+                          num_groups);
+      }
+    }
+  }
 }
 
 /*static*/
@@ -516,6 +516,165 @@ ParallelConfig Op::view_to_pc(MachineView const &view) const {
   return config;
 }
 
+static bool get_op_task_ids(OperatorType op_type,
+                            unsigned &fwd_task_id,
+                            unsigned &bwd_task_id) {
+  switch (op_type) {
+    case OP_LINEAR:
+      fwd_task_id = LINEAR_FWD_TASK_ID;
+      bwd_task_id = LINEAR_BWD_TASK_ID;
+      return true;
+    case OP_CONV2D:
+      fwd_task_id = CONV2D_FWD_TASK_ID;
+      bwd_task_id = CONV2D_BWD_TASK_ID;
+      return true;
+    case OP_POOL2D:
+      fwd_task_id = POOL2D_FWD_TASK_ID;
+      bwd_task_id = POOL2D_BWD_TASK_ID;
+      return true;
+    case OP_BATCHNORM:
+      fwd_task_id = BATCHNORM_FWD_TASK_ID;
+      bwd_task_id = BATCHNORM_BWD_TASK_ID;
+      return true;
+    case OP_BATCHMATMUL:
+      fwd_task_id = BATCHMATMUL_FWD_TASK_ID;
+      bwd_task_id = BATCHMATMUL_BWD_TASK_ID;
+      return true;
+    case OP_LAYERNORM:
+      fwd_task_id = LAYERNORM_FWD_TASK_ID;
+      bwd_task_id = LAYERNORM_BWD_TASK_ID;
+      return true;
+    case OP_EMBEDDING:
+      fwd_task_id = EMBED_FWD_TASK_ID;
+      bwd_task_id = EMBED_BWD_TASK_ID;
+      return true;
+    case OP_SOFTMAX:
+      fwd_task_id = SOFTMAX_FWD_TASK_ID;
+      bwd_task_id = SOFTMAX_BWD_TASK_ID;
+      return true;
+    case OP_DROPOUT:
+      fwd_task_id = DROPOUT_FWD_TASK_ID;
+      bwd_task_id = DROPOUT_BWD_TASK_ID;
+      return true;
+    case OP_FLAT:
+      fwd_task_id = FLAT_FWD_TASK_ID;
+      bwd_task_id = FLAT_BWD_TASK_ID;
+      return true;
+    case OP_CONCAT:
+      fwd_task_id = CONCAT_FWD_TASK_ID;
+      bwd_task_id = CONCAT_BWD_TASK_ID;
+      return true;
+    case OP_SPLIT:
+      fwd_task_id = SPLIT_FWD_TASK_ID;
+      bwd_task_id = SPLIT_BWD_TASK_ID;
+      return true;
+    case OP_RESHAPE:
+      fwd_task_id = RESHAPE_FWD_TASK_ID;
+      bwd_task_id = RESHAPE_BWD_TASK_ID;
+      return true;
+    case OP_TRANSPOSE:
+      fwd_task_id = TRANSPOSE_FWD_TASK_ID;
+      bwd_task_id = TRANSPOSE_BWD_TASK_ID;
+      return true;
+    case OP_MULTIHEAD_ATTENTION:
+      fwd_task_id = ATTENTION_FWD_TASK_ID;
+      bwd_task_id = ATTENTION_BWD_TASK_ID;
+      return true;
+    case OP_EW_ADD:
+    case OP_EW_SUB:
+    case OP_EW_MUL:
+    case OP_EW_DIV:
+    case OP_EW_MAX:
+    case OP_EW_MIN:
+      fwd_task_id = ELEMENTBINARY_FWD_TASK_ID;
+      bwd_task_id = ELEMENTBINARY_BWD_TASK_ID;
+      return true;
+    case OP_RELU:
+    case OP_SIGMOID:
+    case OP_TANH:
+    case OP_ELU:
+    case OP_GELU:
+    case OP_EXP:
+    case OP_IDENTITY:
+      fwd_task_id = ELEMENTUNARY_FWD_TASK_ID;
+      bwd_task_id = ELEMENTUNARY_BWD_TASK_ID;
+      return true;
+    case OP_REPARTITION:
+      fwd_task_id = REPARTITION_FWD_TASK_ID;
+      bwd_task_id = REPARTITION_BWD_TASK_ID;
+      return true;
+    case OP_COMBINE:
+      fwd_task_id = COMBINE_FWD_TASK_ID;
+      bwd_task_id = COMBINE_BWD_TASK_ID;
+      return true;
+    case OP_REPLICATE:
+      fwd_task_id = REPLICATE_FWD_TASK_ID;
+      bwd_task_id = REPLICATE_BWD_TASK_ID;
+      return true;
+    case OP_REDUCTION:
+      fwd_task_id = REDUCTION_FWD_TASK_ID;
+      bwd_task_id = REDUCTION_BWD_TASK_ID;
+      return true;
+    case OP_GROUP_BY:
+      fwd_task_id = GROUP_BY_FWD_TASK_ID;
+      bwd_task_id = GROUP_BY_BWD_TASK_ID;
+      return true;
+    case OP_AGGREGATE:
+      fwd_task_id = AGGREGATE_FWD_TASK_ID;
+      bwd_task_id = AGGREGATE_BWD_TASK_ID;
+      return true;
+    case OP_EXPERTS:
+      // Experts only runs in inference
+      fwd_task_id = EXPERTS_INF_TASK_ID;
+      bwd_task_id = EXPERTS_BWD_TASK_ID;
+      return true;
+    default:
+      return false;
+  }
+}
+
+bool Simulator::load_measured_costs(std::string const &file_name) {
+  std::ifstream file(file_name);
+  if (!file.good()) {
+    fprintf(stderr, "Cannot open measured cost file %s\n", file_name.c_str());
+    return false;
+  }
+  if (!load_measured_cost_table(file, measured_costs)) {
+    fprintf(stderr, "Malformed measured cost file %s\n", file_name.c_str());
+    measured_costs.clear();
+    return false;
+  }
+  // Cached measurements were taken before the table was available
+  hash_to_operator_cost.clear();
+  strict_hash_to_operator_cost.clear();
+  return true;
+}
+
+void Simulator::apply_measured_costs(Op const *op,
+                                     MachineView const &mv,
+                                     CostMetrics &cost_metrics) const {
+  unsigned fwd_task_id, bwd_task_id;
+  if (measured_costs.empty() ||
+      !get_op_task_ids(op->op_type, fwd_task_id, bwd_task_id)) {
+    return;
+  }
+  // Ops whose parameters are unknown cannot be told apart from other ops
+  // launching the same task on the same view
+  size_t params_hash = get_op_parameters_hash(op);
+  if (params_hash == 0) {
+    return;
+  }
+  // Mapper timestamps are in us, simulated times are in ms
+  auto fwd = measured_costs.find({fwd_task_id, mv.hash(), params_hash});
+  if (fwd != measured_costs.end()) {
+    cost_metrics.forward_time = fwd->second.mean_us / 1e3f;
+  }
+  auto bwd = measured_costs.find({bwd_task_id, mv.hash(), params_hash});
+  if (bwd != measured_costs.end()) {
+    cost_metrics.backward_time = bwd->second.mean_us / 1e3f;
+  }
+}
+
 CostMetrics Simulator::measure_operator_cost(Op const *op,
                                              MachineView const &mv) {
   tl::optional<OperatorParameters> retrieved_params = get_op_parameters(op);
@@ -530,6 +689,7 @@ CostMetrics Simulator::measure_operator_cost(Op const *op,
         handle_measure_operator_cost_unimplemented(op);
       }
       op->estimate_sync_cost(this, mv, cost_metrics);
+      apply_measured_costs(op, mv, cost_metrics);
       this->strict_hash_to_operator_cost[key] = cost_metrics;
     }
     return this->strict_hash_to_operator_cost.at(key);
@@ -551,6 +711,7 @@ CostMetrics Simulator::measure_operator_cost(Op const *op,
       handle_measure_operator_cost_unimplemented(op);
     }
     op->estimate_sync_cost(this, mv, cost_metrics);
+    apply_measured_costs(op, mv, cost_metrics);
     hash_to_operator_cost[hash] = cost_metrics;
     return cost_metrics;
   } else {
@@ -49,6 +49,7 @@
 #include "flexflow/utils/dot/dot_file.h"
 #include <chrono>
 #include <iomanip>
+#include <tuple>
 
 namespace FlexFlow::PCG {
 
@@ -601,10 +602,16 @@ void GraphXfer::find_matches(int depth,
   }
 }
 
+static bool changes_graph(SimplificationSettings const &settings) {
+  return settings.simplify_parallel_ops || settings.fuse_parallel_ops ||
+         settings.remove_trailing_parallel_ops || settings.remove_noops;
+}
+
 template <typename GraphComparator>
 void GraphXfer::run(
     int depth,
     Graph *graph,
+    CompactPCG const &compact_graph,
     std::priority_queue<Graph *, std::vector<Graph *>, GraphComparator>
         &candidates,
     std::unordered_set<size_t> &hashmap,
@@ -645,7 +652,15 @@ void GraphXfer::run(
     // Generate a new graph by applying xfer rule
     log_xfers.spew() << "Found a match for xfer: " << this->get_name();
     num_matches_found++;
-    Graph *newGraph = this->create_new_graph(graph, simplification_settings);
+    CompactPCG derived = this->rewrite_compact(compact_graph);
+    // Without simplification the materialized graph has the same hash, so
+    // duplicates are dropped before copying anything into a Graph
+    if (!changes_graph(simplification_settings) &&
+        hashmap.find(derived.hash()) != hashmap.end()) {
+      return;
+    }
+    Graph *newGraph = new Graph(model, derived);
+    newGraph->simplify(simplification_settings);
     // Check that the new graph should not have any loop
     if (newGraph->has_loop()) {
       printf("Found a new graph with LOOP!!!!\n");
@@ -655,14 +670,17 @@ void GraphXfer::run(
     }
     // TODO: remove me for better performance
     assert(newGraph->check_correctness());
+    // Check for a duplicate before running the cost model on the graph. A
+    // graph rejected once stays rejected, since the threshold only drops.
+    if (!hashmap.insert(newGraph->hash()).second) {
+      delete newGraph;
+      return;
+    }
     if (newGraph->optimal_cost() < threshold &&
         (int)newGraph->inEdges.size() < maxNumOps) {
-      if (hashmap.find(newGraph->hash()) == hashmap.end()) {
-        hashmap.insert(newGraph->hash());
-        log_xfers.spew() << "Found new candidate";
-        // newGraph->print_dot();
-        candidates.push(newGraph);
-      }
+      log_xfers.spew() << "Found new candidate";
+      // newGraph->print_dot();
+      candidates.push(newGraph);
     } else {
       num_matches_rejected++;
       delete newGraph;
@@ -678,6 +696,7 @@ void GraphXfer::run(
         match(srcOp, op, graph);
         run(depth + 1,
             graph,
+            compact_graph,
             candidates,
             hashmap,
             threshold,
@@ -790,52 +809,71 @@ std::unique_ptr<Graph> Graph::with_output_tensor_reshaped_to(
 
 Graph *GraphXfer::create_new_graph(
     Graph const *graph, SimplificationSettings const &simplification_settings) {
-  Graph *newGraph = new Graph(model);
-  // Step 1: map dst ops
-  std::vector<OpX *>::const_iterator dstIt;
-  // Step 2: add edges to the graph
-  for (auto const &opIt : graph->inEdges) {
-    if (mappedOps.find(opIt.first) == mappedOps.end()) {
-      // Unmapped ops
-      auto const &list = opIt.second;
-      for (auto const &it : list) {
-        if (mappedOps.find(it.srcOp) != mappedOps.end()) {
-          // mapped src -> unmapped dst
-          TensorX srcTen;
-          srcTen.op = mappedOps[it.srcOp];
-          srcTen.idx = it.srcIdx;
-          assert(mappedOutputs.find(srcTen) != mappedOutputs.end());
-          TensorX dstTen = mappedOutputs[srcTen];
-          newGraph->add_edge(dstTen.op->mapOp, it.dstOp, dstTen.idx, it.dstIdx);
-        } else {
-          // unmapped src -> unmmaped dst
-          newGraph->add_edge(it.srcOp, it.dstOp, it.srcIdx, it.dstIdx);
-        }
+  return this->create_new_graph(graph->compact(), simplification_settings);
+}
+
+Graph *GraphXfer::create_new_graph(
+    CompactPCG const &graph,
+    SimplificationSettings const &simplification_settings) {
+  Graph *newGraph = new Graph(model, this->rewrite_compact(graph));
+  newGraph->simplify(simplification_settings);
+  return newGraph;
+}
+
+CompactPCG GraphXfer::rewrite_compact(CompactPCG const &graph) {
+  using FlexFlow::PCG::Utils::CompactEdge;
+
+  std::vector<int> removed;
+  for (auto const &it : mappedOps) {
+    int id = graph.find(it.first);
+    assert(id != -1);
+    removed.push_back(id);
+  }
+  // Step 1: map dst ops, which get the ids following the graph's
+  std::vector<Node> added;
+  std::unordered_map<OpX const *, int> dst_ids;
+  for (OpX const *dstOp : dstOps) {
+    dst_ids[dstOp] = graph.num_ids() + added.size();
+    added.push_back(dstOp->mapOp);
+  }
+  std::vector<CompactEdge> edges;
+  // Step 2: mapped src -> unmapped dst edges now leave the dst op that
+  // produces the mapped output; edges between unmapped ops are kept
+  for (int src : removed) {
+    OpX *srcOp = mappedOps.at(graph.node(src));
+    for (CompactEdge const &e : graph.out_edges(src)) {
+      if (mappedOps.find(graph.node(e.dst)) != mappedOps.end()) {
+        continue;
       }
+      TensorX srcTen;
+      srcTen.op = srcOp;
+      srcTen.idx = e.src_idx;
+      assert(mappedOutputs.find(srcTen) != mappedOutputs.end());
+      TensorX dstTen = mappedOutputs[srcTen];
+      edges.push_back({dst_ids.at(dstTen.op), e.dst, dstTen.idx, e.dst_idx});
     }
   }
   // Step 3: add edges for mapped ops
-  for (dstIt = dstOps.begin(); dstIt != dstOps.end(); dstIt++) {
-    OpX *dstOp = *dstIt;
+  for (OpX const *dstOp : dstOps) {
     for (size_t i = 0; i < dstOp->inputs.size(); i++) {
       if (dstOp->inputs[i].op == NULL) {
         // unmapped src -> mapped dst
         std::multimap<int, std::pair<Node, int>>::const_iterator it =
             mappedInputs.find(dstOp->inputs[i].idx);
         assert(it != mappedInputs.end());
-        std::pair<Node, int> const &srcEdge = it->second;
-        newGraph->add_edge(srcEdge.first, dstOp->mapOp, srcEdge.second, i);
+        int src = graph.find(it->second.first);
+        assert(src != -1);
+        edges.push_back({src, dst_ids.at(dstOp), it->second.second, (int)i});
       } else {
         // mapped src -> mapped dst
-        OpX *srcOp = dstOp->inputs[i].op;
-        int srcIdx = dstOp->inputs[i].idx;
-        newGraph->add_edge(srcOp->mapOp, dstOp->mapOp, srcIdx, i);
+        edges.push_back({dst_ids.at(dstOp->inputs[i].op),
+                         dst_ids.at(dstOp),
+                         dstOp->inputs[i].idx,
+                         (int)i});
       }
     }
   }
-  newGraph->simplify(simplification_settings);
-
-  return newGraph;
+  return graph.rewrite(removed, added, edges);
 }
 
 bool GraphXfer::create_new_operator(OpX const *opx, Node &op) {
@@ -1728,6 +1766,86 @@ std::vector<GraphXfer *> create_xfers(FFModel *model,
   return xfers;
 }
 
+// Canonical string for the type and constraints of an OpX, so that
+// check_opxes_have_same_type_and_constraints reduces to string equality
+std::string opx_signature(OpX const &opx) {
+  std::vector<std::tuple<int, int, int>> pm;
+  for (PMConstraint const &c : opx.pmConstraints) {
+    pm.push_back({c.comp, c.para, c.value});
+  }
+  std::sort(pm.begin(), pm.end());
+  std::vector<std::tuple<bool, int, int, int, int, int, int>> tn;
+  for (TNConstraint const &c : opx.tnConstraints) {
+    tn.push_back({c.singlePara,
+                  c.comp,
+                  c.para1,
+                  c.dim1,
+                  c.singlePara ? 0 : c.para2,
+                  c.singlePara ? 0 : c.dim2,
+                  c.singlePara ? c.value : 0});
+  }
+  std::sort(tn.begin(), tn.end());
+  std::ostringstream oss;
+  oss << opx.type << "[";
+  for (auto const &c : pm) {
+    oss << std::get<0>(c) << "," << std::get<1>(c) << "," << std::get<2>(c)
+        << ";";
+  }
+  oss << "][";
+  for (auto const &c : tn) {
+    oss << std::get<0>(c) << "," << std::get<1>(c) << "," << std::get<2>(c)
+        << "," << std::get<3>(c) << "," << std::get<4>(c) << ","
+        << std::get<5>(c) << "," << std::get<6>(c) << ";";
+  }
+  oss << "]";
+  return oss.str();
+}
+
+std::vector<GraphXfer *>
+    create_xfers(FFModel *model,
+                 sl::CompiledRuleCollection const &compiled,
+                 int parallel_degree) {
+  // Same pruning as the uncompiled overload, but using a hash set of xfer
+  // signatures instead of comparing every pair of xfers
+  std::vector<GraphXfer *> xfers;
+  std::unordered_set<std::string> seen;
+  for (sl::Rule const &r : compiled.rules) {
+    if (r.srcOp.size() != 1 || r.dstOp.size() == 1) {
+      continue;
+    }
+    GraphXfer *xfer = new GraphXfer(model);
+    create_xfer(*xfer, r, parallel_degree);
+    std::string signature;
+    for (OpX const *opx : xfer->srcOps) {
+      signature += opx_signature(*opx);
+    }
+    signature += "->";
+    for (OpX const *opx : xfer->dstOps) {
+      signature += opx_signature(*opx);
+    }
+    if (seen.insert(signature).second) {
+      xfers.push_back(xfer);
+    } else {
+      delete xfer;
+    }
+  }
+  return xfers;
+}
+
+bool xfer_may_match(GraphXfer const *xfer,
+                    std::unordered_set<OperatorType> const &graph_op_types) {
+  return xfer->srcOps.empty() ||
+         graph_op_types.find(xfer->srcOps[0]->type) != graph_op_types.end();
+}
+
+std::unordered_set<OperatorType> get_graph_op_types(Graph const *graph) {
+  std::unordered_set<OperatorType> op_types;
+  for (auto const &it : graph->inEdges) {
+    op_types.insert(it.first.ptr->op_type);
+  }
+  return op_types;
+}
+
 GraphSearchHelper::GraphSearchHelper(FFModel *model)
     : model(model), config(model->config), mem_config(1.0) {
   this->logger = std::unique_ptr<RecursiveLogger>(new RecursiveLogger("gs"));
@@ -1796,8 +1914,13 @@ void GraphSearchHelper::generate_all_pcg_xfers() {
     if (numNodes > 1) {
       considered_parallel_degrees.push_back(numNodes * workersPerNode);
     }
-    sl::RuleCollection rule_collection = sl::load_rule_collection_from_path(
-        config.substitution_json_path.value());
+    sl::CompiledRuleCollection rule_collection =
+        sl::load_compiled_rule_collection_from_path(
+            config.substitution_json_path.value());
+    log_xfers.debug() << "Loaded " << rule_collection.rules.size()
+                      << " substitution rules ("
+                      << rule_collection.num_duplicates_removed
+                      << " duplicates removed)";
     for (int degree : considered_parallel_degrees) {
       std::vector<GraphXfer *> xfers =
           create_xfers(this->model, rule_collection, degree);
@@ -2101,8 +2224,12 @@ void GraphSearchHelper::find_rewrite_matches(
     Graph const *graph, std::vector<GraphXferMatch> &matches) const {
   std::vector<GraphXfer *> xfers;
   this->load_graph_substitutions(xfers);
+  std::unordered_set<OperatorType> graph_op_types = get_graph_op_types(graph);
 
   for (GraphXfer *xfer : xfers) {
+    if (!xfer_may_match(xfer, graph_op_types)) {
+      continue;
+    }
     log_xfer_matches.debug()
         << "Finding matches for xfer: " << xfer->get_name();
     xfer->find_matches(graph, matches);
@@ -2303,11 +2430,20 @@ std::unique_ptr<Graph> GraphSearchHelper::base_optimize(
                    candidates.size());
 
     log_xfers.debug() << "Considering " << xfers.size() << " possible xfers";
+    std::unordered_set<OperatorType> graph_op_types =
+        get_graph_op_types(cur_graph);
+    // Candidates are derived from this snapshot rather than by copying
+    // cur_graph for every match
+    CompactPCG cur_compact = cur_graph->compact();
     for (size_t i = 0; i < xfers.size(); i++) {
+      if (!xfer_may_match(xfers[i], graph_op_types)) {
+        continue;
+      }
       int num_matches_found = 0, num_matches_rejected = 0;
       log_xfers.debug() << "Considering xfer: " << xfers[i]->get_name();
       xfers[i]->run(0,
                     cur_graph,
+                    cur_compact,
                     candidates,
                     hashmap,
                     best_cost * alpha,
@@ -2408,11 +2544,18 @@ std::unique_ptr<Graph> GraphSearchHelper::base_optimize_with_memory(
 
     log_xfers.debug() << "Considering " << xfers.size()
                       << " possible xfers in base_optimize_with_memory";
+    std::unordered_set<OperatorType> graph_op_types =
+        get_graph_op_types(cur_graph);
+    CompactPCG cur_compact = cur_graph->compact();
     for (size_t i = 0; i < xfers.size(); i++) {
+      if (!xfer_may_match(xfers[i], graph_op_types)) {
+        continue;
+      }
       int num_matches_found = 0, num_matches_rejected = 0;
       log_xfers.debug() << "Considering xfer: " << xfers[i]->get_name();
       xfers[i]->run(0,
                     cur_graph,
+                    cur_compact,
                     candidates,
                     hashmap,
                     best_cost * alpha,
@@ -1,7 +1,15 @@
 #include "flexflow/substitution_loader.h"
+#include <algorithm>
 #include <cassert>
+#include <cstdlib>
+#include <filesystem>
 #include <functional>
+#include <map>
+#include <set>
 #include <sstream>
+#include <tuple>
+#include <unistd.h>
+#include <unordered_set>
 
 using json = nlohmann::json;
 
@@ -75,4 +83,382 @@ RuleCollection load_rule_collection_from_path(std::string const &path) {
   return load_rule_collection(input);
 }
 
+namespace {
+
+// Bump whenever the layout written by save_compiled_rule_collection changes
+uint32_t const COMPILED_RULES_MAGIC = 0x46465352; // "FFSR"
+uint32_t const COMPILED_RULES_VERSION = 2;
+
+void append_operator_key(std::ostringstream &oss, Operator const &op) {
+  std::vector<std::pair<int, int>> para;
+  for (Parameter const &p : op.para) {
+    para.push_back({p.key, p.value});
+  }
+  std::sort(para.begin(), para.end());
+  oss << op.op_type << "(";
+  for (Tensor const &t : op.input) {
+    oss << t.opId << ":" << t.tsId << ",";
+  }
+  oss << ")[";
+  for (auto const &p : para) {
+    oss << p.first << "=" << p.second << ",";
+  }
+  oss << "]";
+}
+
+// Canonical form of a rule that ignores its name and parameter order
+std::string structural_key(Rule const &r) {
+  std::ostringstream oss;
+  for (Operator const &op : r.srcOp) {
+    append_operator_key(oss, op);
+  }
+  oss << "->";
+  for (Operator const &op : r.dstOp) {
+    append_operator_key(oss, op);
+  }
+  std::vector<std::tuple<int, int, int, int>> mapped;
+  for (MapOutput const &m : r.mappedOutput) {
+    mapped.push_back({m.srcOpId, m.srcTsId, m.dstOpId, m.dstTsId});
+  }
+  std::sort(mapped.begin(), mapped.end());
+  for (auto const &m : mapped) {
+    oss << "|" << std::get<0>(m) << ":" << std::get<1>(m) << ">"
+        << std::get<2>(m) << ":" << std::get<3>(m);
+  }
+  return oss.str();
+}
+
+template <typename T>
+void write_pod(std::ostream &s, T const &value) {
+  s.write(reinterpret_cast<char const *>(&value), sizeof(T));
+}
+
+template <typename T>
+bool read_pod(std::istream &s, T &value) {
+  s.read(reinterpret_cast<char *>(&value), sizeof(T));
+  return (bool)s;
+}
+
+// Upper bound on any count when the stream cannot tell its size
+constexpr uint64_t MAX_CACHED_COUNT = 1 << 24;
+
+// Read the number of elements that follow, each taking at least
+// element_bytes in the stream. Counts the rest of the stream cannot hold
+// come from a truncated or corrupted cache and are rejected before they
+// are used to size anything.
+bool read_count(std::istream &s, uint32_t &num, uint64_t element_bytes) {
+  if (!read_pod(s, num)) {
+    return false;
+  }
+  uint64_t max_count = MAX_CACHED_COUNT;
+  std::streampos const pos = s.tellg();
+  if (pos != std::streampos(-1)) {
+    s.seekg(0, std::ios::end);
+    std::streampos const end = s.tellg();
+    s.seekg(pos);
+    if (!s || end < pos) {
+      return false;
+    }
+    max_count = (uint64_t)(end - pos) / element_bytes;
+  }
+  return num <= max_count;
+}
+
+void write_tensors(std::ostream &s, std::vector<Tensor> const &tensors) {
+  write_pod(s, (uint32_t)tensors.size());
+  for (Tensor const &t : tensors) {
+    write_pod(s, (int32_t)t.opId);
+    write_pod(s, (int32_t)t.tsId);
+  }
+}
+
+bool read_tensors(std::istream &s, std::vector<Tensor> &tensors) {
+  uint32_t num = 0;
+  if (!read_count(s, num, 2 * sizeof(int32_t))) {
+    return false;
+  }
+  tensors.resize(num);
+  for (Tensor &t : tensors) {
+    int32_t op_id, ts_id;
+    if (!read_pod(s, op_id) || !read_pod(s, ts_id)) {
+      return false;
+    }
+    t.opId = op_id;
+    t.tsId = ts_id;
+  }
+  return true;
+}
+
+void write_parameters(std::ostream &s, std::vector<Parameter> const &para) {
+  write_pod(s, (uint32_t)para.size());
+  for (Parameter const &p : para) {
+    write_pod(s, (int32_t)p.key);
+    write_pod(s, (int32_t)p.value);
+  }
+}
+
+bool read_parameters(std::istream &s, std::vector<Parameter> &para) {
+  uint32_t num = 0;
+  if (!read_count(s, num, 2 * sizeof(int32_t))) {
+    return false;
+  }
+  para.resize(num);
+  for (Parameter &p : para) {
+    int32_t key, value;
+    if (!read_pod(s, key) || !read_pod(s, value)) {
+      return false;
+    }
+    p.key = (PMParameter)key;
+    p.value = value;
+  }
+  return true;
+}
+
+void write_operators(std::ostream &s, std::vector<Operator> const &ops) {
+  write_pod(s, (uint32_t)ops.size());
+  for (Operator const &op : ops) {
+    write_pod(s, (int32_t)op.op_type);
+    write_tensors(s, op.input);
+    write_parameters(s, op.para);
+  }
+}
+
+bool read_operators(std::istream &s, std::vector<Operator> &ops) {
+  uint32_t num = 0;
+  // Type, tensor count and parameter count
+  if (!read_count(s, num, sizeof(int32_t) + 2 * sizeof(uint32_t))) {
+    return false;
+  }
+  ops.resize(num);
+  for (Operator &op : ops) {
+    int32_t op_type;
+    if (!read_pod(s, op_type)) {
+      return false;
+    }
+    op.op_type = (OperatorType)op_type;
+    if (!read_tensors(s, op.input) || !read_parameters(s, op.para)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void write_string(std::ostream &s, std::string const &str) {
+  write_pod(s, (uint32_t)str.size());
+  s.write(str.data(), str.size());
+}
+
+bool read_string(std::istream &s, std::string &str) {
+  uint32_t len = 0;
+  if (!read_count(s, len, 1)) {
+    return false;
+  }
+  str.resize(len);
+  s.read(&str[0], len);
+  return (bool)s;
+}
+
+// Identifies the JSON file a cache was built from
+std::pair<uint64_t, int64_t> source_stamp(std::string const &path) {
+  std::error_code ec;
+  uint64_t size = std::filesystem::file_size(path, ec);
+  if (ec) {
+    return {0, 0};
+  }
+  auto mtime = std::filesystem::last_write_time(path, ec);
+  if (ec) {
+    return {size, 0};
+  }
+  return {size, (int64_t)mtime.time_since_epoch().count()};
+}
+
+} // namespace
+
+std::string compiled_rule_cache_path(std::string const &path) {
+  std::filesystem::path dir;
+  char const *xdg_cache = std::getenv("XDG_CACHE_HOME");
+  char const *home = std::getenv("HOME");
+  if (xdg_cache != nullptr && xdg_cache[0] != '\0') {
+    dir = xdg_cache;
+  } else if (home != nullptr && home[0] != '\0') {
+    dir = std::filesystem::path(home) / ".cache";
+  } else {
+    return "";
+  }
+  std::error_code ec;
+  std::string source = std::filesystem::absolute(path, ec).string();
+  if (ec) {
+    source = path;
+  }
+  std::ostringstream name;
+  name << std::hex << std::hash<std::string>()(source) << ".rules";
+  return (dir / "flexflow" / "substitutions" / name.str()).string();
+}
+
+CompiledRuleCollection compile_rule_collection(RuleCollection const &c) {
+  CompiledRuleCollection compiled;
+
+  // A parameter key that takes many different values across the collection
+  // rejects more candidate nodes, so it is checked first
+  std::map<PMParameter, std::set<int>> values_per_key;
+  for (Rule const &r : c.rules) {
+    for (Operator const &op : r.srcOp) {
+      for (Parameter const &p : op.para) {
+        values_per_key[p.key].insert(p.value);
+      }
+    }
+  }
+  auto more_selective = [&](Parameter const &a, Parameter const &b) {
+    size_t na = values_per_key[a.key].size();
+    size_t nb = values_per_key[b.key].size();
+    if (na != nb) {
+      return na > nb;
+    }
+    if (a.key != b.key) {
+      return a.key < b.key;
+    }
+    return a.value < b.value;
+  };
+
+  std::unordered_set<std::string> seen;
+  for (Rule const &r : c.rules) {
+    if (!seen.insert(structural_key(r)).second) {
+      compiled.num_duplicates_removed++;
+      continue;
+    }
+    Rule rule = r;
+    for (Operator &op : rule.srcOp) {
+      std::sort(op.para.begin(), op.para.end(), more_selective);
+    }
+    std::sort(rule.mappedOutput.begin(),
+              rule.mappedOutput.end(),
+              [](MapOutput const &a, MapOutput const &b) {
+                return std::make_pair(a.srcOpId, a.srcTsId) <
+                       std::make_pair(b.srcOpId, b.srcTsId);
+              });
+    compiled.rules.push_back(rule);
+  }
+
+  return compiled;
+}
+
+void save_compiled_rule_collection(CompiledRuleCollection const &c,
+                                   std::ostream &s) {
+  write_pod(s, (uint64_t)c.num_duplicates_removed);
+  write_pod(s, (uint32_t)c.rules.size());
+  for (Rule const &r : c.rules) {
+    write_string(s, r.name);
+    write_operators(s, r.srcOp);
+    write_operators(s, r.dstOp);
+    write_pod(s, (uint32_t)r.mappedOutput.size());
+    for (MapOutput const &m : r.mappedOutput) {
+      write_pod(s, (int32_t)m.dstOpId);
+      write_pod(s, (int32_t)m.dstTsId);
+      write_pod(s, (int32_t)m.srcOpId);
+      write_pod(s, (int32_t)m.srcTsId);
+    }
+  }
+}
+
+bool load_compiled_rule_collection(std::istream &s,
+                                   CompiledRuleCollection &c) {
+  uint64_t num_duplicates_removed = 0;
+  uint32_t num_rules = 0;
+  // Name length, operator counts and mapped-output count of each rule
+  if (!read_pod(s, num_duplicates_removed) ||
+      !read_count(s, num_rules, 4 * sizeof(uint32_t))) {
+    return false;
+  }
+  c.num_duplicates_removed = num_duplicates_removed;
+  c.rules.resize(num_rules);
+  for (Rule &r : c.rules) {
+    if (!read_string(s, r.name) || !read_operators(s, r.srcOp) ||
+        !read_operators(s, r.dstOp)) {
+      return false;
+    }
+    uint32_t num_mapped = 0;
+    if (!read_count(s, num_mapped, 4 * sizeof(int32_t))) {
+      return false;
+    }
+    r.mappedOutput.resize(num_mapped);
+    for (MapOutput &m : r.mappedOutput) {
+      int32_t v[4];
+      for (int i = 0; i < 4; i++) {
+        if (!read_pod(s, v[i])) {
+          return false;
+        }
+      }
+      m.dstOpId = v[0];
+      m.dstTsId = v[1];
+      m.srcOpId = v[2];
+      m.srcTsId = v[3];
+    }
+  }
+  return true;
+}
+
+CompiledRuleCollection
+    load_compiled_rule_collection_from_path(std::string const &path) {
+  std::string const cache_path = compiled_rule_cache_path(path);
+  std::pair<uint64_t, int64_t> stamp = source_stamp(path);
+  std::error_code ec;
+  std::string source = std::filesystem::absolute(path, ec).string();
+
+  if (!cache_path.empty()) {
+    std::ifstream cache(cache_path, std::ios::binary);
+    uint32_t magic = 0, version = 0;
+    std::string cached_source;
+    uint64_t size = 0;
+    int64_t mtime = 0;
+    // The source path guards against two rule files whose paths hash to the
+    // same cache file
+    if (cache && read_pod(cache, magic) && read_pod(cache, version) &&
+        magic == COMPILED_RULES_MAGIC && version == COMPILED_RULES_VERSION &&
+        read_string(cache, cached_source) && read_pod(cache, size) &&
+        read_pod(cache, mtime) && cached_source == source &&
+        size == stamp.first && mtime == stamp.second) {
+      CompiledRuleCollection compiled;
+      if (load_compiled_rule_collection(cache, compiled)) {
+        return compiled;
+      }
+    }
+  }
+
+  CompiledRuleCollection compiled =
+      compile_rule_collection(load_rule_collection_from_path(path));
+  if (cache_path.empty()) {
+    return compiled;
+  }
+
+  // The cache is only an accelerator, so failing to write it is not an
+  // error. It is written to a private file first and renamed into place, so
+  // concurrent loaders never read a partially written cache.
+  std::filesystem::path final_path(cache_path);
+  std::filesystem::create_directories(final_path.parent_path(), ec);
+  std::string const tmp_path =
+      cache_path + ".tmp." + std::to_string(getpid());
+  {
+    std::ofstream cache(tmp_path, std::ios::binary | std::ios::trunc);
+    if (!cache) {
+      return compiled;
+    }
+    write_pod(cache, COMPILED_RULES_MAGIC);
+    write_pod(cache, COMPILED_RULES_VERSION);
+    write_string(cache, source);
+    write_pod(cache, stamp.first);
+    write_pod(cache, stamp.second);
+    save_compiled_rule_collection(compiled, cache);
+    cache.close();
+    if (!cache) {
+      std::filesystem::remove(tmp_path, ec);
+      return compiled;
+    }
+  }
+  std::filesystem::rename(tmp_path, final_path, ec);
+  if (ec) {
+    std::filesystem::remove(tmp_path, ec);
+  }
+  return compiled;
+}
+
 } // namespace FlexFlow::substitution_loader
@@ -0,0 +1,152 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares BPETokenizer against GPT_Tokenizer on the data of
+// gpt_tokenizer.cpp: both must produce the same ids for every line, and
+// the throughput of each is reported in tokens/sec.
+
+#include <flexflow/bpe_tokenizer.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+
+using FlexFlow::BPETokenizer;
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                       start)
+      .count();
+}
+
+static void report(char const *name, size_t tokens, double seconds) {
+  printf("%-36s %10.3f s %14.0f tokens/s\n", name, seconds, tokens / seconds);
+}
+
+int main(int argc, char *argv[]) {
+  if ((argc != 2 && argc != 5) ||
+      (strcmp(argv[1], "gpt-2") && strcmp(argv[1], "opt"))) {
+    fprintf(stderr,
+            "Usage: %s <gpt-2|opt> [vocab_file merge_file input_file]\n",
+            argv[0]);
+    return 1;
+  }
+  tokenizer_mode mode =
+      strcmp(argv[1], "gpt-2") == 0 ? GPT2_TOKENIZER : OPT_TOKENIZER;
+  std::string vocab_file = mode == GPT2_TOKENIZER ? "./gpt2_bpe/encoder.json"
+                                                  : "opt_bpe/gpt2-vocab.json";
+  std::string merge_file = mode == GPT2_TOKENIZER ? "./gpt2_bpe/vocab.bpe"
+                                                  : "opt_bpe/gpt2-merges.txt";
+  std::string input_file = "./wikitext-103-raw/wiki.valid.raw";
+  if (argc == 5) {
+    vocab_file = argv[2];
+    merge_file = argv[3];
+    input_file = argv[4];
+  }
+
+  GPT_Tokenizer legacy(mode, vocab_file, merge_file);
+  std::vector<std::string> lines;
+  std::ifstream infile(input_file);
+  if (!infile) {
+    std::cout << "Error opening input file" << std::endl;
+    return -1;
+  }
+  std::string line;
+  while (std::getline(infile, line)) {
+    std::string stripped_line = legacy.strip(line);
+    if (stripped_line.length() > 0) {
+      lines.push_back(stripped_line);
+    }
+  }
+  unsigned const num_threads =
+      std::max(1u, std::thread::hardware_concurrency());
+  printf("%zu lines, %u threads\n", lines.size(), num_threads);
+
+  // Reference ids. max_length exceeds the number of tokens, so nothing is
+  // truncated.
+  std::vector<std::vector<int32_t>> input_ids(lines.size());
+  std::vector<std::vector<int32_t>> mask_ids(lines.size());
+  auto start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < lines.size(); i++) {
+    legacy.encode(
+        lines[i], lines[i].length() + 1, &input_ids[i], &mask_ids[i]);
+  }
+  double const legacy_seconds = seconds_since(start);
+  std::vector<std::vector<int32_t>> expected(lines.size());
+  size_t num_tokens = 0;
+  for (size_t i = 0; i < lines.size(); i++) {
+    size_t const first = mode == OPT_TOKENIZER ? 1 : 0;
+    for (size_t j = first; j < input_ids[i].size(); j++) {
+      if (mask_ids[i][j]) {
+        expected[i].push_back(input_ids[i][j]);
+      }
+    }
+    num_tokens += expected[i].size();
+  }
+  report("GPT_Tokenizer::encode", num_tokens, legacy_seconds);
+
+  {
+    BPETokenizer tokenizer(mode, vocab_file, merge_file);
+    std::vector<std::vector<int32_t>> output(lines.size());
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lines.size(); i++) {
+      output[i] = tokenizer.encode(lines[i]);
+    }
+    report("BPETokenizer::encode (cold cache)",
+           num_tokens,
+           seconds_since(start));
+    start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < lines.size(); i++) {
+      output[i] = tokenizer.encode(lines[i]);
+    }
+    report("BPETokenizer::encode (warm cache)",
+           num_tokens,
+           seconds_since(start));
+  }
+
+  BPETokenizer tokenizer(mode, vocab_file, merge_file);
+  start = std::chrono::steady_clock::now();
+  std::vector<std::vector<int32_t>> output =
+      tokenizer.encode_batch(lines, num_threads);
+  report("BPETokenizer::encode_batch", num_tokens, seconds_since(start));
+
+  std::vector<std::string> expected_text(lines.size());
+  start = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < lines.size(); i++) {
+    expected_text[i] = legacy.decode(input_ids[i], mask_ids[i]);
+  }
+  report("GPT_Tokenizer::decode", num_tokens, seconds_since(start));
+  start = std::chrono::steady_clock::now();
+  std::vector<std::string> decoded =
+      tokenizer.decode_batch(output, num_threads);
+  report("BPETokenizer::decode_batch", num_tokens, seconds_since(start));
+
+  size_t mismatches = 0;
+  for (size_t i = 0; i < lines.size(); i++) {
+    if (output[i] != expected[i] || decoded[i] != expected_text[i]) {
+      if (mismatches++ < 10) {
+        std::cout << "Mismatch on line: " << lines[i] << std::endl;
+      }
+    }
+  }
+  if (mismatches > 0) {
+    std::cout << mismatches << " of " << lines.size()
+              << " lines differ from GPT_Tokenizer" << std::endl;
+    return 1;
+  }
+  return 0;
+}
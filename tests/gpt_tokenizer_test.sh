@@ -3,7 +3,7 @@ set -x
 set -e
 
 cleanup() {
-	rm -rf wikitext-103-raw-v1.zip wikitext-103-raw gpt2_bpe opt_bpe gpt_tokenizer pytokenizer.py bpe.py hf_tokenizer.py 
+	rm -rf wikitext-103-raw-v1.zip wikitext-103-raw gpt2_bpe opt_bpe gpt_tokenizer gpt_tokenizer_bench pytokenizer.py bpe.py hf_tokenizer.py 
 }
 
 # Cd into directory holding this script
@@ -15,6 +15,8 @@ cleanup
 # Compile the FlexFlow C++ tokenizer stand-alone
 g++ -std=c++11 -I../deps/json/include -I../include -o gpt_tokenizer gpt_tokenizer.cpp ../src/runtime/gpt_tokenizer.cc
 chmod +x gpt_tokenizer
+# Compile the benchmark of the BPE tokenizer against the C++ tokenizer above
+g++ -std=c++11 -O2 -I../deps/json/include -I../include -o gpt_tokenizer_bench gpt_tokenizer_bench.cpp ../src/runtime/gpt_tokenizer.cc ../src/runtime/bpe_tokenizer.cc -pthread
 
 # Download and inflate wikitext dataset
 wget https://s3.amazonaws.com/research.metamind.io/wikitext/wikitext-103-raw-v1.zip
@@ -63,6 +65,9 @@ chmod +x pytokenizer.py
 # Check that the outputs match
 diff ./wikitext-103-raw/wiki.valid.bpe.flexflow.gpt2 ./wikitext-103-raw/wiki.valid.bpe.minGPT
 
+# Check that the BPE tokenizer matches, and report tokens/sec of both
+./gpt_tokenizer_bench gpt-2
+
 ###############################################################################################
 ##################################### OPT tests ###############################################
 ###############################################################################################
@@ -103,5 +108,8 @@ chmod +x hf_tokenizer.py
 # Check that the outputs match
 diff ./wikitext-103-raw/wiki.valid.bpe.flexflow.opt ./wikitext-103-raw/wiki.valid.bpe.OPT
 
+# Check that the BPE tokenizer matches, and report tokens/sec of both
+./gpt_tokenizer_bench opt
+
 # Clean up after test
 cleanup
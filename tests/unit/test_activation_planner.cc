@@ -0,0 +1,45 @@
+#include "flexflow/activation_planner.h"
+#include "gtest/gtest.h"
+
+using namespace FlexFlow;
+
+static ActivationInterval
+    make_interval(int first_op, int last_op, size_t bytes, int reuse_class) {
+  ActivationInterval t;
+  t.first_op = first_op;
+  t.last_op = last_op;
+  t.bytes = bytes;
+  t.reuse_class = reuse_class;
+  return t;
+}
+
+TEST(activation_planner, buffers_are_reused_after_last_reader) {
+  // A chain a -> b -> c -> d where each tensor is read by the next op only
+  std::vector<ActivationInterval> tensors = {
+      make_interval(0, 1, 1024, 0),
+      make_interval(1, 2, 1024, 0),
+      make_interval(2, 3, 1024, 0),
+      make_interval(3, 3, 1024, 0),
+  };
+  ActivationPlan plan = plan_activation_memory(tensors);
+  EXPECT_EQ(plan.buffer_bytes.size(), 2);
+  EXPECT_NE(plan.buffer[0], plan.buffer[1]);
+  EXPECT_EQ(plan.buffer[0], plan.buffer[2]);
+  EXPECT_EQ(plan.buffer[1], plan.buffer[3]);
+  EXPECT_EQ(plan.naive_bytes[0], 4096);
+  EXPECT_EQ(plan.reused_bytes[0], 2048);
+}
+
+TEST(activation_planner, classes_and_arenas_do_not_share_buffers) {
+  std::vector<ActivationInterval> tensors = {
+      make_interval(0, 0, 1024, 0),
+      make_interval(1, 1, 1024, 1),
+      make_interval(2, 2, 1024, 0),
+  };
+  tensors[2].arena = 1;
+  ActivationPlan plan = plan_activation_memory(tensors);
+  EXPECT_EQ(plan.buffer_bytes.size(), 3);
+  ASSERT_EQ(plan.reused_bytes.size(), 2);
+  EXPECT_EQ(plan.reused_bytes[0], 2048);
+  EXPECT_EQ(plan.reused_bytes[1], 1024);
+}
@@ -0,0 +1,72 @@
+#include "flexflow/bpe_tokenizer.h"
+#include "gtest/gtest.h"
+
+using namespace FlexFlow;
+
+namespace {
+
+// "Ġ" is the byte-level form of a space. "aa a" ranks before "a a" although
+// it needs the result of "a a", so the merge order matters.
+char const VOCAB[] = R"({"<pad>": 0, "<unk>": 1, "a": 2, "b": 3, "aa": 4,
+  "aaa": 5, "Ġ": 6, "Ġa": 7, "ab": 8, "'s": 9, "s": 10, "'": 11})";
+char const MERGES[] = "#version: 0.2\naa a\na a\nĠ a\na b\n' s\n";
+
+struct BPETokenizerTest : public ::testing::Test {
+  void SetUp() override {
+    vocab_file = ::testing::TempDir() + "bpe_tokenizer_vocab.json";
+    merge_file = ::testing::TempDir() + "bpe_tokenizer_merges.txt";
+    std::ofstream(vocab_file) << VOCAB;
+    std::ofstream(merge_file) << MERGES;
+  }
+  std::string vocab_file, merge_file;
+};
+
+std::vector<std::string> const TEXTS = {
+    "aaaa",
+    "aaaaa b",
+    "ab aab's  a\t\tb",
+    "a's'sa 'S",
+    "12 ab!! a\n\n  aab",
+    "\xc3\xa9\xe4\xb8\xad aa \xe2\x80\x83 a",
+};
+
+} // namespace
+
+TEST_F(BPETokenizerTest, merges_lowest_rank_pair_everywhere_first) {
+  BPETokenizer tokenizer(GPT2_TOKENIZER, vocab_file, merge_file);
+  EXPECT_EQ(tokenizer.encode("aaaa"), std::vector<int32_t>({4, 4}));
+  EXPECT_EQ(tokenizer.encode("aaaaa"), std::vector<int32_t>({4, 5}));
+  EXPECT_EQ(tokenizer.encode(" a's"), std::vector<int32_t>({7, 9}));
+  EXPECT_EQ(tokenizer.encode("c"), std::vector<int32_t>({1}));
+}
+
+TEST_F(BPETokenizerTest, matches_gpt_tokenizer) {
+  for (tokenizer_mode mode : {GPT2_TOKENIZER, OPT_TOKENIZER}) {
+    GPT_Tokenizer reference(mode, vocab_file, merge_file);
+    BPETokenizer tokenizer(mode, vocab_file, merge_file);
+    for (std::string const &text : TEXTS) {
+      std::vector<int32_t> expected_ids, expected_mask, ids, mask;
+      reference.encode(text, 8, &expected_ids, &expected_mask);
+      tokenizer.encode(text, 8, &ids, &mask);
+      EXPECT_EQ(ids, expected_ids) << text;
+      EXPECT_EQ(mask, expected_mask) << text;
+      EXPECT_EQ(tokenizer.decode(ids, mask), reference.decode(ids, mask))
+          << text;
+    }
+  }
+}
+
+TEST_F(BPETokenizerTest, batches_match_single_calls) {
+  BPETokenizer tokenizer(GPT2_TOKENIZER, vocab_file, merge_file);
+  std::vector<std::string> texts;
+  for (int i = 0; i < 64; i++) {
+    texts.push_back(TEXTS[i % TEXTS.size()]);
+  }
+  std::vector<std::vector<int32_t>> ids = tokenizer.encode_batch(texts, 4);
+  std::vector<std::string> decoded = tokenizer.decode_batch(ids, 4);
+  ASSERT_EQ(ids.size(), texts.size());
+  for (size_t i = 0; i < texts.size(); i++) {
+    EXPECT_EQ(ids[i], tokenizer.encode(texts[i]));
+    EXPECT_EQ(decoded[i], tokenizer.decode(ids[i]));
+  }
+}
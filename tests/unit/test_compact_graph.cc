@@ -0,0 +1,119 @@
+#include "flexflow/compact_graph.h"
+#include "flexflow/dominators.h"
+#include "gtest/gtest.h"
+#include <random>
+
+using namespace FlexFlow::PCG::Utils;
+
+using IntGraph = CompactGraph<int>;
+
+// The graph with the live nodes and edges of g, built from scratch
+static IntGraph rebuild(IntGraph const &g) {
+  std::vector<int> nodes;
+  std::vector<int> new_id(g.num_ids(), -1);
+  for (int id = 0; id < g.num_ids(); id++) {
+    if (g.contains(id)) {
+      new_id[id] = nodes.size();
+      nodes.push_back(g.node(id));
+    }
+  }
+  std::vector<CompactEdge> edges;
+  for (int id = 0; id < g.num_ids(); id++) {
+    if (g.contains(id)) {
+      for (CompactEdge e : g.in_edges(id)) {
+        e.src = new_id[e.src];
+        e.dst = new_id[e.dst];
+        edges.push_back(e);
+      }
+    }
+  }
+  return IntGraph(nodes, edges);
+}
+
+static IntGraph random_dag(std::mt19937 &gen, int num_nodes) {
+  std::vector<int> nodes;
+  std::vector<CompactEdge> edges;
+  for (int i = 0; i < num_nodes; i++) {
+    nodes.push_back(100 + i);
+    int fan_in = i == 0 ? 0 : 1 + gen() % 2;
+    for (int k = 0; k < fan_in; k++) {
+      edges.push_back({(int)(gen() % i), i, (int)(gen() % 2), k});
+    }
+  }
+  return IntGraph(nodes, edges);
+}
+
+TEST(compact_graph, rewrite_keeps_ids_and_shares_copies) {
+  IntGraph g({10, 11, 12, 13}, {{0, 1, 0, 0}, {1, 2, 0, 0}, {2, 3, 0, 0}});
+  IntGraph copy = g;
+  EXPECT_EQ(&*copy.in_edges(2).begin(), &*g.in_edges(2).begin());
+
+  // Replace 11 -> 12 with a single node 14
+  IntGraph h = g.rewrite({1, 2}, {14}, {{0, 4, 0, 0}, {4, 3, 0, 0}});
+  EXPECT_EQ(h.num_nodes(), 3);
+  EXPECT_EQ(h.num_edges(), 2);
+  EXPECT_EQ(h.find(14), 4);
+  EXPECT_EQ(h.find(11), -1);
+  EXPECT_EQ(h.find(13), 3);
+  EXPECT_EQ(h.node(0), 10);
+  ASSERT_EQ(h.in_edges(3).size(), 1);
+  EXPECT_EQ(h.in_edges(3).begin()->src, 4);
+  // The original is untouched
+  EXPECT_EQ(g.num_nodes(), 4);
+  EXPECT_EQ(g.find(11), 1);
+  EXPECT_EQ(h.hash(), rebuild(h).hash());
+  EXPECT_NE(h.hash(), g.hash());
+}
+
+TEST(compact_graph, incremental_hash_matches_rebuild) {
+  std::mt19937 gen(0);
+  IntGraph g = random_dag(gen, 40);
+  int next_value = 1000;
+  for (int step = 0; step < 50; step++) {
+    // Remove a random live node, add one that takes over its edges
+    int victim;
+    do {
+      victim = gen() % g.num_ids();
+    } while (!g.contains(victim));
+    int const fresh = g.num_ids();
+    std::vector<CompactEdge> added;
+    for (CompactEdge e : g.in_edges(victim)) {
+      e.dst = fresh;
+      added.push_back(e);
+    }
+    for (CompactEdge e : g.out_edges(victim)) {
+      e.src = fresh;
+      added.push_back(e);
+    }
+    g = g.rewrite({victim}, {next_value++}, added);
+    ASSERT_EQ(g.hash(), rebuild(g).hash()) << "step " << step;
+  }
+  std::vector<int> half;
+  for (int id = 0; id < g.num_ids(); id += 2) {
+    if (g.contains(id)) {
+      half.push_back(id);
+    }
+  }
+  IntGraph sub = g.subgraph(half);
+  EXPECT_EQ(sub.num_nodes(), half.size());
+  EXPECT_EQ(sub.hash(), rebuild(sub).hash());
+}
+
+TEST(compact_graph, dense_post_dominators_match_generic) {
+  std::mt19937 gen(1);
+  for (int trial = 0; trial < 20; trial++) {
+    IntGraph g = random_dag(gen, 5 + trial * 3);
+    if (trial % 2 == 1) {
+      g = g.rewrite({(int)(gen() % g.num_ids())}, {}, {});
+    }
+    std::unordered_map<int, int> expected = imm_post_dominators(g);
+    std::vector<int> dense = dense_imm_post_dominators(g);
+    for (int id = 0; id < g.num_ids(); id++) {
+      if (g.contains(id)) {
+        EXPECT_EQ(dense[id], expected.at(id)) << "trial " << trial;
+      } else {
+        EXPECT_EQ(dense[id], -1);
+      }
+    }
+  }
+}
@@ -0,0 +1,798 @@
+#include "flexflow/ffconst_utils.h"
+#include "flexflow/ops/kernels/cpu_kernels.h"
+#include "gtest/gtest.h"
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace FlexFlow;
+
+static std::vector<float> random_vector(size_t n, unsigned seed) {
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  std::vector<float> v(n);
+  for (float &x : v) {
+    x = dist(gen);
+  }
+  return v;
+}
+
+TEST(cpu_kernels, linear_matches_reference) {
+  // Odd sizes exercise the tile and vector remainders
+  int const in_dim = 37, out_dim = 11, batch_size = 67;
+  std::vector<float> input = random_vector(in_dim * batch_size, 1);
+  std::vector<float> weight = random_vector(in_dim * out_dim, 2);
+  std::vector<float> bias = random_vector(out_dim, 3);
+  std::vector<float> output(out_dim * batch_size);
+  Kernels::CPU::linear_forward(input.data(),
+                               weight.data(),
+                               bias.data(),
+                               output.data(),
+                               in_dim,
+                               out_dim,
+                               batch_size,
+                               AC_MODE_RELU);
+  for (int b = 0; b < batch_size; b++) {
+    for (int o = 0; o < out_dim; o++) {
+      float ref = bias[o];
+      for (int k = 0; k < in_dim; k++) {
+        ref += input[b * in_dim + k] * weight[o * in_dim + k];
+      }
+      EXPECT_NEAR(output[b * out_dim + o], std::max(ref, 0.0f), 1e-4f);
+    }
+  }
+}
+
+TEST(cpu_kernels, rms_norm_and_silu) {
+  int const dim = 19, rows = 3;
+  std::vector<float> input = random_vector(dim * rows, 4);
+  std::vector<float> weight = random_vector(dim, 5);
+  std::vector<float> output(dim * rows);
+  Kernels::CPU::rms_norm_forward(
+      input.data(), weight.data(), output.data(), dim, rows, 1e-6f, 2);
+  for (int r = 0; r < rows; r++) {
+    float sq = 0;
+    for (int i = 0; i < dim; i++) {
+      sq += input[r * dim + i] * input[r * dim + i];
+    }
+    float scale = 1.0f / std::sqrt(sq / dim + 1e-6f);
+    for (int i = 0; i < dim; i++) {
+      EXPECT_NEAR(
+          output[r * dim + i], input[r * dim + i] * scale * weight[i], 1e-5f);
+    }
+  }
+
+  std::vector<float> gate = random_vector(dim, 6);
+  std::vector<float> up = random_vector(dim, 7);
+  Kernels::CPU::sigmoid_silu_multi(
+      gate.data(), up.data(), output.data(), dim, 1);
+  for (int i = 0; i < dim; i++) {
+    float silu = gate[i] / (1.0f + std::exp(-gate[i]));
+    EXPECT_NEAR(output[i], silu * up[i], 1e-6f);
+  }
+}
+
+TEST(cpu_kernels, sampling_top_p) {
+  int const vocab_size = 300;
+  // Row 0 puts 0.5, 0.3 and 0.2 on tokens 7, 250 and 3; row 1 is uniform
+  std::vector<float> probs(2 * vocab_size, 0.0f);
+  probs[7] = 0.5f;
+  probs[250] = 0.3f;
+  probs[3] = 0.2f;
+  std::fill(probs.begin() + vocab_size, probs.end(), 1.0f / vocab_size);
+  int indices[2];
+  std::vector<std::pair<float, int>> draws = {
+      {0.0f, 7}, {0.49f, 7}, {0.51f, 250}, {0.79f, 250}, {0.81f, 3}};
+  for (auto const &draw : draws) {
+    float uniforms[2] = {draw.first, 0.0f};
+    Kernels::CPU::sampling_top_p(
+        probs.data(), uniforms, indices, vocab_size, 2, 1.0f);
+    EXPECT_EQ(indices[0], draw.second) << draw.first;
+    EXPECT_EQ(indices[1], 0);
+  }
+  // With top_p = 0.6 only tokens 7 and 250 can be drawn. In the uniform row
+  // the draw goes past the first sorted block of 64 tokens.
+  float uniforms[2] = {0.99f, 0.99f};
+  Kernels::CPU::sampling_top_p(
+      probs.data(), uniforms, indices, vocab_size, 2, 0.6f);
+  EXPECT_EQ(indices[0], 250);
+  EXPECT_EQ(indices[1], 178);
+}
+
+TEST(cpu_kernels, argmax_and_embedding) {
+  std::vector<float> logits = {0.1f, 0.7f, 0.7f, -1.0f, 2.0f, 0.0f};
+  int indices[2];
+  Kernels::CPU::argmax(logits.data(), indices, 3, 2);
+  EXPECT_EQ(indices[0], 1);
+  EXPECT_EQ(indices[1], 1);
+
+  int const out_dim = 20;
+  std::vector<float> table = random_vector(4 * out_dim, 8);
+  std::vector<int64_t> tokens = {3, 0, 2, 2};
+  std::vector<float> output(2 * out_dim);
+  Kernels::CPU::embedding_lookup(
+      tokens.data(), table.data(), output.data(), 2, out_dim, 2, AGGR_MODE_AVG);
+  for (int i = 0; i < out_dim; i++) {
+    EXPECT_NEAR(output[i], (table[3 * out_dim + i] + table[i]) / 2, 1e-6f);
+    EXPECT_FLOAT_EQ(output[out_dim + i], table[2 * out_dim + i]);
+  }
+}
+
+TEST(cpu_kernels, packed_linear_matches_unpacked) {
+  // in_dim spans several depth passes, out_dim ends in a partial panel
+  int const in_dim = 600, out_dim = 53, batch_size = 9;
+  std::vector<float> input = random_vector(in_dim * batch_size, 9);
+  std::vector<float> weight = random_vector(in_dim * out_dim, 10);
+  std::vector<float> bias = random_vector(out_dim, 11);
+  std::vector<float> packed(
+      Kernels::CPU::packed_linear_weight_size(in_dim, out_dim));
+  Kernels::CPU::pack_linear_weight(
+      weight.data(), packed.data(), in_dim, out_dim);
+  std::vector<float> expected(out_dim * batch_size);
+  Kernels::CPU::linear_forward(input.data(),
+                               weight.data(),
+                               bias.data(),
+                               expected.data(),
+                               in_dim,
+                               out_dim,
+                               batch_size,
+                               AC_MODE_GELU);
+  for (int num_threads : {1, 3}) {
+    std::vector<float> output(out_dim * batch_size);
+    Kernels::CPU::linear_forward_packed(input.data(),
+                                        packed.data(),
+                                        bias.data(),
+                                        output.data(),
+                                        in_dim,
+                                        out_dim,
+                                        batch_size,
+                                        AC_MODE_GELU,
+                                        num_threads);
+    for (size_t i = 0; i < output.size(); i++) {
+      EXPECT_NEAR(output[i], expected[i], 1e-4f);
+    }
+  }
+}
+
+TEST(cpu_kernels, batch_matmul_matches_reference) {
+  int const m = 21, n = 6, k = 300, batch = 3;
+  std::vector<float> a = random_vector(batch * n * k, 12);
+  std::vector<float> b = random_vector(batch * k * m, 13);
+  for (int num_threads : {1, 2, 4}) {
+    std::vector<float> o(batch * n * m);
+    Kernels::CPU::batch_matmul_forward(a.data(),
+                                       b.data(),
+                                       o.data(),
+                                       m,
+                                       n,
+                                       k,
+                                       k,
+                                       m,
+                                       m,
+                                       (size_t)n * k,
+                                       (size_t)k * m,
+                                       (size_t)n * m,
+                                       batch,
+                                       num_threads);
+    for (int i = 0; i < batch; i++) {
+      for (int r = 0; r < n; r++) {
+        for (int c = 0; c < m; c++) {
+          float ref = 0;
+          for (int kk = 0; kk < k; kk++) {
+            ref += a[(i * n + r) * k + kk] * b[(i * k + kk) * m + c];
+          }
+          EXPECT_NEAR(o[(i * n + r) * m + c], ref, 1e-4f);
+        }
+      }
+    }
+  }
+}
+
+// Random weight in the |values|offsets|scales| layout of
+// load_quantization_weight, with fp32 scales and offsets
+static std::vector<char> random_quantized_weight(int in_dim,
+                                                 int out_dim,
+                                                 DataType quantization_type,
+                                                 unsigned seed) {
+  size_t const num_elements = (size_t)in_dim * out_dim;
+  size_t const value_bytes =
+      quantization_type == DT_INT4 ? num_elements / 2 : num_elements;
+  size_t const num_groups = num_elements / INT4_NUM_OF_ELEMENTS_PER_GROUP;
+  std::vector<char> weight(value_bytes + 2 * num_groups * sizeof(float));
+  std::mt19937 gen(seed);
+  for (size_t i = 0; i < value_bytes; i++) {
+    weight[i] = (char)(gen() & 0xFF);
+  }
+  float *offsets = (float *)(weight.data() + value_bytes);
+  float *scales = offsets + num_groups;
+  std::uniform_real_distribution<float> offset_dist(-0.5f, 0.5f);
+  std::uniform_real_distribution<float> scale_dist(8.0f, 64.0f);
+  for (size_t g = 0; g < num_groups; g++) {
+    offsets[g] = offset_dist(gen);
+    scales[g] = scale_dist(gen);
+  }
+  return weight;
+}
+
+TEST(cpu_kernels, decompress_matches_group_layout) {
+  int const in_dim = 2, out_dim = 64;
+  std::vector<char> weight =
+      random_quantized_weight(in_dim, out_dim, DT_INT4, 14);
+  std::vector<float> output(in_dim * out_dim);
+  Kernels::CPU::decompress_quantized_weight(
+      weight.data(), output.data(), in_dim, out_dim, DT_INT4);
+  float const *offsets = (float const *)(weight.data() + in_dim * out_dim / 2);
+  float const *scales = offsets + in_dim * out_dim / 32;
+  // Row 33, column 1: low nibble of byte 33, second group of column 1
+  unsigned char byte = weight[33];
+  EXPECT_FLOAT_EQ(output[33 * in_dim + 1],
+                  (byte & 0xF) / scales[in_dim + 1] + offsets[in_dim + 1]);
+  EXPECT_FLOAT_EQ(output[33 * in_dim],
+                  (byte >> 4) / scales[in_dim] + offsets[in_dim]);
+}
+
+TEST(cpu_kernels, quantized_linear_matches_decompressed) {
+  // in_dim leaves a vector remainder, batch_size a tile remainder
+  int const in_dim = 70, out_dim = 96, batch_size = 5;
+  std::vector<float> input = random_vector(in_dim * batch_size, 15);
+  std::vector<float> bias = random_vector(out_dim, 16);
+  for (DataType type : {DT_INT4, DT_INT8}) {
+    std::vector<char> weight =
+        random_quantized_weight(in_dim, out_dim, type, 17);
+    std::vector<float> decompressed(in_dim * out_dim);
+    Kernels::CPU::decompress_quantized_weight(
+        weight.data(), decompressed.data(), in_dim, out_dim, type);
+    std::vector<float> expected(out_dim * batch_size);
+    Kernels::CPU::linear_forward(input.data(),
+                                 decompressed.data(),
+                                 bias.data(),
+                                 expected.data(),
+                                 in_dim,
+                                 out_dim,
+                                 batch_size,
+                                 AC_MODE_RELU);
+    for (int num_threads : {1, 2}) {
+      std::vector<float> output(out_dim * batch_size);
+      Kernels::CPU::linear_forward_quantized(input.data(),
+                                             weight.data(),
+                                             bias.data(),
+                                             output.data(),
+                                             in_dim,
+                                             out_dim,
+                                             batch_size,
+                                             type,
+                                             AC_MODE_RELU,
+                                             num_threads);
+      for (size_t i = 0; i < output.size(); i++) {
+        EXPECT_NEAR(
+            output[i], expected[i], 1e-4f * (1 + std::abs(expected[i])));
+      }
+    }
+  }
+}
+
+TEST(cpu_kernels, rotary_embedding_rotates_pairs) {
+  int const head_dim = 8, num_heads = 2, position = 5;
+  std::vector<float> x = random_vector(head_dim * num_heads, 18);
+  std::vector<float> y = x;
+  Kernels::CPU::rotary_embedding(y.data(), num_heads, head_dim, position);
+  for (int h = 0; h < num_heads; h++) {
+    for (int i = 0; i < head_dim / 2; i++) {
+      double freq = position / std::pow(10000.0, 2.0 * i / head_dim);
+      float re = x[h * head_dim + i], im = x[h * head_dim + i + head_dim / 2];
+      EXPECT_NEAR(y[h * head_dim + i], re * cos(freq) - im * sin(freq), 1e-5);
+      EXPECT_NEAR(y[h * head_dim + i + head_dim / 2],
+                  re * sin(freq) + im * cos(freq),
+                  1e-5);
+    }
+  }
+}
+
+TEST(cpu_kernels, causal_attention_matches_reference) {
+  // Grouped-query layout; one request decodes a token deep in its cache
+  // (several key blocks), the other prefills more than a query block
+  int const num_q_heads = 4, num_kv_heads = 2, head_dim = 12;
+  int const max_depth = 160, q_stride = num_q_heads * head_dim;
+  int const kv_stride = num_kv_heads * head_dim;
+  std::vector<Kernels::CPU::AttentionRequest> requests = {{0, 1, 130, 1},
+                                                          {1, 20, 3, 0}};
+  int const num_tokens = 21;
+  std::vector<float> q = random_vector(num_tokens * q_stride, 19);
+  std::vector<float> keys = random_vector(2 * max_depth * kv_stride, 20);
+  std::vector<float> values = random_vector(2 * max_depth * kv_stride, 21);
+  std::vector<float> slopes = {0.5f, 0.25f, 0.125f, 0.0625f};
+  float const scale = 1.0f / std::sqrt((float)head_dim);
+  for (bool alibi : {false, true}) {
+    std::vector<float> output(num_tokens * q_stride);
+    Kernels::CPU::causal_attention(q.data(),
+                                   q_stride,
+                                   keys.data(),
+                                   values.data(),
+                                   (size_t)max_depth * kv_stride,
+                                   kv_stride,
+                                   output.data(),
+                                   q_stride,
+                                   requests.data(),
+                                   (int)requests.size(),
+                                   num_q_heads,
+                                   num_kv_heads,
+                                   head_dim,
+                                   scale,
+                                   alibi ? slopes.data() : nullptr,
+                                   3);
+    for (auto const &req : requests) {
+      for (int t = 0; t < req.num_tokens; t++) {
+        int const depth = req.first_depth + t;
+        int const row = req.token_offset + t;
+        for (int h = 0; h < num_q_heads; h++) {
+          int const g = h / (num_q_heads / num_kv_heads);
+          float const *qv = q.data() + row * q_stride + h * head_dim;
+          std::vector<double> p(depth + 1);
+          double max_score = -1e30, sum = 0;
+          for (int k = 0; k <= depth; k++) {
+            float const *kv = keys.data() +
+                              (req.cache_slot * max_depth + k) * kv_stride +
+                              g * head_dim;
+            double s = 0;
+            for (int d = 0; d < head_dim; d++) {
+              s += qv[d] * kv[d];
+            }
+            p[k] = s * scale + (alibi ? slopes[h] * (k - depth) : 0.0);
+            max_score = std::max(max_score, p[k]);
+          }
+          for (double &x : p) {
+            x = std::exp(x - max_score);
+            sum += x;
+          }
+          for (int d = 0; d < head_dim; d++) {
+            double ref = 0;
+            for (int k = 0; k <= depth; k++) {
+              ref += p[k] / sum *
+                     values[(req.cache_slot * max_depth + k) * kv_stride +
+                            g * head_dim + d];
+            }
+            EXPECT_NEAR(output[row * q_stride + h * head_dim + d], ref, 1e-5);
+          }
+        }
+      }
+    }
+  }
+}
+
+TEST(cpu_kernels, tree_attention_follows_bitmask) {
+  // Request 0 verifies a 20-token tree on top of 70 committed tokens; each
+  // token sees its ancestors and itself. Request 1 has its queries at bits
+  // 5..7 of random mask words, as in a speculative beam layer.
+  int const num_q_heads = 4, num_kv_heads = 2, head_dim = 12;
+  int const max_depth = 96, q_stride = num_q_heads * head_dim;
+  int const kv_stride = num_kv_heads * head_dim;
+  std::vector<unsigned long long> tree_mask(20, 0), beam_mask(10, 0);
+  std::vector<int> parent(20, -1);
+  std::mt19937 gen(22);
+  for (int t = 0; t < 20; t++) {
+    parent[t] = t == 0 ? -1 : (int)(gen() % t);
+    for (int a = t; a >= 0; a = parent[a]) {
+      tree_mask[a] |= 1ull << t;
+    }
+  }
+  for (auto &word : beam_mask) {
+    word = ((unsigned long long)gen() << 32) | gen();
+  }
+  std::vector<Kernels::CPU::TreeAttentionRequest> requests = {
+      {0, 20, 90, 70, 0, 0, tree_mask.data()},
+      {20, 3, 40, 30, 5, 1, beam_mask.data()}};
+  int const num_tokens = 23;
+  std::vector<float> q = random_vector(num_tokens * q_stride, 23);
+  std::vector<float> keys = random_vector(2 * max_depth * kv_stride, 24);
+  std::vector<float> values = random_vector(2 * max_depth * kv_stride, 25);
+  float const scale = 1.0f / std::sqrt((float)head_dim);
+  std::vector<float> output(num_tokens * q_stride);
+  Kernels::CPU::tree_attention(q.data(),
+                               q_stride,
+                               keys.data(),
+                               values.data(),
+                               (size_t)max_depth * kv_stride,
+                               kv_stride,
+                               output.data(),
+                               q_stride,
+                               requests.data(),
+                               (int)requests.size(),
+                               num_q_heads,
+                               num_kv_heads,
+                               head_dim,
+                               scale,
+                               3);
+  for (auto const &req : requests) {
+    for (int t = 0; t < req.num_tokens; t++) {
+      int const row = req.token_offset + t;
+      std::vector<int> seen;
+      for (int k = 0; k < req.num_keys; k++) {
+        if (k < req.non_tree_cache_size ||
+            ((req.mask[k - req.non_tree_cache_size] >>
+              (req.first_query_bit + t)) &
+             1)) {
+          seen.push_back(k);
+        }
+      }
+      for (int h = 0; h < num_q_heads; h++) {
+        int const g = h / (num_q_heads / num_kv_heads);
+        float const *qv = q.data() + row * q_stride + h * head_dim;
+        std::vector<double> p;
+        double max_score = -1e30, sum = 0;
+        for (int k : seen) {
+          float const *kv = keys.data() +
+                            (req.cache_slot * max_depth + k) * kv_stride +
+                            g * head_dim;
+          double s = 0;
+          for (int d = 0; d < head_dim; d++) {
+            s += qv[d] * kv[d];
+          }
+          p.push_back(s * scale);
+          max_score = std::max(max_score, p.back());
+        }
+        for (double &x : p) {
+          x = std::exp(x - max_score);
+          sum += x;
+        }
+        for (int d = 0; d < head_dim; d++) {
+          double ref = 0;
+          for (size_t i = 0; i < seen.size(); i++) {
+            ref += p[i] / sum *
+                   values[(req.cache_slot * max_depth + seen[i]) * kv_stride +
+                          g * head_dim + d];
+          }
+          EXPECT_NEAR(output[row * q_stride + h * head_dim + d], ref, 1e-5);
+        }
+      }
+    }
+  }
+}
+
+TEST(cpu_kernels, half_conversion_round_trips) {
+  // Every finite half converts to float and back unchanged
+  for (uint32_t bits = 0; bits < 0x10000; bits++) {
+    Kernels::CPU::Half h{(uint16_t)bits};
+    if ((bits & 0x7C00) == 0x7C00 && (bits & 0x3FF) != 0) {
+      continue; // NaN payloads are not preserved
+    }
+    EXPECT_EQ(Kernels::CPU::float_to_half(Kernels::CPU::half_to_float(h)).bits,
+              bits);
+  }
+  // Ties between neighbours 2^-10 apart go to the even mantissa
+  EXPECT_EQ(Kernels::CPU::float_to_half(1.0f + 2.0f / 4096).bits, 0x3C00);
+  EXPECT_EQ(Kernels::CPU::float_to_half(1.0f + 6.0f / 4096).bits, 0x3C02);
+  EXPECT_EQ(Kernels::CPU::float_to_half(65520.0f).bits, 0x7C00);
+  EXPECT_FLOAT_EQ(Kernels::CPU::half_to_float({0x0001}),
+                  std::ldexp(1.0f, -24));
+}
+
+TEST(cpu_kernels, residual_norms_match_separate_ops) {
+  int const dim = 37, rows = 5;
+  float const eps = 1e-5f;
+  std::vector<float> input = random_vector(dim * rows, 26);
+  std::vector<float> residual1 = random_vector(dim * rows, 27);
+  std::vector<float> residual2 = random_vector(dim * rows, 28);
+  std::vector<float> bias = random_vector(dim, 29);
+  std::vector<float> gamma = random_vector(dim, 30);
+  std::vector<float> beta = random_vector(dim, 31);
+  std::vector<float> added(dim * rows), output(dim * rows);
+
+  Kernels::CPU::residual_rms_norm_forward(input.data(),
+                                          residual1.data(),
+                                          gamma.data(),
+                                          added.data(),
+                                          output.data(),
+                                          dim,
+                                          rows,
+                                          eps,
+                                          3);
+  std::vector<float> sum(dim * rows), expected(dim * rows);
+  for (int i = 0; i < dim * rows; i++) {
+    sum[i] = input[i] + residual1[i];
+  }
+  Kernels::CPU::rms_norm_forward(
+      sum.data(), gamma.data(), expected.data(), dim, rows, eps, 1);
+  for (int i = 0; i < dim * rows; i++) {
+    EXPECT_FLOAT_EQ(added[i], sum[i]);
+    EXPECT_NEAR(output[i], expected[i], 1e-5f);
+  }
+
+  for (bool two_residuals : {false, true}) {
+    Kernels::CPU::residual_layer_norm_forward(
+        input.data(),
+        residual1.data(),
+        two_residuals ? residual2.data() : nullptr,
+        bias.data(),
+        gamma.data(),
+        beta.data(),
+        added.data(),
+        output.data(),
+        dim,
+        rows,
+        eps,
+        2);
+    for (int r = 0; r < rows; r++) {
+      double mean = 0, var = 0;
+      for (int i = 0; i < dim; i++) {
+        int const k = r * dim + i;
+        sum[k] = input[k] + residual1[k] + bias[i] +
+                 (two_residuals ? residual2[k] : 0.0f);
+        mean += sum[k];
+      }
+      mean /= dim;
+      for (int i = 0; i < dim; i++) {
+        var += (sum[r * dim + i] - mean) * (sum[r * dim + i] - mean);
+      }
+      double const rstd = 1.0 / std::sqrt(var / dim + eps);
+      for (int i = 0; i < dim; i++) {
+        int const k = r * dim + i;
+        EXPECT_NEAR(added[k], sum[k], 1e-6f);
+        EXPECT_NEAR(
+            output[k], (sum[k] - mean) * rstd * gamma[i] + beta[i], 1e-4f);
+      }
+    }
+  }
+}
+
+TEST(cpu_kernels, half_norms_accumulate_in_fp32) {
+  // Large rows whose sum of squares would lose precision in fp16
+  int const dim = 4096, rows = 2;
+  std::vector<float> a = random_vector(dim * rows, 32);
+  std::vector<float> b = random_vector(dim * rows, 33);
+  std::vector<float> w = random_vector(dim, 34);
+  std::vector<Kernels::CPU::Half> ha(dim * rows), hb(dim * rows), hw(dim);
+  for (int i = 0; i < dim * rows; i++) {
+    ha[i] = Kernels::CPU::float_to_half(a[i]);
+    hb[i] = Kernels::CPU::float_to_half(b[i]);
+  }
+  for (int i = 0; i < dim; i++) {
+    hw[i] = Kernels::CPU::float_to_half(w[i]);
+  }
+  std::vector<Kernels::CPU::Half> added(dim * rows), output(dim * rows);
+  Kernels::CPU::residual_rms_norm_forward(ha.data(),
+                                          hb.data(),
+                                          hw.data(),
+                                          added.data(),
+                                          output.data(),
+                                          dim,
+                                          rows,
+                                          1e-6f,
+                                          2);
+  for (int r = 0; r < rows; r++) {
+    double sq = 0;
+    for (int i = 0; i < dim; i++) {
+      int const k = r * dim + i;
+      float const x = Kernels::CPU::half_to_float(Kernels::CPU::float_to_half(
+          Kernels::CPU::half_to_float(ha[k]) +
+          Kernels::CPU::half_to_float(hb[k])));
+      EXPECT_EQ(Kernels::CPU::half_to_float(added[k]), x);
+      sq += (double)x * x;
+    }
+    double const rms = 1.0 / std::sqrt(sq / dim + 1e-6);
+    for (int i = 0; i < dim; i++) {
+      int const k = r * dim + i;
+      double const ref = Kernels::CPU::half_to_float(added[k]) * rms *
+                         Kernels::CPU::half_to_float(hw[i]);
+      EXPECT_NEAR(Kernels::CPU::half_to_float(output[k]),
+                  ref,
+                  1e-3 * (1 + std::abs(ref)));
+    }
+  }
+
+  std::vector<Kernels::CPU::Half> silu(dim);
+  Kernels::CPU::sigmoid_silu_multi(ha.data(), hb.data(), silu.data(), dim, 3);
+  for (int i = 0; i < dim; i++) {
+    float const x = Kernels::CPU::half_to_float(ha[i]);
+    float const ref =
+        x / (1 + std::exp(-x)) * Kernels::CPU::half_to_float(hb[i]);
+    EXPECT_NEAR(Kernels::CPU::half_to_float(silu[i]), ref, 1e-3f);
+  }
+}
+
+TEST(cpu_kernels, half_sampling_embedding_and_linear) {
+  using Kernels::CPU::Half;
+  int const vocab_size = 300, out_dim = 20;
+  std::vector<float> logits = random_vector(vocab_size, 35);
+  logits[123] = 4.0f;
+  std::vector<Half> hlogits(vocab_size);
+  Kernels::CPU::convert(logits.data(), hlogits.data(), vocab_size);
+  int index;
+  Kernels::CPU::argmax(hlogits.data(), &index, vocab_size, 1);
+  EXPECT_EQ(index, 123);
+  float uniform = 0.0f;
+  Kernels::CPU::sampling_top_p(
+      hlogits.data(), &uniform, &index, vocab_size, 1, 1.0f);
+  EXPECT_EQ(index, 123);
+
+  std::vector<float> table = random_vector(4 * out_dim, 36);
+  std::vector<Half> htable(table.size());
+  Kernels::CPU::convert(table.data(), htable.data(), table.size());
+  std::vector<int32_t> tokens = {3, 1};
+  std::vector<Half> rows(2 * out_dim), sum(out_dim);
+  Kernels::CPU::embedding_lookup(
+      tokens.data(), htable.data(), rows.data(), 1, out_dim, 2, AGGR_MODE_NONE);
+  Kernels::CPU::embedding_lookup(
+      tokens.data(), htable.data(), sum.data(), 2, out_dim, 1, AGGR_MODE_SUM);
+  for (int i = 0; i < out_dim; i++) {
+    EXPECT_EQ(rows[i].bits, htable[3 * out_dim + i].bits);
+    EXPECT_EQ(rows[out_dim + i].bits, htable[out_dim + i].bits);
+    float const ref = Kernels::CPU::half_to_float(htable[3 * out_dim + i]) +
+                      Kernels::CPU::half_to_float(htable[out_dim + i]);
+    EXPECT_EQ(sum[i].bits, Kernels::CPU::float_to_half(ref).bits);
+  }
+
+  // A half weight packs to the same panels as its fp32 widening
+  int const in_dim = 70, cols = 19;
+  std::vector<float> weight = random_vector(in_dim * cols, 37);
+  std::vector<Half> hweight(weight.size());
+  Kernels::CPU::convert(weight.data(), hweight.data(), weight.size());
+  Kernels::CPU::convert(hweight.data(), weight.data(), weight.size());
+  size_t const packed_size =
+      Kernels::CPU::packed_linear_weight_size(in_dim, cols);
+  std::vector<float> packed(packed_size), hpacked(packed_size);
+  Kernels::CPU::pack_linear_weight(weight.data(), packed.data(), in_dim, cols);
+  Kernels::CPU::pack_linear_weight(
+      hweight.data(), hpacked.data(), in_dim, cols);
+  EXPECT_EQ(packed, hpacked);
+}
+
+TEST(cpu_kernels, moe_dispatch_matches_dense_kernels) {
+  // Skewed routing: expert 0 gets most assignments and overflows capacity
+  int const n = 5, k = 2, batch_size = 23, data_dim = 19, capacity = 6;
+  std::mt19937 gen(7);
+  std::discrete_distribution<int> route({8, 2, 1, 1, 0});
+  std::vector<int> assign(batch_size * k);
+  for (int &e : assign) {
+    e = route(gen);
+  }
+  std::vector<float> input = random_vector(batch_size * data_dim, 8);
+  std::vector<float> gate = random_vector(batch_size * k, 9);
+
+  // Reference: the per-assignment walk of gb_forward_kernel and
+  // agg_forward_kernel
+  std::vector<std::vector<float>> ref_groups(
+      n, std::vector<float>(capacity * data_dim, -1.0f));
+  std::vector<float> ref_output(batch_size * data_dim, 0.0f);
+  std::vector<int> ref_counts(n, 0);
+  for (int i = 0; i < batch_size * k; i++) {
+    int const e = assign[i];
+    int const row = ref_counts[e]++;
+    if (row >= capacity) {
+      continue;
+    }
+    for (int d = 0; d < data_dim; d++) {
+      float const x = input[(i / k) * data_dim + d];
+      ref_groups[e][row * data_dim + d] = x;
+      ref_output[(i / k) * data_dim + d] += gate[i] * x;
+    }
+  }
+
+  std::vector<std::vector<float>> groups(
+      n, std::vector<float>(capacity * data_dim, -1.0f));
+  std::vector<float *> group_ptrs;
+  for (std::vector<float> &g : groups) {
+    group_ptrs.push_back(g.data());
+  }
+  std::vector<int> counts(n);
+  Kernels::CPU::group_by_forward(input.data(),
+                                 assign.data(),
+                                 group_ptrs.data(),
+                                 counts.data(),
+                                 n,
+                                 k,
+                                 capacity,
+                                 batch_size,
+                                 data_dim,
+                                 3);
+  EXPECT_EQ(counts, ref_counts);
+  EXPECT_GT(counts[0], capacity);
+  EXPECT_EQ(counts[4], 0);
+  for (int e = 0; e < n; e++) {
+    EXPECT_EQ(groups[e], ref_groups[e]) << "expert " << e;
+  }
+
+  // Identity experts: aggregating the groups gives back the gated inputs
+  std::vector<float> output(batch_size * data_dim);
+  Kernels::CPU::aggregate_forward(group_ptrs.data(),
+                                  assign.data(),
+                                  gate.data(),
+                                  output.data(),
+                                  n,
+                                  k,
+                                  capacity,
+                                  batch_size,
+                                  data_dim,
+                                  2);
+  for (int i = 0; i < batch_size * data_dim; i++) {
+    EXPECT_NEAR(output[i], ref_output[i], 1e-6f);
+  }
+}
+
+TEST(cpu_kernels, grouped_experts_match_per_token_gemv) {
+  // Block of experts [2, 6) out of 8; expert 2 is hot enough to span
+  // several row tiles and to overflow capacity
+  int const num_tokens = 150, k = 2, start = 2, num_experts = 4;
+  int const capacity = 90, data_dim = 21, internal_dim = 13, out_dim = 9;
+  std::mt19937 gen(11);
+  std::discrete_distribution<int> route({1, 1, 12, 2, 1, 0, 1, 1});
+  std::vector<int> indices(num_tokens * k);
+  for (int &e : indices) {
+    e = route(gen);
+  }
+  std::vector<float> input = random_vector(num_tokens * data_dim, 12);
+  std::vector<float> gate = random_vector(num_tokens * k, 13);
+  for (int num_layers : {1, 2}) {
+    int const dim1 = num_layers == 1 ? out_dim : internal_dim;
+    int const weight_size = num_layers == 1
+                                ? data_dim * out_dim
+                                : internal_dim * (data_dim + out_dim);
+    int const bias_size = num_layers == 1 ? out_dim : internal_dim + out_dim;
+    std::vector<float> weights = random_vector(num_experts * weight_size, 14);
+    std::vector<float> biases = random_vector(num_experts * bias_size, 15);
+    for (bool use_bias : {false, true}) {
+      float const *b = use_bias ? biases.data() : nullptr;
+      // Reference: one GEMV per kept assignment, as the GPU kernels do
+      std::vector<float> ref(num_tokens * out_dim, 0.0f);
+      std::vector<int> count(num_experts, 0);
+      std::vector<float> h(dim1), y(out_dim);
+      for (int a = 0; a < num_tokens * k; a++) {
+        int const e = indices[a] - start;
+        if (e < 0 || e >= num_experts || count[e]++ >= capacity) {
+          continue;
+        }
+        float const *w = weights.data() + e * weight_size;
+        Kernels::CPU::linear_forward(&input[(a / k) * data_dim],
+                                     w,
+                                     b == nullptr ? nullptr : b + e * bias_size,
+                                     h.data(),
+                                     data_dim,
+                                     dim1,
+                                     1,
+                                     AC_MODE_RELU);
+        if (num_layers == 2) {
+          Kernels::CPU::linear_forward(
+              h.data(),
+              w + data_dim * internal_dim,
+              b == nullptr ? nullptr : b + e * bias_size + internal_dim,
+              y.data(),
+              internal_dim,
+              out_dim,
+              1,
+              AC_MODE_RELU);
+        } else {
+          y = h;
+        }
+        for (int o = 0; o < out_dim; o++) {
+          ref[(a / k) * out_dim + o] += gate[a] * y[o];
+        }
+      }
+      EXPECT_GT(count[0], capacity);
+
+      std::vector<float> output(num_tokens * out_dim, -1.0f);
+      std::vector<int> counts(num_experts);
+      Kernels::CPU::experts_forward(input.data(),
+                                    indices.data(),
+                                    gate.data(),
+                                    output.data(),
+                                    weights.data(),
+                                    b,
+                                    counts.data(),
+                                    num_tokens,
+                                    k,
+                                    num_experts,
+                                    start,
+                                    capacity,
+                                    data_dim,
+                                    out_dim,
+                                    num_layers,
+                                    internal_dim,
+                                    AC_MODE_RELU,
+                                    3);
+      EXPECT_EQ(counts, count);
+      for (int i = 0; i < num_tokens * out_dim; i++) {
+        ASSERT_NEAR(output[i], ref[i], 1e-4f)
+            << num_layers << " layers, bias " << use_bias << ", i " << i;
+      }
+    }
+  }
+}
@@ -0,0 +1,116 @@
+#include "flexflow/expert_load_balancer.h"
+#include "gtest/gtest.h"
+#include <sstream>
+
+using namespace FlexFlow;
+
+namespace {
+
+// Experts e * experts_per_device ... on device e, as Experts blocks are laid
+// out today
+double contiguous_makespan(std::vector<double> const &load,
+                           std::vector<double> const &cost,
+                           int experts_per_device) {
+  double makespan = 0.0;
+  for (size_t d = 0; d < cost.size(); d++) {
+    double tokens = 0.0;
+    for (int i = 0; i < experts_per_device; i++) {
+      tokens += load[d * experts_per_device + i];
+    }
+    makespan = std::max(makespan, tokens * cost[d]);
+  }
+  return makespan;
+}
+
+void check_placement(ExpertPlacement const &placement,
+                     std::vector<double> const &load,
+                     int slots_per_device) {
+  ASSERT_EQ(placement.expert_device.size(), load.size());
+  size_t num_placed = 0;
+  for (size_t d = 0; d < placement.device_experts.size(); d++) {
+    EXPECT_LE((int)placement.device_experts[d].size(), slots_per_device);
+    for (int e : placement.device_experts[d]) {
+      EXPECT_EQ(placement.expert_device[e], (int)d);
+      num_placed++;
+    }
+  }
+  EXPECT_EQ(num_placed, load.size());
+}
+
+} // namespace
+
+TEST(expert_load_balancer, records_moving_average_and_drops) {
+  ExpertLoadBalancer balancer;
+  balancer.record_routing("moe_0", {10, 0, 2}, 4);
+  balancer.record_routing("moe_0", {0, 10, 2}, 4);
+  ExpertRoutingStats s = balancer.get_routing_stats("moe_0");
+  EXPECT_EQ(s.num_steps, 2u);
+  EXPECT_EQ(s.num_assignments, 24u);
+  EXPECT_EQ(s.num_dropped, 12u);
+  ASSERT_EQ(s.load.size(), 3u);
+  EXPECT_DOUBLE_EQ(s.load[0], ExpertLoadBalancer::LOAD_DECAY * 10);
+  EXPECT_DOUBLE_EQ(s.load[1], (1 - ExpertLoadBalancer::LOAD_DECAY) * 10);
+  EXPECT_DOUBLE_EQ(s.load[2], 2);
+  EXPECT_EQ(balancer.get_layers(), std::vector<std::string>({"moe_0"}));
+  EXPECT_TRUE(balancer.get_routing_stats("moe_1").load.empty());
+}
+
+TEST(expert_load_balancer, routing_stats_round_trip) {
+  ExpertLoadBalancer balancer;
+  balancer.record_routing("layers 0 moe", {7, 1, 3}, 4);
+  balancer.record_routing("layers 0 moe", {2, 5, 3}, 4);
+  balancer.record_routing("moe_1", {1, 2}, 8);
+  std::stringstream ss;
+  balancer.write_routing_stats(ss);
+
+  ExpertLoadBalancer loaded;
+  loaded.record_routing("stale", {1}, 1);
+  ASSERT_TRUE(loaded.load_routing_stats(ss));
+  EXPECT_EQ(loaded.get_layers(), balancer.get_layers());
+  for (std::string const &layer : balancer.get_layers()) {
+    ExpertRoutingStats a = balancer.get_routing_stats(layer);
+    ExpertRoutingStats b = loaded.get_routing_stats(layer);
+    EXPECT_EQ(a.num_steps, b.num_steps);
+    EXPECT_EQ(a.num_assignments, b.num_assignments);
+    EXPECT_EQ(a.num_dropped, b.num_dropped);
+    EXPECT_EQ(a.load, b.load);
+  }
+
+  std::istringstream malformed("\"moe_0\" 1 2 0 3 1.0 2.0\n");
+  EXPECT_FALSE(loaded.load_routing_stats(malformed));
+  EXPECT_EQ(loaded.get_layers(), balancer.get_layers());
+}
+
+TEST(expert_load_balancer, spreads_hot_experts) {
+  // Two hot experts share the first device of a contiguous layout
+  std::vector<double> load = {400, 300, 20, 20, 10, 10, 10, 10};
+  std::vector<double> cost(4, 1.0);
+  int const slots_per_device = 3;
+  ExpertPlacement placement =
+      ExpertLoadBalancer::plan_placement(load, cost, slots_per_device);
+  check_placement(placement, load, slots_per_device);
+  EXPECT_NE(placement.expert_device[0], placement.expert_device[1]);
+  // The cold experts fill the two devices without a hot one
+  EXPECT_EQ(placement.device_experts[placement.expert_device[0]].size(), 1u);
+  EXPECT_EQ(placement.device_experts[placement.expert_device[1]].size(), 1u);
+  EXPECT_DOUBLE_EQ(placement.makespan(), 400);
+  EXPECT_LT(placement.makespan(), contiguous_makespan(load, cost, 2));
+  double total = 0.0;
+  for (double t : placement.device_time) {
+    total += t;
+  }
+  EXPECT_NEAR(total, 780, 1e-9);
+}
+
+TEST(expert_load_balancer, follows_device_cost) {
+  // Uniform load: the device that is twice as fast takes the most experts
+  std::vector<double> load(6, 100);
+  std::vector<double> cost = {1.0, 2.0, 2.0};
+  ExpertPlacement placement = ExpertLoadBalancer::plan_placement(load, cost, 4);
+  check_placement(placement, load, 4);
+  EXPECT_GT(placement.device_experts[0].size(),
+            placement.device_experts[1].size());
+  EXPECT_GT(placement.device_experts[0].size(),
+            placement.device_experts[2].size());
+  EXPECT_DOUBLE_EQ(placement.makespan(), 400);
+}
@@ -0,0 +1,118 @@
+#include "flexflow/incremental_detokenizer.h"
+#include "gtest/gtest.h"
+
+using namespace FlexFlow;
+
+namespace {
+
+// Byte-level vocabulary: token i is the bytes pieces[i]. Decoding replaces
+// every byte that is not part of a complete UTF-8 character with U+FFFD,
+// like a lossy UTF-8 conversion.
+std::vector<std::string> const BYTE_PIECES = {
+    "Hello", " wor", "ld", " \xe4", "\xb8", "\xad", "\xe6\x96\x87", "!"};
+
+std::string decode_bytes(std::vector<int32_t> const &tokens) {
+  std::string bytes, text;
+  for (int32_t t : tokens) {
+    bytes += BYTE_PIECES[t];
+  }
+  for (size_t i = 0; i < bytes.size();) {
+    unsigned char const c = bytes[i];
+    size_t length = 4;
+    if (c < 0x80) {
+      length = 1;
+    } else if ((c >> 5) == 6) {
+      length = 2;
+    } else if ((c >> 4) == 14) {
+      length = 3;
+    }
+    bool valid = (c < 0x80 || (c >> 6) == 3) && i + length <= bytes.size();
+    for (size_t k = 1; valid && k < length; k++) {
+      valid = (bytes[i + k] & 0xC0) == 0x80;
+    }
+    if (valid) {
+      text += bytes.substr(i, length);
+      i += length;
+    } else {
+      text += "\xEF\xBF\xBD";
+      i += 1;
+    }
+  }
+  return text;
+}
+
+// SentencePiece-style vocabulary: "_" stands for a space, which is dropped
+// from the first piece of the decoded sequence
+std::vector<std::string> const SPACE_PIECES = {"_The", "_cat", "s", "_sat", "."};
+
+std::string decode_pieces(std::vector<int32_t> const &tokens) {
+  std::string text;
+  for (int32_t t : tokens) {
+    text += SPACE_PIECES[t];
+  }
+  for (char &c : text) {
+    if (c == '_') {
+      c = ' ';
+    }
+  }
+  return !text.empty() && text[0] == ' ' ? text.substr(1) : text;
+}
+
+// Streams tokens[num_prompt_tokens:] one at a time and checks that the
+// prompt text plus every step's text equals decoding all tokens. The prompt
+// must end on a character boundary, or be empty.
+void check_stream(std::vector<int32_t> const &tokens,
+                  size_t num_prompt_tokens,
+                  IncrementalDetokenizer::Decoder const &decode) {
+  std::vector<int32_t> history(tokens.begin(),
+                               tokens.begin() + num_prompt_tokens);
+  IncrementalDetokenizer detokenizer(history.size());
+  std::string text = decode(history);
+  for (size_t i = num_prompt_tokens; i < tokens.size(); i++) {
+    history.push_back(tokens[i]);
+    bool const last = i + 1 == tokens.size();
+    std::string const delta = detokenizer.step(history, decode, last);
+    if (!last) {
+      EXPECT_EQ(delta.find("\xEF\xBF\xBD"), std::string::npos);
+    }
+    text += delta;
+    // Everything returned so far is final
+    EXPECT_EQ(decode(history).compare(0, text.size(), text), 0);
+  }
+  EXPECT_EQ(text, decode(tokens));
+}
+
+} // namespace
+
+TEST(incremental_detokenizer, holds_back_incomplete_characters) {
+  std::vector<int32_t> tokens = {0, 1, 2};
+  IncrementalDetokenizer detokenizer(tokens.size());
+  tokens.push_back(3);
+  EXPECT_EQ(detokenizer.step(tokens, decode_bytes), "");
+  tokens.push_back(4);
+  EXPECT_EQ(detokenizer.step(tokens, decode_bytes), "");
+  tokens.push_back(5);
+  EXPECT_EQ(detokenizer.step(tokens, decode_bytes), " \xe4\xb8\xad");
+  tokens.push_back(6);
+  EXPECT_EQ(detokenizer.step(tokens, decode_bytes), "\xe6\x96\x87");
+}
+
+TEST(incremental_detokenizer, keeps_leading_spaces_of_pieces) {
+  std::vector<int32_t> tokens = {0};
+  IncrementalDetokenizer detokenizer(tokens.size());
+  tokens.push_back(1);
+  EXPECT_EQ(detokenizer.step(tokens, decode_pieces), " cat");
+  tokens.push_back(2);
+  EXPECT_EQ(detokenizer.step(tokens, decode_pieces), "s");
+}
+
+TEST(incremental_detokenizer, steps_add_up_to_full_decode) {
+  check_stream({0, 1, 2, 3, 4, 5, 6, 7, 3, 4, 5}, 1, decode_bytes);
+  check_stream({0, 3, 4, 5, 3, 4, 5, 1, 2}, 0, decode_bytes);
+  check_stream({0, 3, 4, 5, 3, 4, 5, 1, 2}, 4, decode_bytes);
+  // Flushes an incomplete character at the end
+  check_stream({0, 1, 3, 4}, 1, decode_bytes);
+  check_stream({0, 1, 2, 3, 1, 2, 1, 4}, 1, decode_pieces);
+  check_stream({0, 1, 2, 3, 1, 2, 1, 4}, 6, decode_pieces);
+  check_stream({0, 1, 2, 3, 1, 2, 1, 4, 3, 1, 2, 1, 2, 4}, 0, decode_pieces);
+}
@@ -0,0 +1,103 @@
+#include "flexflow/inference_fusion.h"
+#include "gtest/gtest.h"
+
+using namespace FlexFlow;
+
+namespace {
+
+FusionNode make_node(OperatorType op_type,
+                     std::vector<int> const &inputs,
+                     int num_outputs = 1) {
+  FusionNode node;
+  node.op_type = op_type;
+  for (int input : inputs) {
+    node.inputs.push_back(std::make_pair(input, 0));
+  }
+  node.num_outputs = num_outputs;
+  return node;
+}
+
+} // namespace
+
+// A pre-norm block with a SwiGLU MLP written out op by op:
+// 0 input, 1 rms, 2 attention, 3 add, 4 rms, 5 w1, 6 w3, 7 sigmoid, 8 mul,
+// 9 mul, 10 w2, 11 add
+TEST(inference_fusion, rewrites_swiglu_block) {
+  std::vector<FusionNode> nodes = {
+      make_node(OP_INPUT, {}),
+      make_node(OP_RMS_NORM, {0}),
+      make_node(OP_INC_MULTIHEAD_SELF_ATTENTION, {1}),
+      make_node(OP_EW_ADD, {0, 2}),
+      make_node(OP_RMS_NORM, {3}),
+      make_node(OP_LINEAR, {4}),
+      make_node(OP_LINEAR, {4}),
+      make_node(OP_SIGMOID, {5}),
+      make_node(OP_EW_MUL, {7, 5}),
+      make_node(OP_EW_MUL, {6, 8}),
+      make_node(OP_LINEAR, {9}),
+      make_node(OP_EW_ADD, {3, 10}),
+  };
+  std::vector<FusionMatch> matches = plan_inference_fusion(nodes);
+  ASSERT_EQ(matches.size(), 2);
+  EXPECT_EQ(matches[0].pattern, FUSE_RESIDUAL_RMS_NORM);
+  EXPECT_EQ(matches[0].nodes, std::vector<int>({3, 4}));
+  EXPECT_EQ(matches[0].inputs, nodes[3].inputs);
+  EXPECT_EQ(matches[1].pattern, FUSE_SIGMOID_SILU_MULTI);
+  EXPECT_EQ(matches[1].nodes, std::vector<int>({7, 8, 9}));
+  std::vector<std::pair<int, int>> gate_inputs = {{5, 0}, {6, 0}};
+  EXPECT_EQ(matches[1].inputs, gate_inputs);
+}
+
+TEST(inference_fusion, respects_readers_and_groups) {
+  std::vector<FusionNode> nodes = {
+      make_node(OP_INPUT, {}),
+      make_node(OP_LINEAR, {0}),
+      make_node(OP_SIGMOID, {1}),
+      // The output of this Linear is read twice
+      make_node(OP_LINEAR, {2}),
+      make_node(OP_RELU, {3}),
+      make_node(OP_EW_ADD, {3, 4}),
+      make_node(OP_LAYERNORM, {5}),
+      make_node(OP_EW_ADD, {6, 0}),
+      make_node(OP_LAYERNORM, {7}),
+  };
+  // The last norm is in the next pipeline stage
+  nodes[8].group = 1;
+  // A Linear that already has an activation
+  nodes.push_back(make_node(OP_LINEAR, {8}));
+  nodes.back().fusible = false;
+  nodes.push_back(make_node(OP_RELU, {9}));
+  // The Linear kernels have no GELU or tanh epilogue
+  nodes.push_back(make_node(OP_LINEAR, {10}));
+  nodes.push_back(make_node(OP_GELU, {11}));
+  nodes.push_back(make_node(OP_LINEAR, {12}));
+  nodes.push_back(make_node(OP_TANH, {13}));
+  std::vector<FusionMatch> matches = plan_inference_fusion(nodes);
+  ASSERT_EQ(matches.size(), 2);
+  EXPECT_EQ(matches[0].pattern, FUSE_LINEAR_ACTIVATION);
+  EXPECT_EQ(matches[0].nodes, std::vector<int>({1, 2}));
+  EXPECT_EQ(matches[1].pattern, FUSE_RESIDUAL_LAYER_NORM);
+  EXPECT_EQ(matches[1].nodes, std::vector<int>({5, 6}));
+}
+
+TEST(inference_fusion, keeps_readers_of_the_sum_in_order) {
+  std::vector<FusionNode> nodes = {
+      make_node(OP_INPUT, {}),
+      make_node(OP_INPUT, {}),
+      make_node(OP_EW_ADD, {0, 1}),
+      // Reads the sum before the norm: the fused operator would only write
+      // it at the norm's place
+      make_node(OP_LINEAR, {2}),
+      make_node(OP_RMS_NORM, {2}),
+      make_node(OP_EW_ADD, {3, 4}),
+      make_node(OP_RMS_NORM, {5}),
+      // Reads the sum after the norm
+      make_node(OP_LINEAR, {5}),
+  };
+  nodes[3].fusible = false;
+  nodes[7].fusible = false;
+  std::vector<FusionMatch> matches = plan_inference_fusion(nodes);
+  ASSERT_EQ(matches.size(), 1);
+  EXPECT_EQ(matches[0].pattern, FUSE_RESIDUAL_RMS_NORM);
+  EXPECT_EQ(matches[0].nodes, std::vector<int>({5, 6}));
+}
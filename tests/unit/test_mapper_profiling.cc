@@ -0,0 +1,116 @@
+#include "flexflow/mapper_profiling.h"
+#include "gtest/gtest.h"
+#include <cstring>
+#include <sstream>
+#include <thread>
+
+using namespace FlexFlow;
+
+static MapperProfilingRecord make_record(unsigned task_id,
+                                         size_t view_hash,
+                                         long long start_ns,
+                                         long long end_ns,
+                                         size_t params_hash = 0) {
+  MapperProfilingRecord r;
+  r.task_id = task_id;
+  r.view_hash = view_hash;
+  r.params_hash = params_hash;
+  r.start_ns = start_ns;
+  r.end_ns = end_ns;
+  return r;
+}
+
+TEST(mapper_profiling, buffer_drops_when_full) {
+  MapperProfilingBuffer buffer(4);
+  std::vector<std::thread> writers;
+  for (int t = 0; t < 4; t++) {
+    writers.emplace_back([&buffer, t]() {
+      for (int i = 0; i < 3; i++) {
+        buffer.record(make_record(t, 0, 0, 1000));
+      }
+    });
+  }
+  for (auto &w : writers) {
+    w.join();
+  }
+  EXPECT_EQ(buffer.snapshot().size(), 4);
+  EXPECT_EQ(buffer.dropped(), 8);
+}
+
+TEST(mapper_profiling, aggregate_and_round_trip) {
+  std::vector<MapperProfilingRecord> records = {
+      make_record(7, 42, 0, 2000, 5),
+      make_record(7, 42, 5000, 9000, 5),
+      make_record(7, 43, 0, 1000, 5),
+      // Same task and view, but an op of another shape
+      make_record(7, 42, 0, 50000, 6),
+  };
+  MapperProfilingRecord copy = make_record(0, 42, 0, 100000);
+  copy.kind = MapperProfilingRecord::COPY;
+  records.push_back(copy);
+
+  MeasuredCostTable table = aggregate_measured_costs(records);
+  ASSERT_EQ(table.size(), 3);
+  MeasuredCost const &cost = table.at({7, 42, 5});
+  EXPECT_EQ(cost.count, 2);
+  EXPECT_FLOAT_EQ(cost.mean_us, 3.0);
+  EXPECT_FLOAT_EQ(cost.min_us, 2.0);
+  EXPECT_FLOAT_EQ(cost.max_us, 4.0);
+
+  std::stringstream ss;
+  write_measured_cost_table(ss, table);
+  MeasuredCostTable loaded;
+  ASSERT_TRUE(load_measured_cost_table(ss, loaded));
+  ASSERT_EQ(loaded.size(), 3);
+  EXPECT_EQ(loaded.at({7, 42, 5}).count, 2);
+  EXPECT_FLOAT_EQ(loaded.at({7, 43, 5}).mean_us, 1.0);
+  EXPECT_FLOAT_EQ(loaded.at({7, 42, 6}).mean_us, 50.0);
+
+  std::stringstream bad("7 42 5 oops\n");
+  EXPECT_FALSE(load_measured_cost_table(bad, loaded));
+}
+
+TEST(mapper_profiling, chrome_trace_is_relative_to_first_event) {
+  std::vector<MapperProfilingRecord> records = {
+      make_record(1, 0, 10000, 12000),
+      make_record(2, 0, 11000, 15000),
+  };
+  strcpy(records[0].name, "Linear \"Forward\"");
+  std::stringstream ss;
+  write_chrome_trace(ss, records);
+  std::string trace = ss.str();
+  EXPECT_NE(trace.find("\"name\":\"Linear \\\"Forward\\\"\""),
+            std::string::npos);
+  EXPECT_NE(trace.find("\"name\":\"task 2\""), std::string::npos);
+  EXPECT_NE(trace.find("\"ts\":0,"), std::string::npos);
+  EXPECT_NE(trace.find("\"ts\":1,\"dur\":4"), std::string::npos);
+}
+
+TEST(mapper_profiling, stateful_tasks_keep_their_kind) {
+  using Selector = MeasuredVariantSelector;
+  // Task 2 keeps state across launches, task 1 does not
+  Selector selector(1, {2});
+  // One op of each task per step; the first steps explore both kinds
+  for (unsigned task_id : {1u, 2u}) {
+    EXPECT_EQ(selector.select(task_id, 7), Selector::GPU);
+    selector.record(task_id, Selector::GPU, 100);
+    EXPECT_EQ(selector.select(task_id, 8), Selector::CPU);
+    selector.record(task_id, Selector::CPU, 10);
+    // The CPU is faster
+    EXPECT_EQ(selector.select(task_id, 9), Selector::CPU);
+  }
+  EXPECT_EQ(selector.select(2, 7), Selector::GPU);
+  EXPECT_EQ(selector.select(2, 8), Selector::CPU);
+  // The averages move and the kind of task 1 flips between steps
+  for (int i = 0; i < 4; i++) {
+    selector.record(1, Selector::CPU, 1000);
+    selector.record(2, Selector::CPU, 1000);
+  }
+  EXPECT_EQ(selector.select(1, 7), Selector::GPU);
+  EXPECT_EQ(selector.select(1, 9), Selector::GPU);
+  EXPECT_EQ(selector.select(2, 7), Selector::GPU);
+  EXPECT_EQ(selector.select(2, 8), Selector::CPU);
+  EXPECT_EQ(selector.select(2, 9), Selector::CPU);
+  // New ops of a stateful task follow the averages
+  EXPECT_EQ(selector.select(2, 10), Selector::GPU);
+}
@@ -0,0 +1,62 @@
+#include "flexflow/memory_optimization.h"
+#include "gtest/gtest.h"
+
+using namespace FlexFlow;
+
+TEST(memory_optimization, peak_memory_frees_dead_outputs) {
+  // A chain a -> b -> c on device 0: a's output dies once b has run
+  OpMemoryFootprint a, b, c;
+  a.device_ids = {0};
+  a.weights_mb = 1.0;
+  a.outputs_mb = 10.0;
+  a.step = 0;
+  a.last_use_step = 1;
+  b.device_ids = {0};
+  b.weights_mb = 2.0;
+  b.outputs_mb = 20.0;
+  b.step = 1;
+  b.last_use_step = 2;
+  c.device_ids = {0};
+  c.outputs_mb = 5.0;
+  c.step = 2;
+  c.last_use_step = 2;
+
+  std::unordered_map<int, float> peak =
+      estimate_peak_memory_per_device({a, b, c});
+  ASSERT_EQ(peak.size(), 1);
+  // weights (3) + a and b alive together at step 1 (30)
+  EXPECT_FLOAT_EQ(peak.at(0), 33.0);
+}
+
+TEST(memory_optimization, peak_memory_per_device) {
+  OpMemoryFootprint a, b;
+  a.device_ids = {0, 1};
+  a.weights_mb = 4.0;
+  a.outputs_mb = 8.0;
+  a.step = 0;
+  a.last_use_step = 1;
+  b.device_ids = {1};
+  b.outputs_mb = 16.0;
+  b.step = 1;
+  b.last_use_step = 1;
+
+  std::unordered_map<int, float> peak =
+      estimate_peak_memory_per_device({a, b});
+  ASSERT_EQ(peak.size(), 2);
+  EXPECT_FLOAT_EQ(peak.at(0), 12.0);
+  EXPECT_FLOAT_EQ(peak.at(1), 28.0);
+}
+
+TEST(memory_optimization, pareto_frontier) {
+  std::vector<MemorySearchPoint> points = {
+      {1.0, 10.0, 100.0},
+      {0.5, 12.0, 60.0},
+      {0.75, 11.0, 120.0}, // dominated by the first point
+      {0.0, 20.0, 50.0},
+  };
+  std::vector<MemorySearchPoint> frontier = pareto_frontier(points);
+  ASSERT_EQ(frontier.size(), 3);
+  EXPECT_FLOAT_EQ(frontier[0].lambda, 1.0);
+  EXPECT_FLOAT_EQ(frontier[1].lambda, 0.5);
+  EXPECT_FLOAT_EQ(frontier[2].lambda, 0.0);
+}
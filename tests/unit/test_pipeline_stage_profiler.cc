@@ -0,0 +1,62 @@
+#include "flexflow/pipeline_stage_profiler.h"
+#include "gtest/gtest.h"
+#include <algorithm>
+
+using namespace FlexFlow;
+
+namespace {
+
+// Runs num_steps steps of num_micro_batches independent request groups
+// through stages that take stage_time each, launching the groups round
+// robin as serve_incr_decoding does. A group's next batch is available when
+// its previous one leaves the last stage, and a stage works on one launch
+// at a time, in launch order.
+void simulate(PipelineStageProfiler &profiler,
+              std::vector<double> const &stage_time,
+              int num_micro_batches,
+              int num_steps) {
+  int const num_stages = stage_time.size();
+  std::vector<double> ready(num_micro_batches, 0.0);
+  std::vector<double> stage_free(num_stages, 0.0);
+  int launch = 0;
+  for (int step = 0; step < num_steps; step++) {
+    for (int g = 0; g < num_micro_batches; g++, launch++) {
+      profiler.record(launch, -1, ready[g]);
+      double t = ready[g];
+      for (int s = 0; s < num_stages; s++) {
+        t = std::max(t, stage_free[s]) + stage_time[s];
+        stage_free[s] = t;
+        profiler.record(launch, s, t);
+      }
+      ready[g] = t;
+    }
+  }
+}
+
+} // namespace
+
+TEST(pipeline_stage_profiler, single_batch_leaves_stages_idle) {
+  PipelineStageProfiler profiler(2);
+  simulate(profiler, {10.0, 10.0}, 1, 4);
+  EXPECT_EQ(profiler.busy_time(), std::vector<double>({40.0, 40.0}));
+  std::vector<double> utilization = profiler.utilization();
+  EXPECT_DOUBLE_EQ(utilization[0], 0.5);
+  EXPECT_DOUBLE_EQ(utilization[1], 0.5);
+  profiler.reset();
+  EXPECT_EQ(profiler.busy_time(), std::vector<double>({0.0, 0.0}));
+}
+
+TEST(pipeline_stage_profiler, micro_batches_fill_the_pipeline) {
+  PipelineStageProfiler profiler(4);
+  simulate(profiler, {10.0, 10.0, 10.0, 10.0}, 4, 50);
+  for (double u : profiler.utilization()) {
+    EXPECT_GT(u, 0.95);
+    EXPECT_LE(u, 1.0);
+  }
+  // The slowest stage bounds the others
+  PipelineStageProfiler unbalanced(2);
+  simulate(unbalanced, {10.0, 20.0}, 2, 50);
+  std::vector<double> utilization = unbalanced.utilization();
+  EXPECT_GT(utilization[1], 0.95);
+  EXPECT_LT(utilization[0], 0.55);
+}
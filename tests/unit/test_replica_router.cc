@@ -0,0 +1,41 @@
+#include "flexflow/replica_router.h"
+#include "gtest/gtest.h"
+
+using namespace FlexFlow;
+
+TEST(replica_router, balances_queued_tokens) {
+  ReplicaRouter router(3);
+  EXPECT_EQ(router.route(1, 100), 0);
+  EXPECT_EQ(router.route(2, 10), 1);
+  EXPECT_EQ(router.route(3, 10), 2);
+  // Replica 1 and 2 tie at 10 tokens
+  EXPECT_EQ(router.route(4, 50), 1);
+  EXPECT_EQ(router.route(5, 20), 2);
+  EXPECT_EQ(router.queued_tokens(), std::vector<size_t>({100, 60, 30}));
+  EXPECT_EQ(router.get_replica(4), 1);
+}
+
+TEST(replica_router, counts_kv_cache_occupancy) {
+  ReplicaRouter router(2);
+  EXPECT_EQ(router.route(1, 64), 0);
+  EXPECT_EQ(router.route(2, 16), 1);
+  // Prefill of request 1 in two chunks, then decoding
+  router.update(1, 32);
+  EXPECT_EQ(router.queued_tokens(), std::vector<size_t>({32, 16}));
+  EXPECT_EQ(router.cached_tokens(), std::vector<size_t>({32, 0}));
+  router.update(1, 64);
+  router.update(1, 65);
+  router.update(2, 16);
+  EXPECT_EQ(router.queued_tokens(), std::vector<size_t>({0, 0}));
+  EXPECT_EQ(router.cached_tokens(), std::vector<size_t>({65, 16}));
+  EXPECT_EQ(router.route(3, 8), 1);
+  // Finishing request 1 frees its cache entries on replica 0
+  router.release(1);
+  EXPECT_EQ(router.cached_tokens(), std::vector<size_t>({0, 16}));
+  EXPECT_EQ(router.route(4, 8), 0);
+  router.release(2);
+  router.release(3);
+  router.release(4);
+  EXPECT_EQ(router.queued_tokens(), std::vector<size_t>({0, 0}));
+  EXPECT_EQ(router.cached_tokens(), std::vector<size_t>({0, 0}));
+}
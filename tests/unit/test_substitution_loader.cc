@@ -1,6 +1,9 @@
 #include "flexflow/substitution.h"
 #include "flexflow/substitution_loader.h"
 #include "gtest/gtest.h"
+#include <cstdlib>
+#include <filesystem>
+#include <sstream>
 
 namespace sl = FlexFlow::substitution_loader;
 // using namespace FlexFlow::substitution_loader;
@@ -134,6 +137,152 @@ TEST(substitution_loader, operator_deserialization) {
   EXPECT_EQ(o.para.size(), 0);
 }
 
+TEST(substitution_loader, compile_rule_collection) {
+  sl::Tensor input_tensor;
+  input_tensor.opId = -1;
+  input_tensor.tsId = 0;
+
+  sl::Parameter acti;
+  acti.key = PM_ACTI;
+  acti.value = AC_MODE_NONE;
+  sl::Parameter acti_relu;
+  acti_relu.key = PM_ACTI;
+  acti_relu.value = AC_MODE_RELU;
+  sl::Parameter numdim;
+  numdim.key = PM_NUMDIM;
+  numdim.value = 3;
+
+  sl::Operator linear;
+  linear.op_type = OP_LINEAR;
+  linear.input = {input_tensor};
+  linear.para = {numdim, acti};
+
+  sl::Operator linear_relu = linear;
+  linear_relu.para = {numdim, acti_relu};
+
+  sl::Operator relu;
+  relu.op_type = OP_RELU;
+  relu.input = {input_tensor};
+  relu.para = {};
+
+  sl::MapOutput map_output;
+  map_output.srcOpId = 0;
+  map_output.srcTsId = 0;
+  map_output.dstOpId = 0;
+  map_output.dstTsId = 0;
+
+  sl::Rule r1;
+  r1.name = "r1";
+  r1.srcOp = {linear};
+  r1.dstOp = {linear, linear};
+  r1.mappedOutput = {map_output};
+
+  // Same as r1 up to parameter order and name
+  sl::Rule r2 = r1;
+  r2.name = "r2";
+  r2.srcOp[0].para = {acti, numdim};
+
+  sl::Rule r3 = r1;
+  r3.name = "r3";
+  r3.srcOp = {linear_relu};
+
+  sl::Rule r4 = r1;
+  r4.name = "r4";
+  r4.srcOp = {relu};
+
+  sl::RuleCollection collection;
+  collection.rules = {r1, r2, r3, r4};
+
+  sl::CompiledRuleCollection compiled = sl::compile_rule_collection(collection);
+  EXPECT_EQ(compiled.num_duplicates_removed, 1);
+  ASSERT_EQ(compiled.rules.size(), 3);
+  EXPECT_EQ(compiled.rules[0].name, "r1");
+  EXPECT_EQ(compiled.rules[1].name, "r3");
+  EXPECT_EQ(compiled.rules[2].name, "r4");
+  // PM_ACTI takes two values across the collection, PM_NUMDIM only one
+  EXPECT_EQ(compiled.rules[0].srcOp[0].para[0].key, PM_ACTI);
+  EXPECT_EQ(compiled.rules[0].srcOp[0].para[1].key, PM_NUMDIM);
+
+  std::stringstream buffer;
+  sl::save_compiled_rule_collection(compiled, buffer);
+  sl::CompiledRuleCollection reloaded;
+  ASSERT_TRUE(sl::load_compiled_rule_collection(buffer, reloaded));
+  EXPECT_EQ(reloaded.num_duplicates_removed, 1);
+  ASSERT_EQ(reloaded.rules.size(), 3);
+  EXPECT_EQ(reloaded.rules[1].name, "r3");
+  EXPECT_EQ(reloaded.rules[1].srcOp[0].para[0].value, AC_MODE_RELU);
+
+  std::stringstream truncated(buffer.str().substr(0, 10));
+  sl::CompiledRuleCollection broken;
+  EXPECT_FALSE(sl::load_compiled_rule_collection(truncated, broken));
+
+  // Corrupted counts are rejected instead of sizing huge allocations: the
+  // rule count follows the 8-byte duplicate count, the length of the first
+  // rule name follows the rule count
+  for (size_t offset : {8, 12}) {
+    std::string bytes = buffer.str();
+    bytes.replace(offset, 4, std::string(4, '\xff'));
+    std::stringstream corrupted(bytes);
+    sl::CompiledRuleCollection garbage;
+    EXPECT_FALSE(sl::load_compiled_rule_collection(corrupted, garbage));
+  }
+}
+
+TEST(substitution_loader, compiled_cache_goes_to_user_cache_dir) {
+  std::filesystem::path root =
+      std::filesystem::temp_directory_path() / "ff_substitution_cache_test";
+  std::filesystem::remove_all(root);
+  std::filesystem::create_directories(root / "rules");
+  std::filesystem::path source = root / "rules" / "subst.json";
+  {
+    std::ofstream json_file(source);
+    json_file << R"({"rule": [{"name": "r1",
+        "srcOp": [{"type": "OP_RELU",
+                   "input": [{"opId": -1, "tsId": 0}], "para": []}],
+        "dstOp": [], "mappedOutput": []}]})";
+  }
+  // Restored on every exit from the test, so later tests see the caller's
+  // environment
+  struct ScopedCacheHome {
+    bool was_set;
+    std::string value;
+    ScopedCacheHome(std::string const &path) {
+      char const *old = std::getenv("XDG_CACHE_HOME");
+      was_set = old != nullptr;
+      value = was_set ? old : "";
+      setenv("XDG_CACHE_HOME", path.c_str(), 1);
+    }
+    ~ScopedCacheHome() {
+      if (was_set) {
+        setenv("XDG_CACHE_HOME", value.c_str(), 1);
+      } else {
+        unsetenv("XDG_CACHE_HOME");
+      }
+    }
+  } cache_home((root / "cache").string());
+
+  std::string cache_path = sl::compiled_rule_cache_path(source.string());
+  EXPECT_EQ(cache_path.rfind((root / "cache" / "flexflow").string(), 0), 0);
+  sl::CompiledRuleCollection compiled =
+      sl::load_compiled_rule_collection_from_path(source.string());
+  ASSERT_EQ(compiled.rules.size(), 1);
+  EXPECT_TRUE(std::filesystem::exists(cache_path));
+  // Nothing is written next to the source, including temporary files
+  EXPECT_EQ(std::distance(std::filesystem::directory_iterator(root / "rules"),
+                          std::filesystem::directory_iterator()),
+            1);
+  EXPECT_EQ(std::distance(std::filesystem::directory_iterator(
+                              std::filesystem::path(cache_path).parent_path()),
+                          std::filesystem::directory_iterator()),
+            1);
+
+  sl::CompiledRuleCollection cached =
+      sl::load_compiled_rule_collection_from_path(source.string());
+  ASSERT_EQ(cached.rules.size(), 1);
+  EXPECT_EQ(cached.rules[0].name, "r1");
+  std::filesystem::remove_all(root);
+}
+
 // TEST(substitution_loader, load_full_file) {
 //   sl::RuleCollection collection =
 //       sl::load_rule_collection_from_path("tests/unit/graph_subst_3_v2.json");
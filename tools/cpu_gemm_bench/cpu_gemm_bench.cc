@@ -0,0 +1,144 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the CPU Linear kernels on the projection shapes of the models in
+// inference/models. Usage:
+//   cpu_gemm_bench [--threads N] [--iterations N]
+
+#include "flexflow/ops/kernels/cpu_kernels.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace FlexFlow;
+
+struct Shape {
+  char const *name;
+  int in_dim, out_dim;
+};
+
+static Shape const shapes[] = {
+    {"opt-125m attn", 768, 768},
+    {"opt-125m fc1", 768, 3072},
+    {"opt-125m fc2", 3072, 768},
+    {"opt-6.7b fc1", 4096, 16384},
+    {"opt-6.7b fc2", 16384, 4096},
+    {"llama-7b attn", 4096, 4096},
+    {"llama-7b w1/w3", 4096, 11008},
+    {"llama-7b w2", 11008, 4096},
+};
+
+static int const batch_sizes[] = {1, 8, 128};
+
+static double seconds_per_call(std::function<void()> const &fn,
+                               int iterations) {
+  fn(); // warm up caches and page in the buffers
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    fn();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+int main(int argc, char **argv) {
+  int num_threads = 1, iterations = 10;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      num_threads = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--iterations") && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--threads N] [--iterations N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  printf("%-16s %6s %6s %6s %12s %12s %12s\n",
+         "shape",
+         "in",
+         "out",
+         "batch",
+         "ref GFLOP/s",
+         "1T GFLOP/s",
+         "NT GFLOP/s");
+  for (Shape const &shape : shapes) {
+    std::vector<float> weight((size_t)shape.in_dim * shape.out_dim);
+    std::vector<float> bias(shape.out_dim);
+    for (float &x : weight) {
+      x = dist(gen);
+    }
+    for (float &x : bias) {
+      x = dist(gen);
+    }
+    std::vector<float> packed(
+        Kernels::CPU::packed_linear_weight_size(shape.in_dim, shape.out_dim));
+    Kernels::CPU::pack_linear_weight(
+        weight.data(), packed.data(), shape.in_dim, shape.out_dim);
+    for (int batch_size : batch_sizes) {
+      std::vector<float> input((size_t)shape.in_dim * batch_size);
+      std::vector<float> output((size_t)shape.out_dim * batch_size);
+      for (float &x : input) {
+        x = dist(gen);
+      }
+      double const flops = 2.0 * shape.in_dim * shape.out_dim * batch_size;
+      double const ref = seconds_per_call(
+          [&]() {
+            Kernels::CPU::linear_forward(input.data(),
+                                         weight.data(),
+                                         bias.data(),
+                                         output.data(),
+                                         shape.in_dim,
+                                         shape.out_dim,
+                                         batch_size,
+                                         AC_MODE_RELU);
+          },
+          iterations);
+      auto packed_call = [&](int threads) {
+        return seconds_per_call(
+            [&]() {
+              Kernels::CPU::linear_forward_packed(input.data(),
+                                                  packed.data(),
+                                                  bias.data(),
+                                                  output.data(),
+                                                  shape.in_dim,
+                                                  shape.out_dim,
+                                                  batch_size,
+                                                  AC_MODE_RELU,
+                                                  threads);
+            },
+            iterations);
+      };
+      double const single = packed_call(1);
+      double const multi = packed_call(num_threads);
+      printf("%-16s %6d %6d %6d %12.2f %12.2f %12.2f\n",
+             shape.name,
+             shape.in_dim,
+             shape.out_dim,
+             batch_size,
+             flops / ref * 1e-9,
+             flops / single * 1e-9,
+             flops / multi * 1e-9);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,199 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures the fused residual + normalization CPU kernels against a separate
+// residual add followed by the plain normalization, for fp32 and fp16 rows.
+// Both are reported against the bytes the fused kernel must move (inputs
+// and weights read once, both outputs written once). Usage:
+//   cpu_norm_bench [--threads N] [--iterations N]
+
+#include "flexflow/ops/kernels/cpu_kernels.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace FlexFlow;
+using Kernels::CPU::Half;
+
+static int const dims[] = {768, 4096, 8192};
+static int const row_counts[] = {1, 16, 256};
+
+static double seconds_per_call(std::function<void()> const &fn,
+                               int iterations) {
+  fn(); // warm up caches and page in the buffers
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    fn();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+static float to_float(float x) {
+  return x;
+}
+
+static float to_float(Half x) {
+  return Kernels::CPU::half_to_float(x);
+}
+
+static void from_float(float x, float &out) {
+  out = x;
+}
+
+static void from_float(float x, Half &out) {
+  out = Kernels::CPU::float_to_half(x);
+}
+
+// The unfused sequence: a full pass for the residual add, then the norm
+// reads the sum back from memory. The add converts fp16 one element at a
+// time, so the fp16 separate column is a lower bound, not a tuned baseline.
+template <typename T>
+static void separate_add(T const *a, T const *b, T *out, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    from_float(to_float(a[i]) + to_float(b[i]), out[i]);
+  }
+}
+
+template <typename T>
+static void run(char const *type_name, int num_threads, int iterations) {
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  for (int dim : dims) {
+    std::vector<T> weight(dim), beta(dim);
+    for (int i = 0; i < dim; i++) {
+      from_float(dist(gen), weight[i]);
+      from_float(dist(gen), beta[i]);
+    }
+    for (int rows : row_counts) {
+      size_t const n = (size_t)dim * rows;
+      std::vector<T> input(n), residual(n), residual_output(n), output(n);
+      for (size_t i = 0; i < n; i++) {
+        from_float(dist(gen), input[i]);
+        from_float(dist(gen), residual[i]);
+      }
+      // Two rows read, two rows written, plus the weights
+      double const rms_bytes = (4.0 * n + dim) * sizeof(T);
+      double const ln_bytes = (4.0 * n + 2.0 * dim) * sizeof(T);
+
+      double const rms_separate = seconds_per_call(
+          [&]() {
+            separate_add(
+                input.data(), residual.data(), residual_output.data(), n);
+            Kernels::CPU::rms_norm_forward(residual_output.data(),
+                                           weight.data(),
+                                           output.data(),
+                                           dim,
+                                           rows,
+                                           1e-6f,
+                                           num_threads);
+          },
+          iterations);
+      double const rms_fused = seconds_per_call(
+          [&]() {
+            Kernels::CPU::residual_rms_norm_forward(input.data(),
+                                                    residual.data(),
+                                                    weight.data(),
+                                                    residual_output.data(),
+                                                    output.data(),
+                                                    dim,
+                                                    rows,
+                                                    1e-6f,
+                                                    num_threads);
+          },
+          iterations);
+      // Without residuals the layer norm kernel is a plain layer norm
+      double const ln_separate = seconds_per_call(
+          [&]() {
+            separate_add(
+                input.data(), residual.data(), residual_output.data(), n);
+            Kernels::CPU::residual_layer_norm_forward<T>(
+                residual_output.data(),
+                nullptr,
+                nullptr,
+                nullptr,
+                weight.data(),
+                beta.data(),
+                residual_output.data(),
+                output.data(),
+                dim,
+                rows,
+                1e-5f,
+                num_threads);
+          },
+          iterations);
+      double const ln_fused = seconds_per_call(
+          [&]() {
+            Kernels::CPU::residual_layer_norm_forward<T>(
+                input.data(),
+                residual.data(),
+                nullptr,
+                nullptr,
+                weight.data(),
+                beta.data(),
+                residual_output.data(),
+                output.data(),
+                dim,
+                rows,
+                1e-5f,
+                num_threads);
+          },
+          iterations);
+      printf("%-6s %6d %6d %12.0f %10.2f %10.2f %12.0f %10.2f %10.2f\n",
+             type_name,
+             dim,
+             rows,
+             rms_bytes,
+             rms_bytes / rms_separate * 1e-9,
+             rms_bytes / rms_fused * 1e-9,
+             ln_bytes,
+             ln_bytes / ln_separate * 1e-9,
+             ln_bytes / ln_fused * 1e-9);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  int num_threads = 1, iterations = 100;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      num_threads = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--iterations") && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--threads N] [--iterations N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  printf("%-6s %6s %6s %12s %10s %10s %12s %10s %10s\n",
+         "type",
+         "dim",
+         "rows",
+         "rms bytes",
+         "sep GB/s",
+         "fused GB/s",
+         "ln bytes",
+         "sep GB/s",
+         "fused GB/s");
+  run<float>("fp32", num_threads, iterations);
+  run<Half>("fp16", num_threads, iterations);
+  return 0;
+}
@@ -0,0 +1,249 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+
+// Measures the CPU Experts kernel, which packs the kept tokens of every
+// expert into one ragged batch and runs a GEMM per expert, against the
+// per-token execution of the GPU path: one GEMV per kept assignment, which
+// re-reads the expert's weights for every token. Both run a two-layer
+// expert MLP over the same routing, for several expert counts and token
+// distributions. Usage:
+//   experts_gemm_bench [--threads N] [--iterations N] [--tokens N]
+
+#include "flexflow/ops/kernels/cpu_kernels.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+using namespace FlexFlow;
+
+static int const expert_counts[] = {8, 32, 64};
+static int const data_dim = 512, internal_dim = 1024, k = 2;
+// Capacity factor of the Experts operator
+static float const alpha = 2.0f;
+
+static double seconds_per_call(std::function<void()> const &fn,
+                               int iterations) {
+  fn(); // warm up caches and page in the buffers
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    fn();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+// Expert weights of each routed assignment: uniform, Zipf-like (expert e
+// with weight 1 / (e + 1)), or half of the traffic on a single expert
+static std::vector<double> route_weights(char const *distribution,
+                                         int num_experts) {
+  std::vector<double> w(num_experts, 1.0);
+  for (int e = 0; e < num_experts; e++) {
+    if (!strcmp(distribution, "zipf")) {
+      w[e] = 1.0 / (e + 1);
+    } else if (!strcmp(distribution, "hot")) {
+      w[e] = e == 0 ? num_experts - 1 : 1.0;
+    }
+  }
+  return w;
+}
+
+// The per-token baseline, with the capacity rule of the Experts operator
+static void per_token_forward(float const *input,
+                              int const *indices,
+                              float const *gate,
+                              float *output,
+                              float const *weights,
+                              float const *biases,
+                              int num_tokens,
+                              int num_experts,
+                              int capacity,
+                              int out_dim) {
+  size_t const weight_size = (size_t)internal_dim * (data_dim + out_dim);
+  int const bias_size = internal_dim + out_dim;
+  std::vector<int> count(num_experts, 0);
+  std::vector<float> h(internal_dim), y(out_dim);
+  std::fill(output, output + (size_t)num_tokens * out_dim, 0.0f);
+  for (int a = 0; a < num_tokens * k; a++) {
+    int const e = indices[a];
+    if (count[e]++ >= capacity) {
+      continue;
+    }
+    float const *w = weights + e * weight_size;
+    float const *b = biases + e * bias_size;
+    Kernels::CPU::linear_forward(input + (size_t)(a / k) * data_dim,
+                                 w,
+                                 b,
+                                 h.data(),
+                                 data_dim,
+                                 internal_dim,
+                                 1,
+                                 AC_MODE_RELU);
+    Kernels::CPU::linear_forward(h.data(),
+                                 w + (size_t)data_dim * internal_dim,
+                                 b + internal_dim,
+                                 y.data(),
+                                 internal_dim,
+                                 out_dim,
+                                 1,
+                                 AC_MODE_RELU);
+    float *o = output + (size_t)(a / k) * out_dim;
+    for (int i = 0; i < out_dim; i++) {
+      o[i] += gate[a] * y[i];
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  int num_threads = 1, iterations = 5, num_tokens = 256;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--threads") && i + 1 < argc) {
+      num_threads = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--iterations") && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else if (!strcmp(argv[i], "--tokens") && i + 1 < argc) {
+      num_tokens = atoi(argv[++i]);
+    } else {
+      fprintf(stderr,
+              "usage: %s [--threads N] [--iterations N] [--tokens N]\n",
+              argv[0]);
+      return 1;
+    }
+  }
+  int const out_dim = data_dim;
+
+  printf("%d tokens, top-%d, %d -> %d -> %d, %d threads\n",
+         num_tokens,
+         k,
+         data_dim,
+         internal_dim,
+         out_dim,
+         num_threads);
+  printf("%7s %-8s %8s %6s %11s %11s %11s %12s %9s\n",
+         "experts",
+         "routing",
+         "capacity",
+         "kept",
+         "gemv ms",
+         "gemv GF/s",
+         "grouped ms",
+         "grouped GF/s",
+         "max diff");
+  std::mt19937 gen(0);
+  std::uniform_real_distribution<float> dist(-0.1f, 0.1f);
+  std::vector<float> input((size_t)num_tokens * data_dim);
+  std::vector<float> gate((size_t)num_tokens * k);
+  for (float &x : input) {
+    x = dist(gen);
+  }
+  for (float &x : gate) {
+    x = dist(gen) + 0.5f;
+  }
+  for (int num_experts : expert_counts) {
+    size_t const weight_size = (size_t)internal_dim * (data_dim + out_dim);
+    std::vector<float> weights(num_experts * weight_size);
+    std::vector<float> biases((size_t)num_experts * (internal_dim + out_dim));
+    for (float &x : weights) {
+      x = dist(gen);
+    }
+    for (float &x : biases) {
+      x = dist(gen);
+    }
+    int const capacity = (int)std::ceil(alpha * k / num_experts * num_tokens);
+    for (char const *distribution : {"uniform", "zipf", "hot"}) {
+      std::vector<double> w = route_weights(distribution, num_experts);
+      std::discrete_distribution<int> route(w.begin(), w.end());
+      // The k experts of a token are distinct, as top-k routing makes them
+      std::vector<int> indices((size_t)num_tokens * k);
+      for (int t = 0; t < num_tokens; t++) {
+        for (int j = 0; j < k; j++) {
+          int e;
+          do {
+            e = route(gen);
+          } while (std::find(&indices[t * k], &indices[t * k + j], e) !=
+                   &indices[t * k + j]);
+          indices[t * k + j] = e;
+        }
+      }
+      std::vector<int> counts(num_experts);
+      std::vector<float> expected((size_t)num_tokens * out_dim);
+      std::vector<float> output((size_t)num_tokens * out_dim);
+      double const gemv = seconds_per_call(
+          [&]() {
+            per_token_forward(input.data(),
+                              indices.data(),
+                              gate.data(),
+                              expected.data(),
+                              weights.data(),
+                              biases.data(),
+                              num_tokens,
+                              num_experts,
+                              capacity,
+                              out_dim);
+          },
+          iterations);
+      double const grouped = seconds_per_call(
+          [&]() {
+            Kernels::CPU::experts_forward(input.data(),
+                                          indices.data(),
+                                          gate.data(),
+                                          output.data(),
+                                          weights.data(),
+                                          biases.data(),
+                                          counts.data(),
+                                          num_tokens,
+                                          k,
+                                          num_experts,
+                                          0,
+                                          capacity,
+                                          data_dim,
+                                          out_dim,
+                                          2,
+                                          internal_dim,
+                                          AC_MODE_RELU,
+                                          num_threads);
+          },
+          iterations);
+      int kept = 0;
+      for (int c : counts) {
+        kept += std::min(c, capacity);
+      }
+      float max_diff = 0.0f;
+      for (size_t i = 0; i < output.size(); i++) {
+        max_diff = std::max(max_diff, std::abs(output[i] - expected[i]));
+      }
+      double const flops =
+          2.0 * kept * internal_dim * (double)(data_dim + out_dim);
+      printf("%7d %-8s %8d %6d %11.3f %11.2f %11.3f %12.2f %9.2e\n",
+             num_experts,
+             distribution,
+             capacity,
+             kept,
+             gemv * 1e3,
+             flops / gemv * 1e-9,
+             grouped * 1e3,
+             flops / grouped * 1e-9,
+             max_diff);
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,252 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Compares the hash-map graph layout of PCG::Graph (BasicGraph here, which
+// stores the same maps of edge sets) with CompactGraph on the operations of
+// the substitution search: copying a candidate, deriving a rewritten graph,
+// hashing it and finding bottlenecks with post-dominators. The graphs have
+// the operator structure of the PCGs of examples/cpp. Usage:
+//   pcg_graph_bench [--iterations N]
+
+#include "flexflow/compact_graph.h"
+#include "flexflow/dominators.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+using namespace FlexFlow::PCG::Utils;
+
+struct EdgeList {
+  int num_nodes = 0;
+  std::vector<CompactEdge> edges;
+
+  int add(std::vector<int> const &inputs) {
+    for (size_t i = 0; i < inputs.size(); i++) {
+      edges.push_back({inputs[i], num_nodes, 0, (int)i});
+    }
+    return num_nodes++;
+  }
+};
+
+// Each transformer layer: attention with q/k/v projections, residual add,
+// layer norm, two-layer MLP, residual add; parallel ops around the MLP
+static EdgeList transformer(int num_layers) {
+  EdgeList g;
+  int x = g.add({});
+  for (int l = 0; l < num_layers; l++) {
+    int q = g.add({x}), k = g.add({x}), v = g.add({x});
+    int attn = g.add({q, k, v});
+    int o = g.add({attn});
+    int add1 = g.add({x, o});
+    int ln1 = g.add({add1});
+    int repartition = g.add({ln1});
+    int fc1 = g.add({repartition});
+    int relu = g.add({fc1});
+    int fc2 = g.add({relu});
+    int reduction = g.add({fc2});
+    int add2 = g.add({ln1, reduction});
+    x = g.add({add2});
+  }
+  g.add({x});
+  return g;
+}
+
+// Bottleneck blocks with a projection shortcut at the start of each stage
+static EdgeList resnet(int num_blocks) {
+  EdgeList g;
+  int x = g.add({g.add({})});
+  for (int b = 0; b < num_blocks; b++) {
+    int c1 = g.add({x});
+    int c2 = g.add({g.add({c1})});
+    int c3 = g.add({g.add({c2})});
+    int shortcut = b % 4 == 0 ? g.add({x}) : x;
+    x = g.add({g.add({c3, shortcut})});
+  }
+  g.add({g.add({x})});
+  return g;
+}
+
+// Inception modules: four branches of different depth joined by a concat
+static EdgeList inception(int num_modules) {
+  EdgeList g;
+  int x = g.add({});
+  for (int m = 0; m < num_modules; m++) {
+    int b1 = g.add({x});
+    int b2 = g.add({g.add({x})});
+    int b3 = g.add({g.add({g.add({x})})});
+    int b4 = g.add({g.add({x})});
+    x = g.add({b1, b2, b3, b4});
+  }
+  g.add({x});
+  return g;
+}
+
+struct Model {
+  char const *name;
+  EdgeList graph;
+};
+
+static double seconds_per_call(std::function<void()> const &fn,
+                               int iterations) {
+  fn(); // warm up
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; i++) {
+    fn();
+  }
+  std::chrono::duration<double> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+// Graph::hash on the hash-map layout
+static size_t basic_hash(BasicGraph<size_t> const &g) {
+  size_t total_hash = 0;
+  for (size_t n : g.nodes) {
+    size_t node_hash = std::hash<size_t>()(n);
+    auto it = g.in_edges.find(n);
+    if (it != g.in_edges.end()) {
+      for (auto const &e : it->second) {
+        size_t edge_hash = 17;
+        edge_hash = edge_hash * 31 + std::hash<size_t>()(e.first);
+        node_hash *= edge_hash;
+      }
+    }
+    total_hash += node_hash;
+  }
+  return total_hash;
+}
+
+int main(int argc, char **argv) {
+  int iterations = 20;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "--iterations") && i + 1 < argc) {
+      iterations = atoi(argv[++i]);
+    } else {
+      fprintf(stderr, "usage: %s [--iterations N]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  std::vector<Model> models = {
+      {"Transformer-12", transformer(12)},
+      {"Transformer-48", transformer(48)},
+      {"ResNet-50", resnet(16)},
+      {"ResNet-152", resnet(50)},
+      {"InceptionV3", inception(11)},
+  };
+  printf("%-16s %6s %6s %19s %19s %19s %19s\n",
+         "model",
+         "nodes",
+         "edges",
+         "copy map/csr us",
+         "rewrite map/csr us",
+         "hash map/csr us",
+         "ipdom map/csr us");
+  for (Model const &model : models) {
+    EdgeList const &list = model.graph;
+    std::vector<size_t> values(list.num_nodes);
+    BasicGraph<size_t> basic;
+    for (int i = 0; i < list.num_nodes; i++) {
+      // Spread the node values like operator pointers
+      values[i] = 0x100000 + 64 * (size_t)i;
+      basic.add_node(values[i]);
+    }
+    for (CompactEdge const &e : list.edges) {
+      basic.add_edge(values[e.src], values[e.dst]);
+    }
+    CompactGraph<size_t> compact(values, list.edges);
+
+    // The rewrite replaces a node in the middle by a fresh one
+    int const victim = list.num_nodes / 2;
+    size_t const fresh = 0x10;
+    std::vector<CompactEdge> rewired;
+    for (CompactEdge e : compact.in_edges(victim)) {
+      e.dst = compact.num_ids();
+      rewired.push_back(e);
+    }
+    for (CompactEdge e : compact.out_edges(victim)) {
+      e.src = compact.num_ids();
+      rewired.push_back(e);
+    }
+
+    // Keeps the results alive so the timed calls are not optimized out
+    volatile size_t sink = 0;
+    double const copy_map = seconds_per_call(
+        [&]() {
+          BasicGraph<size_t> copy = basic;
+          sink += copy.nodes.size();
+        },
+        iterations);
+    double const copy_csr = seconds_per_call(
+        [&]() {
+          CompactGraph<size_t> copy = compact;
+          sink += copy.num_nodes();
+        },
+        iterations);
+    double const rewrite_map = seconds_per_call(
+        [&]() {
+          BasicGraph<size_t> copy = basic;
+          size_t const v = values[victim];
+          auto in_edges = copy.in_edges[v];
+          auto out_edges = copy.out_edges[v];
+          for (auto const &e : in_edges) {
+            copy.remove_edge(e);
+            copy.add_edge(e.first, fresh);
+          }
+          for (auto const &e : out_edges) {
+            copy.remove_edge(e);
+            copy.add_edge(fresh, e.second);
+          }
+          copy.nodes.erase(v);
+          copy.in_edges.erase(v);
+          copy.out_edges.erase(v);
+          sink += basic_hash(copy);
+        },
+        iterations);
+    double const rewrite_csr = seconds_per_call(
+        [&]() {
+          CompactGraph<size_t> copy =
+              compact.rewrite({victim}, {fresh}, rewired);
+          sink += copy.hash();
+        },
+        iterations);
+    double const hash_map = seconds_per_call(
+        [&]() { sink += basic_hash(basic); }, iterations);
+    double const hash_csr = seconds_per_call(
+        [&]() { sink += compact.hash(); }, iterations);
+    double const ipdom_map = seconds_per_call(
+        [&]() { sink += imm_post_dominators(basic).size(); }, iterations);
+    double const ipdom_csr = seconds_per_call(
+        [&]() { sink += dense_imm_post_dominators(compact).size(); },
+        iterations);
+    printf("%-16s %6d %6zu %9.1f/%9.1f %9.1f/%9.1f %9.1f/%9.1f "
+           "%9.1f/%9.1f\n",
+           model.name,
+           list.num_nodes,
+           list.edges.size(),
+           copy_map * 1e6,
+           copy_csr * 1e6,
+           rewrite_map * 1e6,
+           rewrite_csr * 1e6,
+           hash_map * 1e6,
+           hash_csr * 1e6,
+           ipdom_map * 1e6,
+           ipdom_csr * 1e6);
+  }
+  return 0;
+}
@@ -0,0 +1,104 @@
+/* Copyright 2023 CMU, Facebook, LANL, MIT, NVIDIA, and Stanford (alphabetical)
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Measures how fast RequestManager takes in a submission of prompts: one
+// register_new_request call per prompt (what FFModel::generate used to do)
+// against one register_new_requests call for the whole submission. The
+// single-prompt path logs every request to stdout, so results go to stderr.
+// Usage:
+//   request_ingestion_bench <llama|opt|falcon> <tokenizer path>
+//                           [--prompts N] [--threads N]
+
+#include "flexflow/request_manager.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+
+using namespace FlexFlow;
+
+static char const *words[] = {
+    "The",  "model",   "serves", "requests", "with", "speculative",
+    "tree", "decoding", "and",   "tokens",   "are",  "grouped",
+    "into", "batches", "of",     "64",       ",",    "verified",
+    "by",   "the",     "LLM.",   "Überprüft"};
+
+// Prompts of 16 to 256 words, so that tokenization cost varies per prompt
+static std::vector<std::string> make_prompts(int num_prompts) {
+  std::mt19937 gen(0);
+  std::uniform_int_distribution<int> length(16, 256);
+  std::uniform_int_distribution<int> word(0,
+                                          sizeof(words) / sizeof(words[0]) - 1);
+  std::vector<std::string> prompts(num_prompts);
+  for (std::string &prompt : prompts) {
+    int n = length(gen);
+    for (int i = 0; i < n; i++) {
+      prompt += (i > 0 ? " " : "") + std::string(words[word(gen)]);
+    }
+  }
+  return prompts;
+}
+
+static void report(char const *name, int num_prompts, double seconds) {
+  fprintf(stderr,
+          "%-28s %8.3f s %12.0f prompts/s\n",
+          name,
+          seconds,
+          num_prompts / seconds);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr,
+            "Usage: %s <llama|opt|falcon> <tokenizer path> [--prompts N] "
+            "[--threads N]\n",
+            argv[0]);
+    return 1;
+  }
+  ModelType model_type = !strcmp(argv[1], "llama") ? ModelType::LLAMA
+                         : !strcmp(argv[1], "opt") ? ModelType::OPT
+                                                   : ModelType::FALCON;
+  int num_prompts = 10000, num_threads = 0;
+  for (int i = 3; i + 1 < argc; i += 2) {
+    if (!strcmp(argv[i], "--prompts")) {
+      num_prompts = atoi(argv[i + 1]);
+    } else if (!strcmp(argv[i], "--threads")) {
+      num_threads = atoi(argv[i + 1]);
+    }
+  }
+
+  RequestManager *rm = RequestManager::get_request_manager();
+  rm->set_max_sequence_length(4096);
+  rm->register_tokenizer(model_type, 1, 2, argv[2]);
+  std::vector<std::string> prompts = make_prompts(num_prompts);
+
+  auto start = std::chrono::steady_clock::now();
+  for (std::string const &prompt : prompts) {
+    rm->register_new_request(prompt, 4096);
+  }
+  std::chrono::duration<double> serial =
+      std::chrono::steady_clock::now() - start;
+
+  start = std::chrono::steady_clock::now();
+  rm->register_new_requests(prompts, 4096, num_threads);
+  std::chrono::duration<double> batched =
+      std::chrono::steady_clock::now() - start;
+
+  fprintf(stderr, "%d prompts\n", num_prompts);
+  report("register_new_request", num_prompts, serial.count());
+  report("register_new_requests", num_prompts, batched.count());
+  return 0;
+}
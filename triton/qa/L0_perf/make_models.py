@@ -0,0 +1,90 @@
+#------------------------------------------------------------------------------#
+# Copyright 2022 NVIDIA CORPORATION
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#------------------------------------------------------------------------------#
+
+# Generate the models for the throughput benchmark. Both models add two
+# [MAX_BATCH_SIZE, ELEMENTS] tensors on one CPU; only 'add_batched' lets
+# Triton coalesce concurrent requests into one execution.
+
+from onnx import helper
+from onnx import TensorProto as tp
+from onnx import checker
+from onnx import save
+import argparse
+import os
+
+MAX_BATCH_SIZE = 16
+ELEMENTS = 4096
+
+CONFIG = """name: "{name}"
+backend: "legion"
+max_batch_size: {max_batch_size}
+input [
+  {{
+    name: "input0"
+    data_type: TYPE_FP32
+    dims: [ {elements} ]
+  }},
+  {{
+    name: "input1"
+    data_type: TYPE_FP32
+    dims: [ {elements} ]
+  }}
+]
+output [
+  {{
+    name: "output"
+    data_type: TYPE_FP32
+    dims: [ {elements} ]
+  }}
+]
+instance_group [ {{ kind : KIND_MODEL }}]
+{batching}
+"""
+
+
+def add_model(path, name, dynamic_batching):
+    node = helper.make_node('Add',
+                            inputs=['input0', 'input1'],
+                            outputs=['output'])
+    shape = [MAX_BATCH_SIZE, ELEMENTS]
+    graph = helper.make_graph([node], 'perf_graph', [
+        helper.make_tensor_value_info('input0', tp.FLOAT, shape),
+        helper.make_tensor_value_info('input1', tp.FLOAT, shape)
+    ], [helper.make_tensor_value_info('output', tp.FLOAT, shape)])
+    model = helper.make_model(graph, producer_name='model')
+    checker.check_model(model)
+    version_dir = os.path.join(path, name, '1')
+    os.makedirs(version_dir, exist_ok=True)
+    save(model, os.path.join(version_dir, 'model.onnx'))
+    # Run the whole operator on the first CPU
+    with open(os.path.join(version_dir, 'model.strategy'), 'w') as f:
+        f.write('1 Add 1 2 1 1 1 0')
+    batching = ('dynamic_batching {{ max_queue_delay_microseconds: 100 }}'
+                if dynamic_batching else '')
+    with open(os.path.join(path, name, 'config.pbtxt'), 'w') as f:
+        f.write(
+            CONFIG.format(name=name,
+                          max_batch_size=MAX_BATCH_SIZE,
+                          elements=ELEMENTS,
+                          batching=batching))
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument('path', help='model repository to create')
+    args = parser.parse_args()
+    add_model(args.path, 'add_batched', True)
+    add_model(args.path, 'add_unbatched', False)
@@ -0,0 +1,77 @@
+#------------------------------------------------------------------------------#
+# Copyright 2022 NVIDIA CORPORATION
+#
+# Licensed under the Apache License, Version 2.0 (the "License");
+# you may not use this file except in compliance with the License.
+# You may obtain a copy of the License at
+#
+# http://www.apache.org/licenses/LICENSE-2.0
+#
+# Unless required by applicable law or agreed to in writing, software
+# distributed under the License is distributed on an "AS IS" BASIS,
+# WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+# See the License for the specific language governing permissions and
+# limitations under the License.
+#------------------------------------------------------------------------------#
+
+# Report the requests/sec of the benchmark models as the number of
+# concurrent clients grows, each client keeps one request in flight.
+
+import numpy as np
+import tritonhttpclient
+import argparse
+import threading
+import time
+
+ELEMENTS = 4096
+
+
+def client_loop(model_name, deadline, counts, index):
+    client = tritonhttpclient.InferenceServerClient(url="localhost:8000")
+    data = np.random.rand(1, ELEMENTS).astype(np.float32)
+    inputs = [
+        tritonhttpclient.InferInput('input0', [1, ELEMENTS], "FP32"),
+        tritonhttpclient.InferInput('input1', [1, ELEMENTS], "FP32")
+    ]
+    inputs[0].set_data_from_numpy(data)
+    inputs[1].set_data_from_numpy(data)
+    outputs = [tritonhttpclient.InferRequestedOutput('output')]
+    while time.time() < deadline:
+        result = client.infer(model_name=model_name,
+                              inputs=inputs,
+                              outputs=outputs)
+        if not np.allclose(result.as_numpy('output'), data + data):
+            raise RuntimeError("wrong result from '{}'".format(model_name))
+        counts[index] += 1
+
+
+def measure(model_name, concurrency, seconds):
+    counts = [0] * concurrency
+    deadline = time.time() + seconds
+    threads = [
+        threading.Thread(target=client_loop,
+                         args=(model_name, deadline, counts, i))
+        for i in range(concurrency)
+    ]
+    start = time.time()
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    return sum(counts) / (time.time() - start)
+
+
+if __name__ == '__main__':
+    parser = argparse.ArgumentParser()
+    parser.add_argument('--seconds', type=float, default=10.0)
+    parser.add_argument('--concurrency',
+                        type=int,
+                        nargs='+',
+                        default=[1, 2, 4, 8, 16])
+    args = parser.parse_args()
+    print("{:<16}{:>12}{:>16}".format("model", "concurrency", "requests/sec"))
+    for model_name in ['add_unbatched', 'add_batched']:
+        for concurrency in args.concurrency:
+            throughput = measure(model_name, concurrency, args.seconds)
+            print("{:<16}{:>12}{:>16.1f}".format(model_name, concurrency,
+                                                  throughput))
@@ -307,6 +307,7 @@ LegionModelInstance::ProcessRequests(
   std::vector<uint64_t> compute_input_end_ns(request_count);
   std::vector<uint64_t> compute_output_start_ns(request_count);
   RunModel(inputs, outputs, compute_input_end_ns, compute_output_start_ns);
+  ScatterOutputTensors(outputs, &responses);
 
   uint64_t request_end_ns = request_start_ns;
   SET_TIMESTAMP(request_end_ns);
@@ -377,10 +378,7 @@ LegionModelInstance::SetInputTensors(
     std::vector<TRITONBACKEND_Response*>* responses,
     std::vector<InputTensor>& inputs)
 {
-  // [FIXME] more checking in terms of expected byte size and actual byte size
   const int max_batch_size = Model()->MaxBatchSize();
-  size_t padding_batch_size =
-      (max_batch_size == 0) ? 0 : max_batch_size - total_batch_size;
 
   // All requests must have equally-sized input tensors so use any
   // request as the representative for the input tensors.
@@ -418,7 +416,78 @@ LegionModelInstance::SetInputTensors(
         tensor.strides_[i - 1] = tensor.strides_[i] * batchn_shape[i];
       }
     }
+    // The model always runs on a single buffer holding the full batch
+    // that the model was built for, padded with zeros past the requests
+    const size_t batch_byte_size =
+        (max_batch_size == 0) ? GetByteSize(input_datatype, batchn_shape)
+                              : tensor.strides_[0] * max_batch_size;
+
+    // If the requests already sit back to back in one memory and fill the
+    // batch then we can attach their buffers directly without any copies
+    bool contiguous = true;
+    const char* base = nullptr;
+    TRITONSERVER_MemoryType base_memory_type = TRITONSERVER_MEMORY_CPU;
+    int64_t base_memory_type_id = 0;
+    size_t offset = 0;
+    for (size_t request_idx = 0; request_idx < request_count; ++request_idx) {
+      TRITONBACKEND_Input* input;
+      RESPOND_ALL_AND_RETURN_IF_ERROR(
+          false, responses, request_count,
+          TRITONBACKEND_RequestInputByIndex(
+              requests[request_idx], input_idx, &input));
+
+      uint32_t buffer_count;
+      RESPOND_ALL_AND_RETURN_IF_ERROR(
+          false, responses, request_count,
+          TRITONBACKEND_InputProperties(
+              input, nullptr, nullptr, nullptr, nullptr, nullptr,
+              &buffer_count));
+      if (buffer_count != 1) {
+        contiguous = false;
+        break;
+      }
+      const void* buffer;
+      uint64_t buffer_byte_size;
+      TRITONSERVER_MemoryType memory_type = TRITONSERVER_MEMORY_CPU;
+      int64_t memory_type_id = 0;
+      RESPOND_ALL_AND_RETURN_IF_ERROR(
+          false, responses, request_count,
+          TRITONBACKEND_InputBuffer(
+              input, 0, &buffer, &buffer_byte_size, &memory_type,
+              &memory_type_id));
+      if (request_idx == 0) {
+        base = static_cast<const char*>(buffer);
+        base_memory_type = memory_type;
+        base_memory_type_id = memory_type_id;
+      } else if (
+          (buffer != base + offset) || (memory_type != base_memory_type) ||
+          (memory_type_id != base_memory_type_id)) {
+        contiguous = false;
+        break;
+      }
+      offset += buffer_byte_size;
+    }
+    if (contiguous && (offset == batch_byte_size)) {
+      tensor.buffers_.emplace_back(base);
+      tensor.buffer_locations_.emplace_back(
+          base_memory_type, base_memory_type_id);
+      tensor.buffer_memories_.emplace_back(
+          runtime->FindMemory(base_memory_type, base_memory_type_id));
+      continue;
+    }
 
+    // Otherwise coalesce the requests into one buffer
+    // FIXME using CPU for now, can be smart based on what kind of input
+    // buffer that the model prefers
+    BackendMemory* backend_memory;
+    RESPOND_ALL_AND_RETURN_IF_ERROR(
+        false, responses, request_count,
+        BackendMemory::Create(
+            Model()->TritonMemoryManager(), BackendMemory::AllocationType::CPU,
+            0, batch_byte_size, &backend_memory));
+    tensor.allocated_memory_.emplace_back(backend_memory);
+    char* coalesced = backend_memory->MemoryPtr();
+    offset = 0;
     for (size_t request_idx = 0; request_idx < request_count; ++request_idx) {
       TRITONBACKEND_Input* input;
       RESPOND_ALL_AND_RETURN_IF_ERROR(
@@ -427,115 +496,35 @@ LegionModelInstance::SetInputTensors(
               requests[request_idx], input_idx, &input));
 
       uint64_t total_buffer_byte_size;
-      uint32_t buffer_count;
       RESPOND_ALL_AND_RETURN_IF_ERROR(
           false, responses, request_count,
           TRITONBACKEND_InputProperties(
               input, nullptr, nullptr, nullptr, nullptr,
-              &total_buffer_byte_size, &buffer_count));
-
-      // Check if the input buffers need to be preprocessed into
-      // contiguous buffer that satisfies the constraints
-      bool need_preprocess = false;
-      std::vector<const void*> buffers;
-      std::vector<Memory> buffer_memories;
-      std::vector<std::pair<TRITONSERVER_MemoryType, int64_t>> buffer_locations;
-      // FIXME need to understand how a buffer satisfies the constraints,
-      // currently the request input must be in one contiguous buffer, and
-      // we shouldn't need to concatenate buffer for requests as splitting along
-      // batch dimension should be okay.
-      need_preprocess = (buffer_count > 1);
-      if (!need_preprocess) {
-        const void* buffer;
-        uint64_t buffer_byte_size;
-        TRITONSERVER_MemoryType memory_type;
-        int64_t memory_type_id;
-        RESPOND_ALL_AND_RETURN_IF_ERROR(
-            false, responses, request_count,
-            TRITONBACKEND_InputBuffer(
-                input, 0, &buffer, &buffer_byte_size, &memory_type,
-                &memory_type_id));
-        buffers.emplace_back(buffer);
-        buffer_locations.emplace_back(memory_type, memory_type_id);
-        buffer_memories.emplace_back(
-            runtime->FindMemory(memory_type, memory_type_id));
-      }
-      // for (size_t buffer_idx = 0; buffer_idx < buffer_count; ++buffer_count)
-      // {
-      //   const void* buffer;
-      //   uint64_t buffer_byte_size;
-      //   TRITONSERVER_MemoryType memory_type;
-      //   int64_t memory_type_id;
-      //   RESPOND_ALL_AND_RETURN_IF_ERROR(
-      //       false, responses, request_count,
-      //       TRITONBACKEND_InputBuffer(
-      //           input, buffer_idx, &buffer, &buffer_byte_size, &memory_type,
-      //           &memory_type_id));
-      //   // Check if the buffer is good
-      //   for (auto it = tensor.strides_.cbegin();
-      //        it != tensor.strides_.cend(); ++it) {
-      //     if (*it <= buffer_byte_size) {
-      //       need_preprocess = ((buffer_byte_size % *it) != 0);
-      //       break;
-      //     }
-      //   }
-      //   if (need_preprocess) {
-      //     break;
-      //   } else {
-      //     buffers.emplace_back(buffer);
-      //     buffer_locations.emplace_back(memory_type, memory_type_id);
-      //   }
-      // }
-      if (need_preprocess) {
-        // FIXME using CPU for now, can be smart based on what kind of input
-        // buffer that the model prefers
-        BackendMemory* backend_memory;
+              &total_buffer_byte_size, nullptr));
+      if ((offset + total_buffer_byte_size) > batch_byte_size) {
         RESPOND_ALL_AND_RETURN_IF_ERROR(
             false, responses, request_count,
-            BackendMemory::Create(
-                Model()->TritonMemoryManager(),
-                BackendMemory::AllocationType::CPU, 0, total_buffer_byte_size,
-                &backend_memory));
-        tensor.allocated_memory_.emplace_back(backend_memory);
-        RESPOND_ALL_AND_RETURN_IF_ERROR(
-            false, responses, request_count,
-            ReadInputTensor(
-                requests[request_idx], input_name, backend_memory->MemoryPtr(),
-                &total_buffer_byte_size));
-        tensor.buffers_.emplace_back(backend_memory->MemoryPtr());
-        tensor.buffer_locations_.emplace_back(
-            backend_memory->MemoryType(), backend_memory->MemoryTypeId());
-        tensor.buffer_memories_.emplace_back(runtime->FindMemory(
-            backend_memory->MemoryType(), backend_memory->MemoryTypeId()));
-      } else {
-        std::copy(
-            buffers.begin(), buffers.end(),
-            std::back_inserter(tensor.buffers_));
-        std::copy(
-            buffer_locations.begin(), buffer_locations.end(),
-            std::back_inserter(tensor.buffer_locations_));
-        std::copy(
-            buffer_memories.begin(), buffer_memories.end(),
-            std::back_inserter(tensor.buffer_memories_));
+            TRITONSERVER_ErrorNew(
+                TRITONSERVER_ERROR_INVALID_ARG,
+                (std::string("input '") + input_name + "' of '" + Name() +
+                 "' exceeds the expected batch byte size " +
+                 std::to_string(batch_byte_size))
+                    .c_str()));
       }
-    }
-
-    if (padding_batch_size != 0) {
-      size_t byte_size = tensor.strides_[0] * padding_batch_size;
-      BackendMemory* backend_memory;
       RESPOND_ALL_AND_RETURN_IF_ERROR(
           false, responses, request_count,
-          BackendMemory::Create(
-              Model()->TritonMemoryManager(),
-              BackendMemory::AllocationType::CPU, 0, byte_size,
-              &backend_memory));
-      tensor.allocated_memory_.emplace_back(backend_memory);
-      // set the value of the padding to zeros
-      memset(backend_memory->MemoryPtr(), 0, byte_size);
-      tensor.buffers_.emplace_back(backend_memory->MemoryPtr());
-      tensor.buffer_locations_.emplace_back(
-          backend_memory->MemoryType(), backend_memory->MemoryTypeId());
+          ReadInputTensor(
+              requests[request_idx], input_name, coalesced + offset,
+              &total_buffer_byte_size));
+      offset += total_buffer_byte_size;
     }
+    // set the value of the padding to zeros
+    memset(coalesced + offset, 0, batch_byte_size - offset);
+    tensor.buffers_.emplace_back(coalesced);
+    tensor.buffer_locations_.emplace_back(
+        backend_memory->MemoryType(), backend_memory->MemoryTypeId());
+    tensor.buffer_memories_.emplace_back(runtime->FindMemory(
+        backend_memory->MemoryType(), backend_memory->MemoryTypeId()));
   }
   return true;
 }
@@ -549,8 +538,6 @@ LegionModelInstance::SetOutputTensors(
     std::vector<OutputTensor>& outputs)
 {
   const int max_batch_size = Model()->MaxBatchSize();
-  size_t padding_batch_size =
-      (max_batch_size == 0) ? 0 : max_batch_size - total_batch_size;
 
   const auto& output_infos = model_state_->OutputInfos();
   outputs.reserve(output_infos.size());
@@ -571,12 +558,15 @@ LegionModelInstance::SetOutputTensors(
         tensor.strides_[i - 1] = tensor.strides_[i] * batchn_shape[i];
       }
     }
-    size_t batch1_byte_size = GetByteSize(triton_dtype, batchn_shape);
+    const size_t batch_byte_size = GetByteSize(triton_dtype, batchn_shape);
+    size_t batch1_byte_size = batch_byte_size;
     if (max_batch_size != 0) {
       batch1_byte_size /= batchn_shape[0];
     }
-    // Prepare the output buffer for each response, if the output is not
-    // requested, backend managed buffer will be used
+    // Prepare the output buffer for each response that requested it and
+    // remember where its slice lives in the coalesced output
+    std::vector<OutputTensor::Scatter> requested;
+    size_t offset = 0;
     for (size_t request_idx = 0; request_idx < request_count; ++request_idx) {
       uint32_t requested_output_count;
       RESPOND_ALL_AND_RETURN_IF_ERROR(
@@ -596,6 +586,8 @@ LegionModelInstance::SetOutputTensors(
           break;
         }
       }
+      const size_t byte_size =
+          batch1_byte_size * request_batch_sizes[request_idx];
       if (found) {
         if (max_batch_size != 0) {
           batchn_shape[0] = request_batch_sizes[request_idx];
@@ -615,49 +607,82 @@ LegionModelInstance::SetOutputTensors(
         RESPOND_ALL_AND_RETURN_IF_ERROR(
             false, responses, request_count,
             TRITONBACKEND_OutputBuffer(
-                response_output, &buffer,
-                batch1_byte_size * request_batch_sizes[request_idx],
-                &memory_type, &memory_type_id));
-        tensor.buffers_.emplace_back(buffer);
-        tensor.buffer_locations_.emplace_back(memory_type, memory_type_id);
-        tensor.buffer_memories_.emplace_back(
-            runtime->FindMemory(memory_type, memory_type_id));
-      } else {
-        BackendMemory* backend_memory;
-        RESPOND_ALL_AND_RETURN_IF_ERROR(
-            false, responses, request_count,
-            BackendMemory::Create(
-                Model()->TritonMemoryManager(),
-                BackendMemory::AllocationType::CPU, 0,
-                batch1_byte_size * request_batch_sizes[request_idx],
-                &backend_memory));
-        tensor.allocated_memory_.emplace_back(backend_memory);
-        tensor.buffers_.emplace_back(backend_memory->MemoryPtr());
-        tensor.buffer_locations_.emplace_back(
-            backend_memory->MemoryType(), backend_memory->MemoryTypeId());
-        tensor.buffer_memories_.emplace_back(runtime->FindMemory(
-            backend_memory->MemoryType(), backend_memory->MemoryTypeId()));
+                response_output, &buffer, byte_size, &memory_type,
+                &memory_type_id));
+        OutputTensor::Scatter scatter;
+        scatter.request_index_ = request_idx;
+        scatter.offset_ = offset;
+        scatter.byte_size_ = byte_size;
+        scatter.buffer_ = buffer;
+        scatter.memory_type_ = memory_type;
+        scatter.memory_type_id_ = memory_type_id;
+        requested.emplace_back(scatter);
       }
+      offset += byte_size;
     }
-    if (padding_batch_size != 0) {
-      BackendMemory* backend_memory;
-      RESPOND_ALL_AND_RETURN_IF_ERROR(
-          false, responses, request_count,
-          BackendMemory::Create(
-              Model()->TritonMemoryManager(),
-              BackendMemory::AllocationType::CPU, 0,
-              batch1_byte_size * padding_batch_size, &backend_memory));
-      tensor.allocated_memory_.emplace_back(backend_memory);
-      tensor.buffers_.emplace_back(backend_memory->MemoryPtr());
+    // A single request that fills the whole batch is written in place,
+    // otherwise the model writes a coalesced buffer which is scattered
+    // into the response buffers after the model has run
+    if ((requested.size() == 1) &&
+        (requested.front().byte_size_ == batch_byte_size)) {
+      const OutputTensor::Scatter& direct = requested.front();
+      tensor.buffers_.emplace_back(direct.buffer_);
       tensor.buffer_locations_.emplace_back(
-          backend_memory->MemoryType(), backend_memory->MemoryTypeId());
-      tensor.buffer_memories_.emplace_back(runtime->FindMemory(
-          backend_memory->MemoryType(), backend_memory->MemoryTypeId()));
+          direct.memory_type_, direct.memory_type_id_);
+      tensor.buffer_memories_.emplace_back(
+          runtime->FindMemory(direct.memory_type_, direct.memory_type_id_));
+      continue;
     }
+    BackendMemory* backend_memory;
+    RESPOND_ALL_AND_RETURN_IF_ERROR(
+        false, responses, request_count,
+        BackendMemory::Create(
+            Model()->TritonMemoryManager(), BackendMemory::AllocationType::CPU,
+            0, batch_byte_size, &backend_memory));
+    tensor.allocated_memory_.emplace_back(backend_memory);
+    tensor.buffers_.emplace_back(backend_memory->MemoryPtr());
+    tensor.buffer_locations_.emplace_back(
+        backend_memory->MemoryType(), backend_memory->MemoryTypeId());
+    tensor.buffer_memories_.emplace_back(runtime->FindMemory(
+        backend_memory->MemoryType(), backend_memory->MemoryTypeId()));
+    tensor.scatters_.swap(requested);
   }
   return true;
 }
 
+void
+LegionModelInstance::ScatterOutputTensors(
+    const std::vector<OutputTensor>& outputs,
+    std::vector<TRITONBACKEND_Response*>* responses)
+{
+  bool cuda_used = false;
+  for (const auto& tensor : outputs) {
+    if (tensor.scatters_.empty())
+      continue;
+    assert(tensor.buffers_.size() == 1);
+    const char* coalesced = static_cast<const char*>(tensor.buffers_[0]);
+    for (const auto& scatter : tensor.scatters_) {
+      bool copy_used_cuda = false;
+      GUARDED_RESPOND_IF_ERROR(
+          (*responses), scatter.request_index_,
+          CopyBuffer(
+              tensor.name_, tensor.buffer_locations_[0].first,
+              tensor.buffer_locations_[0].second, scatter.memory_type_,
+              scatter.memory_type_id_, scatter.byte_size_,
+              coalesced + scatter.offset_, scatter.buffer_, 0 /*stream*/,
+              &copy_used_cuda));
+      cuda_used = cuda_used || copy_used_cuda;
+    }
+  }
+#ifdef LEGION_USE_CUDA
+  // Copies into GPU response buffers are asynchronous on the null stream
+  if (cuda_used)
+    cudaStreamSynchronize(0);
+#else
+  assert(!cuda_used);
+#endif
+}
+
 IndexSpace
 LegionModelInstance::find_or_create_index_space(const Domain& domain)
 {
@@ -45,6 +45,18 @@ struct OutputTensor {
   // A placeholder for the memory acquired to hold the part of the output
   // that is not requested
   std::vector<std::unique_ptr<BackendMemory>> allocated_memory_;
+  // The slices of the coalesced output buffer that must be copied into
+  // the response buffers after the model has run. Empty if the model
+  // writes directly into the response buffer of a single request.
+  struct Scatter {
+    size_t request_index_;
+    size_t offset_;
+    size_t byte_size_;
+    void* buffer_;
+    TRITONSERVER_MemoryType memory_type_;
+    int64_t memory_type_id_;
+  };
+  std::vector<Scatter> scatters_;
 };
 
 //
@@ -121,6 +133,12 @@ class LegionModelInstance : public BackendModelInstance {
       std::vector<TRITONBACKEND_Response*>* responses,
       std::vector<OutputTensor>& outputs);
 
+  // Copy the coalesced outputs into the response buffers of the requests,
+  // errors are sent with the corresponding response
+  void ScatterOutputTensors(
+      const std::vector<OutputTensor>& outputs,
+      std::vector<TRITONBACKEND_Response*>* responses);
+
   LegionModelInstance(
       TRITONBACKEND_ModelInstance* triton_model_instance,
       LegionModelState* model_state, unsigned index, Realm::Event ready);
@@ -18,8 +18,14 @@
 #include "instance.h"
 #include "onnx_parser.h"
 #include "operator.h"
+#include "operators/conv2d.h"
+#include "operators/fused_elementwise.h"
+#include "operators/matmul.h"
 #include "tensor.h"
 
+#include <map>
+#include <set>
+
 using namespace Legion;
 
 namespace triton {
@@ -520,7 +526,8 @@ void LegionModelState::LoadLayers(void) const {
   std::vector<Realm::Event> loaded_events;
   for (unsigned idx1 = 0; idx1 < layers_.size(); idx1++) {
     Operator *op = layers_[idx1];
-    LayerStrategy const *config = strategy_->layers[idx1];
+    // Fusion removes layers so use the strategy of the operator itself
+    LayerStrategy const *config = op->strategy;
     for (unsigned idx2 = 0; idx2 < config->nProcs; idx2++) {
       Realm::Processor proc = config->local_processors[idx2];
       loaded_events.push_back(runtime_->LoadLayer(proc, op));
@@ -532,15 +539,146 @@ void LegionModelState::LoadLayers(void) const {
   }
 }
 
+// Fused layers execute their tiles together, so both layers must be
+// partitioned identically across the same processors
+static bool same_partitioning(LayerStrategy const *one,
+                              LayerStrategy const *two) {
+  if (one == two) {
+    return true;
+  }
+  if ((one->kind != two->kind) || (one->nDims != two->nDims) ||
+      (one->nProcs != two->nProcs) ||
+      (one->global_processors != two->global_processors)) {
+    return false;
+  }
+  for (int d = 0; d < one->nDims; d++) {
+    if (one->dim[d] != two->dim[d]) {
+      return false;
+    }
+  }
+  for (unsigned idx = 0; idx < one->nProcs; idx++) {
+    if ((one->local_processors[idx] != two->local_processors[idx]) ||
+        (one->local_points[idx] != two->local_points[idx])) {
+      return false;
+    }
+  }
+  return true;
+}
+
 void LegionModelState::FuseLayers(void) {
-  // FIXME: add support for layer fusion
+  // Count the readers of every tensor. Model outputs count as a reader so
+  // that they are never fused away.
+  std::map<Tensor const *, unsigned> num_readers;
+  std::map<Tensor const *, Operator *> last_reader;
+  for (auto op : layers_) {
+    for (auto tensor : op->input_tensors()) {
+      num_readers[tensor]++;
+      last_reader[tensor] = op;
+    }
+  }
+  for (auto const &output : outputs_) {
+    num_readers[output.second]++;
+  }
+  // The only reader of the output of 'op' if it is an elementwise layer
+  // that can be fused with 'op'
+  auto fusible_successor = [&](Operator *op) -> Operator * {
+    if (op->output_tensors().size() != 1) {
+      return nullptr;
+    }
+    Tensor const *output = op->output_tensors()[0];
+    if (num_readers[output] != 1) {
+      return nullptr;
+    }
+    Operator *next = last_reader[output];
+    if (!FusedElementwise::IsFusible(next) ||
+        !same_partitioning(op->strategy, next->strategy)) {
+      return nullptr;
+    }
+    return next;
+  };
+
+  std::set<Operator *> fused;
+  std::map<Operator *, Operator *> replacements;
+  for (auto op : layers_) {
+    if (fused.count(op) > 0) {
+      continue;
+    }
+    Conv2D *conv2d = dynamic_cast<Conv2D *>(op);
+    MatMul *matmul = dynamic_cast<MatMul *>(op);
+    if ((conv2d != nullptr) || (matmul != nullptr)) {
+      // Fold unary layers into the producer's epilogue. A ReLU directly
+      // after a convolution becomes its activation, which the GPU variant
+      // supports as well; other epilogues only exist on the CPU.
+      std::vector<CpuElementwiseStep> &epilogue =
+          (conv2d != nullptr) ? conv2d->epilogue : matmul->epilogue;
+      Operator *next = nullptr;
+      while ((next = fusible_successor(op)) != nullptr) {
+        if (next->input_tensors().size() != 1) {
+          break;
+        }
+        if ((conv2d != nullptr) && (conv2d->activation == AC_MODE_NONE) &&
+            epilogue.empty() && (next->op_type == OP_RELU)) {
+          conv2d->activation = AC_MODE_RELU;
+        } else if ((op->strategy->kind == Realm::Processor::LOC_PROC) &&
+                   (epilogue.size() < MAX_FUSED_STEPS)) {
+          epilogue.push_back(FusedElementwise::UnaryStep(next));
+        } else {
+          break;
+        }
+        op->AdoptOutputs(next);
+        fused.insert(next);
+      }
+      continue;
+    }
+    // Merge chains of elementwise layers into a single CPU task
+    if (!FusedElementwise::IsFusible(op) ||
+        (op->strategy->kind != Realm::Processor::LOC_PROC)) {
+      continue;
+    }
+    std::vector<Operator *> chain(1, op);
+    Operator *next = nullptr;
+    while ((chain.size() < MAX_FUSED_STEPS) &&
+           ((next = fusible_successor(chain.back())) != nullptr)) {
+      chain.push_back(next);
+    }
+    if (chain.size() < 2) {
+      continue;
+    }
+    std::string fused_name;
+    for (auto member : chain) {
+      fused_name += (fused_name.empty() ? "" : "+") + member->op_name;
+      fused.insert(member);
+    }
+    // The fused layer runs where the last layer of the chain did so that
+    // all the other operands of the chain are ready
+    replacements[chain.back()] = new FusedElementwise(
+        this, chain.back()->strategy, chain, fused_name.c_str());
+  }
+  if (fused.empty()) {
+    return;
+  }
+
+  std::vector<Operator *> layers;
+  for (auto op : layers_) {
+    auto finder = replacements.find(op);
+    if (finder != replacements.end()) {
+      layers.push_back(finder->second);
+    } else if (fused.count(op) == 0) {
+      layers.push_back(op);
+    }
+  }
+  for (auto op : fused) {
+    delete op;
+  }
+  layers_.swap(layers);
 }
 
 void LegionModelState::FreeLayers(void) const {
   std::vector<Realm::Event> freed_events;
   for (unsigned idx1 = 0; idx1 < layers_.size(); idx1++) {
     Operator *op = layers_[idx1];
-    LayerStrategy const *config = strategy_->layers[idx1];
+    // Fusion removes layers so use the strategy of the operator itself
+    LayerStrategy const *config = op->strategy;
     for (unsigned idx2 = 0; idx2 < config->nProcs; idx2++) {
       Realm::Processor proc = config->local_processors[idx2];
       freed_events.push_back(runtime_->FreeLayer(proc, op));
@@ -24,9 +24,14 @@
 #include "operators/softmax.h"
 #include "operators/unary.h"
 
+#include <fcntl.h>
 #include <google/protobuf/io/coded_stream.h>
 #include <google/protobuf/text_format.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdlib>
 #include <fstream>
 #include <string>
 #include "triton/backend/backend_common.h"
@@ -121,6 +126,53 @@ ReadTextFile(const std::string& path, std::string* contents)
   return nullptr;  // success
 }
 
+// Map the whole file read-only, the mapping is released along with the
+// last reference to it
+TRITONSERVER_Error*
+MapFile(
+    const std::string& path, std::shared_ptr<const void>* mapping,
+    size_t* byte_size)
+{
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL,
+        (std::string("failed to open external data file ") + path + ": " +
+         strerror(errno))
+            .c_str());
+  }
+  struct stat file_stat;
+  if (fstat(fd, &file_stat) != 0) {
+    const int stat_errno = errno;
+    close(fd);
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL,
+        (std::string("failed to stat external data file ") + path + ": " +
+         strerror(stat_errno))
+            .c_str());
+  }
+  *byte_size = file_stat.st_size;
+  if (*byte_size == 0) {
+    close(fd);
+    mapping->reset();
+    return nullptr;  // success
+  }
+  void* addr = mmap(nullptr, *byte_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  const int mmap_errno = errno;
+  // The mapping stays valid once the descriptor is closed
+  close(fd);
+  if (addr == MAP_FAILED) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INTERNAL,
+        (std::string("failed to map external data file ") + path + ": " +
+         strerror(mmap_errno))
+            .c_str());
+  }
+  const size_t length = *byte_size;
+  mapping->reset(addr, [length](void* ptr) { munmap(ptr, length); });
+  return nullptr;  // success
+}
+
 }  // namespace
 
 std::map<std::string, OnnxParser::ParseFn_t> OnnxParser::op_type_parser_map_{
@@ -177,6 +229,8 @@ OnnxParser::LoadModel(
   OnnxParser parser(
       find_local_processor_fn, model, strategy, onnx_model, inputs, outputs,
       layers);
+  // External data locations are relative to the directory of the model
+  parser.model_directory_ = onnx_file.substr(0, onnx_file.rfind('/') + 1);
 
   // Note that the weights specified in 'initializer' may also be specified
   // in 'input', thus we should parse in "weight, input" order so that we can
@@ -306,42 +360,25 @@ OnnxParser::LoadWeight(
     std::function<Legion::Rect<Dim>(Realm::Processor)> local_bound_fn,
     const onnx::TensorProto* weight_proto, Weights* weight)
 {
-  const auto& processors = find_local_processor_fn_(strategy->kind);
-  for (const auto& proc : processors) {
-    if (strategy->is_local_processor(proc)) {
-      size_t proc_idx = strategy->find_local_offset(proc);
-      weight->local_bounds[proc_idx] = Legion::Domain(local_bound_fn(proc));
-      const auto& local_bounds = weight->local_bounds[proc_idx];
-      size_t total_byte_size = sizeof_datatype(weight->type);
-      for (int dim_idx = (weight->bounds.size() - 1); dim_idx >= 0; --dim_idx) {
-        weight->local_strides[proc_idx][dim_idx] = total_byte_size;
-        total_byte_size *=
-            ((local_bounds.hi()[dim_idx] + 1) - local_bounds.lo()[dim_idx]);
-      }
-      weight->local_allocation[proc_idx] = std::malloc(total_byte_size);
-      if (weight->local_allocation[proc_idx] == nullptr) {
-        return TRITONSERVER_ErrorNew(
-            TRITONSERVER_ERROR_INTERNAL,
-            (std::string(
-                 "Failed to allocate local system memory for weight for '" +
-                 std::to_string(weight->owner->op_type) + "' layer named '" +
-                 weight->owner->op_name + "'")
-                 .c_str()));
-      }
-    }
+  size_t total_byte_size = sizeof_datatype(weight->type);
+  std::vector<size_t> strides(weight->bounds.size());
+  for (int dim_idx = (weight->bounds.size() - 1); dim_idx >= 0; --dim_idx) {
+    strides[dim_idx] = total_byte_size;
+    total_byte_size *= weight->bounds[dim_idx];
   }
 
-  // [FIXME] need to expand to be able to load from external files
+  const void* weight_ptr = nullptr;
+  std::shared_ptr<const void> mapping;
   if (weight_proto->has_data_location() &&
       (weight_proto->data_location() ==
        onnx::TensorProto::DataLocation::TensorProto_DataLocation_EXTERNAL)) {
-    return TRITONSERVER_ErrorNew(
-        TRITONSERVER_ERROR_UNSUPPORTED,
-        "Loading weight stored out of ONNX file is currently not supported");
+    const char* external_ptr;
+    RETURN_IF_ERROR(FindExternalData(
+        weight_proto, total_byte_size, &mapping, &external_ptr));
+    weight_ptr = external_ptr;
+  } else if (!weight_proto->has_data_location()) {
+    weight_ptr = weight_proto->raw_data().data();
   }
-  const void* weight_ptr = weight_proto->has_data_location()
-                               ? nullptr
-                               : weight_proto->raw_data().data();
   // boolean value stored in raw_data is represent in 1 byte (00000001 for true,
   // 00000000 for false), thus special handling is required
   // https://github.com/onnx/onnx/blob/v1.9.0/onnx/onnx-ml.proto#L558
@@ -378,14 +415,40 @@ OnnxParser::LoadWeight(
         break;
     }
   }
-  size_t total_byte_size = sizeof_datatype(weight->type);
-  std::vector<size_t> strides(weight->bounds.size());
-  for (int dim_idx = (weight->bounds.size() - 1); dim_idx >= 0; --dim_idx) {
-    strides[dim_idx] = total_byte_size;
-    total_byte_size *= weight->bounds[dim_idx];
-  }
-  for (size_t proc_idx = 0; proc_idx < MAX_LOCAL_PROCS; ++proc_idx) {
-    if (weight->local_allocation[proc_idx] != nullptr) {
+
+  const auto& processors = find_local_processor_fn_(strategy->kind);
+  for (const auto& proc : processors) {
+    if (strategy->is_local_processor(proc)) {
+      size_t proc_idx = strategy->find_local_offset(proc);
+      weight->local_bounds[proc_idx] = Legion::Domain(local_bound_fn(proc));
+      const auto& local_bounds = weight->local_bounds[proc_idx];
+      size_t local_byte_size = sizeof_datatype(weight->type);
+      for (int dim_idx = (weight->bounds.size() - 1); dim_idx >= 0; --dim_idx) {
+        weight->local_strides[proc_idx][dim_idx] = local_byte_size;
+        local_byte_size *=
+            ((local_bounds.hi()[dim_idx] + 1) - local_bounds.lo()[dim_idx]);
+      }
+      // Processors holding the whole weight read it in place from mapped
+      // external data, so the weight is not duplicated per processor
+      if ((mapping != nullptr) && !is_raw_boolean &&
+          (local_byte_size == total_byte_size) &&
+          ((reinterpret_cast<uintptr_t>(weight_ptr) %
+            sizeof_datatype(weight->type)) == 0)) {
+        weight->local_allocation[proc_idx] = const_cast<void*>(weight_ptr);
+        weight->local_view[proc_idx] = true;
+        weight->mapping = mapping;
+        continue;
+      }
+      weight->local_allocation[proc_idx] = std::malloc(local_byte_size);
+      if (weight->local_allocation[proc_idx] == nullptr) {
+        return TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_INTERNAL,
+            (std::string(
+                 "Failed to allocate local system memory for weight for '" +
+                 std::to_string(weight->owner->op_type) + "' layer named '" +
+                 weight->owner->op_name + "'")
+                 .c_str()));
+      }
       RETURN_IF_ERROR(SetElementData(
           strides, weight->local_bounds[proc_idx],
           weight->local_strides[proc_idx], 0, is_raw_boolean,
@@ -396,6 +459,77 @@ OnnxParser::LoadWeight(
   return nullptr;  // success
 }
 
+TRITONSERVER_Error*
+OnnxParser::FindExternalData(
+    const onnx::TensorProto* weight_proto, const size_t byte_size,
+    std::shared_ptr<const void>* mapping, const char** data)
+{
+  std::string location;
+  size_t offset = 0;
+  size_t length = byte_size;
+  for (const auto& entry : weight_proto->external_data()) {
+    if (entry.key() == "location") {
+      location = entry.value();
+    } else if ((entry.key() == "offset") || (entry.key() == "length")) {
+      char* end = nullptr;
+      const size_t value = std::strtoull(entry.value().c_str(), &end, 10);
+      if (entry.value().empty() || (*end != '\0')) {
+        return TRITONSERVER_ErrorNew(
+            TRITONSERVER_ERROR_INVALID_ARG,
+            (std::string("Invalid external data ") + entry.key() + " '" +
+             entry.value() + "' for weight '" + weight_proto->name() + "'")
+                .c_str());
+      }
+      if (entry.key() == "offset")
+        offset = value;
+      else
+        length = value;
+    }
+    // The "checksum" entry is not verified
+  }
+  // The location is relative to the directory of the model file
+  if (location.empty() || (location[0] == '/') ||
+      (location.find("..") != std::string::npos)) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (std::string("External data location '") + location +
+         "' of weight '" + weight_proto->name() +
+         "' must be a path within the model directory")
+            .c_str());
+  }
+  if (length != byte_size) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (std::string("External data of weight '") + weight_proto->name() +
+         "' has " + std::to_string(length) + " bytes, expected " +
+         std::to_string(byte_size))
+            .c_str());
+  }
+
+  // Map each external data file once, all of its weights are views into it
+  auto it = external_files_.find(location);
+  if (it == external_files_.end()) {
+    std::shared_ptr<const void> file_mapping;
+    size_t file_size = 0;
+    RETURN_IF_ERROR(
+        MapFile(model_directory_ + location, &file_mapping, &file_size));
+    it = external_files_
+             .emplace(location, std::make_pair(file_mapping, file_size))
+             .first;
+  }
+  if ((offset > it->second.second) ||
+      (byte_size > (it->second.second - offset))) {
+    return TRITONSERVER_ErrorNew(
+        TRITONSERVER_ERROR_INVALID_ARG,
+        (std::string("External data of weight '") + weight_proto->name() +
+         "' is out of the bounds of '" + location + "'")
+            .c_str());
+  }
+  *mapping = it->second.first;
+  *data = static_cast<const char*>(it->second.first.get()) + offset;
+  return nullptr;  // success
+}
+
 TRITONSERVER_Error*
 OnnxParser::SetElementData(
     const std::vector<size_t>& strides, const Legion::Domain& local_bounds,
@@ -13,6 +13,7 @@
  * limitations under the License.
  */
 
+#include <memory>
 #include <string>
 #include <vector>
 #include "model.h"
@@ -103,6 +104,11 @@ class OnnxParser {
       const LayerStrategy* strategy,
       std::function<Legion::Rect<Dim>(Realm::Processor)> local_bound_fn,
       const onnx::TensorProto* weight_proto, Weights* weight);
+  // Locate the data of a weight stored in an external data file, the file
+  // is memory-mapped once and shared by all the weights stored in it
+  TRITONSERVER_Error* FindExternalData(
+      const onnx::TensorProto* weight_proto, const size_t byte_size,
+      std::shared_ptr<const void>* mapping, const char** data);
   TRITONSERVER_Error* SetElementData(
       const std::vector<size_t>& strides, const Legion::Domain& local_bounds,
       const size_t* local_strides, size_t dim_idx, const bool is_raw_boolean,
@@ -121,6 +127,10 @@ class OnnxParser {
   std::vector<Operator*>* layers_;
   std::map<std::string, std::unique_ptr<Tensor>> tensors_;
   std::map<std::string, const onnx::TensorProto*> weights_;
+  std::string model_directory_;
+  // Mapping and byte size of each external data file by location
+  std::map<std::string, std::pair<std::shared_ptr<const void>, size_t>>
+      external_files_;
 };
 
 }}}  // namespace triton::backend::legion
@@ -17,7 +17,9 @@
 #include "operators/binary.h"
 #include "operators/concat.h"
 #include "operators/conv2d.h"
+#include "operators/fused_elementwise.h"
 #include "operators/matmul.h"
+#include "operators/pool2d.h"
 #include "operators/reshape.h"
 #include "operators/softmax.h"
 #include "operators/unary.h"
@@ -40,13 +42,25 @@ Operator::~Operator(void)
   for (auto tensor : outputs) delete tensor;
 }
 
+void
+Operator::AdoptOutputs(Operator* other)
+{
+  assert(other != this);
+  for (auto tensor : outputs) delete tensor;
+  outputs = other->outputs;
+  other->outputs.clear();
+  for (auto tensor : outputs) tensor->owner = this;
+}
+
 /*static*/ void
 Operator::PreregisterTaskVariants(void)
 {
   BinaryOperator::PreregisterTaskVariants();
   Concat::PreregisterTaskVariants();
   Conv2D::PreregisterTaskVariants();
+  FusedElementwise::PreregisterTaskVariants();
   MatMul::PreregisterTaskVariants();
+  Pool2D::PreregisterTaskVariants();
   Reshape::PreregisterTaskVariants();
   Softmax::PreregisterTaskVariants();
   UnaryOperator::PreregisterTaskVariants();
@@ -75,6 +75,14 @@ class Operator {
  public:
   static void PreregisterTaskVariants(void);
 
+ public:
+  // Used by the layer fusion pass to inspect and rewire the graph
+  const std::vector<Tensor*>& input_tensors(void) const { return inputs; }
+  const std::vector<Tensor*>& output_tensors(void) const { return outputs; }
+  // Take ownership of the outputs of an operator that is being fused into
+  // this one, deleting the outputs this operator produced before
+  void AdoptOutputs(Operator* other);
+
  public:
   const OperatorType op_type;
   const std::string op_name;
@@ -14,6 +14,7 @@
  */
 
 #include "binary.h"
+#include "cpu_kernels.h"
 
 using namespace Legion;
 
@@ -240,13 +241,118 @@ BinaryOperator::PreregisterTaskVariants(void)
 #endif
 }
 
+// Half precision has no host arithmetic so convert blocks of it to float
+static void
+binary_forward_cpu_half(
+    OperatorType op_type, const __half* input0, const __half* input1,
+    __half* output, size_t num_elements)
+{
+  const size_t BLOCK = 1024;
+  float buffer0[BLOCK], buffer1[BLOCK];
+  for (size_t offset = 0; offset < num_elements; offset += BLOCK) {
+    const size_t count = std::min(BLOCK, num_elements - offset);
+    for (size_t i = 0; i < count; i++) {
+      buffer0[i] = static_cast<float>(input0[offset + i]);
+      buffer1[i] = static_cast<float>(input1[offset + i]);
+    }
+    cpu_binary<float>(op_type, buffer0, buffer1, buffer0, count);
+    for (size_t i = 0; i < count; i++) output[offset + i] = __half(buffer0[i]);
+  }
+}
+
 /*static*/ void
 BinaryOperator::forward_cpu(
     const Task* task, const std::vector<PhysicalRegion>& regions, Context ctx,
     Runtime* runtime)
 {
-  // TODO: implement this
-  assert(false);
+  assert(task->local_arglen == sizeof(BinaryArgs));
+  const BinaryArgs* args = (const BinaryArgs*)task->local_args;
+  const void* input0_ptr = nullptr;
+  const void* input1_ptr = nullptr;
+  void* output_ptr = nullptr;
+  size_t volume = 0;
+  if (args->inplace) {
+    assert(regions.size() == 2);
+    assert(task->regions.size() == 2);
+    switch (args->bounds.get_dim()) {
+#define DIMFUNC(DIM)                                             \
+  case DIM: {                                                    \
+    const Rect<DIM> bounds = args->bounds;                       \
+    volume = bounds.volume();                                    \
+    output_ptr = TensorAccessor<LEGION_READ_WRITE, DIM>::access( \
+        args->datatype, bounds, regions[0]);                     \
+    input0_ptr = output_ptr;                                     \
+    input1_ptr = TensorAccessor<LEGION_READ_ONLY, DIM>::access(  \
+        args->datatype, bounds, regions[1]);                     \
+    break;                                                       \
+  }
+      LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+      default:
+        abort();
+    }
+  } else {
+    assert(regions.size() == 3);
+    assert(task->regions.size() == 3);
+    switch (args->bounds.get_dim()) {
+#define DIMFUNC(DIM)                                                \
+  case DIM: {                                                       \
+    const Rect<DIM> bounds = args->bounds;                          \
+    volume = bounds.volume();                                       \
+    output_ptr = TensorAccessor<LEGION_WRITE_DISCARD, DIM>::access( \
+        args->datatype, bounds, regions[0]);                        \
+    input0_ptr = TensorAccessor<LEGION_READ_ONLY, DIM>::access(     \
+        args->datatype, bounds, regions[1]);                        \
+    input1_ptr = TensorAccessor<LEGION_READ_ONLY, DIM>::access(     \
+        args->datatype, bounds, regions[2]);                        \
+    break;                                                          \
+  }
+      LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+      default:
+        abort();
+    }
+  }
+  switch (args->datatype) {
+    case DT_HALF: {
+      binary_forward_cpu_half(
+          args->op_type, (const __half*)input0_ptr, (const __half*)input1_ptr,
+          (__half*)output_ptr, volume);
+      break;
+    }
+    case DT_FLOAT: {
+      cpu_binary<float>(
+          args->op_type, (const float*)input0_ptr, (const float*)input1_ptr,
+          (float*)output_ptr, volume);
+      break;
+    }
+    case DT_DOUBLE: {
+      cpu_binary<double>(
+          args->op_type, (const double*)input0_ptr, (const double*)input1_ptr,
+          (double*)output_ptr, volume);
+      break;
+    }
+    case DT_INT8: {
+      cpu_binary<int8_t>(
+          args->op_type, (const int8_t*)input0_ptr, (const int8_t*)input1_ptr,
+          (int8_t*)output_ptr, volume);
+      break;
+    }
+    case DT_INT32: {
+      cpu_binary<int32_t>(
+          args->op_type, (const int32_t*)input0_ptr,
+          (const int32_t*)input1_ptr, (int32_t*)output_ptr, volume);
+      break;
+    }
+    case DT_INT64: {
+      cpu_binary<int64_t>(
+          args->op_type, (const int64_t*)input0_ptr,
+          (const int64_t*)input1_ptr, (int64_t*)output_ptr, volume);
+      break;
+    }
+    default:
+      abort();
+  }
 }
 
 #ifdef LEGION_USE_CUDA
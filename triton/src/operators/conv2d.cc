@@ -170,6 +170,30 @@ Conv2D::Load(Processor proc)
     proc_args.bias_bounds = Rect<1>(output.lo[1], output.hi[1]);
     proc_args.bias_datatype = weights[1]->type;
   }
+  proc_args.filter_bounds = GetWeightBounds(proc);
+  proc_args.kernel_h = kernel_h;
+  proc_args.kernel_w = kernel_w;
+  proc_args.stride_h = stride_h;
+  proc_args.stride_w = stride_w;
+  proc_args.groups = groups;
+  assert(epilogue.size() <= MAX_FUSED_STEPS);
+  proc_args.num_epilogue_steps = epilogue.size();
+  for (unsigned idx = 0; idx < epilogue.size(); idx++)
+    proc_args.epilogue[idx] = epilogue[idx];
+  // Derive the padding from the global shapes the same way the GPU
+  // variant does from the local ones so both agree on the output size
+  const coord_t image_h = inputs[0]->bounds[2];
+  const coord_t image_w = inputs[0]->bounds[3];
+  const coord_t output_image_h = outputs[0]->bounds[2];
+  const coord_t output_image_w = outputs[0]->bounds[3];
+  proc_args.pad_h =
+      ((output_image_h - 1) * coord_t(stride_h) + coord_t(kernel_h) - image_h +
+       1) /
+      2;
+  proc_args.pad_w =
+      ((output_image_w - 1) * coord_t(stride_w) + coord_t(kernel_w) - image_w +
+       1) /
+      2;
 #ifdef LEGION_USE_CUDA
   if (proc.kind() == Processor::TOC_PROC) {
     proc_args.cudnn = model->runtime_->cudnn[local_index];
@@ -293,7 +317,7 @@ Conv2D::Load(Processor proc)
           device_ptr, wts->local_allocation[local_index], weights_size,
           cudaMemcpyHostToDevice));
       // Free the old allocation since we no longer need it
-      std::free(wts->local_allocation[local_index]);
+      wts->FreeLocalAllocation(local_index);
       wts->local_allocation[local_index] = device_ptr;
       wts->local_memory[local_index] = local_fb;
     }
@@ -465,8 +489,7 @@ Conv2D::Free(Processor proc)
     CHECK_CUDNN(cudnnDestroyConvolutionDescriptor(proc_args.convDesc));
     CHECK_CUDA(cudaFree(weights[0]->local_allocation[local_index]));
     if (use_bias) {
-      std::free(weights[1]->local_allocation[local_index]);
-      weights[1]->local_allocation[local_index] = nullptr;
+      weights[1]->FreeLocalAllocation(local_index);
     }
     if (proc_args.workSpaceSize > 0) {
       for (int idx = 0; idx < MAX_NUM_INSTANCES; idx++) {
@@ -477,8 +500,7 @@ Conv2D::Free(Processor proc)
 #endif
   {
     for (Weights* wts : weights) {
-      std::free(wts->local_allocation[local_index]);
-      wts->local_allocation[local_index] = nullptr;
+      wts->FreeLocalAllocation(local_index);
     }
   }
 }
@@ -504,13 +526,146 @@ Conv2D::PreregisterTaskVariants(void)
 #endif
 }
 
+template <typename T>
+static void
+conv2d_forward_cpu(
+    const Conv2DArgs* args, const T* input, T* output, const T* filter,
+    const T* bias)
+{
+  const Rect<4>& in = args->input_bounds;
+  const Rect<4>& out = args->local_bounds;
+  const size_t batch = out.hi[0] - out.lo[0] + 1;
+  const size_t in_c = in.hi[1] - in.lo[1] + 1;
+  const size_t out_c = out.hi[1] - out.lo[1] + 1;
+  // The filter is (out_channel, in_channel / groups, kernel_h, kernel_w)
+  // and the whole of it is mapped on every processor
+  const size_t total_out_c = args->filter_bounds.hi[0] + 1;
+  const size_t group_in_c = in_c / args->groups;
+  const size_t group_out_c = total_out_c / args->groups;
+  assert(size_t(args->filter_bounds.hi[1] + 1) == group_in_c);
+  assert((in.hi[0] - in.lo[0] + 1) == coord_t(batch));
+
+  CpuWindow window;
+  window.in_h = in.hi[2] - in.lo[2] + 1;
+  window.in_w = in.hi[3] - in.lo[3] + 1;
+  window.in_h0 = in.lo[2];
+  window.in_w0 = in.lo[3];
+  window.out_h = out.hi[2] - out.lo[2] + 1;
+  window.out_w = out.hi[3] - out.lo[3] + 1;
+  window.out_h0 = out.lo[2];
+  window.out_w0 = out.lo[3];
+  window.kernel_h = args->kernel_h;
+  window.kernel_w = args->kernel_w;
+  window.stride_h = args->stride_h;
+  window.stride_w = args->stride_w;
+  window.pad_h = args->pad_h;
+  window.pad_w = args->pad_w;
+
+  // Lower each group of each image to a GEMM of the filter rows for the
+  // local output channels against the unfolded input
+  const size_t in_plane = window.in_h * window.in_w;
+  const size_t out_plane = window.out_h * window.out_w;
+  const size_t patch = group_in_c * args->kernel_h * args->kernel_w;
+  std::vector<T> col(patch * out_plane);
+  for (size_t n = 0; n < batch; n++) {
+    for (size_t g = 0; g < args->groups; g++) {
+      const size_t oc_lo = std::max<size_t>(out.lo[1], g * group_out_c);
+      const size_t oc_hi =
+          std::min<size_t>(out.hi[1] + 1, (g + 1) * group_out_c);
+      if (oc_lo >= oc_hi)
+        continue;
+      cpu_im2col(
+          input + (n * in_c + g * group_in_c) * in_plane, group_in_c, window,
+          col.data());
+      cpu_gemm(
+          oc_hi - oc_lo, out_plane, patch, filter + oc_lo * patch, patch,
+          col.data(), out_plane,
+          output + (n * out_c + (oc_lo - out.lo[1])) * out_plane, out_plane);
+    }
+    for (size_t c = 0; c < out_c; c++) {
+      T* plane = output + (n * out_c + c) * out_plane;
+      if (bias != nullptr) {
+        const T b = bias[c];
+        for (size_t i = 0; i < out_plane; i++) plane[i] += b;
+      }
+      if (args->relu) {
+        for (size_t i = 0; i < out_plane; i++)
+          plane[i] = std::max(plane[i], T(0));
+      }
+    }
+  }
+  if (args->num_epilogue_steps > 0)
+    cpu_elementwise_chain<T>(
+        args->epilogue, args->num_epilogue_steps, output, nullptr, output,
+        batch * out_c * out_plane);
+}
+
+template <typename T>
+static std::vector<float>
+convert_to_float(const T* data, size_t volume)
+{
+  std::vector<float> result(volume);
+  for (size_t i = 0; i < volume; i++) result[i] = static_cast<float>(data[i]);
+  return result;
+}
+
 /*static*/ void
 Conv2D::forward_cpu(
     const Task* task, const std::vector<PhysicalRegion>& regions, Context ctx,
     Runtime* runtime)
 {
-  // TODO: implement this
-  assert(false);
+  assert(task->local_arglen == sizeof(Conv2DArgs));
+  const Conv2DArgs* args = (const Conv2DArgs*)task->local_args;
+  assert(regions.size() == (3 + int(args->use_bias)));
+  assert(task->regions.size() == (3 + int(args->use_bias)));
+
+  const void* input_ptr = TensorAccessor<LEGION_READ_ONLY, 4>::access(
+      args->input_datatype, args->input_bounds, regions[0]);
+  void* output_ptr = TensorAccessor<LEGION_WRITE_DISCARD, 4>::access(
+      args->output_datatype, args->local_bounds, regions[1]);
+  const void* filter_ptr = TensorAccessor<LEGION_READ_ONLY, 4>::access(
+      args->filter_datatype, args->filter_bounds, regions[2]);
+  const void* bias_ptr = NULL;
+  if (args->use_bias)
+    bias_ptr = TensorAccessor<LEGION_READ_ONLY, 1>::access(
+        args->bias_datatype, args->bias_bounds, regions[3]);
+  assert(args->input_datatype == args->output_datatype);
+  assert(args->filter_datatype == args->output_datatype);
+  switch (args->output_datatype) {
+    case DT_HALF: {
+      // No host arithmetic for half precision so compute in float
+      const std::vector<float> input = convert_to_float(
+          (const __half*)input_ptr, args->input_bounds.volume());
+      const std::vector<float> filter = convert_to_float(
+          (const __half*)filter_ptr, args->filter_bounds.volume());
+      std::vector<float> bias;
+      if (args->use_bias)
+        bias = convert_to_float(
+            (const __half*)bias_ptr, args->bias_bounds.volume());
+      std::vector<float> output(args->local_bounds.volume());
+      conv2d_forward_cpu<float>(
+          args, input.data(), output.data(), filter.data(),
+          args->use_bias ? bias.data() : nullptr);
+      __half* output_half = (__half*)output_ptr;
+      for (size_t i = 0; i < output.size(); i++)
+        output_half[i] = __half(output[i]);
+      break;
+    }
+    case DT_FLOAT: {
+      conv2d_forward_cpu<float>(
+          args, (const float*)input_ptr, (float*)output_ptr,
+          (const float*)filter_ptr, (const float*)bias_ptr);
+      break;
+    }
+    case DT_DOUBLE: {
+      conv2d_forward_cpu<double>(
+          args, (const double*)input_ptr, (double*)output_ptr,
+          (const double*)filter_ptr, (const double*)bias_ptr);
+      break;
+    }
+    default:
+      abort();
+  }
 }
 
 #ifdef LEGION_USE_CUDA
@@ -16,6 +16,7 @@
 #ifndef __LEGION_TRITON_CONV2D_H__
 #define __LEGION_TRITON_CONV2D_H__
 
+#include "cpu_kernels.h"
 #include "operator.h"
 #include "tensor.h"
 #ifdef LEGION_USE_CUDA
@@ -47,7 +48,15 @@ struct Conv2DArgs : public OperatorArgs {
 #endif
   Legion::Rect<4> input_bounds;
   Legion::Rect<4> local_bounds;
+  Legion::Rect<4> filter_bounds;
   Legion::Rect<1> bias_bounds;
+  // Convolution geometry for the CPU variant; the GPU variant keeps
+  // it in the cuDNN descriptors
+  size_t kernel_h, kernel_w, stride_h, stride_w, groups;
+  Legion::coord_t pad_h, pad_w;
+  // Elementwise operators fused onto the output by the CPU variant
+  CpuElementwiseStep epilogue[MAX_FUSED_STEPS];
+  unsigned num_epilogue_steps;
   DataType input_datatype;
   DataType output_datatype;
   DataType filter_datatype;
@@ -110,10 +119,12 @@ class Conv2D : public Operator {
       const void* filter_ptr, const void* bias_ptr);
 #endif
  public:
-  const ActivationMode activation;
+  // Not const since layer fusion can fold a following ReLU into it
+  ActivationMode activation;
   const size_t in_channels, out_channels, kernel_h, kernel_w;
   const size_t stride_h, stride_w, padding_h, padding_w, groups;
   const bool use_bias;
+  std::vector<CpuElementwiseStep> epilogue;
 
  protected:
   Legion::DomainTransform input_transform;
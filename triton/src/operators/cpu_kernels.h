@@ -0,0 +1,381 @@
+/* Copyright 2022 NVIDIA CORPORATION
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LEGION_TRITON_CPU_KERNELS_H__
+#define __LEGION_TRITON_CPU_KERNELS_H__
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdlib>
+#include <limits>
+#include <vector>
+
+#include "types.h"
+
+// Host kernels shared by the LOC_PROC task variants of the operators.
+// They only depend on the standard library and types.h so that they can be
+// unit tested without a Legion runtime. The loops are written with
+// unit-stride inner loops so that the compiler vectorizes them; parallelism
+// across cores comes from the index launches, which place one point task
+// on each CPU processor in the layer strategy.
+
+namespace triton { namespace backend { namespace legion {
+
+// Row-major C[m][n] = A[m][k] * B[k][n]. B is walked in panels of
+// GEMM_KC x GEMM_NC so that a panel stays in cache while it is reused
+// for every row of A, and four rows of C are updated per pass over the
+// panel so that each loaded element of B feeds four multiply-adds.
+constexpr size_t GEMM_KC = 128;
+constexpr size_t GEMM_NC = 256;
+
+template <typename T>
+void
+cpu_gemm(
+    size_t m, size_t n, size_t k, const T* A, size_t lda, const T* B,
+    size_t ldb, T* C, size_t ldc)
+{
+  for (size_t i = 0; i < m; i++) std::fill(C + i * ldc, C + i * ldc + n, T(0));
+  for (size_t j0 = 0; j0 < n; j0 += GEMM_NC) {
+    const size_t nc = std::min(GEMM_NC, n - j0);
+    for (size_t p0 = 0; p0 < k; p0 += GEMM_KC) {
+      const size_t kc = std::min(GEMM_KC, k - p0);
+      size_t i = 0;
+      for (; (i + 4) <= m; i += 4) {
+        T* __restrict__ c0 = C + i * ldc + j0;
+        T* __restrict__ c1 = c0 + ldc;
+        T* __restrict__ c2 = c1 + ldc;
+        T* __restrict__ c3 = c2 + ldc;
+        for (size_t p = p0; p < (p0 + kc); p++) {
+          const T a0 = A[i * lda + p];
+          const T a1 = A[(i + 1) * lda + p];
+          const T a2 = A[(i + 2) * lda + p];
+          const T a3 = A[(i + 3) * lda + p];
+          const T* __restrict__ b = B + p * ldb + j0;
+          for (size_t j = 0; j < nc; j++) {
+            const T bj = b[j];
+            c0[j] += a0 * bj;
+            c1[j] += a1 * bj;
+            c2[j] += a2 * bj;
+            c3[j] += a3 * bj;
+          }
+        }
+      }
+      for (; i < m; i++) {
+        T* __restrict__ c = C + i * ldc + j0;
+        for (size_t p = p0; p < (p0 + kc); p++) {
+          const T a = A[i * lda + p];
+          const T* __restrict__ b = B + p * ldb + j0;
+          for (size_t j = 0; j < nc; j++) c[j] += a * b[j];
+        }
+      }
+    }
+  }
+}
+
+// Geometry of one 2-D tile of a convolution or pooling. The input and
+// output tiles are given with their global offsets so that halo regions
+// and zero padding can be told apart.
+struct CpuWindow {
+  size_t in_h, in_w;    // extent of the local input tile
+  long in_h0, in_w0;    // global coordinate of the first input row/column
+  size_t out_h, out_w;  // extent of the local output tile
+  long out_h0, out_w0;  // global coordinate of the first output row/column
+  size_t kernel_h, kernel_w;
+  size_t stride_h, stride_w;
+  long pad_h, pad_w;
+};
+
+// Unfold `channels` planes of the input tile into
+// col[(c * kernel_h + kh) * kernel_w + kw][oh * out_w + ow] so that the
+// convolution becomes a single GEMM against the filter matrix.
+template <typename T>
+void
+cpu_im2col(const T* input, size_t channels, const CpuWindow& w, T* col)
+{
+  const size_t plane = w.out_h * w.out_w;
+  for (size_t c = 0; c < channels; c++) {
+    const T* in_plane = input + c * w.in_h * w.in_w;
+    for (size_t kh = 0; kh < w.kernel_h; kh++) {
+      for (size_t kw = 0; kw < w.kernel_w; kw++) {
+        T* __restrict__ dst =
+            col + ((c * w.kernel_h + kh) * w.kernel_w + kw) * plane;
+        for (size_t oh = 0; oh < w.out_h; oh++) {
+          const long ih = (w.out_h0 + long(oh)) * long(w.stride_h) - w.pad_h +
+                          long(kh) - w.in_h0;
+          T* __restrict__ row = dst + oh * w.out_w;
+          if ((ih < 0) || (ih >= long(w.in_h))) {
+            std::fill(row, row + w.out_w, T(0));
+            continue;
+          }
+          const T* src = in_plane + ih * w.in_w;
+          for (size_t ow = 0; ow < w.out_w; ow++) {
+            const long iw = (w.out_w0 + long(ow)) * long(w.stride_w) -
+                            w.pad_w + long(kw) - w.in_w0;
+            row[ow] = ((iw < 0) || (iw >= long(w.in_w))) ? T(0) : src[iw];
+          }
+        }
+      }
+    }
+  }
+}
+
+// Max or average pooling over `planes` independent planes. Averages exclude
+// the padding, matching ONNX's default count_include_pad=0; positions that
+// fall in the padding are recognized from the global image extent.
+template <typename T>
+void
+cpu_pool2d(
+    const T* input, T* output, size_t planes, const CpuWindow& w,
+    long image_h, long image_w, bool max_pool)
+{
+  for (size_t p = 0; p < planes; p++) {
+    const T* in_plane = input + p * w.in_h * w.in_w;
+    T* out_plane = output + p * w.out_h * w.out_w;
+    for (size_t oh = 0; oh < w.out_h; oh++) {
+      const long gh = (w.out_h0 + long(oh)) * long(w.stride_h) - w.pad_h;
+      const long h_lo = std::max(gh, std::max(w.in_h0, 0L));
+      const long h_hi = std::min(
+          gh + long(w.kernel_h), std::min(w.in_h0 + long(w.in_h), image_h));
+      for (size_t ow = 0; ow < w.out_w; ow++) {
+        const long gw = (w.out_w0 + long(ow)) * long(w.stride_w) - w.pad_w;
+        const long w_lo = std::max(gw, std::max(w.in_w0, 0L));
+        const long w_hi = std::min(
+            gw + long(w.kernel_w), std::min(w.in_w0 + long(w.in_w), image_w));
+        T acc = max_pool ? -std::numeric_limits<T>::infinity() : T(0);
+        for (long h = h_lo; h < h_hi; h++) {
+          const T* row = in_plane + (h - w.in_h0) * w.in_w;
+          for (long x = w_lo - w.in_w0; x < (w_hi - w.in_w0); x++)
+            acc = max_pool ? std::max(acc, row[x]) : acc + row[x];
+        }
+        if (!max_pool) {
+          const long count = (h_hi - h_lo) * (w_hi - w_lo);
+          acc = (count > 0) ? acc / T(count) : T(0);
+        }
+        out_plane[oh * w.out_w + ow] = acc;
+      }
+    }
+  }
+}
+
+// Softmax along the middle axis of a [outer][len][inner] tensor, computed
+// with the maximum subtracted for numerical stability
+template <typename T>
+void
+cpu_softmax(const T* input, T* output, size_t outer, size_t len, size_t inner)
+{
+  if (inner == 1) {
+    for (size_t o = 0; o < outer; o++) {
+      const T* __restrict__ in = input + o * len;
+      T* __restrict__ out = output + o * len;
+      T max_value = in[0];
+      for (size_t l = 1; l < len; l++) max_value = std::max(max_value, in[l]);
+      T sum = 0;
+      for (size_t l = 0; l < len; l++) {
+        out[l] = std::exp(in[l] - max_value);
+        sum += out[l];
+      }
+      const T scale = T(1) / sum;
+      for (size_t l = 0; l < len; l++) out[l] *= scale;
+    }
+    return;
+  }
+  // Keep the innermost loop unit-stride by reducing a whole row of `inner`
+  // columns at a time
+  std::vector<T> max_values(inner), sums(inner);
+  for (size_t o = 0; o < outer; o++) {
+    const T* in = input + o * len * inner;
+    T* out = output + o * len * inner;
+    std::copy(in, in + inner, max_values.begin());
+    for (size_t l = 1; l < len; l++)
+      for (size_t i = 0; i < inner; i++)
+        max_values[i] = std::max(max_values[i], in[l * inner + i]);
+    std::fill(sums.begin(), sums.end(), T(0));
+    for (size_t l = 0; l < len; l++) {
+      for (size_t i = 0; i < inner; i++) {
+        out[l * inner + i] = std::exp(in[l * inner + i] - max_values[i]);
+        sums[i] += out[l * inner + i];
+      }
+    }
+    for (size_t i = 0; i < inner; i++) sums[i] = T(1) / sums[i];
+    for (size_t l = 0; l < len; l++)
+      for (size_t i = 0; i < inner; i++) out[l * inner + i] *= sums[i];
+  }
+}
+
+// Elementwise unary operators, one loop per operator so that each inner
+// loop vectorizes. `input` and `output` may be the same buffer.
+template <typename T>
+void
+cpu_unary(
+    OperatorType op_type, T scalar, const T* input, T* output,
+    size_t num_elements)
+{
+  switch (op_type) {
+    case OP_EXP: {
+      for (size_t i = 0; i < num_elements; i++) output[i] = std::exp(input[i]);
+      break;
+    }
+    case OP_LOG: {
+      for (size_t i = 0; i < num_elements; i++) output[i] = std::log(input[i]);
+      break;
+    }
+    case OP_SQRT: {
+      for (size_t i = 0; i < num_elements; i++)
+        output[i] = std::sqrt(input[i]);
+      break;
+    }
+    case OP_IDENTITY: {
+      if (input != output)
+        std::copy(input, input + num_elements, output);
+      break;
+    }
+    case OP_SCALAR_MULTIPLY: {
+      for (size_t i = 0; i < num_elements; i++) output[i] = input[i] * scalar;
+      break;
+    }
+    case OP_SCALAR_ADD: {
+      for (size_t i = 0; i < num_elements; i++) output[i] = input[i] + scalar;
+      break;
+    }
+    case OP_SCALAR_SUB: {
+      for (size_t i = 0; i < num_elements; i++) output[i] = input[i] - scalar;
+      break;
+    }
+    case OP_SCALAR_TRUE_DIV: {
+      for (size_t i = 0; i < num_elements; i++) output[i] = input[i] / scalar;
+      break;
+    }
+    case OP_GELU: {
+      for (size_t i = 0; i < num_elements; i++)
+        output[i] = input[i] * T(0.5) * std::erfc(-input[i] * T(M_SQRT1_2));
+      break;
+    }
+    case OP_RECIPROCAL: {
+      for (size_t i = 0; i < num_elements; i++) output[i] = T(1) / input[i];
+      break;
+    }
+    case OP_RELU: {
+      for (size_t i = 0; i < num_elements; i++)
+        output[i] = std::max(input[i], T(0));
+      break;
+    }
+    case OP_SIGMOID: {
+      for (size_t i = 0; i < num_elements; i++)
+        output[i] = T(1) / (T(1) + std::exp(-input[i]));
+      break;
+    }
+    case OP_TANH: {
+      for (size_t i = 0; i < num_elements; i++)
+        output[i] = std::tanh(input[i]);
+      break;
+    }
+    case OP_ELU: {
+      // alpha = 1 as in the cuDNN activation descriptor
+      for (size_t i = 0; i < num_elements; i++)
+        output[i] = (input[i] > T(0)) ? input[i] : std::expm1(input[i]);
+      break;
+    }
+    default:
+      abort();
+  }
+}
+
+// Elementwise binary operators on operands of the same shape. `output`
+// may be the same buffer as either input.
+template <typename T>
+void
+cpu_binary(
+    OperatorType op_type, const T* input0, const T* input1, T* output,
+    size_t num_elements)
+{
+  switch (op_type) {
+    case OP_EW_ADD: {
+      for (size_t i = 0; i < num_elements; i++)
+        output[i] = input0[i] + input1[i];
+      break;
+    }
+    case OP_EW_SUB: {
+      for (size_t i = 0; i < num_elements; i++)
+        output[i] = input0[i] - input1[i];
+      break;
+    }
+    case OP_EW_MUL: {
+      for (size_t i = 0; i < num_elements; i++)
+        output[i] = input0[i] * input1[i];
+      break;
+    }
+    case OP_EW_DIV: {
+      for (size_t i = 0; i < num_elements; i++)
+        output[i] = input0[i] / input1[i];
+      break;
+    }
+    default:
+      abort();
+  }
+}
+
+// One step of a fused elementwise chain. Unary steps apply `op_type` with
+// `scalar` to the running value; binary steps combine the running value
+// with input `input` of the fused operation, as the left operand unless
+// `swap` is set.
+struct CpuElementwiseStep {
+  OperatorType op_type;
+  int input;  // -1 for unary steps
+  bool swap;
+  double scalar;
+};
+
+constexpr unsigned MAX_FUSED_STEPS = 8;
+// Elements per block of a fused chain, small enough to stay in L1
+constexpr size_t FUSED_BLOCK_SIZE = 512;
+
+// Run a chain of elementwise steps on `head`, reading each tensor once and
+// writing `output` once instead of materializing every intermediate. The
+// steps are computed in TC, which lets half precision data be processed
+// in float. `output` may be the same buffer as `head`.
+template <typename T, typename TC = T>
+void
+cpu_elementwise_chain(
+    const CpuElementwiseStep* steps, unsigned num_steps, const T* head,
+    const T* const* inputs, T* output, size_t num_elements)
+{
+  TC buffer[FUSED_BLOCK_SIZE], operand[FUSED_BLOCK_SIZE];
+  for (size_t offset = 0; offset < num_elements; offset += FUSED_BLOCK_SIZE) {
+    const size_t count = std::min(FUSED_BLOCK_SIZE, num_elements - offset);
+    for (size_t i = 0; i < count; i++)
+      buffer[i] = static_cast<TC>(head[offset + i]);
+    for (unsigned s = 0; s < num_steps; s++) {
+      const CpuElementwiseStep& step = steps[s];
+      if (step.input < 0) {
+        cpu_unary<TC>(
+            step.op_type, static_cast<TC>(step.scalar), buffer, buffer, count);
+        continue;
+      }
+      const T* other = inputs[step.input] + offset;
+      for (size_t i = 0; i < count; i++) operand[i] = static_cast<TC>(other[i]);
+      if (step.swap)
+        cpu_binary<TC>(step.op_type, operand, buffer, buffer, count);
+      else
+        cpu_binary<TC>(step.op_type, buffer, operand, buffer, count);
+    }
+    for (size_t i = 0; i < count; i++)
+      output[offset + i] = static_cast<T>(buffer[i]);
+  }
+}
+
+}}}  // namespace triton::backend::legion
+
+#endif  // __LEGION_TRITON_CPU_KERNELS_H__
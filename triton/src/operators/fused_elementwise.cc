@@ -0,0 +1,343 @@
+/* Copyright 2022 NVIDIA CORPORATION
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "fused_elementwise.h"
+#include "binary.h"
+#include "unary.h"
+
+using namespace Legion;
+
+namespace triton { namespace backend { namespace legion {
+
+FusedElementwiseArgs::FusedElementwiseArgs(void) {}
+
+static bool
+IsBinaryStep(OperatorType op_type)
+{
+  switch (op_type) {
+    case OP_EW_ADD:
+    case OP_EW_SUB:
+    case OP_EW_MUL:
+    case OP_EW_DIV:
+      return true;
+    default:
+      break;
+  }
+  return false;
+}
+
+FusedElementwise::FusedElementwise(
+    LegionModelState* model, const LayerStrategy* strategy,
+    const std::vector<Operator*>& chain, const char* name)
+    : Operator(model, strategy, OP_FUSED, name, CountInputs(chain), 0, 1),
+      datatype(chain.back()->output_tensors()[0]->type)
+{
+  assert(!chain.empty() && (chain.size() <= MAX_FUSED_STEPS));
+  Operator* head = chain.front();
+  assert(IsFusible(head));
+  inputs = head->input_tensors();
+  if (IsBinaryStep(head->op_type)) {
+    CpuElementwiseStep step;
+    step.op_type = head->op_type;
+    step.input = 1;
+    step.swap = false;
+    step.scalar = 0.0;
+    steps.push_back(step);
+  } else {
+    steps.push_back(UnaryStep(head));
+  }
+  for (unsigned idx = 1; idx < chain.size(); idx++) {
+    Operator* op = chain[idx];
+    assert(IsFusible(op));
+    const Tensor* value = chain[idx - 1]->output_tensors()[0];
+    const std::vector<Tensor*>& op_inputs = op->input_tensors();
+    if (op_inputs.size() == 1) {
+      assert(op_inputs[0] == value);
+      steps.push_back(UnaryStep(op));
+      continue;
+    }
+    assert(op_inputs.size() == 2);
+    // The running value is the left operand unless it is the right one
+    const bool swap = (op_inputs[1] == value);
+    assert(swap || (op_inputs[0] == value));
+    Tensor* other = op_inputs[swap ? 0 : 1];
+    assert(other != value);
+    CpuElementwiseStep step;
+    step.op_type = op->op_type;
+    step.input = inputs.size();
+    step.swap = swap;
+    step.scalar = 0.0;
+    inputs.push_back(other);
+    steps.push_back(step);
+  }
+  assert(inputs.size() == num_inputs);
+  // The output of the last operator in the chain is now ours; the
+  // intermediate tensors are deleted along with the fused operators
+  AdoptOutputs(chain.back());
+}
+
+/*static*/ unsigned
+FusedElementwise::CountInputs(const std::vector<Operator*>& chain)
+{
+  unsigned result = chain.front()->input_tensors().size();
+  for (unsigned idx = 1; idx < chain.size(); idx++)
+    if (chain[idx]->input_tensors().size() == 2)
+      result++;
+  return result;
+}
+
+/*static*/ bool
+FusedElementwise::IsFusible(const Operator* op)
+{
+  const std::vector<Tensor*>& op_outputs = op->output_tensors();
+  if (op_outputs.size() != 1)
+    return false;
+  const DataType type = op_outputs[0]->type;
+  if ((type != DT_HALF) && (type != DT_FLOAT) && (type != DT_DOUBLE))
+    return false;
+  const UnaryOperator* unary = dynamic_cast<const UnaryOperator*>(op);
+  if (unary != nullptr) {
+    if (unary->inplace)
+      return false;
+    switch (op->op_type) {
+      case OP_CAST:
+        // Only casts to the same type, which are identities
+        return (op->input_tensors()[0]->type == type);
+      case OP_EXP:
+      case OP_LOG:
+      case OP_SQRT:
+      case OP_IDENTITY:
+      case OP_SCALAR_MULTIPLY:
+      case OP_SCALAR_ADD:
+      case OP_SCALAR_SUB:
+      case OP_SCALAR_TRUE_DIV:
+      case OP_GELU:
+      case OP_RECIPROCAL:
+      case OP_RELU:
+      case OP_SIGMOID:
+      case OP_TANH:
+      case OP_ELU:
+        return true;
+      default:
+        return false;
+    }
+  }
+  const BinaryOperator* binary = dynamic_cast<const BinaryOperator*>(op);
+  if (binary != nullptr)
+    return !binary->inplace && IsBinaryStep(op->op_type);
+  return false;
+}
+
+/*static*/ CpuElementwiseStep
+FusedElementwise::UnaryStep(const Operator* op)
+{
+  const UnaryOperator* unary = dynamic_cast<const UnaryOperator*>(op);
+  assert(unary != nullptr);
+  CpuElementwiseStep step;
+  step.op_type = (op->op_type == OP_CAST) ? OP_IDENTITY : op->op_type;
+  step.input = -1;
+  step.swap = false;
+  switch (unary->scalar_type) {
+    case DT_HALF: {
+      step.scalar = static_cast<float>(unary->scalar.half_value);
+      break;
+    }
+    case DT_FLOAT: {
+      step.scalar = unary->scalar.float_value;
+      break;
+    }
+    case DT_DOUBLE: {
+      step.scalar = unary->scalar.double_value;
+      break;
+    }
+    default:
+      step.scalar = 0.0;
+  }
+  return step;
+}
+
+Domain
+FusedElementwise::GetBounds(Processor proc)
+{
+  const size_t dims = outputs[0]->bounds.size();
+  DomainPoint lo, hi;
+  lo.dim = dims;
+  hi.dim = dims;
+  for (int d = 0; d < dims; d++) {
+    lo[d] = 0;
+    hi[d] = outputs[0]->bounds[d] - 1;
+  }
+  const Domain global(lo, hi);
+  return strategy->find_local_domain(proc, global);
+}
+
+void
+FusedElementwise::Load(Realm::Processor proc)
+{
+  assert(proc.kind() == strategy->kind);
+  // If this processor is not used for this layer there is nothing to do
+  if (!strategy->is_local_processor(proc))
+    return;
+  // Chains are only formed for layers mapped onto CPUs
+  assert(proc.kind() == Processor::LOC_PROC);
+  const unsigned local_index = strategy->find_local_offset(proc);
+  FusedElementwiseArgs& proc_args = args[local_index];
+  proc_args.owner = this;
+  proc_args.bounds = GetBounds(proc);
+  proc_args.datatype = datatype;
+  proc_args.num_inputs = inputs.size();
+  proc_args.num_steps = steps.size();
+  for (unsigned idx = 0; idx < steps.size(); idx++)
+    proc_args.steps[idx] = steps[idx];
+}
+
+void
+FusedElementwise::initialize(
+    LegionModelInstance* instance, const unsigned instance_index,
+    Legion::Runtime* runtime, Legion::Context ctx, Legion::MapperID mapper)
+{
+  const Domain launch_domain = strategy->get_launch_domain();
+  // Find or create the launch space domain
+  IndexSpace launch_space = instance->find_or_create_index_space(launch_domain);
+  // Also get the sharding function from the strategy
+  ShardingFunction* shardfn = strategy->sharding_function;
+  // Construct a future map for the pass-by-value arguments
+  std::map<DomainPoint, TaskArgument> values;
+  for (Domain::DomainPointIterator itr(launch_domain); itr; itr++) {
+    const Processor proc = shardfn->find_proc(itr.p, launch_domain);
+    if (!strategy->is_local_processor(proc))
+      continue;
+    const unsigned local_index = strategy->find_local_offset(proc);
+    values[itr.p] =
+        TaskArgument(args + local_index, sizeof(FusedElementwiseArgs));
+  }
+  argmaps[instance_index] = runtime->construct_future_map(
+      ctx, launch_space, values, true /*collective*/, shardfn->sharding_id);
+
+  IndexTaskLauncher& launcher = launchers[instance_index];
+  launcher = IndexTaskLauncher(
+      FUSED_ELEMENTWISE_TASK_ID, launch_space, TaskArgument(NULL, 0),
+      ArgumentMap(argmaps[instance_index]), Predicate::TRUE_PRED,
+      false /*must*/, mapper, strategy->tag);
+  // Create a logical region for the output data
+  assert(outputs.size() == 1);
+  LogicalRegion output_region = instance->create_tensor_region(outputs[0]);
+  LogicalPartition output_part =
+      instance->find_or_create_tiled_partition(outputs[0], strategy);
+  launcher.add_region_requirement(RegionRequirement(
+      output_part, 0 /*projection id*/, LEGION_WRITE_DISCARD, LEGION_EXCLUSIVE,
+      output_region));
+  launcher.add_field(0, FID_DATA);
+  for (unsigned idx = 0; idx < inputs.size(); idx++) {
+    LogicalRegion input_region = inputs[idx]->region[instance_index];
+    LogicalPartition input_part =
+        instance->find_or_create_tiled_partition(inputs[idx], strategy);
+    launcher.add_region_requirement(RegionRequirement(
+        input_part, 0 /*projection id*/, LEGION_READ_ONLY, LEGION_EXCLUSIVE,
+        input_region));
+    launcher.add_field(idx + 1, FID_DATA);
+  }
+}
+
+void
+FusedElementwise::forward(
+    LegionModelInstance* instance, const unsigned instance_index,
+    Legion::Runtime* runtime, Legion::Context ctx, Legion::MapperID mapper)
+{
+  runtime->execute_index_space(ctx, launchers[instance_index]);
+}
+
+void
+FusedElementwise::finalize(
+    LegionModelInstance* instance, const unsigned instance_index,
+    Legion::Runtime* runtime, Legion::Context ctx, Legion::MapperID mapper)
+{
+  argmaps[instance_index] = FutureMap();
+}
+
+void
+FusedElementwise::Free(Realm::Processor proc)
+{
+  assert(proc.kind() == strategy->kind);
+}
+
+/*static*/ void
+FusedElementwise::PreregisterTaskVariants(void)
+{
+  {
+    TaskVariantRegistrar cpu_registrar(
+        FUSED_ELEMENTWISE_TASK_ID, "Fused Elementwise CPU");
+    cpu_registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    cpu_registrar.set_leaf();
+    Runtime::preregister_task_variant<forward_cpu>(
+        cpu_registrar, "Fused Elementwise Operator");
+  }
+}
+
+/*static*/ void
+FusedElementwise::forward_cpu(
+    const Task* task, const std::vector<PhysicalRegion>& regions, Context ctx,
+    Runtime* runtime)
+{
+  assert(task->local_arglen == sizeof(FusedElementwiseArgs));
+  const FusedElementwiseArgs* args =
+      (const FusedElementwiseArgs*)task->local_args;
+  assert(regions.size() == (1 + args->num_inputs));
+  assert(task->regions.size() == (1 + args->num_inputs));
+  void* output_ptr = nullptr;
+  const void* input_ptrs[MAX_FUSED_STEPS + 1];
+  size_t volume = 0;
+  switch (args->bounds.get_dim()) {
+#define DIMFUNC(DIM)                                                   \
+  case DIM: {                                                          \
+    const Rect<DIM> bounds = args->bounds;                             \
+    volume = bounds.volume();                                          \
+    output_ptr = TensorAccessor<LEGION_WRITE_DISCARD, DIM>::access(    \
+        args->datatype, bounds, regions[0]);                           \
+    for (unsigned idx = 0; idx < args->num_inputs; idx++)              \
+      input_ptrs[idx] = TensorAccessor<LEGION_READ_ONLY, DIM>::access( \
+          args->datatype, bounds, regions[idx + 1]);                   \
+    break;                                                             \
+  }
+    LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+    default:
+      abort();
+  }
+  switch (args->datatype) {
+    case DT_HALF: {
+      cpu_elementwise_chain<__half, float>(
+          args->steps, args->num_steps, (const __half*)input_ptrs[0],
+          (const __half* const*)input_ptrs, (__half*)output_ptr, volume);
+      break;
+    }
+    case DT_FLOAT: {
+      cpu_elementwise_chain<float>(
+          args->steps, args->num_steps, (const float*)input_ptrs[0],
+          (const float* const*)input_ptrs, (float*)output_ptr, volume);
+      break;
+    }
+    case DT_DOUBLE: {
+      cpu_elementwise_chain<double>(
+          args->steps, args->num_steps, (const double*)input_ptrs[0],
+          (const double* const*)input_ptrs, (double*)output_ptr, volume);
+      break;
+    }
+    default:
+      abort();
+  }
+}
+
+}}}  // namespace triton::backend::legion
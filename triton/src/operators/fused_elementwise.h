@@ -0,0 +1,91 @@
+/* Copyright 2022 NVIDIA CORPORATION
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __LEGION_TRITON_FUSED_ELEMENTWISE_H__
+#define __LEGION_TRITON_FUSED_ELEMENTWISE_H__
+
+#include "cpu_kernels.h"
+#include "operator.h"
+#include "tensor.h"
+
+namespace triton { namespace backend { namespace legion {
+
+struct FusedElementwiseArgs : public OperatorArgs {
+ public:
+  FusedElementwiseArgs(void);
+  Legion::Domain bounds;
+  DataType datatype;
+  unsigned num_inputs;
+  unsigned num_steps;
+  CpuElementwiseStep steps[MAX_FUSED_STEPS];
+};
+
+// A chain of unary and binary elementwise operators executed as a single
+// task, created by LegionModelState::FuseLayers. The first input feeds the
+// head of the chain and every binary operator after the head contributes
+// one more input.
+class FusedElementwise : public Operator {
+ public:
+  FusedElementwise(
+      LegionModelState* model, const LayerStrategy* strategy,
+      const std::vector<Operator*>& chain, const char* name);
+  virtual ~FusedElementwise(void) = default;
+
+  Legion::Domain GetBounds(Realm::Processor proc);
+
+  virtual void Load(Realm::Processor processor) override;
+  virtual void initialize(
+      LegionModelInstance* instance, const unsigned instance_index,
+      Legion::Runtime* runtime, Legion::Context ctx,
+      Legion::MapperID mapper) override;
+  virtual void forward(
+      LegionModelInstance* instance, const unsigned instance_index,
+      Legion::Runtime* runtime, Legion::Context ctx,
+      Legion::MapperID mapper) override;
+  virtual void finalize(
+      LegionModelInstance* instance, const unsigned instance_index,
+      Legion::Runtime* runtime, Legion::Context ctx,
+      Legion::MapperID mapper) override;
+  virtual void Free(Realm::Processor processor) override;
+
+ public:
+  // Whether the operator can be a step of a fused chain
+  static bool IsFusible(const Operator* op);
+  // The step for a fusible unary operator, also used for the epilogues
+  // of Conv2D and MatMul
+  static CpuElementwiseStep UnaryStep(const Operator* op);
+
+  static void PreregisterTaskVariants(void);
+  static void forward_cpu(
+      const Legion::Task* task,
+      const std::vector<Legion::PhysicalRegion>& regions, Legion::Context ctx,
+      Legion::Runtime* runtime);
+
+ protected:
+  static unsigned CountInputs(const std::vector<Operator*>& chain);
+
+ public:
+  const DataType datatype;
+  std::vector<CpuElementwiseStep> steps;
+
+ protected:
+  FusedElementwiseArgs args[MAX_LOCAL_PROCS];
+  Legion::FutureMap argmaps[MAX_NUM_INSTANCES];
+  Legion::IndexTaskLauncher launchers[MAX_NUM_INSTANCES];
+};
+
+}}}  // namespace triton::backend::legion
+
+#endif  // __LEGION_TRITON_FUSED_ELEMENTWISE_H__
@@ -378,6 +378,10 @@ MatMul::Load(Processor proc)
   proc_args.in1_datatype = inputs[0]->type;
   proc_args.in2_datatype = inputs[1]->type;
   proc_args.out_datatype = outputs[0]->type;
+  assert(epilogue.size() <= MAX_FUSED_STEPS);
+  proc_args.num_epilogue_steps = epilogue.size();
+  for (unsigned idx = 0; idx < epilogue.size(); idx++)
+    proc_args.epilogue[idx] = epilogue[idx];
 #ifdef LEGION_USE_CUDA
   if (proc.kind() == Processor::TOC_PROC)
     proc_args.cublas = model->runtime_->cublas[local_index];
@@ -591,13 +595,164 @@ MatMul::PreregisterTaskVariants(void)
 #endif
 }
 
+static std::vector<size_t>
+domain_extents(const Domain& domain)
+{
+  std::vector<size_t> extents(domain.get_dim());
+  for (int d = 0; d < domain.get_dim(); d++)
+    extents[d] = domain.hi()[d] - domain.lo()[d] + 1;
+  return extents;
+}
+
+template <typename T>
+static void
+matmul_forward_cpu(
+    const MatMulArgs* args, const T* in1, const T* in2, T* out)
+{
+  const std::vector<size_t> in1_extents = domain_extents(args->in1_bounds);
+  const std::vector<size_t> in2_extents = domain_extents(args->in2_bounds);
+  const std::vector<size_t> out_extents = domain_extents(args->out_bounds);
+  const size_t in1_dims = in1_extents.size();
+  const size_t in2_dims = in2_extents.size();
+  // Following numpy, a 1-D left operand is a row vector and a 1-D right
+  // operand is a column vector, and neither adds a dimension to the output
+  const size_t m = (in1_dims == 1) ? 1 : in1_extents[in1_dims - 2];
+  const size_t k = in1_extents[in1_dims - 1];
+  const size_t n = (in2_dims == 1) ? 1 : in2_extents[in2_dims - 1];
+  assert(k == ((in2_dims == 1) ? in2_extents[0] : in2_extents[in2_dims - 2]));
+  const size_t batch_dims = out_extents.size() - ((in1_dims == 1) ? 0 : 1) -
+                            ((in2_dims == 1) ? 0 : 1);
+  const size_t in1_batch_dims = (in1_dims > 2) ? (in1_dims - 2) : 0;
+  const size_t in2_batch_dims = (in2_dims > 2) ? (in2_dims - 2) : 0;
+  assert(in1_batch_dims <= batch_dims);
+  assert(in2_batch_dims <= batch_dims);
+  size_t batch_count = 1;
+  for (size_t d = 0; d < batch_dims; d++) batch_count *= out_extents[d];
+  // Walk the output batches in row-major order and map each one to the
+  // input batches, which are aligned to the right and broadcast along
+  // any dimension of extent one
+  std::vector<size_t> index(batch_dims, 0);
+  for (size_t b = 0; b < batch_count; b++) {
+    size_t in1_batch = 0, in2_batch = 0;
+    for (size_t d = 0; d < in1_batch_dims; d++) {
+      const size_t extent = in1_extents[d];
+      const size_t coord = index[batch_dims - in1_batch_dims + d];
+      in1_batch = in1_batch * extent + ((extent == 1) ? 0 : coord);
+    }
+    for (size_t d = 0; d < in2_batch_dims; d++) {
+      const size_t extent = in2_extents[d];
+      const size_t coord = index[batch_dims - in2_batch_dims + d];
+      in2_batch = in2_batch * extent + ((extent == 1) ? 0 : coord);
+    }
+    cpu_gemm(
+        m, n, k, in1 + in1_batch * m * k, k, in2 + in2_batch * k * n, n,
+        out + b * m * n, n);
+    for (int d = int(batch_dims) - 1; d >= 0; d--) {
+      if (++index[d] < out_extents[d])
+        break;
+      index[d] = 0;
+    }
+  }
+  if (args->num_epilogue_steps > 0)
+    cpu_elementwise_chain<T>(
+        args->epilogue, args->num_epilogue_steps, out, nullptr, out,
+        batch_count * m * n);
+}
+
+template <typename T>
+static std::vector<float>
+convert_to_float(const T* data, size_t volume)
+{
+  std::vector<float> result(volume);
+  for (size_t i = 0; i < volume; i++) result[i] = static_cast<float>(data[i]);
+  return result;
+}
+
 /*static*/ void
 MatMul::forward_cpu(
     const Task* task, const std::vector<PhysicalRegion>& regions, Context ctx,
     Runtime* runtime)
 {
-  // TODO: implement this with OpenBLAS or something like it
-  abort();
+  assert(task->local_arglen == sizeof(MatMulArgs));
+  const MatMulArgs* args = (const MatMulArgs*)task->local_args;
+  assert(regions.size() == 3);
+  assert(task->regions.size() == 3);
+  void* out_ptr = nullptr;
+  const void *in1_ptr = nullptr, *in2_ptr = nullptr;
+  switch (args->out_bounds.get_dim()) {
+#define DIMFUNC(DIM)                                             \
+  case DIM: {                                                    \
+    const Rect<DIM> bounds = args->out_bounds;                   \
+    out_ptr = TensorAccessor<LEGION_WRITE_DISCARD, DIM>::access( \
+        args->out_datatype, bounds, regions[0]);                 \
+    break;                                                       \
+  }
+    LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+    default:
+      abort();
+  }
+  switch (args->in1_bounds.get_dim()) {
+#define DIMFUNC(DIM)                                         \
+  case DIM: {                                                \
+    const Rect<DIM> bounds = args->in1_bounds;               \
+    in1_ptr = TensorAccessor<LEGION_READ_ONLY, DIM>::access( \
+        args->in1_datatype, bounds, regions[1]);             \
+    break;                                                   \
+  }
+    LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+    default:
+      abort();
+  }
+  switch (args->in2_bounds.get_dim()) {
+#define DIMFUNC(DIM)                                         \
+  case DIM: {                                                \
+    const Rect<DIM> bounds = args->in2_bounds;               \
+    in2_ptr = TensorAccessor<LEGION_READ_ONLY, DIM>::access( \
+        args->in2_datatype, bounds, regions[2]);             \
+    break;                                                   \
+  }
+    LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+    default:
+      abort();
+  }
+  assert(args->in1_datatype == args->out_datatype);
+  assert(args->in2_datatype == args->out_datatype);
+  switch (args->out_datatype) {
+    case DT_HALF: {
+      // No host arithmetic for half precision so compute in float
+      const std::vector<float> in1 = convert_to_float(
+          (const __half*)in1_ptr, args->in1_bounds.get_volume());
+      const std::vector<float> in2 = convert_to_float(
+          (const __half*)in2_ptr, args->in2_bounds.get_volume());
+      std::vector<float> out(args->out_bounds.get_volume());
+      matmul_forward_cpu<float>(args, in1.data(), in2.data(), out.data());
+      __half* out_half = (__half*)out_ptr;
+      for (size_t i = 0; i < out.size(); i++) out_half[i] = __half(out[i]);
+      break;
+    }
+    case DT_FLOAT: {
+      matmul_forward_cpu<float>(
+          args, (const float*)in1_ptr, (const float*)in2_ptr, (float*)out_ptr);
+      break;
+    }
+    case DT_DOUBLE: {
+      matmul_forward_cpu<double>(
+          args, (const double*)in1_ptr, (const double*)in2_ptr,
+          (double*)out_ptr);
+      break;
+    }
+    case DT_INT32: {
+      matmul_forward_cpu<int32_t>(
+          args, (const int32_t*)in1_ptr, (const int32_t*)in2_ptr,
+          (int32_t*)out_ptr);
+      break;
+    }
+    default:
+      abort();
+  }
 }
 
 #ifdef LEGION_USE_CUDA
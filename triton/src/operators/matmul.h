@@ -16,6 +16,7 @@
 #ifndef __LEGION_TRITON_MATMUL_H__
 #define __LEGION_TRITON_MATMUL_H__
 
+#include "cpu_kernels.h"
 #include "operator.h"
 #include "tensor.h"
 
@@ -52,6 +53,9 @@ struct MatMulArgs : public OperatorArgs {
   MatMul* owner;
   Legion::Domain in1_bounds, in2_bounds, out_bounds;
   DataType in1_datatype, in2_datatype, out_datatype;
+  // Elementwise operators fused onto the output by the CPU variant
+  CpuElementwiseStep epilogue[MAX_FUSED_STEPS];
+  unsigned num_epilogue_steps;
 #ifdef LEGION_USE_CUDA
   cublasHandle_t cublas;
 #endif
@@ -122,6 +126,10 @@ class MatMul : public Operator {
   typedef std::tuple<unsigned, unsigned, unsigned> FunctorKey;
   typedef std::map<FunctorKey, MatMulProjectionFunctor*> FunctorTable;
   static FunctorTable in1_functors, in2_functors;
+
+ public:
+  // Elementwise operators fused onto the output by layer fusion
+  std::vector<CpuElementwiseStep> epilogue;
 };
 
 }}}  // namespace triton::backend::legion
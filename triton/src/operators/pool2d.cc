@@ -14,10 +14,12 @@
  */
 
 #include "pool2d.h"
+#include "cpu_kernels.h"
+
+using namespace Legion;
 
 namespace triton { namespace backend { namespace legion {
 
-// FIXME below are stub functions, need to fill in implementation
 Pool2D::Pool2D(
     LegionModelState* model, const LayerStrategy* strategy, int kernelH,
     int kernelW, int strideH, int strideW, int paddingH, int paddingW,
@@ -27,42 +29,277 @@ Pool2D::Pool2D(
       stride_h(strideH), stride_w(strideW), padding_h(paddingH),
       padding_w(paddingW)
 {
+  assert(strategy->nDims == 4);
 }
 
 Pool2D::~Pool2D() {}
+
 void
-Pool2D::Load(Realm::Processor processor)
+Pool2D::Configure(Tensor* input, Tensor* output)
 {
+  assert(input != nullptr);
+  assert(output != nullptr);
+  assert(input->bounds.size() == 4);
+  assert(output->bounds.size() == 4);
+  assert(input->type == output->type);
+  inputs.push_back(input);
+  outputs.push_back(output);
+  // Each output tile reads the input window under it: the batch and
+  // channel dimensions line up one to one, while along the height and
+  // width the window starts `stride` input rows per output row earlier
+  // and extends by the kernel less the padding
+  Point<4> tiles;
+  for (int i = 0; i < 4; i++)
+    tiles[i] = (output->bounds[i] + strategy->dim[i] - 1) / strategy->dim[i];
+  Transform<4, 4> transform;
+  for (int i = 0; i < 4; i++)
+    for (int j = 0; j < 4; j++) transform[i][j] = 0;
+  transform[0][0] = tiles[0];
+  transform[1][1] = tiles[1];
+  transform[2][2] = tiles[2] * stride_h;
+  transform[3][3] = tiles[3] * stride_w;
+  input_transform = transform;
+  Rect<4> extent;
+  for (int i = 0; i < 2; i++) {
+    extent.lo[i] = 0;
+    extent.hi[i] = tiles[i] - 1;
+  }
+  extent.lo[2] = -padding_h;
+  extent.hi[2] = (tiles[2] - 1) * stride_h + kernel_h - 1 - padding_h;
+  extent.lo[3] = -padding_w;
+  extent.hi[3] = (tiles[3] - 1) * stride_w + kernel_w - 1 - padding_w;
+  input_extent = extent;
 }
-void
-Pool2D::Free(Realm::Processor processor)
+
+Rect<4>
+Pool2D::GetInputBounds(Processor proc)
+{
+  const Point<4> point = strategy->find_local_point(proc);
+  const Transform<4, 4> transform = input_transform;
+  const Point<4> offset = transform * point;
+  const Rect<4> extent = input_extent;
+  const Rect<4> result(extent.lo + offset, extent.hi + offset);
+  Rect<4> bounds;
+  for (int d = 0; d < 4; d++) {
+    bounds.lo[d] = 0;
+    bounds.hi[d] = inputs[0]->bounds[d] - 1;
+  }
+  return result.intersection(bounds);
+}
+
+Rect<4>
+Pool2D::GetOutputBounds(Processor proc)
 {
+  DomainPoint lo, hi;
+  lo.dim = 4;
+  hi.dim = 4;
+  for (int d = 0; d < 4; d++) {
+    lo[d] = 0;
+    hi[d] = outputs[0]->bounds[d] - 1;
+  }
+  const Domain global(lo, hi);
+  const Rect<4> result = strategy->find_local_domain(proc, global);
+  return result;
 }
+
 void
-Pool2D::Configure(Tensor* input, Tensor* output)
+Pool2D::Load(Processor proc)
 {
+  assert(proc.kind() == strategy->kind);
+  // If this processor is not used for this layer there is nothing to do
+  if (!strategy->is_local_processor(proc))
+    return;
+  if (proc.kind() != Processor::LOC_PROC) {
+    fprintf(stderr, "TODO: support for GPU execution of pool2d operator");
+    abort();
+  }
+  const unsigned local_index = strategy->find_local_offset(proc);
+  Pool2DArgs& proc_args = args[local_index];
+  proc_args.owner = this;
+  proc_args.local_index = local_index;
+  proc_args.input_bounds = GetInputBounds(proc);
+  proc_args.local_bounds = GetOutputBounds(proc);
+  proc_args.datatype = outputs[0]->type;
+  proc_args.pool_type = pool_type;
+  proc_args.kernel_h = kernel_h;
+  proc_args.kernel_w = kernel_w;
+  proc_args.stride_h = stride_h;
+  proc_args.stride_w = stride_w;
+  proc_args.padding_h = padding_h;
+  proc_args.padding_w = padding_w;
+  proc_args.image_h = inputs[0]->bounds[2];
+  proc_args.image_w = inputs[0]->bounds[3];
+  proc_args.relu = (activation == AC_MODE_RELU);
 }
+
 void
 Pool2D::initialize(
     LegionModelInstance* instance, const unsigned instance_index,
-    Legion::Runtime* runtime, Legion::Context ctx, Legion::MapperID mapper)
+    Runtime* runtime, Context ctx, MapperID mapper)
 {
+  const Domain launch_domain = strategy->get_launch_domain();
+  // Find or create the launch space domain
+  IndexSpace launch_space = instance->find_or_create_index_space(launch_domain);
+  // Also get the sharding function from the strategy
+  ShardingFunction* shardfn = strategy->sharding_function;
+  // Construct a future map for the pass-by-value arguments
+  std::map<DomainPoint, TaskArgument> values;
+  for (Domain::DomainPointIterator itr(launch_domain); itr; itr++) {
+    const Processor proc = shardfn->find_proc(itr.p, launch_domain);
+    if (!strategy->is_local_processor(proc))
+      continue;
+    const unsigned local_index = strategy->find_local_offset(proc);
+    values[itr.p] = TaskArgument(args + local_index, sizeof(Pool2DArgs));
+  }
+  argmaps[instance_index] = runtime->construct_future_map(
+      ctx, launch_space, values, true /*collective*/, shardfn->sharding_id);
+
+  // Create a logical region for the output data
+  assert(outputs.size() == 1);
+  LogicalRegion output_region = instance->create_tensor_region(outputs[0]);
+
+  // Create an aliased partition of the input that includes the halo
+  // of each pooling window
+  assert(inputs.size() == 1);
+  assert(inputs[0]->region[instance_index].exists());
+  LogicalRegion input_region = inputs[0]->region[instance_index];
+  IndexPartition part = instance->find_or_create_partition(
+      input_region.get_index_space(), launch_space, input_transform,
+      input_extent, LEGION_COMPUTE_COMPLETE_KIND);
+  LogicalPartition input_part = runtime->get_logical_partition_by_tree(
+      ctx, part, input_region.get_field_space(), input_region.get_tree_id());
+  LogicalPartition output_part =
+      instance->find_or_create_tiled_partition(outputs[0], strategy);
+
+  IndexTaskLauncher& launcher = launchers[instance_index];
+  launcher = IndexTaskLauncher(
+      POOL2D_TASK_ID, launch_space, TaskArgument(NULL, 0),
+      ArgumentMap(argmaps[instance_index]), Predicate::TRUE_PRED,
+      false /*must*/, mapper, strategy->tag);
+  launcher.add_region_requirement(RegionRequirement(
+      input_part, 0 /*projection id*/, LEGION_READ_ONLY, LEGION_EXCLUSIVE,
+      input_region));
+  launcher.add_field(0, FID_DATA);
+  launcher.add_region_requirement(RegionRequirement(
+      output_part, 0 /*projection id*/, LEGION_WRITE_DISCARD, LEGION_EXCLUSIVE,
+      output_region));
+  launcher.add_field(1, FID_DATA);
 }
+
 void
 Pool2D::forward(
     LegionModelInstance* instance, const unsigned instance_index,
-    Legion::Runtime* runtime, Legion::Context ctx, Legion::MapperID mapper)
+    Runtime* runtime, Context ctx, MapperID mapper)
 {
+  runtime->execute_index_space(ctx, launchers[instance_index]);
 }
+
 void
 Pool2D::finalize(
     LegionModelInstance* instance, const unsigned instance_index,
-    Legion::Runtime* runtime, Legion::Context ctx, Legion::MapperID mapper)
+    Runtime* runtime, Context ctx, MapperID mapper)
+{
+  argmaps[instance_index] = FutureMap();
+}
+
+void
+Pool2D::Free(Processor proc)
+{
+  assert(proc.kind() == strategy->kind);
+}
+
+/*static*/ void
+Pool2D::PreregisterTaskVariants(void)
 {
+  {
+    TaskVariantRegistrar cpu_registrar(POOL2D_TASK_ID, "Pool2D CPU");
+    cpu_registrar.add_constraint(ProcessorConstraint(Processor::LOC_PROC));
+    cpu_registrar.set_leaf();
+    Runtime::preregister_task_variant<forward_cpu>(
+        cpu_registrar, "Pool2D Operator");
+  }
 }
+
+template <typename T>
+static void
+pool2d_forward_cpu(const Pool2DArgs* args, const T* input, T* output)
+{
+  const Rect<4>& in = args->input_bounds;
+  const Rect<4>& out = args->local_bounds;
+  CpuWindow window;
+  window.in_h = in.hi[2] - in.lo[2] + 1;
+  window.in_w = in.hi[3] - in.lo[3] + 1;
+  window.in_h0 = in.lo[2];
+  window.in_w0 = in.lo[3];
+  window.out_h = out.hi[2] - out.lo[2] + 1;
+  window.out_w = out.hi[3] - out.lo[3] + 1;
+  window.out_h0 = out.lo[2];
+  window.out_w0 = out.lo[3];
+  window.kernel_h = args->kernel_h;
+  window.kernel_w = args->kernel_w;
+  window.stride_h = args->stride_h;
+  window.stride_w = args->stride_w;
+  window.pad_h = args->padding_h;
+  window.pad_w = args->padding_w;
+  // Batch and channel planes are all independent
+  const size_t planes =
+      (out.hi[0] - out.lo[0] + 1) * (out.hi[1] - out.lo[1] + 1);
+  cpu_pool2d(
+      input, output, planes, window, args->image_h, args->image_w,
+      (args->pool_type == POOL_MAX));
+  if (args->relu) {
+    const size_t volume = out.volume();
+    for (size_t i = 0; i < volume; i++) output[i] = std::max(output[i], T(0));
+  }
+}
+
+/*static*/ void
+Pool2D::forward_cpu(
+    const Task* task, const std::vector<PhysicalRegion>& regions, Context ctx,
+    Runtime* runtime)
+{
+  assert(task->local_arglen == sizeof(Pool2DArgs));
+  const Pool2DArgs* args = (const Pool2DArgs*)task->local_args;
+  assert(regions.size() == 2);
+  assert(task->regions.size() == 2);
+  const void* input_ptr = TensorAccessor<LEGION_READ_ONLY, 4>::access(
+      args->datatype, args->input_bounds, regions[0]);
+  void* output_ptr = TensorAccessor<LEGION_WRITE_DISCARD, 4>::access(
+      args->datatype, args->local_bounds, regions[1]);
+  switch (args->datatype) {
+    case DT_HALF: {
+      // No host arithmetic for half precision so compute in float
+      const size_t input_volume = args->input_bounds.volume();
+      const size_t output_volume = args->local_bounds.volume();
+      std::vector<float> input(input_volume), output(output_volume);
+      const __half* input_half = (const __half*)input_ptr;
+      for (size_t i = 0; i < input_volume; i++)
+        input[i] = static_cast<float>(input_half[i]);
+      pool2d_forward_cpu<float>(args, input.data(), output.data());
+      __half* output_half = (__half*)output_ptr;
+      for (size_t i = 0; i < output_volume; i++)
+        output_half[i] = __half(output[i]);
+      break;
+    }
+    case DT_FLOAT: {
+      pool2d_forward_cpu<float>(
+          args, (const float*)input_ptr, (float*)output_ptr);
+      break;
+    }
+    case DT_DOUBLE: {
+      pool2d_forward_cpu<double>(
+          args, (const double*)input_ptr, (double*)output_ptr);
+      break;
+    }
+    default:
+      abort();
+  }
+}
+
 Pool2DArgs::Pool2DArgs(void) {}
 
 #ifdef LEGION_USE_CUDA
+// FIXME below are stub functions, need to fill in implementation
 Pool2DArgs
 Pool2D::initialize_gpu(
     const Legion::Task* task,
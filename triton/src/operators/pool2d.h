@@ -29,6 +29,15 @@ struct Pool2DArgs : public OperatorArgs {
   cudnnActivationDescriptor_t actiDesc;
   cudnnPoolingDescriptor_t poolDesc;
 #endif
+  Legion::Rect<4> input_bounds;
+  Legion::Rect<4> local_bounds;
+  DataType datatype;
+  PoolType pool_type;
+  int kernel_h, kernel_w, stride_h, stride_w, padding_h, padding_w;
+  // Global height and width of the input image so that padding can be
+  // told apart from the halo of neighboring tiles
+  Legion::coord_t image_h, image_w;
+  unsigned local_index;
   bool relu;
 };
 
@@ -41,6 +50,8 @@ class Pool2D : public Operator {
   virtual ~Pool2D(void);
 
   void Configure(Tensor* input, Tensor* output);
+  Legion::Rect<4> GetInputBounds(Realm::Processor proc);
+  Legion::Rect<4> GetOutputBounds(Realm::Processor proc);
 
   virtual void Load(Realm::Processor processor) override;
   virtual void initialize(
@@ -57,6 +68,12 @@ class Pool2D : public Operator {
       Legion::MapperID mapper) override;
   virtual void Free(Realm::Processor processor) override;
 
+ public:
+  static void PreregisterTaskVariants(void);
+  static void forward_cpu(
+      const Legion::Task* task,
+      const std::vector<Legion::PhysicalRegion>& regions, Legion::Context ctx,
+      Legion::Runtime* runtime);
 #ifdef LEGION_USE_CUDA
   static Pool2DArgs initialize_gpu(
       const Legion::Task* task,
@@ -73,6 +90,13 @@ class Pool2D : public Operator {
   const ActivationMode activation;
   const PoolType pool_type;
   const int kernel_h, kernel_w, stride_h, stride_w, padding_h, padding_w;
+
+ protected:
+  Legion::DomainTransform input_transform;
+  Legion::Domain input_extent;
+  Pool2DArgs args[MAX_LOCAL_PROCS];
+  Legion::FutureMap argmaps[MAX_NUM_INSTANCES];
+  Legion::IndexTaskLauncher launchers[MAX_NUM_INSTANCES];
 };
 
 }}}  // namespace triton::backend::legion
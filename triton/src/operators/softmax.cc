@@ -14,6 +14,7 @@
  */
 
 #include "softmax.h"
+#include "cpu_kernels.h"
 
 using namespace Legion;
 
@@ -297,8 +298,63 @@ Softmax::forward_cpu(
     const Task* task, const std::vector<PhysicalRegion>& regions, Context ctx,
     Runtime* runtime)
 {
-  // TODO: implement this
-  assert(false);
+  assert(task->local_arglen == sizeof(SoftmaxArgs));
+  const SoftmaxArgs* args = (const SoftmaxArgs*)task->local_args;
+  assert(regions.size() == 2);
+  assert(task->regions.size() == 2);
+  const void* input_ptr = nullptr;
+  void* output_ptr = nullptr;
+  switch (args->bounds.get_dim()) {
+#define DIMFUNC(DIM)                                                \
+  case DIM: {                                                       \
+    const Rect<DIM> bounds = args->bounds;                          \
+    input_ptr = TensorAccessor<LEGION_READ_ONLY, DIM>::access(      \
+        args->datatype, bounds, regions[0]);                        \
+    output_ptr = TensorAccessor<LEGION_WRITE_DISCARD, DIM>::access( \
+        args->datatype, bounds, regions[1]);                        \
+    break;                                                          \
+  }
+    LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+    default:
+      abort();
+  }
+  // View the row-major tile as [outer][len][inner] around the softmax
+  // dimension, which is never partitioned
+  size_t outer = 1, inner = 1;
+  for (unsigned d = 0; d < args->dim; d++)
+    outer *= (args->bounds.hi()[d] - args->bounds.lo()[d] + 1);
+  const size_t len =
+      args->bounds.hi()[args->dim] - args->bounds.lo()[args->dim] + 1;
+  for (int d = args->dim + 1; d < args->bounds.get_dim(); d++)
+    inner *= (args->bounds.hi()[d] - args->bounds.lo()[d] + 1);
+  switch (args->datatype) {
+    case DT_HALF: {
+      // No host arithmetic for half precision so compute in float
+      const size_t volume = outer * len * inner;
+      std::vector<float> input_buffer(volume), output_buffer(volume);
+      const __half* input = (const __half*)input_ptr;
+      __half* output = (__half*)output_ptr;
+      for (size_t i = 0; i < volume; i++)
+        input_buffer[i] = static_cast<float>(input[i]);
+      cpu_softmax<float>(
+          input_buffer.data(), output_buffer.data(), outer, len, inner);
+      for (size_t i = 0; i < volume; i++) output[i] = __half(output_buffer[i]);
+      break;
+    }
+    case DT_FLOAT: {
+      cpu_softmax<float>(
+          (const float*)input_ptr, (float*)output_ptr, outer, len, inner);
+      break;
+    }
+    case DT_DOUBLE: {
+      cpu_softmax<double>(
+          (const double*)input_ptr, (double*)output_ptr, outer, len, inner);
+      break;
+    }
+    default:
+      abort();
+  }
 }
 
 SoftmaxArgs::SoftmaxArgs(void) {}
@@ -14,6 +14,7 @@
  */
 
 #include "unary.h"
+#include "cpu_kernels.h"
 
 using namespace Legion;
 
@@ -272,13 +273,254 @@ UnaryOperator::PreregisterTaskVariants(void)
 #endif
 }
 
+// Half precision has no host arithmetic so convert blocks of it to float
+static void
+unary_forward_cpu_half(
+    OperatorType op_type, __half scalar, const __half* input, __half* output,
+    size_t num_elements)
+{
+  const size_t BLOCK = 1024;
+  float buffer[BLOCK];
+  for (size_t offset = 0; offset < num_elements; offset += BLOCK) {
+    const size_t count = std::min(BLOCK, num_elements - offset);
+    for (size_t i = 0; i < count; i++)
+      buffer[i] = static_cast<float>(input[offset + i]);
+    cpu_unary<float>(
+        op_type, static_cast<float>(scalar), buffer, buffer, count);
+    for (size_t i = 0; i < count; i++) output[offset + i] = __half(buffer[i]);
+  }
+}
+
+template <typename TO, typename TI>
+static void
+cast_cpu(const TI* __restrict__ input, TO* __restrict__ output, size_t count)
+{
+  for (size_t i = 0; i < count; i++) output[i] = static_cast<TO>(input[i]);
+}
+
+template <typename TI>
+static void
+cast_cpu(const TI* input, __half* output, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+    output[i] = __half(static_cast<float>(input[i]));
+}
+
+template <typename TO>
+static void
+cast_cpu(const __half* input, TO* output, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+    output[i] = static_cast<TO>(static_cast<float>(input[i]));
+}
+
+static void
+cast_cpu(const __half* input, __half* output, size_t count)
+{
+  std::copy(input, input + count, output);
+}
+
+template <typename TI>
+static void
+cast_cpu(DataType casttype, const TI* input, void* output, size_t count)
+{
+  switch (casttype) {
+    case DT_HALF: {
+      cast_cpu(input, (__half*)output, count);
+      break;
+    }
+    case DT_FLOAT: {
+      cast_cpu(input, (float*)output, count);
+      break;
+    }
+    case DT_DOUBLE: {
+      cast_cpu(input, (double*)output, count);
+      break;
+    }
+    case DT_INT8: {
+      cast_cpu(input, (int8_t*)output, count);
+      break;
+    }
+    case DT_INT16: {
+      cast_cpu(input, (int16_t*)output, count);
+      break;
+    }
+    case DT_INT32: {
+      cast_cpu(input, (int32_t*)output, count);
+      break;
+    }
+    case DT_INT64: {
+      cast_cpu(input, (int64_t*)output, count);
+      break;
+    }
+    case DT_UINT8: {
+      cast_cpu(input, (uint8_t*)output, count);
+      break;
+    }
+    case DT_UINT16: {
+      cast_cpu(input, (uint16_t*)output, count);
+      break;
+    }
+    case DT_UINT32: {
+      cast_cpu(input, (uint32_t*)output, count);
+      break;
+    }
+    case DT_UINT64: {
+      cast_cpu(input, (uint64_t*)output, count);
+      break;
+    }
+    case DT_BOOLEAN: {
+      cast_cpu(input, (bool*)output, count);
+      break;
+    }
+    default:
+      abort();
+  }
+}
+
+static void
+cast_cpu(
+    DataType datatype, DataType casttype, const void* input, void* output,
+    size_t count)
+{
+  switch (datatype) {
+    case DT_HALF: {
+      cast_cpu(casttype, (const __half*)input, output, count);
+      break;
+    }
+    case DT_FLOAT: {
+      cast_cpu(casttype, (const float*)input, output, count);
+      break;
+    }
+    case DT_DOUBLE: {
+      cast_cpu(casttype, (const double*)input, output, count);
+      break;
+    }
+    case DT_INT8: {
+      cast_cpu(casttype, (const int8_t*)input, output, count);
+      break;
+    }
+    case DT_INT16: {
+      cast_cpu(casttype, (const int16_t*)input, output, count);
+      break;
+    }
+    case DT_INT32: {
+      cast_cpu(casttype, (const int32_t*)input, output, count);
+      break;
+    }
+    case DT_INT64: {
+      cast_cpu(casttype, (const int64_t*)input, output, count);
+      break;
+    }
+    case DT_UINT8: {
+      cast_cpu(casttype, (const uint8_t*)input, output, count);
+      break;
+    }
+    case DT_UINT16: {
+      cast_cpu(casttype, (const uint16_t*)input, output, count);
+      break;
+    }
+    case DT_UINT32: {
+      cast_cpu(casttype, (const uint32_t*)input, output, count);
+      break;
+    }
+    case DT_UINT64: {
+      cast_cpu(casttype, (const uint64_t*)input, output, count);
+      break;
+    }
+    case DT_BOOLEAN: {
+      cast_cpu(casttype, (const bool*)input, output, count);
+      break;
+    }
+    default:
+      abort();
+  }
+}
+
 /*static*/ void
 UnaryOperator::forward_cpu(
     const Task* task, const std::vector<PhysicalRegion>& regions, Context ctx,
     Runtime* runtime)
 {
-  // TODO: implement this
-  assert(false);
+  assert(task->local_arglen == sizeof(UnaryArgs));
+  const UnaryArgs* args = (const UnaryArgs*)task->local_args;
+  const void* input_ptr = nullptr;
+  void* output_ptr = nullptr;
+  size_t volume = 0;
+  if (args->inplace) {
+    assert(regions.size() == 1);
+    assert(task->regions.size() == 1);
+    switch (args->bounds.get_dim()) {
+#define DIMFUNC(DIM)                                             \
+  case DIM: {                                                    \
+    const Rect<DIM> bounds = args->bounds;                       \
+    volume = bounds.volume();                                    \
+    output_ptr = TensorAccessor<LEGION_READ_WRITE, DIM>::access( \
+        args->datatype, bounds, regions[0]);                     \
+    input_ptr = output_ptr;                                      \
+    break;                                                       \
+  }
+      LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+      default:
+        abort();
+    }
+  } else {
+    assert(regions.size() == 2);
+    assert(task->regions.size() == 2);
+    const DataType output_type =
+        (args->op_type == OP_CAST) ? args->casttype : args->datatype;
+    switch (args->bounds.get_dim()) {
+#define DIMFUNC(DIM)                                                \
+  case DIM: {                                                       \
+    const Rect<DIM> bounds = args->bounds;                          \
+    volume = bounds.volume();                                       \
+    input_ptr = TensorAccessor<LEGION_READ_ONLY, DIM>::access(      \
+        args->datatype, bounds, regions[0]);                        \
+    output_ptr = TensorAccessor<LEGION_WRITE_DISCARD, DIM>::access( \
+        output_type, bounds, regions[1]);                           \
+    break;                                                          \
+  }
+      LEGION_FOREACH_N(DIMFUNC)
+#undef DIMFUNC
+      default:
+        abort();
+    }
+  }
+  if (args->op_type == OP_CAST) {
+    if (args->inplace)
+      assert(args->casttype == args->datatype);
+    else
+      cast_cpu(args->datatype, args->casttype, input_ptr, output_ptr, volume);
+    return;
+  }
+  if ((args->op_type == OP_IDENTITY) && (input_ptr != output_ptr)) {
+    memcpy(output_ptr, input_ptr, volume * sizeof_datatype(args->datatype));
+    return;
+  }
+  switch (args->datatype) {
+    case DT_HALF: {
+      unary_forward_cpu_half(
+          args->op_type, args->scalar.half_value, (const __half*)input_ptr,
+          (__half*)output_ptr, volume);
+      break;
+    }
+    case DT_FLOAT: {
+      cpu_unary<float>(
+          args->op_type, args->scalar.float_value, (const float*)input_ptr,
+          (float*)output_ptr, volume);
+      break;
+    }
+    case DT_DOUBLE: {
+      cpu_unary<double>(
+          args->op_type, args->scalar.double_value, (const double*)input_ptr,
+          (double*)output_ptr, volume);
+      break;
+    }
+    default:
+      // Integer types only support cast and identity, as on the GPU
+      abort();
+  }
 }
 
 #ifdef LEGION_USE_CUDA
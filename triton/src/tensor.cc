@@ -14,6 +14,7 @@
  */
 
 #include "tensor.h"
+#include <cstdlib>
 #include "operator.h"
 
 using namespace Legion;
@@ -47,6 +48,7 @@ Weights::Weights(Operator* op, DataType t, const size_t* dims, size_t num_dims)
   for (size_t idx = 0; idx < MAX_LOCAL_PROCS; ++idx) {
     local_memory[idx] = local_sysmem;
     local_allocation[idx] = nullptr;
+    local_view[idx] = false;
   }
 }
 
@@ -57,6 +59,7 @@ Weights::Weights(Operator* op, DataType t, const std::vector<size_t>& dims)
   for (size_t idx = 0; idx < MAX_LOCAL_PROCS; ++idx) {
     local_memory[idx] = local_sysmem;
     local_allocation[idx] = nullptr;
+    local_view[idx] = false;
   }
 }
 
@@ -67,4 +70,14 @@ Weights::~Weights(void)
   }
 }
 
+void
+Weights::FreeLocalAllocation(unsigned local_index)
+{
+  assert(local_index < MAX_LOCAL_PROCS);
+  if (!local_view[local_index])
+    std::free(local_allocation[local_index]);
+  local_allocation[local_index] = nullptr;
+  local_view[local_index] = false;
+}
+
 }}}  // namespace triton::backend::legion
@@ -16,6 +16,7 @@
 #ifndef __LEGION_TRITON_TENSOR_H__
 #define __LEGION_TRITON_TENSOR_H__
 
+#include <memory>
 #include "config.h"
 #include "legion.h"
 #include "types.h"
@@ -29,7 +30,7 @@ class Tensor {
   virtual ~Tensor(void);
 
  public:
-  Operator* const owner;
+  Operator* owner;  // updated when the producer is fused into another
   const DataType type;
   const std::vector<size_t> bounds;
 
@@ -44,11 +45,20 @@ class Weights : public Tensor {
   Weights(Operator* op, DataType type, const std::vector<size_t>& dims);
   virtual ~Weights(void);
 
+  // Release the local allocation of a processor, views of mapped external
+  // data are dropped rather than freed
+  void FreeLocalAllocation(unsigned local_index);
+
  public:
   Legion::Domain local_bounds[MAX_LOCAL_PROCS];
   Legion::Memory local_memory[MAX_LOCAL_PROCS];
   void* local_allocation[MAX_LOCAL_PROCS];
   size_t local_strides[MAX_LOCAL_PROCS][LEGION_MAX_DIM];
+  // Whether the local allocation points into 'mapping' instead of memory
+  // owned by the weights, the mapping is shared by all the weights stored
+  // in the same external data file
+  bool local_view[MAX_LOCAL_PROCS];
+  std::shared_ptr<const void> mapping;
 };
 
 }}}  // namespace triton::backend::legion
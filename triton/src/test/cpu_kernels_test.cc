@@ -0,0 +1,198 @@
+/* Copyright 2022 NVIDIA CORPORATION
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "gtest/gtest.h"
+
+#include <random>
+
+#include "operators/cpu_kernels.h"
+
+namespace {
+
+namespace tbl = triton::backend::legion;
+
+std::vector<float>
+RandomVector(size_t size, unsigned seed)
+{
+  std::mt19937 gen(seed);
+  std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+  std::vector<float> result(size);
+  for (auto& value : result) value = dist(gen);
+  return result;
+}
+
+TEST(CpuKernelsTest, Gemm)
+{
+  // Sizes straddle the panel and row blocking
+  const size_t m = 7, n = 300, k = 131;
+  auto a = RandomVector(m * k, 1);
+  auto b = RandomVector(k * n, 2);
+  std::vector<float> c(m * n, 42.0f);
+  tbl::cpu_gemm(m, n, k, a.data(), k, b.data(), n, c.data(), n);
+  for (size_t i = 0; i < m; i++) {
+    for (size_t j = 0; j < n; j++) {
+      float expected = 0.0f;
+      for (size_t p = 0; p < k; p++) expected += a[i * k + p] * b[p * n + j];
+      EXPECT_NEAR(c[i * n + j], expected, 1e-4f) << i << ", " << j;
+    }
+  }
+}
+
+// Direct convolution of a whole single-channel image as the reference
+TEST(CpuKernelsTest, Im2colConvolution)
+{
+  const size_t channels = 2, height = 5, width = 6, kernel = 3, stride = 2;
+  const long pad = 1;
+  const size_t out_h = (height + 2 * pad - kernel) / stride + 1;
+  const size_t out_w = (width + 2 * pad - kernel) / stride + 1;
+  auto input = RandomVector(channels * height * width, 3);
+  auto filter = RandomVector(channels * kernel * kernel, 4);
+
+  tbl::CpuWindow window;
+  window.in_h = height;
+  window.in_w = width;
+  window.in_h0 = 0;
+  window.in_w0 = 0;
+  window.out_h = out_h;
+  window.out_w = out_w;
+  window.out_h0 = 0;
+  window.out_w0 = 0;
+  window.kernel_h = kernel;
+  window.kernel_w = kernel;
+  window.stride_h = stride;
+  window.stride_w = stride;
+  window.pad_h = pad;
+  window.pad_w = pad;
+  const size_t patch = channels * kernel * kernel;
+  std::vector<float> col(patch * out_h * out_w);
+  tbl::cpu_im2col(input.data(), channels, window, col.data());
+  std::vector<float> output(out_h * out_w);
+  tbl::cpu_gemm(
+      1, out_h * out_w, patch, filter.data(), patch, col.data(), out_h * out_w,
+      output.data(), out_h * out_w);
+
+  for (size_t oh = 0; oh < out_h; oh++) {
+    for (size_t ow = 0; ow < out_w; ow++) {
+      float expected = 0.0f;
+      for (size_t c = 0; c < channels; c++) {
+        for (size_t kh = 0; kh < kernel; kh++) {
+          for (size_t kw = 0; kw < kernel; kw++) {
+            const long ih = long(oh * stride + kh) - pad;
+            const long iw = long(ow * stride + kw) - pad;
+            if ((ih < 0) || (ih >= long(height)) || (iw < 0) ||
+                (iw >= long(width)))
+              continue;
+            expected += input[(c * height + ih) * width + iw] *
+                        filter[(c * kernel + kh) * kernel + kw];
+          }
+        }
+      }
+      EXPECT_NEAR(output[oh * out_w + ow], expected, 1e-5f);
+    }
+  }
+}
+
+// Pooling a tile with a halo must match pooling the whole image
+TEST(CpuKernelsTest, Pool2dTile)
+{
+  const long height = 6, width = 4;
+  std::vector<float> image(height * width);
+  for (size_t i = 0; i < image.size(); i++) image[i] = float(i);
+
+  tbl::CpuWindow full;
+  full.in_h = height;
+  full.in_w = width;
+  full.in_h0 = 0;
+  full.in_w0 = 0;
+  full.out_h = 3;
+  full.out_w = 2;
+  full.out_h0 = 0;
+  full.out_w0 = 0;
+  full.kernel_h = 3;
+  full.kernel_w = 3;
+  full.stride_h = 2;
+  full.stride_w = 2;
+  full.pad_h = 1;
+  full.pad_w = 1;
+  for (bool max_pool : {true, false}) {
+    std::vector<float> expected(6);
+    tbl::cpu_pool2d(
+        image.data(), expected.data(), 1, full, height, width, max_pool);
+    // The second output row reads input rows 1 to 3
+    tbl::CpuWindow tile = full;
+    tile.in_h = 3;
+    tile.in_h0 = 1;
+    tile.out_h = 1;
+    tile.out_h0 = 1;
+    std::vector<float> output(2);
+    tbl::cpu_pool2d(
+        image.data() + width, output.data(), 1, tile, height, width,
+        max_pool);
+    EXPECT_FLOAT_EQ(output[0], expected[2]);
+    EXPECT_FLOAT_EQ(output[1], expected[3]);
+  }
+  // Corner window covers rows 0-1 and columns 0-1 once padding is excluded
+  std::vector<float> avg(6);
+  tbl::cpu_pool2d(image.data(), avg.data(), 1, full, height, width, false);
+  EXPECT_FLOAT_EQ(avg[0], (0.0f + 1.0f + 4.0f + 5.0f) / 4.0f);
+}
+
+TEST(CpuKernelsTest, Softmax)
+{
+  // Softmax over the middle axis of a [2][3][5] tensor
+  const size_t outer = 2, len = 3, inner = 5;
+  auto input = RandomVector(outer * len * inner, 5);
+  for (size_t inner_size : {inner, size_t(1)}) {
+    const size_t rows = outer * len * inner / (len * inner_size);
+    std::vector<float> output(input.size());
+    tbl::cpu_softmax(input.data(), output.data(), rows, len, inner_size);
+    for (size_t o = 0; o < rows; o++) {
+      for (size_t i = 0; i < inner_size; i++) {
+        float sum = 0.0f;
+        for (size_t l = 0; l < len; l++)
+          sum += std::exp(input[(o * len + l) * inner_size + i]);
+        for (size_t l = 0; l < len; l++) {
+          const size_t idx = (o * len + l) * inner_size + i;
+          EXPECT_NEAR(output[idx], std::exp(input[idx]) / sum, 1e-6f);
+        }
+      }
+    }
+  }
+}
+
+
+TEST(CpuKernelsTest, ElementwiseChain)
+{
+  // relu(x * 2 + a) - b computed in place on x; spans several blocks
+  const size_t n = 2 * tbl::FUSED_BLOCK_SIZE + 3;
+  auto x = RandomVector(n, 6);
+  auto a = RandomVector(n, 7);
+  auto b = RandomVector(n, 8);
+  const float* inputs[] = {nullptr, a.data(), b.data()};
+  tbl::CpuElementwiseStep steps[4];
+  steps[0] = {tbl::OP_SCALAR_MULTIPLY, -1, false, 2.0};
+  steps[1] = {tbl::OP_EW_ADD, 1, true, 0.0};
+  steps[2] = {tbl::OP_RELU, -1, false, 0.0};
+  steps[3] = {tbl::OP_EW_SUB, 2, false, 0.0};
+  std::vector<float> output = x;
+  tbl::cpu_elementwise_chain<float>(
+      steps, 4, output.data(), inputs, output.data(), n);
+  for (size_t i = 0; i < n; i++) {
+    const float expected = std::max(x[i] * 2.0f + a[i], 0.0f) - b[i];
+    EXPECT_NEAR(output[i], expected, 1e-6f);
+  }
+}
+
+}  // namespace
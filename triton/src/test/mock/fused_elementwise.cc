@@ -0,0 +1,29 @@
+/* Copyright 2022 NVIDIA CORPORATION
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "operators/fused_elementwise.h"
+
+namespace triton { namespace backend { namespace legion {
+
+// The parser never fuses layers, only task registration is referenced
+
+void
+FusedElementwise::PreregisterTaskVariants()
+{
+  throw std::invalid_argument(
+      "This function shouldn't be called in parser unit test");
+}
+
+}}}  // namespace triton::backend::legion
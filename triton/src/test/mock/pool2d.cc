@@ -80,4 +80,11 @@ Pool2D::Free(Realm::Processor processor)
       "This function shouldn't be called in parser unit test");
 }
 
+void
+Pool2D::PreregisterTaskVariants()
+{
+  throw std::invalid_argument(
+      "This function shouldn't be called in parser unit test");
+}
+
 }}}  // namespace triton::backend::legion
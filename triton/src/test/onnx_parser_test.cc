@@ -537,6 +537,48 @@ TEST_F(OnnxParserSingleNodeSingleProcessorTest, ParseConv2D)
       std::vector<size_t>({4, 2, 3, 3}));
 }
 
+TEST_F(OnnxParserSingleNodeSingleProcessorTest, ParseConv2DExternalData)
+{
+  // Same model as 'conv2d_with_bias.onnx' with the weight and the bias
+  // stored in 'conv2d_external_data.bin' at offset 0 and 128
+  std::vector<tbl::Tensor*> model_stub;
+  tbl::PartitionStrategy strategy(
+      reinterpret_cast<tbl::LegionModelState*>(&model_stub),
+      {reinterpret_cast<const tbl::LayerStrategy*>(&layer_strategy_)});
+  std::vector<std::pair<std::string, tbl::Tensor*>> inputs;
+  std::vector<std::pair<std::string, tbl::Tensor*>> outputs;
+  std::vector<tbl::Operator*> layers;
+
+  auto err = tbl::OnnxParser::LoadModel(
+      find_local_processor_fn_,
+      reinterpret_cast<tbl::LegionModelState*>(&model_stub), &strategy,
+      "data/conv2d_external_data.onnx", &inputs, &outputs, &layers);
+  ASSERT_TRUE(err == nullptr) << TRITONSERVER_ErrorMessage(err);
+
+  ASSERT_EQ(model_stub.size(), 4) << "Expect 4 tensors are parsed";
+  ASSERT_EQ(layers.size(), 1) << "Expect 1 layer is parsed";
+  auto weight = dynamic_cast<tbl::Weights*>(model_stub[1]);
+  auto bias = dynamic_cast<tbl::Weights*>(model_stub[2]);
+  ASSERT_TRUE((weight != nullptr) && (bias != nullptr));
+
+  // The only processor holds the whole weights, so both are views of the
+  // same mapping of the external data file
+  EXPECT_TRUE(weight->local_view[0]);
+  EXPECT_TRUE(bias->local_view[0]);
+  EXPECT_TRUE(weight->mapping != nullptr);
+  EXPECT_EQ(weight->mapping, bias->mapping);
+  const float* weight_data =
+      reinterpret_cast<const float*>(weight->local_allocation[0]);
+  for (size_t idx = 0; idx < 18; ++idx) {
+    EXPECT_EQ(weight_data[idx], float(idx))
+        << "Mismatched value at weight entry (" << idx << ")";
+  }
+  const float* bias_data =
+      reinterpret_cast<const float*>(bias->local_allocation[0]);
+  EXPECT_EQ(bias_data[0], 0.0f);
+  EXPECT_EQ(bias_data[1], 1.0f);
+}
+
 TEST_F(OnnxParserSingleNodeSingleProcessorTest, ParseIdentity)
 {
   std::vector<tbl::Tensor*> model_stub;
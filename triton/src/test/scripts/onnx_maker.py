@@ -18,6 +18,8 @@ from onnx import helper
 from onnx import TensorProto as tp
 from onnx import checker
 from onnx import save
+from onnx import external_data_helper
+import numpy as np
 import sys
 import argparse
 import os
@@ -163,6 +165,7 @@ def cast(path):
 def conv_models(path):
     conv(path)
     conv_strides(path)
+    conv_external_data(path)
 
 
 def conv(path):
@@ -218,6 +221,44 @@ def conv_autopad(path):
     save(model, os.path.join(path, 'conv_autopad.onnx'))
 
 
+def conv_external_data(path):
+    # Weight and bias are stored in 'conv2d_external_data.bin' at offset 0
+    # and 128 respectively
+    location = 'conv2d_external_data.bin'
+    weight_data = np.arange(18, dtype=np.float32).tobytes()
+    bias_data = np.arange(2, dtype=np.float32).tobytes()
+    with open(os.path.join(path, location), 'wb') as f:
+        f.write(weight_data)
+        f.write(bytes(128 - len(weight_data)))
+        f.write(bias_data)
+    weight = helper.make_tensor('weight', tp.FLOAT, [2, 1, 3, 3],
+                                weight_data, raw=True)
+    bias = helper.make_tensor('bias', tp.FLOAT, [2], bias_data, raw=True)
+    for tensor, offset in [(weight, 0), (bias, 128)]:
+        external_data_helper.set_external_data(tensor, location, offset,
+                                               len(tensor.raw_data))
+        tensor.ClearField('raw_data')
+        tensor.data_location = tp.EXTERNAL
+    node = helper.make_node(
+        'Conv',
+        inputs=['input', 'weight', 'bias'],
+        outputs=['3'],
+        dilations=[1, 1],
+        group=1,
+        kernel_shape=[3, 3],
+        pads=[0, 0, 0, 0],
+        strides=[1, 1],
+    )
+    graph = helper.make_graph(
+        [node],
+        'test_graph',
+        [helper.make_tensor_value_info('input', tp.FLOAT, [4, 1, 5, 5])],
+        [helper.make_tensor_value_info('3', tp.FLOAT, [4, 2, 3, 3])],
+        initializer=[weight, bias])
+    model = helper.make_model(graph, producer_name='model')
+    save(model, os.path.join(path, 'conv2d_external_data.onnx'))
+
+
 ## Flatten
 
 
@@ -166,7 +166,9 @@ enum LayerTaskID {
   BINARY_TASK_ID,
   CONCAT_TASK_ID,
   CONV2D_TASK_ID,
+  FUSED_ELEMENTWISE_TASK_ID,
   MATMUL_TASK_ID,
+  POOL2D_TASK_ID,
   RESHAPE_TASK_ID,
   SOFTMAX_TASK_ID,
   UNARY_TASK_ID,